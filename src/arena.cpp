@@ -0,0 +1,134 @@
+#include "arena.h"
+#include "schema.h"
+#include "profile.h"
+#include <fstream>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+using namespace std;
+
+RecordArena::RecordArena(size_t blockSize) : blockSize(blockSize) {
+}
+
+// Uninitialised space for bytes characters
+char* RecordArena::allocate(size_t bytes) {
+    if (blocks.empty() || blocks.back().size - blocks.back().used < bytes) {
+        Block block;
+        block.size = max(blockSize, bytes);
+        block.data.reset(new char[block.size]);
+        block.used = 0;
+        blocks.push_back(move(block));
+    }
+
+    Block& block = blocks.back();
+    char* memory = block.data.get() + block.used;
+    block.used += bytes;
+    return memory;
+}
+
+// Copy text into the arena
+string_view RecordArena::copy(string_view text) {
+    char* memory = allocate(text.size());
+    memcpy(memory, text.data(), text.size());
+    return string_view(memory, text.size());
+}
+
+// Rewind for reuse, keeping only the largest block
+void RecordArena::reset() {
+    if (blocks.empty()) {
+        return;
+    }
+
+    size_t largest = 0;
+    for (size_t i = 1; i < blocks.size(); i++) {
+        if (blocks[i].size > blocks[largest].size) {
+            largest = i;
+        }
+    }
+
+    Block kept = move(blocks[largest]);
+    kept.used = 0;
+    blocks.clear();
+    blocks.push_back(move(kept));
+}
+
+size_t RecordArena::bytesUsed() const {
+    size_t total = 0;
+    for (const auto& block : blocks) {
+        total += block.used;
+    }
+    return total;
+}
+
+size_t RecordArena::blockCount() const {
+    return blocks.size();
+}
+
+// Read a whole file into the arena as one block
+bool readFileIntoArena(const string& fileName, RecordArena& arena, string_view& contents) {
+    ProfileSpan span("file", "readFileIntoArena");
+    ifstream file(fileName, ios::binary | ios::ate);
+
+    if (!file.is_open()) {
+        return false;
+    }
+
+    streamoff size = file.tellg();
+    file.seekg(0);
+
+    char* memory = arena.allocate((size_t)size);
+    file.read(memory, size);
+    contents = string_view(memory, (size_t)file.gcount());
+    return true;
+}
+
+// Split text at '|' into at most maxFields views
+size_t splitFields(string_view text, string_view* fields, size_t maxFields) {
+    size_t count = 0;
+    size_t start = 0;
+
+    // Like getline on a stringstream, a trailing '|' does not start an empty field
+    while (count < maxFields && start < text.size()) {
+        size_t bar = text.find('|', start);
+        if (bar == string_view::npos) {
+            bar = text.size();
+        }
+        fields[count++] = text.substr(start, bar - start);
+        start = bar + 1;
+    }
+
+    return count;
+}
+
+// Next line of text starting at offset, advancing offset
+bool nextLine(string_view text, size_t& offset, string_view& line) {
+    if (offset >= text.size()) {
+        return false;
+    }
+
+    size_t end = text.find('\n', offset);
+    if (end == string_view::npos) {
+        end = text.size();
+    }
+
+    line = text.substr(offset, end - offset);
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+
+    offset = end + 1;
+    return true;
+}
+
+// Integer field, 0 if it does not start with a number
+int parseIntField(string_view text) {
+    int value = 0;
+    from_chars(text.data(), text.data() + text.size(), value);
+    return value;
+}
+
+// Floating-point field, 0 if it does not start with a number
+double parseDoubleField(string_view text) {
+    return parseDoubleText(text);
+}
@@ -0,0 +1,57 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+
+using namespace std;
+
+// Bump allocator for record text. A loaded file lives in one contiguous block
+// and the fields parsed from it are string_views into that block, so a scan
+// makes a handful of allocations instead of several per record. Everything is
+// released at once by reset() or when the arena goes away.
+class RecordArena {
+private:
+    struct Block {
+        unique_ptr<char[]> data;
+        size_t size;
+        size_t used;
+    };
+
+    vector<Block> blocks;
+    size_t blockSize;
+
+public:
+    explicit RecordArena(size_t blockSize = 64 * 1024);
+
+    // Uninitialised space for bytes characters
+    char* allocate(size_t bytes);
+
+    // Copy text into the arena
+    string_view copy(string_view text);
+
+    // Rewind for reuse; keeps the largest block so similar-sized loads do not reallocate
+    void reset();
+
+    size_t bytesUsed() const;
+    size_t blockCount() const;
+};
+
+// Read a whole file into the arena as one block. False if it cannot be opened.
+bool readFileIntoArena(const string& fileName, RecordArena& arena, string_view& contents);
+
+// Split text at '|' into at most maxFields views; returns the number found.
+// Matches getline(ss, token, '|'): empty text and a trailing '|' add no field.
+size_t splitFields(string_view text, string_view* fields, size_t maxFields);
+
+// Next line of text starting at offset (without '\n' or '\r'), advancing offset.
+// False once the text is exhausted.
+bool nextLine(string_view text, size_t& offset, string_view& line);
+
+// Number parsing without the temporary strings stoi/stod need
+int parseIntField(string_view text);
+double parseDoubleField(string_view text);
+
+#endif // ARENA_H
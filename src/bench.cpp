@@ -0,0 +1,114 @@
+// Load and search benchmark: counts heap allocations and measures throughput.
+// Build with "make bench" and run tourmate_bench from a data directory.
+#include "vehicle.h"
+#include "sales.h"
+#include "topk.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+static atomic<unsigned long long> allocationCount(0);
+
+// Count every heap allocation made through operator new
+void* operator new(size_t size) {
+    allocationCount++;
+    void* memory = malloc(size == 0 ? 1 : size);
+    if (memory == nullptr) {
+        throw bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+
+// Time one phase and report rows/s and allocations per row
+template <typename Phase>
+static void runPhase(const string& name, Phase phase) {
+    unsigned long long allocationsBefore = allocationCount;
+    auto start = chrono::steady_clock::now();
+
+    long long rows = phase();
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    unsigned long long allocations = allocationCount - allocationsBefore;
+
+    cout << left << setw(18) << name
+         << right << setw(10) << rows
+         << setw(10) << fixed << setprecision(1) << seconds * 1000.0
+         << setw(14) << setprecision(0) << (seconds > 0 ? rows / seconds : 0.0)
+         << setw(14) << allocations
+         << setw(12) << setprecision(2) << (rows > 0 ? (double)allocations / rows : 0.0) << endl;
+}
+
+int main() {
+    cout << left << setw(18) << "Phase"
+         << right << setw(10) << "Rows" << setw(10) << "ms" << setw(14) << "Rows/s"
+         << setw(14) << "Allocations" << setw(12) << "Allocs/row" << endl;
+    cout << string(78, '-') << endl;
+
+    vector<Vehicle> vehicles;
+    long long matches = 0;
+
+    runPhase("load vehicles", [&vehicles]() {
+        vehicles = loadVehiclesFromFile();
+        return (long long)vehicles.size();
+    });
+
+    runPhase("search vehicles", [&vehicles, &matches]() {
+        long long rows = 0;
+        for (int pass = 0; pass < 20; pass++) {
+            for (const auto& vehicle : vehicles) {
+                rows++;
+                if (vehicle.getType() == "SUV" && vehicle.getStatus() == "Available" &&
+                    vehicle.getMakeModel().find("Model1") != string::npos) {
+                    matches++;
+                }
+            }
+        }
+        return rows;
+    });
+
+    runPhase("load sales", []() {
+        return (long long)loadSalesFromFile().size();
+    });
+
+    runPhase("scan sales", []() {
+        long long rows = 0;
+        double total = 0;
+        forEachSaleInFile([&rows, &total](const Sales& sale) {
+            rows++;
+            total += sale.getAmount();
+        });
+        return rows;
+    });
+
+    runPhase("search sales", [&matches]() {
+        long long rows = 0;
+        forEachSaleInFile([&rows, &matches](const Sales& sale) {
+            rows++;
+            if (sale.getPaymentStatus() == "Paid" && sale.getCustomerName().find("Smith") != string::npos) {
+                matches++;
+            }
+        });
+        return rows;
+    });
+
+    runPhase("top customers", []() {
+        vector<RankedEntry> top = topCustomersBySpend(DEFAULT_TOP_K);
+        return countStoredSales();
+    });
+
+    cout << "\n(" << matches << " matches)" << endl;
+    return 0;
+}
@@ -0,0 +1,195 @@
+#include "bktree.h"
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+
+using namespace std;
+
+// Levenshtein edit distance between two strings (two-row dynamic programming)
+int editDistance(const string& a, const string& b) {
+    vector<int> previous(b.size() + 1);
+    vector<int> current(b.size() + 1);
+
+    for (size_t j = 0; j <= b.size(); j++) {
+        previous[j] = (int)j;
+    }
+
+    for (size_t i = 1; i <= a.size(); i++) {
+        current[0] = (int)i;
+        for (size_t j = 1; j <= b.size(); j++) {
+            int substitution = previous[j - 1] + (a[i - 1] == b[j - 1] ? 0 : 1);
+            current[j] = min(min(previous[j] + 1, current[j - 1] + 1), substitution);
+        }
+        swap(previous, current);
+    }
+
+    return previous[b.size()];
+}
+
+// File a record ID under a term, adding the term if it is new
+void BKTree::add(const string& term, const string& id) {
+    auto existing = nodeByTerm.find(term);
+    if (existing != nodeByTerm.end()) {
+        nodes[existing->second].ids.push_back(id);
+        return;
+    }
+
+    Node node;
+    node.term = term;
+    node.ids.push_back(id);
+    size_t newIndex = nodes.size();
+
+    if (!nodes.empty()) {
+        // Walk down from the root along edges labelled with the distance to each node
+        size_t current = 0;
+        while (true) {
+            int distance = editDistance(term, nodes[current].term);
+            bool descended = false;
+
+            for (const auto& child : nodes[current].children) {
+                if (child.first == distance) {
+                    current = child.second;
+                    descended = true;
+                    break;
+                }
+            }
+
+            if (!descended) {
+                nodes[current].children.push_back(make_pair(distance, newIndex));
+                break;
+            }
+        }
+    }
+
+    nodes.push_back(node);
+    nodeByTerm[term] = newIndex;
+}
+
+// Remove a record ID from a term
+void BKTree::remove(const string& term, const string& id) {
+    auto existing = nodeByTerm.find(term);
+    if (existing == nodeByTerm.end()) {
+        return;
+    }
+
+    vector<string>& ids = nodes[existing->second].ids;
+    auto it = find(ids.begin(), ids.end(), id);
+    if (it != ids.end()) {
+        ids.erase(it);
+    }
+}
+
+// Terms within maxDistance of the query, closest first
+vector<FuzzyMatch> BKTree::search(const string& query, int maxDistance) const {
+    vector<FuzzyMatch> matches;
+
+    if (nodes.empty()) {
+        return matches;
+    }
+
+    vector<size_t> pending(1, 0);
+    while (!pending.empty()) {
+        const Node& node = nodes[pending.back()];
+        pending.pop_back();
+
+        int distance = editDistance(query, node.term);
+        if (distance <= maxDistance && !node.ids.empty()) {
+            FuzzyMatch match = {node.term, distance, node.ids};
+            matches.push_back(match);
+        }
+
+        for (const auto& child : node.children) {
+            if (child.first >= distance - maxDistance && child.first <= distance + maxDistance) {
+                pending.push_back(child.second);
+            }
+        }
+    }
+
+    sort(matches.begin(), matches.end(), [](const FuzzyMatch& a, const FuzzyMatch& b) {
+        if (a.distance != b.distance) {
+            return a.distance < b.distance;
+        }
+        return a.term < b.term;
+    });
+
+    return matches;
+}
+
+// Number of distinct terms
+size_t BKTree::size() const {
+    return nodes.size();
+}
+
+void BKTree::clear() {
+    nodes.clear();
+    nodeByTerm.clear();
+}
+
+static string normalizeTerm(const string& text) {
+    string term = text;
+    transform(term.begin(), term.end(), term.begin(), [](unsigned char c) { return (char)tolower(c); });
+    return term;
+}
+
+// Constructor
+FuzzyIndex::FuzzyIndex() {
+    loaded = false;
+}
+
+// Index an append-only record
+void FuzzyIndex::add(const string& id, const string& text) {
+    tree.add(normalizeTerm(text), id);
+}
+
+// Index a record that may later be updated or removed
+void FuzzyIndex::replace(const string& id, const string& text) {
+    remove(id);
+    string term = normalizeTerm(text);
+    tree.add(term, id);
+    termById[id] = term;
+}
+
+void FuzzyIndex::remove(const string& id) {
+    auto it = termById.find(id);
+    if (it != termById.end()) {
+        tree.remove(it->second, id);
+        termById.erase(it);
+    }
+}
+
+// Matches within maxDistance edits, closest first
+vector<FuzzyMatch> FuzzyIndex::search(const string& query, int maxDistance) const {
+    return tree.search(normalizeTerm(query), maxDistance);
+}
+
+void FuzzyIndex::clear() {
+    tree.clear();
+    termById.clear();
+    loaded = false;
+}
+
+bool FuzzyIndex::isLoaded() const {
+    return loaded;
+}
+
+void FuzzyIndex::setLoaded(bool value) {
+    loaded = value;
+}
+
+// Prompt for the maximum edit distance of a fuzzy search
+int readMaxEditDistance(int defaultDistance) {
+    string input;
+    cout << "Maximum edit distance (Enter for " << defaultDistance << "): ";
+    getline(cin, input);
+
+    if (input.empty()) {
+        return defaultDistance;
+    }
+
+    try {
+        int distance = stoi(input);
+        return distance < 0 ? defaultDistance : distance;
+    } catch (...) {
+        return defaultDistance;
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef BKTREE_H
+#define BKTREE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+using namespace std;
+
+// Levenshtein edit distance between two strings
+int editDistance(const string& a, const string& b);
+
+// One fuzzy search hit: an indexed term and the record IDs filed under it
+struct FuzzyMatch {
+    string term;
+    int distance;
+    vector<string> ids;
+};
+
+// BK-tree over distinct terms. Each node's children are keyed by their edit
+// distance to the node, so a query within distance d only descends into
+// children whose key lies in [dist - d, dist + d] (triangle inequality).
+class BKTree {
+private:
+    struct Node {
+        string term;
+        vector<string> ids;                 // Records filed under this term
+        vector<pair<int, size_t>> children; // (distance to this node, child index)
+    };
+
+    vector<Node> nodes;
+    unordered_map<string, size_t> nodeByTerm;
+
+public:
+    // File a record ID under a term, adding the term if it is new
+    void add(const string& term, const string& id);
+
+    // Remove a record ID from a term (the term itself stays as an empty node)
+    void remove(const string& term, const string& id);
+
+    // Terms within maxDistance of the query, closest first
+    vector<FuzzyMatch> search(const string& query, int maxDistance) const;
+
+    // Number of distinct terms
+    size_t size() const;
+
+    void clear();
+};
+
+// Case-insensitive fuzzy index from record IDs to one text field
+class FuzzyIndex {
+private:
+    BKTree tree;
+    unordered_map<string, string> termById; // Only kept for records that can change
+    bool loaded;
+
+public:
+    // Constructor
+    FuzzyIndex();
+
+    // Index an append-only record
+    void add(const string& id, const string& text);
+
+    // Index a record that may later be updated or removed
+    void replace(const string& id, const string& text);
+    void remove(const string& id);
+
+    // Matches within maxDistance edits, closest first
+    vector<FuzzyMatch> search(const string& query, int maxDistance) const;
+
+    void clear();
+    bool isLoaded() const;
+    void setLoaded(bool value);
+};
+
+// Prompt for the maximum edit distance of a fuzzy search
+int readMaxEditDistance(int defaultDistance);
+
+#endif // BKTREE_H
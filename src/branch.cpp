@@ -0,0 +1,267 @@
+#include "branch.h"
+#include "vehicle.h"
+#include "sales.h"
+#include "fileutil.h"
+#include "profile.h"
+#include "prefetch.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <limits>
+#include <thread>
+
+using namespace std;
+
+static const string BRANCHES_FILE = "branches.txt";
+
+// Branches listed in branches.txt
+vector<Branch> loadBranches() {
+    vector<Branch> branches;
+    ifstream file(BRANCHES_FILE);
+    string line;
+
+    while (getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        size_t bar = line.find('|');
+        Branch branch;
+        branch.name = line.substr(0, bar);
+        branch.directory = bar == string::npos ? branch.name : line.substr(bar + 1);
+        if (!branch.name.empty() && !branch.directory.empty()) {
+            branches.push_back(branch);
+        }
+    }
+
+    return branches;
+}
+
+// Run work(i) for every branch on its own thread. Each branch's load
+// messages are held back and printed in branch order once all are done.
+void forEachBranchInParallel(const vector<Branch>& branches, const function<void(size_t)>& work) {
+    vector<thread> workers;
+    vector<ostringstream> messages(branches.size());
+    workers.reserve(branches.size());
+
+    for (size_t i = 0; i < branches.size(); i++) {
+        workers.push_back(thread([&branches, &work, &messages, i]() {
+            HeldMessagesScope hold(messages[i]);
+            DataDirectoryScope scope(branches[i].directory);
+            work(i);
+        }));
+    }
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (const auto& branchMessages : messages) {
+        cout << branchMessages.str();
+    }
+}
+
+// Totals of the current thread's data directory, in one pass over each table
+static BranchTotals computeTotalsInDataDirectory() {
+    ProfileSpan span("report", "branchTotals");
+    BranchTotals totals = {false, false, 0, 0, 0, 0, 0, 0.0, 0.0, 0.0};
+    vector<Vehicle> vehicles;
+
+    totals.hasVehicles = loadVehiclesInDataDirectory(vehicles);
+    totals.vehicles = (long long)vehicles.size();
+    for (const auto& vehicle : vehicles) {
+        if (vehicle.getStatus() == "Rented") {
+            totals.rented++;
+        }
+    }
+
+    totals.hasSales = forEachSaleViewInFile([&totals](const SalesView& sale) {
+        totals.sales++;
+        totals.amount += sale.getAmount();
+
+        if (sale.getPaymentStatus() == "Paid") {
+            totals.paidSales++;
+            totals.paidAmount += sale.getAmount();
+        } else if (sale.getPaymentStatus() == "Pending") {
+            totals.pendingSales++;
+            totals.pendingAmount += sale.getAmount();
+        }
+    });
+
+    return totals;
+}
+
+// Totals for every branch, in branch order
+vector<BranchTotals> computeBranchTotals(const vector<Branch>& branches) {
+    vector<BranchTotals> totals(branches.size());
+
+    forEachBranchInParallel(branches, [&totals](size_t i) {
+        totals[i] = computeTotalsInDataDirectory();
+    });
+
+    return totals;
+}
+
+// Print one row of the per-branch breakdown
+static void printBranchRow(const string& name, const BranchTotals& totals) {
+    cout << left << setw(16) << name.substr(0, 15)
+         << right << setw(10) << totals.vehicles
+         << setw(8) << totals.rented
+         << setw(10) << totals.sales
+         << fixed << setprecision(2) << setw(14) << totals.amount
+         << setw(14) << totals.paidAmount
+         << setw(14) << totals.pendingAmount << endl;
+}
+
+// Merged sales report with a per-branch breakdown
+void printBranchReport(const vector<Branch>& branches) {
+    ProfileSpan span("report", "printBranchReport");
+    vector<BranchTotals> totals = computeBranchTotals(branches);
+    BranchTotals all = {false, false, 0, 0, 0, 0, 0, 0.0, 0.0, 0.0};
+
+    cout << "\n===== SALES REPORT: ALL BRANCHES =====\n";
+    cout << "\nPER BRANCH\n";
+    cout << left << setw(16) << "Branch" << right << setw(10) << "Vehicles" << setw(8) << "Rented"
+         << setw(10) << "Sales" << setw(14) << "Amount($)" << setw(14) << "Received($)"
+         << setw(14) << "Pending($)" << endl;
+    cout << string(86, '-') << endl;
+
+    for (size_t i = 0; i < branches.size(); i++) {
+        const BranchTotals& branch = totals[i];
+        printBranchRow(branches[i].name, branch);
+
+        all.vehicles += branch.vehicles;
+        all.rented += branch.rented;
+        all.sales += branch.sales;
+        all.paidSales += branch.paidSales;
+        all.pendingSales += branch.pendingSales;
+        all.amount += branch.amount;
+        all.paidAmount += branch.paidAmount;
+        all.pendingAmount += branch.pendingAmount;
+    }
+
+    cout << string(86, '-') << endl;
+    printBranchRow("All branches", all);
+
+    cout << "\nTotal Number of Sales: " << all.sales << endl;
+    cout << "Total Sales Amount: $" << fixed << setprecision(2) << all.amount << endl;
+    cout << "Paid Sales: " << all.paidSales << endl;
+    cout << "Pending Payments: " << all.pendingSales << endl;
+
+    for (size_t i = 0; i < branches.size(); i++) {
+        if (!totals[i].hasVehicles && !totals[i].hasSales) {
+            cout << "Note: No vehicle or sales files were found for " << branches[i].name
+                 << " in " << branches[i].directory << "." << endl;
+        }
+    }
+}
+
+// Print a heading and count line around each branch's matches
+template <class Record>
+static long long printGroupedMatches(const vector<Branch>& branches, const vector<vector<Record>>& matches,
+                                     const string& noun) {
+    long long total = 0;
+
+    cout << "\nSearch Results:\n";
+    for (size_t i = 0; i < branches.size(); i++) {
+        cout << "\n===== " << branches[i].name << " (" << branches[i].directory << ") =====\n";
+        for (const Record& record : matches[i]) {
+            cout << "------------------------" << endl;
+            record.displayDetails();
+        }
+        cout << matches[i].size() << " matching " << noun << " in " << branches[i].name << "." << endl;
+        total += (long long)matches[i].size();
+    }
+
+    cout << "\nTotal: " << total << " matching " << noun << " across " << branches.size() << " branch(es)." << endl;
+    return total;
+}
+
+// Run a vehicle query on every branch and print the matches grouped by branch
+long long printBranchVehicleQuery(const vector<Branch>& branches, const Query& query) {
+    ProfileSpan span("query", "printBranchVehicleQuery");
+    vector<vector<Vehicle>> matches(branches.size());
+
+    forEachBranchInParallel(branches, [&matches, &query](size_t i) {
+        vector<Vehicle> vehicles;
+        loadVehiclesInDataDirectory(vehicles);
+        for (const auto& vehicle : vehicles) {
+            if (vehicleMatches(vehicle, query)) {
+                matches[i].push_back(vehicle);
+            }
+        }
+    });
+
+    return printGroupedMatches(branches, matches, "vehicle(s)");
+}
+
+// Run a sales query on every branch and print the matches grouped by branch
+long long printBranchSalesQuery(const vector<Branch>& branches, const Query& query) {
+    ProfileSpan span("query", "printBranchSalesQuery");
+    vector<vector<Sales>> matches(branches.size());
+
+    forEachBranchInParallel(branches, [&matches, &query](size_t i) {
+        forEachSaleInFile([&matches, &query, i](const Sales& sale) {
+            if (saleMatches(sale, query)) {
+                matches[i].push_back(sale);
+            }
+        });
+    });
+
+    return printGroupedMatches(branches, matches, "sale(s)");
+}
+
+// Interactive cross-branch reports and searches
+void branchMenu() {
+    vector<Branch> branches = loadBranches();
+    int choice;
+
+    cout << "\n===== ALL BRANCHES =====\n";
+    if (branches.empty()) {
+        cout << "No branches are configured. List them in " << BRANCHES_FILE
+             << " as name|directory, one per line." << endl;
+        return;
+    }
+
+    cout << "Branches: ";
+    for (size_t i = 0; i < branches.size(); i++) {
+        cout << (i > 0 ? ", " : "") << branches[i].name;
+    }
+    cout << "\n\n";
+    cout << "1. Sales Report (all branches)\n";
+    cout << "2. Search Vehicles (all branches)\n";
+    cout << "3. Search Sales (all branches)\n";
+    cout << "Enter your choice: ";
+
+    cin >> choice;
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+
+    if (choice == 1) {
+        printBranchReport(branches);
+        return;
+    }
+    if (choice != 2 && choice != 3) {
+        cout << "Invalid choice." << endl;
+        return;
+    }
+
+    string text;
+    Query query;
+    string error;
+
+    printQueryHelp();
+    cout << "Enter query: ";
+    getline(cin, text);
+
+    bool parsed = choice == 2 ? parseVehicleQuery(text, query, error) : parseSalesQuery(text, query, error);
+    if (!parsed) {
+        cout << "Invalid query: " << error << endl;
+        return;
+    }
+
+    if (choice == 2) {
+        printBranchVehicleQuery(branches, query);
+    } else {
+        printBranchSalesQuery(branches, query);
+    }
+}
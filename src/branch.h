@@ -0,0 +1,61 @@
+#ifndef BRANCH_H
+#define BRANCH_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "query.h"
+
+using namespace std;
+
+// Each depot (branch) keeps its own vehicles and sales in a directory of its
+// own. branches.txt in the working directory lists them, one "name|directory"
+// per line ("." is the working directory itself). Cross-branch reports and
+// searches treat every branch as a shard: one thread per branch reads that
+// branch's tables through a DataDirectoryScope, and the results are merged in
+// branches.txt order. Branch reads never touch the shared in-memory indexes,
+// which always describe the working directory, and never change a branch's
+// files: a legacy sales.txt or vehicles.txt there is read as it is.
+
+// One branch and the directory holding its tables
+struct Branch {
+    string name;
+    string directory;
+};
+
+// Sales and fleet totals of one branch
+struct BranchTotals {
+    bool hasVehicles;       // False if the directory has no vehicle table
+    bool hasSales;          // False if the directory has no sales
+    long long vehicles;
+    long long rented;
+    long long sales;
+    long long paidSales;
+    long long pendingSales;
+    double amount;
+    double paidAmount;
+    double pendingAmount;
+};
+
+// Branches listed in branches.txt (empty if there is none)
+vector<Branch> loadBranches();
+
+// Run work(i) for every branch on its own thread, with that thread's data
+// files in branches[i].directory. Returns once every branch has finished.
+void forEachBranchInParallel(const vector<Branch>& branches, const function<void(size_t)>& work);
+
+// Totals for every branch, in branch order
+vector<BranchTotals> computeBranchTotals(const vector<Branch>& branches);
+
+// Merged sales report with a per-branch breakdown
+void printBranchReport(const vector<Branch>& branches);
+
+// Run a query on every branch and print the matches grouped by branch,
+// returning the total number of matches
+long long printBranchVehicleQuery(const vector<Branch>& branches, const Query& query);
+long long printBranchSalesQuery(const vector<Branch>& branches, const Query& query);
+
+// Interactive cross-branch reports and searches
+void branchMenu();
+
+#endif // BRANCH_H
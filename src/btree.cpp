@@ -0,0 +1,591 @@
+#include "btree.h"
+#include "fileutil.h"
+#include "profile.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+static const char BTREE_MAGIC[8] = {'T', 'M', 'B', 'T', 'R', 'E', 'E', '1'};
+
+// Page layout: kind (16 bits), entry count (16 bits), next leaf (32 bits),
+// then the entries
+static const uint16_t LEAF_PAGE = 1;
+static const uint16_t INTERNAL_PAGE = 2;
+static const size_t PAGE_HEADER_BYTES = 8;
+static const size_t LEAF_ENTRY_BYTES = BTREE_KEY_BYTES + 8;          // Key, value
+static const size_t INTERNAL_ENTRY_BYTES = BTREE_KEY_BYTES + 8 + 4;  // Key, value, child
+static const uint16_t LEAF_CAPACITY = (BTREE_PAGE_BYTES - PAGE_HEADER_BYTES) / LEAF_ENTRY_BYTES;
+static const uint16_t INTERNAL_CAPACITY = (BTREE_PAGE_BYTES - PAGE_HEADER_BYTES) / INTERNAL_ENTRY_BYTES;
+
+// Header page offsets
+static const size_t HEADER_PAGE_SIZE = 8;
+static const size_t HEADER_ROOT = 12;
+static const size_t HEADER_PAGE_COUNT = 16;
+static const size_t HEADER_HEIGHT = 20;
+static const size_t HEADER_ENTRIES = 24;
+static const size_t HEADER_GENERATION = 32;
+
+template <class Value>
+static Value readValue(const char* data, size_t offset) {
+    Value value;
+    memcpy(&value, data + offset, sizeof(Value));
+    return value;
+}
+
+template <class Value>
+static void writeValue(char* data, size_t offset, Value value) {
+    memcpy(data + offset, &value, sizeof(Value));
+}
+
+// Key padded with zero bytes (or cut) to BTREE_KEY_BYTES, so keys compare
+// with memcmp in string order
+static string encodeKey(const string& key) {
+    string encoded = key.substr(0, BTREE_KEY_BYTES);
+    encoded.resize(BTREE_KEY_BYTES, '\0');
+    return encoded;
+}
+
+static string decodeKey(const char* key) {
+    return string(key, strnlen(key, BTREE_KEY_BYTES));
+}
+
+static size_t entryBytes(uint16_t kind) {
+    return kind == LEAF_PAGE ? LEAF_ENTRY_BYTES : INTERNAL_ENTRY_BYTES;
+}
+
+static const char* entryAt(const char* page, size_t index) {
+    return page + PAGE_HEADER_BYTES + index * entryBytes(readValue<uint16_t>(page, 0));
+}
+
+// Order of (key, value) against an entry's
+static int compareEntry(const char* key, uint64_t value, const char* entry) {
+    int order = memcmp(key, entry, BTREE_KEY_BYTES);
+    if (order != 0) {
+        return order;
+    }
+    uint64_t entryValue = readValue<uint64_t>(entry, BTREE_KEY_BYTES);
+    return value < entryValue ? -1 : (value > entryValue ? 1 : 0);
+}
+
+// First entry of a page after (key, value), or before it if orEqual is false
+static uint16_t upperBound(const char* page, const char* key, uint64_t value, bool orEqual) {
+    uint16_t low = 0, high = readValue<uint16_t>(page, 2);
+    while (low < high) {
+        uint16_t middle = (low + high) / 2;
+        int order = compareEntry(key, value, entryAt(page, middle));
+        if (order > 0 || (orEqual && order == 0)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+static vector<char> newPage(uint16_t kind) {
+    vector<char> page(BTREE_PAGE_BYTES, '\0');
+    writeValue<uint16_t>(page.data(), 0, kind);
+    return page;
+}
+
+// Constructor
+DiskBTree::DiskBTree()
+    : pages(nullptr), mappedBytes(0), root(0), pageCount(0), height(0), entries(0), generation(0) {
+#ifndef _WIN32
+    fd = -1;
+#endif
+}
+
+// Destructor
+DiskBTree::~DiskBTree() {
+    close();
+}
+
+// Map the first 'bytes' bytes of the file
+bool DiskBTree::mapFile(size_t bytes) {
+#ifdef _WIN32
+    contents.assign(bytes, '\0');
+    file.clear();
+    file.seekg(0);
+    file.read(contents.data(), bytes);
+    pages = contents.data();
+#else
+    void* mapping = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    pages = (const char*)mapping;
+#endif
+    mappedBytes = bytes;
+    return true;
+}
+
+void DiskBTree::unmapFile() {
+#ifdef _WIN32
+    vector<char>().swap(contents);
+#else
+    if (pages != nullptr) {
+        munmap((void*)pages, mappedBytes);
+    }
+#endif
+    pages = nullptr;
+    mappedBytes = 0;
+}
+
+// Open an existing tree file
+bool DiskBTree::open(const string& path) {
+    ProfileSpan span("index", "DiskBTree::open");
+    close();
+    fileName = path;
+    size_t bytes = 0;
+
+#ifdef _WIN32
+    file.open(path, ios::in | ios::out | ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.seekg(0, ios::end);
+    bytes = (size_t)file.tellg();
+#else
+    fd = ::open(path.c_str(), O_RDWR);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        close();
+        return false;
+    }
+    bytes = (size_t)info.st_size;
+#endif
+
+    if (bytes < BTREE_PAGE_BYTES || !mapFile(bytes) || memcmp(pages, BTREE_MAGIC, sizeof(BTREE_MAGIC)) != 0 ||
+        readValue<uint32_t>(pages, HEADER_PAGE_SIZE) != BTREE_PAGE_BYTES) {
+        close();
+        return false;
+    }
+
+    root = readValue<uint32_t>(pages, HEADER_ROOT);
+    pageCount = readValue<uint32_t>(pages, HEADER_PAGE_COUNT);
+    height = readValue<uint32_t>(pages, HEADER_HEIGHT);
+    entries = readValue<uint64_t>(pages, HEADER_ENTRIES);
+    generation = readValue<uint64_t>(pages, HEADER_GENERATION);
+
+    if (pageCount < 2 || (size_t)pageCount * BTREE_PAGE_BYTES > bytes || root == 0 || root >= pageCount ||
+        height == 0) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void DiskBTree::close() {
+    unmapFile();
+#ifdef _WIN32
+    if (file.is_open()) {
+        file.close();
+    }
+#else
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+#endif
+    root = pageCount = height = 0;
+    entries = generation = 0;
+}
+
+bool DiskBTree::isOpen() const {
+    return pages != nullptr;
+}
+
+const char* DiskBTree::page(uint32_t number) const {
+    return pages + (size_t)number * BTREE_PAGE_BYTES;
+}
+
+// Write one page in place
+bool DiskBTree::writePage(uint32_t number, const char* data) {
+    size_t offset = (size_t)number * BTREE_PAGE_BYTES;
+    bool ok = true;
+#ifdef _WIN32
+    file.clear();
+    file.seekp(offset);
+    file.write(data, BTREE_PAGE_BYTES);
+    file.flush();
+    ok = (bool)file;
+    memcpy(contents.data() + offset, data, BTREE_PAGE_BYTES);
+#else
+    size_t written = 0;
+    while (ok && written < BTREE_PAGE_BYTES) {
+        ssize_t result = pwrite(fd, data + written, BTREE_PAGE_BYTES - written, (off_t)(offset + written));
+        ok = result > 0;
+        written += ok ? (size_t)result : 0;
+    }
+#endif
+    if (!ok) {
+        cout << "Error: Could not write to " << fileName << "." << endl;
+    }
+    return ok;
+}
+
+bool DiskBTree::writeHeader() {
+    vector<char> header(BTREE_PAGE_BYTES, '\0');
+    memcpy(header.data(), BTREE_MAGIC, sizeof(BTREE_MAGIC));
+    writeValue<uint32_t>(header.data(), HEADER_PAGE_SIZE, (uint32_t)BTREE_PAGE_BYTES);
+    writeValue<uint32_t>(header.data(), HEADER_ROOT, root);
+    writeValue<uint32_t>(header.data(), HEADER_PAGE_COUNT, pageCount);
+    writeValue<uint32_t>(header.data(), HEADER_HEIGHT, height);
+    writeValue<uint64_t>(header.data(), HEADER_ENTRIES, entries);
+    writeValue<uint64_t>(header.data(), HEADER_GENERATION, generation);
+    return writePage(0, header.data());
+}
+
+// A new page at the end of the file; the file and the mapping grow by a
+// quarter at a time. Returns 0 if the file could not grow.
+uint32_t DiskBTree::allocatePage() {
+    size_t needed = (size_t)(pageCount + 1) * BTREE_PAGE_BYTES;
+
+    if (needed > mappedBytes) {
+        size_t pagesWanted = max(needed, mappedBytes + mappedBytes / 4) / BTREE_PAGE_BYTES;
+        size_t bytes = pagesWanted * BTREE_PAGE_BYTES;
+#ifdef _WIN32
+        contents.resize(bytes, '\0');
+        pages = contents.data();
+        mappedBytes = bytes;
+#else
+        if (ftruncate(fd, (off_t)bytes) != 0) {
+            return 0;
+        }
+        size_t previous = mappedBytes;
+        munmap((void*)pages, previous);
+        pages = nullptr;
+        if (!mapFile(bytes)) {
+            return 0;
+        }
+#endif
+    }
+    return pageCount++;
+}
+
+// Visit entries with low <= key <= high in order
+void DiskBTree::scan(const string& low, const string& high,
+                     const function<bool(const string& key, uint64_t value)>& visit) const {
+    if (!isOpen()) {
+        return;
+    }
+    string lowKey = encodeKey(low);
+    string highKey = encodeKey(high);
+
+    // Descend to the leaf that would hold (low, 0)
+    uint32_t number = root;
+    for (uint32_t level = 1; level < height; level++) {
+        const char* internal = page(number);
+        uint16_t index = upperBound(internal, lowKey.data(), 0, true);
+        number = readValue<uint32_t>(entryAt(internal, index > 0 ? index - 1 : 0), BTREE_KEY_BYTES + 8);
+    }
+
+    uint16_t index = upperBound(page(number), lowKey.data(), 0, false);
+    while (number != 0) {
+        const char* leaf = page(number);
+        uint16_t count = readValue<uint16_t>(leaf, 2);
+        for (; index < count; index++) {
+            const char* entry = entryAt(leaf, index);
+            if (memcmp(entry, highKey.data(), BTREE_KEY_BYTES) > 0 ||
+                !visit(decodeKey(entry), readValue<uint64_t>(entry, BTREE_KEY_BYTES))) {
+                return;
+            }
+        }
+        number = readValue<uint32_t>(leaf, 4);
+        index = 0;
+    }
+}
+
+// Add one entry: insert it into its leaf, splitting full pages on the way up
+bool DiskBTree::insert(const string& key, uint64_t value) {
+    if (!isOpen()) {
+        return false;
+    }
+    string encoded = encodeKey(key);
+    vector<pair<uint32_t, uint16_t>> path;  // Internal pages and the child taken
+
+    uint32_t number = root;
+    for (uint32_t level = 1; level < height; level++) {
+        const char* internal = page(number);
+        uint16_t index = upperBound(internal, encoded.data(), value, true);
+        index = index > 0 ? index - 1 : 0;
+        path.push_back(make_pair(number, index));
+        number = readValue<uint32_t>(entryAt(internal, index), BTREE_KEY_BYTES + 8);
+    }
+
+    vector<char> leaf(page(number), page(number) + BTREE_PAGE_BYTES);
+    uint16_t count = readValue<uint16_t>(leaf.data(), 2);
+    uint16_t position = upperBound(leaf.data(), encoded.data(), value, true);
+
+    // The page's entries with the new one in place
+    vector<char> merged(PAGE_HEADER_BYTES + (count + 1) * LEAF_ENTRY_BYTES);
+    char* first = merged.data() + PAGE_HEADER_BYTES;
+    memcpy(first, leaf.data() + PAGE_HEADER_BYTES, position * LEAF_ENTRY_BYTES);
+    memcpy(first + position * LEAF_ENTRY_BYTES, encoded.data(), BTREE_KEY_BYTES);
+    writeValue<uint64_t>(first, position * LEAF_ENTRY_BYTES + BTREE_KEY_BYTES, value);
+    memcpy(first + (position + 1) * LEAF_ENTRY_BYTES, leaf.data() + PAGE_HEADER_BYTES + position * LEAF_ENTRY_BYTES,
+           (count - position) * LEAF_ENTRY_BYTES);
+    count++;
+
+    bool ok = true;
+    if (count <= LEAF_CAPACITY) {
+        memcpy(leaf.data() + PAGE_HEADER_BYTES, first, count * LEAF_ENTRY_BYTES);
+        writeValue<uint16_t>(leaf.data(), 2, count);
+        ok = writePage(number, leaf.data());
+    } else {
+        // Split: the upper half moves to a new page after this one
+        uint32_t sibling = allocatePage();
+        if (sibling == 0) {
+            return false;
+        }
+        uint16_t leftCount = count / 2;
+        vector<char> right = newPage(LEAF_PAGE);
+        writeValue<uint16_t>(right.data(), 2, (uint16_t)(count - leftCount));
+        writeValue<uint32_t>(right.data(), 4, readValue<uint32_t>(leaf.data(), 4));
+        memcpy(right.data() + PAGE_HEADER_BYTES, first + leftCount * LEAF_ENTRY_BYTES,
+               (count - leftCount) * LEAF_ENTRY_BYTES);
+
+        memset(leaf.data() + PAGE_HEADER_BYTES, 0, BTREE_PAGE_BYTES - PAGE_HEADER_BYTES);
+        memcpy(leaf.data() + PAGE_HEADER_BYTES, first, leftCount * LEAF_ENTRY_BYTES);
+        writeValue<uint16_t>(leaf.data(), 2, leftCount);
+        writeValue<uint32_t>(leaf.data(), 4, sibling);
+
+        const char* separator = right.data() + PAGE_HEADER_BYTES;
+        ok = writePage(sibling, right.data()) && writePage(number, leaf.data()) &&
+             insertIntoParent(path, separator, readValue<uint64_t>(separator, BTREE_KEY_BYTES), sibling);
+    }
+
+    if (!ok) {
+        return false;
+    }
+    entries++;
+    return writeHeader();
+}
+
+// Add (key, value, child) after the child taken at the end of path, growing
+// a new root when the old one splits
+bool DiskBTree::insertIntoParent(vector<pair<uint32_t, uint16_t>>& path, const char* key, uint64_t value,
+                                 uint32_t child) {
+    if (path.empty()) {
+        uint32_t newRoot = allocatePage();
+        if (newRoot == 0) {
+            return false;
+        }
+        vector<char> internal = newPage(INTERNAL_PAGE);
+        writeValue<uint16_t>(internal.data(), 2, 2);
+        writeValue<uint32_t>(internal.data(), PAGE_HEADER_BYTES + BTREE_KEY_BYTES + 8, root);
+        char* second = internal.data() + PAGE_HEADER_BYTES + INTERNAL_ENTRY_BYTES;
+        memcpy(second, key, BTREE_KEY_BYTES);
+        writeValue<uint64_t>(second, BTREE_KEY_BYTES, value);
+        writeValue<uint32_t>(second, BTREE_KEY_BYTES + 8, child);
+        root = newRoot;
+        height++;
+        return writePage(newRoot, internal.data());
+    }
+
+    uint32_t number = path.back().first;
+    uint16_t position = path.back().second + 1;
+    path.pop_back();
+
+    vector<char> internal(page(number), page(number) + BTREE_PAGE_BYTES);
+    uint16_t count = readValue<uint16_t>(internal.data(), 2);
+
+    vector<char> merged((count + 1) * INTERNAL_ENTRY_BYTES);
+    char* first = merged.data();
+    memcpy(first, internal.data() + PAGE_HEADER_BYTES, position * INTERNAL_ENTRY_BYTES);
+    char* added = first + position * INTERNAL_ENTRY_BYTES;
+    memcpy(added, key, BTREE_KEY_BYTES);
+    writeValue<uint64_t>(added, BTREE_KEY_BYTES, value);
+    writeValue<uint32_t>(added, BTREE_KEY_BYTES + 8, child);
+    memcpy(added + INTERNAL_ENTRY_BYTES, internal.data() + PAGE_HEADER_BYTES + position * INTERNAL_ENTRY_BYTES,
+           (count - position) * INTERNAL_ENTRY_BYTES);
+    count++;
+
+    if (count <= INTERNAL_CAPACITY) {
+        memcpy(internal.data() + PAGE_HEADER_BYTES, first, count * INTERNAL_ENTRY_BYTES);
+        writeValue<uint16_t>(internal.data(), 2, count);
+        return writePage(number, internal.data());
+    }
+
+    uint32_t sibling = allocatePage();
+    if (sibling == 0) {
+        return false;
+    }
+    uint16_t leftCount = count / 2;
+    vector<char> right = newPage(INTERNAL_PAGE);
+    writeValue<uint16_t>(right.data(), 2, (uint16_t)(count - leftCount));
+    memcpy(right.data() + PAGE_HEADER_BYTES, first + leftCount * INTERNAL_ENTRY_BYTES,
+           (count - leftCount) * INTERNAL_ENTRY_BYTES);
+
+    memset(internal.data() + PAGE_HEADER_BYTES, 0, BTREE_PAGE_BYTES - PAGE_HEADER_BYTES);
+    memcpy(internal.data() + PAGE_HEADER_BYTES, first, leftCount * INTERNAL_ENTRY_BYTES);
+    writeValue<uint16_t>(internal.data(), 2, leftCount);
+
+    // Copy the separator out: the pages below may be remapped
+    string separator(right.data() + PAGE_HEADER_BYTES, BTREE_KEY_BYTES);
+    uint64_t separatorValue = readValue<uint64_t>(right.data() + PAGE_HEADER_BYTES, BTREE_KEY_BYTES);
+    return writePage(sibling, right.data()) && writePage(number, internal.data()) &&
+           insertIntoParent(path, separator.data(), separatorValue, sibling);
+}
+
+uint64_t DiskBTree::dataGeneration() const {
+    return generation;
+}
+
+bool DiskBTree::setDataGeneration(uint64_t value) {
+    if (!isOpen()) {
+        return false;
+    }
+    generation = value;
+    return writeHeader();
+}
+
+uint64_t DiskBTree::size() const {
+    return entries;
+}
+
+// Constructor: page 0 is kept for the header
+BTreeWriter::BTreeWriter(const string& path)
+    : path(path), tempPath(path + ".tmp"), nextPage(1), entries(0), ok(true) {
+    file.open(tempPath, ios::binary | ios::trunc);
+    ok = file.is_open();
+    startPage(0);
+}
+
+// Remove the temporary file if finish() was never reached
+BTreeWriter::~BTreeWriter() {
+    if (file.is_open()) {
+        file.close();
+        remove(tempPath.c_str());
+    }
+}
+
+// Begin the next page of a level
+void BTreeWriter::startPage(size_t level) {
+    if (levels.size() <= level) {
+        levels.emplace_back();
+        levels.back().pages = 0;
+    }
+    Level& current = levels[level];
+    current.page = newPage(level == 0 ? LEAF_PAGE : INTERNAL_PAGE);
+    current.number = nextPage++;
+    current.count = 0;
+    current.pages++;
+}
+
+void BTreeWriter::writePage(uint32_t number, const vector<char>& data) {
+    file.seekp((streamoff)number * BTREE_PAGE_BYTES);
+    file.write(data.data(), data.size());
+    ok = ok && (bool)file;
+}
+
+// Append an entry to a level, closing full pages and adding each new page
+// to the level above
+void BTreeWriter::push(size_t level, const string& key, uint64_t value, uint32_t child) {
+    if (levels.size() <= level) {
+        startPage(level);
+    }
+    uint16_t capacity = level == 0 ? LEAF_CAPACITY : INTERNAL_CAPACITY;
+    bool full = levels[level].count == capacity;
+
+    if (full) {
+        uint32_t previous = levels[level].number;
+        vector<char> page = levels[level].page;
+        startPage(level);
+        if (level == 0) {
+            writeValue<uint32_t>(page.data(), 4, levels[level].number);
+        }
+        writePage(previous, page);
+    }
+
+    Level& current = levels[level];
+    char* entry = current.page.data() + PAGE_HEADER_BYTES + current.count * entryBytes(level == 0 ? LEAF_PAGE : INTERNAL_PAGE);
+    memcpy(entry, key.data(), BTREE_KEY_BYTES);
+    writeValue<uint64_t>(entry, BTREE_KEY_BYTES, value);
+    if (level > 0) {
+        writeValue<uint32_t>(entry, BTREE_KEY_BYTES + 8, child);
+    }
+    current.count++;
+    writeValue<uint16_t>(current.page.data(), 2, current.count);
+
+    if (current.pages == 1 && current.count == 1) {
+        current.firstKey = key;
+        current.firstValue = value;
+        current.firstNumber = current.number;
+    }
+
+    if (full) {
+        uint32_t number = current.number;
+        if (current.pages == 2) {
+            // The level's first page joins the new parent level too
+            string firstKey = current.firstKey;
+            uint64_t firstValue = current.firstValue;
+            uint32_t firstNumber = current.firstNumber;
+            push(level + 1, firstKey, firstValue, firstNumber);
+        }
+        push(level + 1, key, value, number);
+    }
+}
+
+// Add the next entry in (key, value) order
+bool BTreeWriter::add(const string& key, uint64_t value) {
+    push(0, encodeKey(key), value, 0);
+    entries++;
+    return ok;
+}
+
+// Add an entry given as btreeSortKey(key, value)
+bool BTreeWriter::addSorted(const string& sortKey) {
+    uint64_t value = 0;
+    for (size_t i = BTREE_KEY_BYTES; i < sortKey.size(); i++) {
+        value = (value << 8) | (unsigned char)sortKey[i];
+    }
+    push(0, sortKey.substr(0, BTREE_KEY_BYTES), value, 0);
+    entries++;
+    return ok;
+}
+
+// Write the open page of each level (the top level has exactly one) and the
+// header, then move the file into place
+bool BTreeWriter::finish(uint64_t generation) {
+    for (const auto& level : levels) {
+        writePage(level.number, level.page);
+    }
+
+    vector<char> header(BTREE_PAGE_BYTES, '\0');
+    memcpy(header.data(), BTREE_MAGIC, sizeof(BTREE_MAGIC));
+    writeValue<uint32_t>(header.data(), HEADER_PAGE_SIZE, (uint32_t)BTREE_PAGE_BYTES);
+    writeValue<uint32_t>(header.data(), HEADER_ROOT, levels.back().number);
+    writeValue<uint32_t>(header.data(), HEADER_PAGE_COUNT, nextPage);
+    writeValue<uint32_t>(header.data(), HEADER_HEIGHT, (uint32_t)levels.size());
+    writeValue<uint64_t>(header.data(), HEADER_ENTRIES, entries);
+    writeValue<uint64_t>(header.data(), HEADER_GENERATION, generation);
+    writePage(0, header);
+
+    file.close();
+    ok = ok && !file.fail();
+    if (!ok) {
+        remove(tempPath.c_str());
+        return false;
+    }
+    return replaceFile(tempPath, path);
+}
+
+// The stored key, then the value most significant byte first
+string btreeSortKey(const string& key, uint64_t value) {
+    string sortKey = encodeKey(key);
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        sortKey += (char)((value >> shift) & 0xFF);
+    }
+    return sortKey;
+}
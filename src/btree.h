@@ -0,0 +1,124 @@
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+
+using namespace std;
+
+// On-disk B+tree of (key, value) entries, kept in a file of fixed-size pages
+// so an index survives restarts. Page 0 is a header (magic, root page, page
+// and entry counts, tree height and the generation of the data the tree
+// describes); every other page is a leaf of sorted entries chained to the
+// next leaf, or an internal page of (smallest entry, child page) pairs.
+// Entries are ordered by key, then value, so a key may repeat. Keys are
+// stored in BTREE_KEY_BYTES bytes; longer keys are cut short, so a lookup
+// may return extra entries and callers re-check what they read.
+//
+// An open tree is mapped read-only (mmap; read into memory on Windows) and
+// lookups touch only the pages they need. Inserts write the changed pages
+// back in place.
+
+const size_t BTREE_PAGE_BYTES = 4096;
+const size_t BTREE_KEY_BYTES = 24;
+
+class DiskBTree {
+private:
+    string fileName;
+    const char* pages;      // The mapped file
+    size_t mappedBytes;
+#ifdef _WIN32
+    fstream file;
+    vector<char> contents;  // Stands in for the mapping
+#else
+    int fd;
+#endif
+    uint32_t root;
+    uint32_t pageCount;     // Pages in use, including the header
+    uint32_t height;        // 1 when the root is a leaf
+    uint64_t entries;
+    uint64_t generation;
+
+    bool mapFile(size_t bytes);
+    void unmapFile();
+    const char* page(uint32_t number) const;
+    bool writePage(uint32_t number, const char* data);
+    bool writeHeader();
+    uint32_t allocatePage();
+    bool insertIntoParent(vector<pair<uint32_t, uint16_t>>& path, const char* key, uint64_t value, uint32_t child);
+
+public:
+    DiskBTree();
+    ~DiskBTree();
+
+    DiskBTree(const DiskBTree&) = delete;
+    DiskBTree& operator=(const DiskBTree&) = delete;
+
+    // Open an existing tree file; false if it is missing or not a tree
+    bool open(const string& path);
+    void close();
+    bool isOpen() const;
+
+    // Visit entries with low <= key <= high in order until visit returns false
+    void scan(const string& low, const string& high, const function<bool(const string& key, uint64_t value)>& visit) const;
+
+    // Add one entry; false if the file could not be written
+    bool insert(const string& key, uint64_t value);
+
+    // Generation of the data the tree describes (0 marks the tree stale)
+    uint64_t dataGeneration() const;
+    bool setDataGeneration(uint64_t value);
+
+    uint64_t size() const;
+};
+
+// Writes a new tree file bottom-up from entries given in (key, value)
+// order, then moves it over path
+class BTreeWriter {
+private:
+    struct Level {
+        vector<char> page;
+        uint32_t number;       // Page being filled
+        uint16_t count;
+        string firstKey;       // Smallest entry of the level's first page
+        uint64_t firstValue;
+        uint32_t firstNumber;
+        uint32_t pages;        // Pages started on this level
+    };
+
+    string path;
+    string tempPath;
+    ofstream file;
+    vector<Level> levels;      // levels[0] holds leaves
+    uint32_t nextPage;
+    uint64_t entries;
+    bool ok;
+
+    void startPage(size_t level);
+    void writePage(uint32_t number, const vector<char>& data);
+    void push(size_t level, const string& key, uint64_t value, uint32_t child);
+
+public:
+    explicit BTreeWriter(const string& path);
+    ~BTreeWriter();
+
+    BTreeWriter(const BTreeWriter&) = delete;
+    BTreeWriter& operator=(const BTreeWriter&) = delete;
+
+    bool add(const string& key, uint64_t value);
+
+    // Add an entry given as btreeSortKey(key, value)
+    bool addSorted(const string& sortKey);
+
+    // Write the upper levels and the header; false if any write failed
+    bool finish(uint64_t generation);
+};
+
+// Text that sorts bytewise in the tree's entry order, so entries can reach a
+// BTreeWriter through an ExternalSorter
+string btreeSortKey(const string& key, uint64_t value);
+
+#endif // BTREE_H
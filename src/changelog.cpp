@@ -0,0 +1,508 @@
+#include "changelog.h"
+#include "events.h"
+#include "config.h"
+#include "fileutil.h"
+#include "profile.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <mutex>
+#include <thread>
+#include <set>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#endif
+
+using namespace std;
+
+static mutex changeLogLock;
+
+// True if change_log is on
+bool changeLogEnabled() {
+    // The event stream is served from the log, so event_socket switches it on
+    static bool enabled = getConfigBool("change_log", !getConfigString("event_socket", "").empty());
+    return enabled;
+}
+
+// "<sequence>|<table>|<op>|<record>\n"
+static string formatChangeLine(long long sequence, const TxChange& change) {
+    return to_string(sequence) + "|" + change.table + "|" + (char)change.op + "|" + change.record + "\n";
+}
+
+// Parse one log line (without its newline)
+static bool parseChangeLine(const string& line, ChangeLogEntry& entry) {
+    size_t bar = line.find('|');
+    if (bar == string::npos || bar == 0 || line.size() < bar + 5 || line[bar + 2] != '|' || line[bar + 4] != '|') {
+        return false;
+    }
+
+    char* end = nullptr;
+    entry.sequence = strtoll(line.c_str(), &end, 10);
+    if (end != line.c_str() + bar || entry.sequence <= 0) {
+        return false;
+    }
+
+    entry.change.table = line[bar + 1];
+    entry.change.op = (ChangeOp)line[bar + 3];
+    entry.change.record = line.substr(bar + 5);
+    return true;
+}
+
+// Last sequence number in a change log file
+long long lastLoggedSequence(const string& path) {
+    ifstream file(path, ios::binary);
+    if (!file.is_open()) {
+        return 0;
+    }
+
+    file.seekg(0, ios::end);
+    long long size = (long long)file.tellg();
+
+    // Read back from the end until the tail holds one complete line; a
+    // partial line at the very end is still being written and is ignored
+    for (long long chunk = 4096;; chunk *= 4) {
+        long long start = size > chunk ? size - chunk : 0;
+        string tail((size_t)(size - start), '\0');
+        file.seekg(start);
+        file.read(&tail[0], (streamsize)tail.size());
+
+        size_t lineEnd = tail.rfind('\n');
+        if (lineEnd != string::npos && lineEnd > 0) {
+            size_t previous = tail.rfind('\n', lineEnd - 1);
+            if (previous != string::npos || start == 0) {
+                size_t lineStart = previous == string::npos ? 0 : previous + 1;
+                ChangeLogEntry entry;
+                return parseChangeLine(tail.substr(lineStart, lineEnd - lineStart), entry) ? entry.sequence : 0;
+            }
+        }
+        if (start == 0) {
+            return 0;
+        }
+    }
+}
+
+// Length of a log file up to the end of its last complete line
+static long long completeLength(const string& path, long long size) {
+    ifstream file(path, ios::binary);
+
+    for (long long end = size; file.is_open() && end > 0;) {
+        long long start = end > 4096 ? end - 4096 : 0;
+        string chunk((size_t)(end - start), '\0');
+        file.seekg(start);
+        file.read(&chunk[0], (streamsize)chunk.size());
+
+        size_t newline = chunk.rfind('\n');
+        if (newline != string::npos) {
+            return start + (long long)newline + 1;
+        }
+        end = start;
+    }
+    return 0;
+}
+
+// Drop a partial last line, left by a write the program did not finish; the
+// file lock must be held. Readers skip such a line, so nothing has seen it.
+static bool dropPartialLine(int fd, const string& path) {
+#ifdef _WIN32
+    long long size = _lseeki64(fd, 0, SEEK_END);
+#else
+    long long size = (long long)lseek(fd, 0, SEEK_END);
+#endif
+    if (size <= 0) {
+        return size == 0;
+    }
+
+    long long length = completeLength(path, size);
+    if (length == size) {
+        return true;
+    }
+#ifdef _WIN32
+    return _chsize_s(fd, length) == 0;
+#else
+    return ftruncate(fd, (off_t)length) == 0;
+#endif
+}
+
+// Append changes to the log with one write
+bool logChanges(const vector<TxChange>& changes) {
+    if (!changeLogEnabled() || changes.empty()) {
+        return true;
+    }
+
+    ProfileSpan span("file", "logChanges");
+    lock_guard<mutex> guard(changeLogLock);
+    string path = dataPath(CHANGE_LOG_FILE);
+
+#ifdef _WIN32
+    int fd = _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, 0644);
+#else
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+#endif
+    if (fd < 0) {
+        cout << "Error: Could not open " << path << " for writing." << endl;
+        return false;
+    }
+
+#ifndef _WIN32
+    // Command mode may be logging from another process; number under the file lock
+    flock(fd, LOCK_EX);
+#endif
+
+    bool ok = dropPartialLine(fd, path);
+    long long sequence = lastLoggedSequence(path);
+    string text;
+    for (const auto& change : changes) {
+        text += formatChangeLine(++sequence, change);
+    }
+
+#ifdef _WIN32
+    ok = ok && _write(fd, text.data(), (unsigned)text.size()) == (int)text.size();
+    _close(fd);
+#else
+    ok = ok && write(fd, text.data(), text.size()) == (ssize_t)text.size();
+    flock(fd, LOCK_UN);
+    close(fd);
+#endif
+
+    if (!ok) {
+        cout << "Error: Could not write " << path << "." << endl;
+        return false;
+    }
+    notifyEventPublisher();
+    return true;
+}
+
+// Append the changes the log does not hold yet
+bool logMissingChanges(const vector<TxChange>& changes) {
+    if (!changeLogEnabled() || changes.empty()) {
+        return true;
+    }
+
+    ProfileSpan span("file", "logMissingChanges");
+    auto lineOf = [](const TxChange& change) { return change.table + string("|") + (char)change.op + "|" + change.record; };
+    multiset<string> missing;
+    for (const auto& change : changes) {
+        missing.insert(lineOf(change));
+    }
+
+    // Strike off every change already logged; a missing log holds none
+    string path = dataPath(CHANGE_LOG_FILE);
+    ChangeLogCursor cursor = {0, 0};
+    vector<ChangeLogEntry> entries;
+    while (!missing.empty() && readChangeLog(path, cursor, 10000, entries) && !entries.empty()) {
+        for (const auto& entry : entries) {
+            auto found = missing.find(lineOf(entry.change));
+            if (found != missing.end()) {
+                missing.erase(found);
+            }
+        }
+        entries.clear();
+    }
+
+    vector<TxChange> unlogged;
+    for (const auto& change : changes) {
+        auto found = missing.find(lineOf(change));
+        if (found != missing.end()) {
+            missing.erase(found);
+            unlogged.push_back(change);
+        }
+    }
+    return logChanges(unlogged);
+}
+
+// Flush the log to disk
+bool syncChangeLog() {
+    string path = dataPath(CHANGE_LOG_FILE);
+    return !changeLogEnabled() || !fileExists(path) || syncFile(path);
+}
+
+// Read up to 'limit' complete entries after the cursor
+bool readChangeLog(const string& path, ChangeLogCursor& cursor, size_t limit, vector<ChangeLogEntry>& entries) {
+    ProfileSpan span("file", "readChangeLog");
+    ifstream file(path, ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    file.seekg(0, ios::end);
+    long long size = (long long)file.tellg();
+    long long offset = cursor.offset > 0 && cursor.offset <= size ? cursor.offset : 0;
+    bool checked = offset == 0;
+    size_t first = entries.size();
+    string line;
+
+    file.seekg(offset);
+    while (entries.size() - first < limit && getline(file, line)) {
+        if (file.eof()) {
+            break;  // Partial line still being written
+        }
+
+        ChangeLogEntry entry;
+        if (parseChangeLine(line, entry)) {
+            // The entry at the hinted offset must follow the cursor, or the hint is stale
+            if (!checked && entry.sequence <= cursor.sequence) {
+                ChangeLogCursor rescan = {cursor.sequence, 0};
+                bool ok = readChangeLog(path, rescan, limit, entries);
+                cursor = rescan;
+                return ok;
+            }
+            checked = true;
+
+            if (entry.sequence > cursor.sequence) {
+                entries.push_back(entry);
+                cursor.sequence = entry.sequence;
+            }
+        }
+        offset += (long long)line.size() + 1;
+    }
+
+    cursor.offset = offset;
+    return true;
+}
+
+#ifdef _WIN32
+
+void startChangeLogServer() {
+    if (!getConfigString("change_log_socket", "").empty()) {
+        cout << "Warning: change_log_socket is not supported on this platform; replicas must read the log from a shared directory." << endl;
+    }
+}
+
+void stopChangeLogServer() {
+}
+
+int listenOnLocalSocket(const string& path) {
+    return -1;
+}
+
+bool requestChangeLog(const string& socketPath, ChangeLogCursor& cursor, size_t limit,
+                      vector<ChangeLogEntry>& entries, long long& primarySequence) {
+    return false;
+}
+
+#else
+
+#ifdef MSG_NOSIGNAL
+static const int SEND_FLAGS = MSG_NOSIGNAL;  // A departed client must not raise SIGPIPE
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+static int serverSocket = -1;
+static string serverPath;
+static thread serverThread;
+
+// Send the whole text; false if the peer has gone away
+static bool sendAll(int fd, const string& text) {
+    size_t sent = 0;
+    while (sent < text.size()) {
+        ssize_t count = send(fd, text.data() + sent, text.size() - sent, SEND_FLAGS);
+        if (count <= 0) {
+            return false;
+        }
+        sent += (size_t)count;
+    }
+    return true;
+}
+
+// Read one request line
+static bool receiveLine(int fd, string& line) {
+    char c;
+    line.clear();
+    while (recv(fd, &c, 1, 0) == 1) {
+        if (c == '\n') {
+            return true;
+        }
+        line += c;
+        if (line.size() > 256) {
+            return false;
+        }
+    }
+    return false;
+}
+
+// Socket address for a path; false if the path is too long
+static bool socketAddress(const string& path, sockaddr_un& address) {
+    memset(&address, 0, sizeof(address));
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+// Request: "READ <sequence> <offset> <limit>". Reply: the entries, then
+// "END <sequence> <offset> <latest sequence>" with the cursor to ask from next.
+static void serveChangeLogClient(int client) {
+    string request;
+    if (!receiveLine(client, request)) {
+        return;
+    }
+
+    istringstream in(request);
+    string verb;
+    ChangeLogCursor cursor = {0, 0};
+    size_t limit = 0;
+    in >> verb >> cursor.sequence >> cursor.offset >> limit;
+
+    if (verb != "READ" || in.fail() || limit == 0) {
+        sendAll(client, "ERROR expected READ <sequence> <offset> <limit>\n");
+        return;
+    }
+
+    string path = dataPath(CHANGE_LOG_FILE);
+    vector<ChangeLogEntry> entries;
+    string reply;
+    readChangeLog(path, cursor, limit, entries);
+    for (const auto& entry : entries) {
+        reply += formatChangeLine(entry.sequence, entry.change);
+    }
+    reply += "END " + to_string(cursor.sequence) + " " + to_string(cursor.offset) + " " +
+             to_string(lastLoggedSequence(path)) + "\n";
+    sendAll(client, reply);
+}
+
+// Listen on a local socket, replacing a stale socket file
+int listenOnLocalSocket(const string& path) {
+    sockaddr_un address;
+    if (!socketAddress(path, address)) {
+        cout << "Error: Socket path is too long: " << path << endl;
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str());
+    if (fd < 0 || bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 8) != 0) {
+        cout << "Error: Could not listen on " << path << ": " << strerror(errno) << endl;
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+// Serve the log on change_log_socket, if set
+void startChangeLogServer() {
+    string path = getConfigString("change_log_socket", "");
+
+    if (path.empty() || serverSocket >= 0) {
+        return;
+    }
+    if (!changeLogEnabled()) {
+        cout << "Warning: change_log_socket is set but change_log is off; the change log is not served." << endl;
+        return;
+    }
+
+    int fd = listenOnLocalSocket(path);
+    if (fd < 0) {
+        return;
+    }
+
+    serverSocket = fd;
+    serverPath = path;
+    serverThread = thread([fd]() {
+        timeval timeout = {5, 0};
+        while (true) {
+            int client = accept(fd, nullptr, nullptr);
+            if (client < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;  // Listening socket shut down
+            }
+            // A stalled client must not hold up the others for long
+            setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            serveChangeLogClient(client);
+            close(client);
+        }
+    });
+}
+
+// Stop serving and remove the socket file
+void stopChangeLogServer() {
+    if (serverSocket < 0) {
+        return;
+    }
+    shutdown(serverSocket, SHUT_RDWR);
+    serverThread.join();
+    close(serverSocket);
+    unlink(serverPath.c_str());
+    serverSocket = -1;
+}
+
+// Ask a primary's change log server for entries after the cursor
+bool requestChangeLog(const string& socketPath, ChangeLogCursor& cursor, size_t limit,
+                      vector<ChangeLogEntry>& entries, long long& primarySequence) {
+    ProfileSpan span("file", "requestChangeLog");
+    sockaddr_un address;
+    if (!socketAddress(socketPath, address)) {
+        return false;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+
+    string request = "READ " + to_string(cursor.sequence) + " " + to_string(cursor.offset) + " " +
+                     to_string(limit) + "\n";
+    string reply;
+    char buffer[65536];
+    ssize_t count;
+
+    if (sendAll(fd, request)) {
+        while ((count = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+            reply.append(buffer, (size_t)count);
+        }
+    }
+    close(fd);
+
+    // Entries are only taken once the END line shows the reply is complete
+    vector<ChangeLogEntry> received;
+    size_t start = 0;
+    while (start < reply.size()) {
+        size_t end = reply.find('\n', start);
+        if (end == string::npos) {
+            break;
+        }
+        string line = reply.substr(start, end - start);
+        start = end + 1;
+
+        if (line.compare(0, 4, "END ") == 0) {
+            istringstream in(line.substr(4));
+            ChangeLogCursor next;
+            long long latest;
+            if (!(in >> next.sequence >> next.offset >> latest)) {
+                return false;
+            }
+            entries.insert(entries.end(), received.begin(), received.end());
+            cursor = next;
+            primarySequence = latest;
+            return true;
+        }
+
+        ChangeLogEntry entry;
+        if (!parseChangeLine(line, entry)) {
+            return false;
+        }
+        received.push_back(entry);
+    }
+    return false;
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef CHANGELOG_H
+#define CHANGELOG_H
+
+#include <string>
+#include <vector>
+#include "txlog.h"
+
+using namespace std;
+
+// With change_log=true in tourmate.conf, every vehicle change and sale this
+// instance stores is also appended to tourmate.changelog, one
+// "<sequence>|<table>|<op>|<record>" line per change. Sequence numbers start
+// at 1 and are never reused, and the file only grows. Read replicas follow it
+// (see replica.h), either straight from a shared directory or through the
+// local socket named by change_log_socket. Whole-table rewrites
+// (saveVehiclesToFile, saveSalesToFile) are not logged, so replicas must be
+// seeded again after one. Sales and vehicle changes made through a
+// transaction (see txlog.h) are logged and synced before the transaction is
+// cleared, and recovery logs any that were stored but not logged. The event stream (see events.h) is served from the
+// same log.
+
+const string CHANGE_LOG_FILE = "tourmate.changelog";
+
+// One logged change
+struct ChangeLogEntry {
+    long long sequence;
+    TxChange change;
+};
+
+// How far a reader has got: the last sequence read and the byte offset just
+// past it. The offset is only a hint; a stale one makes the reader rescan.
+struct ChangeLogCursor {
+    long long sequence;
+    long long offset;
+};
+
+// True if change_log is on (it defaults to on when event_socket is set)
+bool changeLogEnabled();
+
+// Append changes to the log with one write; does nothing if the log is off.
+// A partial last line left by a crash is dropped first. False if the log
+// could not be written.
+bool logChanges(const vector<TxChange>& changes);
+
+// Append those of the changes that are not in the log yet, for a transaction
+// whose data was stored but not logged before the program stopped
+bool logMissingChanges(const vector<TxChange>& changes);
+
+// Flush the log to disk; true if it is off or does not exist yet
+bool syncChangeLog();
+
+// Read up to 'limit' complete entries after the cursor from a change log
+// file, advancing the cursor past them. False if the file cannot be read.
+bool readChangeLog(const string& path, ChangeLogCursor& cursor, size_t limit, vector<ChangeLogEntry>& entries);
+
+// Last sequence number in a change log file (0 if it is empty or missing)
+long long lastLoggedSequence(const string& path);
+
+// Serve the log on change_log_socket, if set, from a background thread
+void startChangeLogServer();
+void stopChangeLogServer();
+
+// Listen on a local (Unix domain) socket, replacing a stale socket file.
+// Returns the listening descriptor, or -1 after printing why not.
+int listenOnLocalSocket(const string& path);
+
+// Ask a primary's change log server for up to 'limit' entries after the
+// cursor, advancing it. primarySequence is set to the primary's latest
+// sequence. False if the server cannot be reached.
+bool requestChangeLog(const string& socketPath, ChangeLogCursor& cursor, size_t limit,
+                      vector<ChangeLogEntry>& entries, long long& primarySequence);
+
+#endif // CHANGELOG_H
@@ -0,0 +1,369 @@
+#include "commands.h"
+#include "topk.h"
+#include "query.h"
+#include "vehicle.h"
+#include "export.h"
+#include "returns.h"
+#include "branch.h"
+#include "replica.h"
+#include "dates.h"
+#include "customers.h"
+#include "fleetstatus.h"
+#include <iostream>
+
+using namespace std;
+
+// A command-mode entry: name, usage text and handler
+struct Command {
+    string name;
+    string usage;
+    int (*handler)(const vector<string>& args);
+};
+
+static int helpCommand(const vector<string>&);
+
+// Parse a positive count argument, falling back to a default when absent
+static bool parseCount(const vector<string>& args, size_t index, size_t defaultValue, size_t& value) {
+    if (index >= args.size()) {
+        value = defaultValue;
+        return true;
+    }
+    try {
+        // Signed, so "-5" is rejected instead of wrapping to a huge count
+        size_t used = 0;
+        long long count = stoll(args[index], &used);
+        value = (size_t)count;
+        return used == args[index].size() && count > 0;
+    } catch (...) {
+        return false;
+    }
+}
+
+// topk customers|vehicles [K]
+static int topKCommand(const vector<string>& args) {
+    size_t k;
+
+    if (args.size() < 2 || !parseCount(args, 2, DEFAULT_TOP_K, k)) {
+        cerr << "Usage: tourmate topk customers|vehicles [K]" << endl;
+        return 1;
+    }
+
+    if (args[1] == "customers") {
+        printTopK("TOP " + to_string(k) + " CUSTOMERS BY SPEND", "Customer", topCustomersBySpend(k));
+    } else if (args[1] == "vehicles") {
+        printTopK("TOP " + to_string(k) + " VEHICLES BY REVENUE", "Vehicle ID", topVehiclesByRevenue(k));
+    } else {
+        cerr << "Unknown top-K target: " << args[1] << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+// query vehicles|sales <conditions...>
+static int queryCommand(const vector<string>& args) {
+    if (args.size() < 3 || (args[1] != "vehicles" && args[1] != "sales")) {
+        cerr << "Usage: tourmate query vehicles|sales <conditions>" << endl;
+        printQueryHelp();
+        return 1;
+    }
+
+    // Conditions may be passed as one quoted argument or as separate words
+    string text;
+    for (size_t i = 2; i < args.size(); i++) {
+        text += (i > 2 ? " " : "") + args[i];
+    }
+
+    Query query;
+    string error;
+    bool parsed = args[1] == "vehicles" ? parseVehicleQuery(text, query, error) : parseSalesQuery(text, query, error);
+
+    if (!parsed) {
+        cerr << "Invalid query: " << error << endl;
+        return 1;
+    }
+
+    if (args[1] == "vehicles") {
+        printVehicleQuery(query, true);
+    } else {
+        printSalesQuery(query, true);
+    }
+    return 0;
+}
+
+// Parse a rate argument
+static bool parseRate(const string& text, double& value) {
+    try {
+        size_t used = 0;
+        value = stod(text, &used);
+        return used == text.size() && value >= 0;
+    } catch (...) {
+        return false;
+    }
+}
+
+// cheapest <type> [status]
+static int cheapestCommand(const vector<string>& args) {
+    if (args.size() < 2 || args.size() > 3) {
+        cerr << "Usage: tourmate cheapest <type> [status]" << endl;
+        return 1;
+    }
+
+    printCheapestVehicle(args[1], args.size() > 2 ? args[2] : "");
+    return 0;
+}
+
+// rates <min> <max> [type] [status]
+static int ratesCommand(const vector<string>& args) {
+    double low, high;
+
+    if (args.size() < 3 || args.size() > 5 || !parseRate(args[1], low) || !parseRate(args[2], high)) {
+        cerr << "Usage: tourmate rates <min> <max> [type] [status]" << endl;
+        return 1;
+    }
+
+    printVehiclesByRate(low, high, args.size() > 3 ? args[3] : "", args.size() > 4 ? args[4] : "");
+    return 0;
+}
+
+// export vehicles|sales csv|jsonl <file|-> [--sort field[:desc]] [conditions...]
+static int exportCommand(const vector<string>& args) {
+    ExportFormat format;
+
+    if (args.size() < 4 || (args[1] != "vehicles" && args[1] != "sales") || !parseExportFormat(args[2], format)) {
+        cerr << "Usage: tourmate export vehicles|sales csv|jsonl <file|-> [--sort field[:desc]] [conditions]" << endl;
+        return 1;
+    }
+
+    size_t first = 4;
+    string sortText;
+    if (args.size() > 5 && args[4] == "--sort") {
+        sortText = args[5];
+        first = 6;
+    }
+
+    string text;
+    for (size_t i = first; i < args.size(); i++) {
+        text += (i > first ? " " : "") + args[i];
+    }
+
+    Query query;
+    SortOrder order;
+    string error;
+    if (!text.empty()) {
+        bool parsed = args[1] == "vehicles" ? parseVehicleQuery(text, query, error) : parseSalesQuery(text, query, error);
+        if (!parsed) {
+            cerr << "Invalid query: " << error << endl;
+            return 1;
+        }
+    }
+    bool parsed = args[1] == "vehicles" ? parseVehicleSortOrder(sortText, order, error)
+                                        : parseSalesSortOrder(sortText, order, error);
+    if (!parsed) {
+        cerr << "Invalid sort order: " << error << endl;
+        return 1;
+    }
+
+    const string& fileName = args[3];
+    long long rows = args[1] == "vehicles" ? exportVehicles(query, order, format, fileName)
+                                           : exportSales(query, order, format, fileName);
+
+    if (rows < 0) {
+        cerr << exportErrorMessage(rows, fileName) << endl;
+        return 1;
+    }
+    // Keep standard output clean when it carries the export itself
+    (fileName == "-" ? cerr : cout) << "Exported " << rows << " row(s)." << endl;
+    return 0;
+}
+
+// list vehicles|sales <field> [asc|desc]
+static int listCommand(const vector<string>& args) {
+    if (args.size() < 3 || args.size() > 4 || (args[1] != "vehicles" && args[1] != "sales")) {
+        cerr << "Usage: tourmate list vehicles|sales <field> [asc|desc]" << endl;
+        return 1;
+    }
+
+    string sortText = args[2] + (args.size() == 4 ? " " + args[3] : "");
+    SortOrder order;
+    string error;
+    bool parsed = args[1] == "vehicles" ? parseVehicleSortOrder(sortText, order, error)
+                                        : parseSalesSortOrder(sortText, order, error);
+    if (!parsed) {
+        cerr << "Invalid sort order: " << error << endl;
+        return 1;
+    }
+
+    long long shown = args[1] == "vehicles" ? printSortedVehicles(order) : printSortedSales(order);
+    return shown < 0 ? 1 : 0;
+}
+
+// customer <name> [contact]
+static int customerCommand(const vector<string>& args) {
+    if (args.size() < 2 || args.size() > 3) {
+        cerr << "Usage: tourmate customer <name> [contact]" << endl;
+        return 1;
+    }
+    return printCustomerHistory(args[1], args.size() == 3 ? args[2] : "") > 0 ? 0 : 1;
+}
+
+// fleet
+static int fleetCommand(const vector<string>& args) {
+    if (args.size() != 1) {
+        cerr << "Usage: tourmate fleet" << endl;
+        return 1;
+    }
+    printFleetDashboard();
+    return 0;
+}
+
+// return [YYYY-MM-DD]
+static int returnCommand(const vector<string>& args) {
+    if (refuseChangeOnReplica()) {
+        return 1;
+    }
+
+    int asOfDay = args.size() > 1 ? dateToDayNumber(args[1]) : todayDayNumber();
+
+    if (args.size() > 2 || asOfDay == INVALID_DAY) {
+        cerr << "Usage: tourmate return [YYYY-MM-DD]" << endl;
+        return 1;
+    }
+
+    ReturnSweep sweep = returnDueVehicles(asOfDay);
+    if (!sweep.committed) {
+        cerr << "Error: The returns could not be recorded. No vehicles were changed." << endl;
+        return 1;
+    }
+
+    cout << "Returned " << sweep.returned << " of " << sweep.rented << " rented vehicle(s); "
+         << sweep.stillOut << " still out, " << sweep.unknown << " without a dated sale." << endl;
+    return 0;
+}
+
+// branches [report | query vehicles|sales <conditions>]
+static int branchesCommand(const vector<string>& args) {
+    vector<Branch> branches = loadBranches();
+
+    if (branches.empty()) {
+        cerr << "Error: No branches are configured. List them in branches.txt as name|directory." << endl;
+        return 1;
+    }
+
+    if (args.size() == 1) {
+        for (const auto& branch : branches) {
+            cout << branch.name << "\t" << branch.directory << endl;
+        }
+        return 0;
+    }
+
+    if (args[1] == "report" && args.size() == 2) {
+        printBranchReport(branches);
+        return 0;
+    }
+
+    if (args[1] != "query" || args.size() < 4 || (args[2] != "vehicles" && args[2] != "sales")) {
+        cerr << "Usage: tourmate branches [report | query vehicles|sales <conditions>]" << endl;
+        return 1;
+    }
+
+    string text;
+    for (size_t i = 3; i < args.size(); i++) {
+        text += (i > 3 ? " " : "") + args[i];
+    }
+
+    Query query;
+    string error;
+    bool parsed = args[2] == "vehicles" ? parseVehicleQuery(text, query, error) : parseSalesQuery(text, query, error);
+
+    if (!parsed) {
+        cerr << "Invalid query: " << error << endl;
+        return 1;
+    }
+
+    if (args[2] == "vehicles") {
+        printBranchVehicleQuery(branches, query);
+    } else {
+        printBranchSalesQuery(branches, query);
+    }
+    return 0;
+}
+
+// replica [status | seed]
+static int replicaCommand(const vector<string>& args) {
+    if (!isReplica()) {
+        cerr << "Error: replica_of is not set in tourmate.conf." << endl;
+        return 1;
+    }
+
+    if (args.size() == 2 && args[1] == "seed") {
+        if (!seedReplica()) {
+            return 1;
+        }
+        cout << "Replica seeded; changes after this point will be applied." << endl;
+        printReplicaStatus();
+        return 0;
+    }
+
+    if (args.size() > 2 || (args.size() == 2 && args[1] != "status")) {
+        cerr << "Usage: tourmate replica [status | seed]" << endl;
+        return 1;
+    }
+
+    long long applied = syncReplica();
+    if (applied > 0) {
+        cout << "Applied " << applied << " change(s)." << endl;
+    }
+    printReplicaStatus();
+    return applied < 0 ? 1 : 0;
+}
+
+static const vector<Command>& commandTable() {
+    static const vector<Command> commands = {
+        {"help", "help", helpCommand},
+        {"topk", "topk customers|vehicles [K]", topKCommand},
+        {"query", "query vehicles|sales <conditions>", queryCommand},
+        {"cheapest", "cheapest <type> [status]", cheapestCommand},
+        {"rates", "rates <min> <max> [type] [status]", ratesCommand},
+        {"export", "export vehicles|sales csv|jsonl <file|-> [--sort field[:desc]] [conditions]", exportCommand},
+        {"list", "list vehicles|sales <field> [asc|desc]", listCommand},
+        {"customer", "customer <name> [contact]", customerCommand},
+        {"fleet", "fleet", fleetCommand},
+        {"return", "return [YYYY-MM-DD]", returnCommand},
+        {"branches", "branches [report | query vehicles|sales <conditions>]", branchesCommand},
+        {"replica", "replica [status | seed]", replicaCommand},
+    };
+    return commands;
+}
+
+// help
+static int helpCommand(const vector<string>&) {
+    cout << "Usage: tourmate [command [arguments...]]\n";
+    cout << "Run without arguments for the interactive menus.\n\n";
+    cout << "Commands:\n";
+    for (const auto& command : commandTable()) {
+        cout << "  " << command.usage << "\n";
+    }
+    return 0;
+}
+
+// Non-interactive command mode: tourmate <command> [arguments...]
+int runCommand(const vector<string>& args) {
+    if (args.empty()) {
+        return helpCommand(args);
+    }
+
+    // A read replica catches up first; the replica command syncs for itself
+    if (args[0] != "replica") {
+        syncReplica();
+    }
+
+    for (const auto& command : commandTable()) {
+        if (command.name == args[0]) {
+            return command.handler(args);
+        }
+    }
+
+    cerr << "Unknown command: " << args[0] << " (try 'tourmate help')" << endl;
+    return 1;
+}
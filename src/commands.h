@@ -0,0 +1,13 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Non-interactive command mode: tourmate <command> [arguments...]
+// Returns the process exit code.
+int runCommand(const vector<string>& args);
+
+#endif // COMMANDS_H
@@ -0,0 +1,74 @@
+#include "config.h"
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <algorithm>
+
+using namespace std;
+
+static const string CONFIG_FILE = "tourmate.conf";
+
+static string trim(const string& text) {
+    size_t start = text.find_first_not_of(" \t\r");
+    if (start == string::npos) {
+        return "";
+    }
+    size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(start, end - start + 1);
+}
+
+// Settings are read once, on first use
+static const map<string, string>& configValues() {
+    static map<string, string> values;
+    static once_flag loaded;
+
+    call_once(loaded, []() {
+        ifstream file(CONFIG_FILE);
+        string line;
+
+        while (getline(file, line)) {
+            size_t comment = line.find('#');
+            if (comment != string::npos) {
+                line = line.substr(0, comment);
+            }
+
+            size_t equals = line.find('=');
+            if (equals != string::npos) {
+                values[trim(line.substr(0, equals))] = trim(line.substr(equals + 1));
+            }
+        }
+    });
+
+    return values;
+}
+
+// String setting
+string getConfigString(const string& key, const string& defaultValue) {
+    auto it = configValues().find(key);
+    return it != configValues().end() ? it->second : defaultValue;
+}
+
+// Integer setting
+long long getConfigInt(const string& key, long long defaultValue) {
+    string value = getConfigString(key, "");
+    try {
+        size_t used = 0;
+        long long result = stoll(value, &used);
+        return used == value.size() ? result : defaultValue;
+    } catch (...) {
+        return defaultValue;
+    }
+}
+
+// Boolean setting
+bool getConfigBool(const string& key, bool defaultValue) {
+    string value = getConfigString(key, "");
+    transform(value.begin(), value.end(), value.begin(), ::tolower);
+
+    if (value == "true" || value == "yes" || value == "on" || value == "1") {
+        return true;
+    } else if (value == "false" || value == "no" || value == "off" || value == "0") {
+        return false;
+    }
+    return defaultValue;
+}
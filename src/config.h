@@ -0,0 +1,20 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <string>
+
+using namespace std;
+
+// Optional settings are read from tourmate.conf in the working directory,
+// one "key=value" per line; '#' starts a comment. Missing keys use defaults.
+
+// String setting
+string getConfigString(const string& key, const string& defaultValue);
+
+// Integer setting (defaultValue if missing or not a number)
+long long getConfigInt(const string& key, long long defaultValue);
+
+// Boolean setting: true/yes/on/1 and false/no/off/0
+bool getConfigBool(const string& key, bool defaultValue);
+
+#endif // CONFIG_H
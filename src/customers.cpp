@@ -0,0 +1,212 @@
+#include "customers.h"
+#include "salesindex.h"
+#include "sales.h"
+#include "profile.h"
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <algorithm>
+#include <map>
+#include <unordered_set>
+#include <cctype>
+
+using namespace std;
+
+static const vector<uint32_t> NO_CUSTOMERS;
+
+static string lowerCase(string_view text) {
+    string result(text);
+    transform(result.begin(), result.end(), result.begin(), [](unsigned char c) { return (char)tolower(c); });
+    return result;
+}
+
+// ID of a customer, adding them if they are new
+uint32_t CustomerDictionary::intern(string_view name, string_view contact) {
+    string key;
+    key.reserve(name.size() + contact.size() + 1);
+    key.append(name).append("|").append(contact);
+
+    auto found = idByKey.find(key);
+    if (found != idByKey.end()) {
+        return found->second;
+    }
+
+    uint32_t id = (uint32_t)names.size();
+    names.emplace_back(name);
+    contacts.emplace_back(contact);
+    idByKey.emplace(move(key), id);
+    byName[lowerCase(name)].push_back(id);
+    return id;
+}
+
+// IDs of customers with this name, any case
+const vector<uint32_t>& CustomerDictionary::idsNamed(const string& name) const {
+    auto found = byName.find(lowerCase(name));
+    return found != byName.end() ? found->second : NO_CUSTOMERS;
+}
+
+const string& CustomerDictionary::nameOf(uint32_t id) const {
+    return names[id];
+}
+
+const string& CustomerDictionary::contactOf(uint32_t id) const {
+    return contacts[id];
+}
+
+size_t CustomerDictionary::size() const {
+    return names.size();
+}
+
+void CustomerDictionary::clear() {
+    names.clear();
+    contacts.clear();
+    idByKey.clear();
+    byName.clear();
+}
+
+// Read one customer's sales through their postings: each record is read at
+// its offset, so the work grows with the customer's history, not the table
+static vector<Sales> loadCustomerSales(const SalesIndex& index, uint32_t customerId) {
+    map<string, vector<pair<uint64_t, string>>> wanted;
+    vector<Sales> history;
+
+    for (uint32_t position : index.positionsOfCustomer(customerId)) {
+        wanted[index.partitionAt(position)].push_back({index.offsetAt(position), index.saleIdAt(position)});
+    }
+
+    for (const auto& partition : wanted) {
+        auto keep = [&history](const Sales& sale) { history.push_back(sale); };
+        if (readSalesAtOffsets(partition.first, partition.second, keep)) {
+            continue;
+        }
+
+        // The partition was rewritten since the index was built: scan it instead
+        unordered_set<string> saleIds;
+        for (const auto& record : partition.second) {
+            saleIds.insert(record.second);
+        }
+        forEachSaleInPartition(partition.first, [&history, &saleIds](const Sales& sale) {
+            if (saleIds.count(sale.getSaleId()) > 0) {
+                history.push_back(sale);
+            }
+        });
+    }
+
+    stable_sort(history.begin(), history.end(), [](const Sales& a, const Sales& b) {
+        return a.getStartDate() < b.getStartDate();
+    });
+    return history;
+}
+
+// Print one customer's sales and totals
+static void printOneCustomer(const SalesIndex& index, uint32_t customerId) {
+    const CustomerDictionary& customers = index.customerDictionary();
+    vector<Sales> history = loadCustomerSales(index, customerId);
+    double total = 0.0;
+    double paid = 0.0;
+    double pending = 0.0;
+
+    cout << "\n===== CUSTOMER HISTORY =====\n";
+    cout << "Customer: " << customers.nameOf(customerId) << endl;
+    cout << "Contact: " << customers.contactOf(customerId) << endl;
+
+    for (const auto& sale : history) {
+        cout << "------------------------" << endl;
+        sale.displayDetails();
+
+        total += sale.getAmount();
+        if (sale.getPaymentStatus() == "Paid") {
+            paid += sale.getAmount();
+        } else if (sale.getPaymentStatus() == "Pending") {
+            pending += sale.getAmount();
+        }
+    }
+
+    cout << "------------------------" << endl;
+    cout << "Rentals: " << history.size() << endl;
+    cout << "Total Spend: $" << fixed << setprecision(2) << total << endl;
+    cout << "Paid: $" << paid << "  Pending: $" << pending << endl;
+    if (!history.empty()) {
+        cout << "First Rental: " << history.front().getStartDate() << endl;
+        cout << "Latest Rental: " << history.back().getStartDate() << endl;
+    }
+}
+
+// Print the history of every matching customer
+size_t printCustomerHistory(const string& name, const string& contact) {
+    ProfileSpan span("query", "printCustomerHistory");
+    const SalesIndex& index = salesIndex();
+    const CustomerDictionary& customers = index.customerDictionary();
+    vector<uint32_t> matches;
+
+    for (uint32_t id : customers.idsNamed(name)) {
+        if (contact.empty() || customers.contactOf(id) == contact) {
+            matches.push_back(id);
+        }
+    }
+
+    if (matches.empty()) {
+        cout << "\nNo customer named \"" << name << "\"";
+        if (!contact.empty()) {
+            cout << " with contact " << contact;
+        }
+        cout << "." << endl;
+        return 0;
+    }
+
+    for (uint32_t id : matches) {
+        printOneCustomer(index, id);
+    }
+    return matches.size();
+}
+
+// Interactive customer history screen
+void customerHistory() {
+    string name;
+    cout << "Enter customer name: ";
+    getline(cin, name);
+
+    const SalesIndex& index = salesIndex();
+    const CustomerDictionary& customers = index.customerDictionary();
+    const vector<uint32_t>& matches = customers.idsNamed(name);
+
+    if (matches.empty()) {
+        cout << "\nNo customer named \"" << name << "\"." << endl;
+
+        // Offer close spellings from the fuzzy name index
+        vector<FuzzyMatch> similar = findCustomersFuzzy(name, 2);
+        if (!similar.empty()) {
+            cout << "Did you mean:";
+            for (size_t i = 0; i < similar.size() && i < 5; i++) {
+                cout << (i == 0 ? " " : ", ") << similar[i].term;
+            }
+            cout << "?" << endl;
+        }
+        return;
+    }
+
+    // Namesakes with different contacts are different customers
+    string contact;
+    if (matches.size() > 1) {
+        cout << "\nCustomers named \"" << name << "\":\n";
+        for (size_t i = 0; i < matches.size(); i++) {
+            cout << (i + 1) << ". " << customers.nameOf(matches[i]) << " (" << customers.contactOf(matches[i])
+                 << ") - " << index.positionsOfCustomer(matches[i]).size() << " sale(s)\n";
+        }
+        cout << "Select customer (0 for all): ";
+
+        int choice;
+        cin >> choice;
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+
+        if (choice < 0 || choice > (int)matches.size()) {
+            cout << "Invalid selection." << endl;
+            return;
+        }
+        if (choice > 0) {
+            contact = customers.contactOf(matches[choice - 1]);
+        }
+    }
+
+    printCustomerHistory(name, contact);
+}
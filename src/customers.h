@@ -0,0 +1,48 @@
+#ifndef CUSTOMERS_H
+#define CUSTOMERS_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+using namespace std;
+
+// A customer is a name and contact together, as in the top customers report,
+// so namesakes stay separate. The sales index (see salesindex.h) keeps one
+// dictionary entry per distinct customer and refers to it from each sale by
+// ID, with a postings list from each customer to their sales, so a
+// customer's history reads only that customer's records.
+
+// Distinct customers, each with a small integer ID
+class CustomerDictionary {
+private:
+    vector<string> names;                             // Per ID
+    vector<string> contacts;                          // Per ID
+    unordered_map<string, uint32_t> idByKey;          // "name|contact"
+    unordered_map<string, vector<uint32_t>> byName;   // Lower-case name
+
+public:
+    // ID of a customer, adding them if they are new
+    uint32_t intern(string_view name, string_view contact);
+
+    // IDs of customers with this name (any case), in the order first seen
+    const vector<uint32_t>& idsNamed(const string& name) const;
+
+    const string& nameOf(uint32_t id) const;
+    const string& contactOf(uint32_t id) const;
+
+    size_t size() const;
+    void clear();
+};
+
+// Print every sale of the customers with this name (any case) and, if
+// contact is not empty, this contact, with each customer's totals. Returns
+// the number of customers found.
+size_t printCustomerHistory(const string& name, const string& contact);
+
+// Interactive customer history screen for the sales search menu
+void customerHistory();
+
+#endif // CUSTOMERS_H
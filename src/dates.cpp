@@ -0,0 +1,110 @@
+#include "dates.h"
+#include <cstdio>
+#include <iostream>
+#include <ctime>
+
+using namespace std;
+
+// Days from 1970-01-01 to the given civil date (proleptic Gregorian calendar)
+static int daysFromCivil(int y, int m, int d) {
+    y -= m <= 2 ? 1 : 0;
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const int yoe = y - era * 400;
+    const int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// Inverse of daysFromCivil
+static void civilFromDays(int z, int& y, int& m, int& d) {
+    z += 719468;
+    const int era = (z >= 0 ? z : z - 146096) / 146097;
+    const int doe = z - era * 146097;
+    const int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp + (mp < 10 ? 3 : -9);
+    y = yoe + era * 400 + (m <= 2 ? 1 : 0);
+}
+
+static int daysInMonth(int y, int m) {
+    static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+    return (m == 2 && leap) ? 29 : days[m - 1];
+}
+
+// Convert a YYYY-MM-DD date to a day number
+int dateToDayNumber(const string& date) {
+    if (date.size() != 10 || date[4] != '-' || date[7] != '-') {
+        return INVALID_DAY;
+    }
+
+    for (size_t i = 0; i < date.size(); i++) {
+        if (i != 4 && i != 7 && (date[i] < '0' || date[i] > '9')) {
+            return INVALID_DAY;
+        }
+    }
+
+    int y = (date[0] - '0') * 1000 + (date[1] - '0') * 100 + (date[2] - '0') * 10 + (date[3] - '0');
+    int m = (date[5] - '0') * 10 + (date[6] - '0');
+    int d = (date[8] - '0') * 10 + (date[9] - '0');
+
+    if (m < 1 || m > 12 || d < 1 || d > daysInMonth(y, m)) {
+        return INVALID_DAY;
+    }
+
+    return daysFromCivil(y, m, d);
+}
+
+// Convert a day number back to a YYYY-MM-DD date
+string dayNumberToDate(int day) {
+    int y, m, d;
+    civilFromDays(day, y, m, d);
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", y, m, d);
+    return buffer;
+}
+
+// Month key (YYYY-MM) for a day number
+string dayNumberToMonth(int day) {
+    return dayNumberToDate(day).substr(0, 7);
+}
+
+// First day of the month containing the given day
+int firstDayOfMonth(int day) {
+    int y, m, d;
+    civilFromDays(day, y, m, d);
+    return daysFromCivil(y, m, 1);
+}
+
+// First day of the following month
+int firstDayOfNextMonth(int day) {
+    int y, m, d;
+    civilFromDays(day, y, m, d);
+    return m == 12 ? daysFromCivil(y + 1, 1, 1) : daysFromCivil(y, m + 1, 1);
+}
+
+// Today's date as a day number (local time)
+int todayDayNumber() {
+    time_t now = time(0);
+    tm* ltm = localtime(&now);
+    return daysFromCivil(1900 + ltm->tm_year, 1 + ltm->tm_mon, ltm->tm_mday);
+}
+
+// Read an optional date, falling back to a default when left blank
+int readOptionalDay(const string& prompt, int defaultDay) {
+    string input;
+    while (true) {
+        cout << prompt;
+        getline(cin, input);
+        if (input.empty()) {
+            return defaultDay;
+        }
+        int day = dateToDayNumber(input);
+        if (day != INVALID_DAY) {
+            return day;
+        }
+        cout << "Invalid date. Please use YYYY-MM-DD." << endl;
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef DATES_H
+#define DATES_H
+
+#include <string>
+
+using namespace std;
+
+// Sentinel returned when a date string cannot be parsed
+const int INVALID_DAY = -2147483647 - 1;
+
+// Convert a YYYY-MM-DD date to a day number (days since 1970-01-01)
+int dateToDayNumber(const string& date);
+
+// Convert a day number back to a YYYY-MM-DD date
+string dayNumberToDate(int day);
+
+// Month key (YYYY-MM) for a day number
+string dayNumberToMonth(int day);
+
+// Day number of the first day of the month containing the given day
+int firstDayOfMonth(int day);
+
+// Day number of the first day of the following month
+int firstDayOfNextMonth(int day);
+
+// Today's date as a day number (local time)
+int todayDayNumber();
+
+// Prompt for a YYYY-MM-DD date; an empty answer returns defaultDay
+int readOptionalDay(const string& prompt, int defaultDay);
+
+#endif // DATES_H
@@ -0,0 +1,370 @@
+#include "deltastore.h"
+#include "fileutil.h"
+#include "profile.h"
+#include <iostream>
+#include <fstream>
+#include <unordered_map>
+#include <cstdio>
+#include <functional>
+
+using namespace std;
+
+// Key of a stored record (text before the first '|')
+string recordKey(const string& record) {
+    return record.substr(0, record.find('|'));
+}
+
+static long long fileSize(const string& path) {
+    ifstream file(path, ios::binary | ios::ate);
+    return file.is_open() ? (long long)file.tellg() : 0;
+}
+
+// Ordered records with a key index; deletes leave holes that are skipped on output
+class RecordFold {
+private:
+    vector<string> records;
+    vector<bool> live;
+    unordered_map<string, size_t> index;
+
+public:
+    void upsert(const string& record) {
+        string key = recordKey(record);
+        auto it = index.find(key);
+        if (it != index.end() && live[it->second]) {
+            records[it->second] = record;
+        } else {
+            index[key] = records.size();
+            records.push_back(record);
+            live.push_back(true);
+        }
+    }
+
+    void erase(const string& key) {
+        auto it = index.find(key);
+        if (it != index.end()) {
+            live[it->second] = false;
+            index.erase(it);
+        }
+    }
+
+    // Apply one delta line ("I|record", "U|record" or "D|key")
+    void apply(const string& line) {
+        if (line.size() < 2 || line[1] != '|') {
+            return;
+        }
+        if (line[0] == CHANGE_DELETE) {
+            erase(line.substr(2));
+        } else {
+            upsert(line.substr(2));
+        }
+    }
+
+    void result(vector<string>& out) {
+        out.clear();
+        for (size_t i = 0; i < records.size(); i++) {
+            if (live[i]) {
+                out.push_back(records[i]);
+            }
+        }
+    }
+};
+
+// Returns true if the file existed
+static bool readLines(const string& path, const function<void(const string&)>& visit) {
+    ifstream file(path);
+    string line;
+
+    if (!file.is_open()) {
+        return false;
+    }
+
+    while (getline(file, line)) {
+        if (!line.empty()) {
+            visit(line);
+        }
+    }
+    return true;
+}
+
+// Constructor
+DeltaStore::DeltaStore(const string& snapshot, long long minBytes)
+    : snapshotFile(snapshot),
+      deltaFile(snapshot + ".delta"),
+      compactingFile(snapshot + ".delta.compacting"),
+      lockFile(snapshot + ".lock"),
+      compactionLockFile(snapshot + ".compact.lock"),
+      minCompactBytes(minBytes),
+      compacting(false),
+      layout(0),
+      sizesKnown(false),
+      snapshotBytes(0),
+      deltaBytes(0),
+      deltaUnsynced(false),
+      frozenUnsynced(false),
+      entriesUnsynced(false) {
+}
+
+// Destructor (waits for a running compaction)
+DeltaStore::~DeltaStore() {
+    waitForCompaction();
+}
+
+void DeltaStore::loadSizes() {
+    if (!sizesKnown) {
+        snapshotBytes = fileSize(snapshotFile);
+        deltaBytes = fileSize(deltaFile) + fileSize(compactingFile);
+        sizesKnown = true;
+    }
+}
+
+// Current records: snapshot with all deltas applied
+bool DeltaStore::load(vector<string>& records) {
+    ProfileSpan span("file", "DeltaStore::load");
+    lock_guard<mutex> guard(fileLock);
+    FileLock filesLock(lockFile, FILE_LOCK_SHARED);
+    RecordFold fold;
+
+    bool found = readLines(snapshotFile, [&fold](const string& line) { fold.upsert(line); });
+    found = readLines(compactingFile, [&fold](const string& line) { fold.apply(line); }) || found;
+    found = readLines(deltaFile, [&fold](const string& line) { fold.apply(line); }) || found;
+
+    fold.result(records);
+    return found;
+}
+
+// Append one change
+bool DeltaStore::append(ChangeOp op, const string& record) {
+    ProfileSpan span("file", "DeltaStore::append");
+    {
+        lock_guard<mutex> guard(fileLock);
+        FileLock filesLock(lockFile, FILE_LOCK_SHARED);
+        loadSizes();
+
+        entriesUnsynced = entriesUnsynced || !fileExists(deltaFile);
+        ofstream file(deltaFile, ios::app);
+        if (!file.is_open()) {
+            cout << "Error: Could not open " << deltaFile << " for writing." << endl;
+            return false;
+        }
+
+        deltaUnsynced = true;
+        file << (char)op << '|' << record << '\n';
+        file.close();
+        if (file.fail()) {
+            cout << "Error: Could not write to " << deltaFile << "." << endl;
+            return false;
+        }
+        deltaBytes += (long long)record.size() + 3;
+    }
+
+    maybeStartCompaction();
+    return true;
+}
+
+// Append several changes with one write
+bool DeltaStore::appendBatch(const vector<pair<ChangeOp, string>>& changes) {
+    ProfileSpan span("file", "DeltaStore::appendBatch");
+    {
+        lock_guard<mutex> guard(fileLock);
+        FileLock filesLock(lockFile, FILE_LOCK_SHARED);
+        loadSizes();
+
+        string text;
+        for (const auto& change : changes) {
+            text += (char)change.first;
+            text += '|';
+            text += change.second;
+            text += '\n';
+        }
+
+        entriesUnsynced = entriesUnsynced || !fileExists(deltaFile);
+        ofstream file(deltaFile, ios::app);
+        if (!file.is_open()) {
+            cout << "Error: Could not open " << deltaFile << " for writing." << endl;
+            return false;
+        }
+
+        deltaUnsynced = true;
+        file.write(text.data(), (streamsize)text.size());
+        file.close();
+        if (file.fail()) {
+            cout << "Error: Could not write to " << deltaFile << "." << endl;
+            return false;
+        }
+        deltaBytes += (long long)text.size();
+    }
+
+    maybeStartCompaction();
+    return true;
+}
+
+// Replace the whole table with a fresh snapshot and empty delta
+void DeltaStore::rewrite(const vector<string>& records) {
+    ProfileSpan span("file", "DeltaStore::rewrite");
+    waitForCompaction();
+    FileLock compactionLock(compactionLockFile, FILE_LOCK_EXCLUSIVE);
+    lock_guard<mutex> guard(fileLock);
+    FileLock filesLock(lockFile, FILE_LOCK_EXCLUSIVE);
+
+    string tempFile = snapshotFile + ".tmp";
+    ofstream file(tempFile);
+
+    if (!file.is_open()) {
+        cout << "Error: Could not open " << tempFile << " for writing." << endl;
+        return;
+    }
+
+    long long newSnapshotBytes = 0;
+    for (const auto& record : records) {
+        file << record << '\n';
+        newSnapshotBytes += (long long)record.size() + 1;
+    }
+    file.close();
+
+    // The deltas go only once the new snapshot is durably in place
+    if (file.fail() || !replaceFileDurably(tempFile, snapshotFile)) {
+        cout << "Error: Could not write " << snapshotFile << "." << endl;
+        remove(tempFile.c_str());
+        return;
+    }
+    remove(compactingFile.c_str());
+    remove(deltaFile.c_str());
+    syncDirectory(directoryOf(snapshotFile));
+    snapshotBytes = newSnapshotBytes;
+    deltaBytes = 0;
+    sizesKnown = true;
+    deltaUnsynced = frozenUnsynced = entriesUnsynced = false;
+}
+
+// Sync the files holding changes not yet on disk: the delta, and the frozen
+// delta if a compaction moved some there and has not yet folded them into a
+// (synced) snapshot. The directory is synced only if an entry changed.
+bool DeltaStore::sync() {
+    ProfileSpan span("file", "DeltaStore::sync");
+    lock_guard<mutex> guard(fileLock);
+    bool ok = true;
+
+    if (frozenUnsynced && fileExists(compactingFile)) {
+        ok = syncFile(compactingFile) && ok;
+    }
+    if (deltaUnsynced && fileExists(deltaFile)) {
+        ok = syncFile(deltaFile) && ok;
+    }
+    if (entriesUnsynced) {
+        ok = syncDirectory(directoryOf(snapshotFile)) && ok;
+    }
+    if (ok) {
+        deltaUnsynced = frozenUnsynced = entriesUnsynced = false;
+    }
+    return ok;
+}
+
+// Start a background compaction once the delta outgrows its threshold
+void DeltaStore::maybeStartCompaction() {
+    {
+        lock_guard<mutex> guard(fileLock);
+        long long threshold = snapshotBytes / 2 > minCompactBytes ? snapshotBytes / 2 : minCompactBytes;
+        if (compacting || deltaBytes < threshold) {
+            return;
+        }
+        compacting = true;
+    }
+
+    // The previous compaction has finished; reap its thread before starting another
+    lock_guard<mutex> guard(compactorLock);
+    if (compactor.joinable()) {
+        compactor.join();
+    }
+    compactor = thread(&DeltaStore::compact, this);
+}
+
+// Fold the delta into a new snapshot (runs on the compactor thread)
+void DeltaStore::compact() {
+    ProfileSpan span("file", "DeltaStore::compact");
+
+    // Another process is compacting; it freezes the shared delta, with this
+    // process's changes in it, once it is done
+    FileLock compactionLock(compactionLockFile, FILE_LOCK_TRY_EXCLUSIVE);
+    if (compactionLock.busy()) {
+        lock_guard<mutex> guard(fileLock);
+        deltaBytes = 0;
+        compacting = false;
+        return;
+    }
+
+    {
+        // Freeze the current delta; new changes go to a fresh delta file
+        lock_guard<mutex> guard(fileLock);
+        FileLock filesLock(lockFile, FILE_LOCK_EXCLUSIVE);
+        layout++;
+
+        if (fileExists(compactingFile)) {
+            // Left over from an interrupted compaction: fold the delta into it,
+            // and drop the delta only once the frozen copy is on disk
+            ofstream frozen(compactingFile, ios::app);
+            readLines(deltaFile, [&frozen](const string& line) { frozen << line << '\n'; });
+            frozen.close();
+            if (!frozen.fail() && syncFile(compactingFile)) {
+                remove(deltaFile.c_str());
+            }
+        } else {
+            replaceFile(deltaFile, compactingFile);
+        }
+        frozenUnsynced = frozenUnsynced || deltaUnsynced;
+        deltaUnsynced = false;
+        entriesUnsynced = true;
+        deltaBytes = 0;
+    }
+
+    // The snapshot and frozen delta are only changed by the compaction lock's
+    // holder, so they can be read and merged without holding the other locks
+    RecordFold fold;
+    readLines(snapshotFile, [&fold](const string& line) { fold.upsert(line); });
+    readLines(compactingFile, [&fold](const string& line) { fold.apply(line); });
+
+    vector<string> records;
+    fold.result(records);
+
+    string tempFile = snapshotFile + ".tmp";
+    ofstream file(tempFile);
+    long long newSnapshotBytes = 0;
+
+    if (file.is_open()) {
+        for (const auto& record : records) {
+            file << record << '\n';
+            newSnapshotBytes += (long long)record.size() + 1;
+        }
+        file.close();
+
+        // The frozen delta goes only once the new snapshot is durably in place
+        lock_guard<mutex> guard(fileLock);
+        FileLock filesLock(lockFile, FILE_LOCK_EXCLUSIVE);
+        if (!file.fail() && replaceFileDurably(tempFile, snapshotFile)) {
+            remove(compactingFile.c_str());
+            syncDirectory(directoryOf(snapshotFile));
+            snapshotBytes = newSnapshotBytes;
+            frozenUnsynced = false;
+        } else {
+            cout << "Error: Could not write " << tempFile << " for compaction." << endl;
+            remove(tempFile.c_str());
+        }
+    } else {
+        cout << "Error: Could not open " << tempFile << " for compaction." << endl;
+    }
+
+    layout++;
+    compacting = false;
+}
+
+// Odd while a compaction is moving the files
+unsigned long long DeltaStore::layoutVersion() const {
+    return layout;
+}
+
+// Block until any background compaction has finished
+void DeltaStore::waitForCompaction() {
+    lock_guard<mutex> guard(compactorLock);
+    if (compactor.joinable()) {
+        compactor.join();
+    }
+}
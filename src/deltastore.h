@@ -0,0 +1,133 @@
+#ifndef DELTASTORE_H
+#define DELTASTORE_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+using namespace std;
+
+// Kinds of change recorded in a delta log
+enum ChangeOp {
+    CHANGE_INSERT = 'I',
+    CHANGE_UPDATE = 'U',
+    CHANGE_DELETE = 'D'
+};
+
+// Storage behind a keyed table (records keyed by the text before the first
+// '|'): load everything, record one change, or replace the whole table.
+class RecordStore {
+public:
+    virtual ~RecordStore() {}
+
+    // Current records. Returns false if the table's files do not exist.
+    virtual bool load(vector<string>& records) = 0;
+
+    // Store one change. For deletes the record is just the key. Returns
+    // false if the change could not be written.
+    virtual bool append(ChangeOp op, const string& record) = 0;
+
+    // Store several changes in order. Stores that can do so write them all at
+    // once. Returns false if the changes could not be written.
+    virtual bool appendBatch(const vector<pair<ChangeOp, string>>& changes) {
+        for (const auto& change : changes) {
+            if (!append(change.first, change.second)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Replace the whole table
+    virtual void rewrite(const vector<string>& records) = 0;
+
+    // Record with this key by a direct lookup, for stores that can do one
+    // without loading the table. False if the store cannot or has no such record.
+    virtual bool find(const string&, string&) { return false; }
+
+    // Flush the table's files to disk; false if they could not be synced
+    virtual bool sync() = 0;
+
+    // Bumped when this process starts moving the table's files around without
+    // changing the table (compaction) and again when it is done, so it is odd
+    // while that is in progress
+    virtual unsigned long long layoutVersion() const { return 0; }
+};
+
+// A table stored as a base snapshot (one record per line, keyed by the text
+// before the first '|') plus an append-only delta log of inserts, updates and
+// deletes. Once the delta grows past max(minimum threshold, half the snapshot),
+// a background thread folds it into a new snapshot. Startup replay is bounded
+// by 1.5x the snapshot size and each record is rewritten O(1) times amortized.
+//
+// Files: <snapshot>, <snapshot>.delta and, while compacting, <snapshot>.delta.compacting.
+// Replaying a delta is idempotent, and a new snapshot is synced into place
+// before the deltas it replaces are removed, so a crash or power loss at any
+// point during compaction leaves a state that loads correctly.
+//
+// Several processes may share the files. Appends and loads hold a shared flock
+// on <snapshot>.lock, which freezing the delta and replacing the snapshot hold
+// exclusively; a compaction or rewrite holds <snapshot>.compact.lock throughout,
+// so only one process at a time folds deltas into a new snapshot.
+class DeltaStore : public RecordStore {
+private:
+    string snapshotFile;
+    string deltaFile;
+    string compactingFile;
+    string lockFile;           // Flocked by appends and loads, and while files move
+    string compactionLockFile; // Flocked for a whole compaction or rewrite
+    long long minCompactBytes;
+
+    mutex fileLock;            // Guards the files and the size counters
+    mutex compactorLock;       // Guards starting and joining the compactor thread
+    thread compactor;
+    atomic<bool> compacting;
+    atomic<unsigned long long> layout;
+    bool sizesKnown;
+    long long snapshotBytes;
+    long long deltaBytes;
+    bool deltaUnsynced;        // Appends since the last sync are not on disk yet
+    bool frozenUnsynced;       // Nor are the ones a compaction froze with the delta
+    bool entriesUnsynced;      // A file was created or renamed since the last sync
+
+    void loadSizes();
+    void maybeStartCompaction();
+    void compact();
+
+public:
+    // Constructor
+    DeltaStore(const string& snapshot, long long minCompactBytes);
+
+    // Destructor (waits for a running compaction)
+    ~DeltaStore();
+
+    // Current records: snapshot with all deltas applied. Returns false if no files exist.
+    bool load(vector<string>& records) override;
+
+    // Append one change. For deletes the record is just the key.
+    bool append(ChangeOp op, const string& record) override;
+
+    // Append several changes with one write
+    bool appendBatch(const vector<pair<ChangeOp, string>>& changes) override;
+
+    // Replace the whole table with a fresh snapshot and empty delta
+    void rewrite(const vector<string>& records) override;
+
+    // Sync the delta files written since the last sync. The snapshot is
+    // always synced into place when it is written, so it never needs one.
+    bool sync() override;
+
+    // Odd while a compaction is moving the files
+    unsigned long long layoutVersion() const override;
+
+    // Block until any background compaction has finished
+    void waitForCompaction();
+};
+
+// Key of a stored record (text before the first '|')
+string recordKey(const string& record);
+
+#endif // DELTASTORE_H
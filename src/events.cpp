@@ -0,0 +1,290 @@
+#include "events.h"
+#include "changelog.h"
+#include "config.h"
+#include "fileutil.h"
+#include "profile.h"
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cerrno>
+#include <atomic>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#endif
+
+using namespace std;
+
+// Event name for a logged change
+static string eventName(const TxChange& change) {
+    if (change.table == TX_SALES) {
+        return "sale.add";
+    }
+    switch (change.op) {
+        case CHANGE_INSERT: return "vehicle.add";
+        case CHANGE_UPDATE: return "vehicle.update";
+        default: return "vehicle.delete";
+    }
+}
+
+// "<sequence>|<event>|<record>\n"
+static string formatEvent(const ChangeLogEntry& entry) {
+    return to_string(entry.sequence) + "|" + eventName(entry.change) + "|" + entry.change.record + "\n";
+}
+
+#ifdef _WIN32
+
+void startEventPublisher() {
+    if (!getConfigString("event_socket", "").empty()) {
+        cout << "Warning: event_socket is not supported on this platform; no events are published." << endl;
+    }
+}
+
+void stopEventPublisher() {
+}
+
+void notifyEventPublisher() {
+}
+
+#else
+
+#ifdef MSG_NOSIGNAL
+static const int SEND_FLAGS = MSG_NOSIGNAL;  // A departed subscriber must not raise SIGPIPE
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+// One connected subscriber
+struct Subscriber {
+    int fd;
+    bool subscribed;        // SUBSCRIBE line received
+    string request;         // SUBSCRIBE line read so far
+    ChangeLogCursor cursor; // Last event queued for this subscriber
+    string pending;         // Events queued but not yet sent
+    size_t sent;            // Bytes of 'pending' already sent
+    bool closed;
+};
+
+static int listenSocket = -1;
+static int wakeRead = -1;
+static atomic<int> wakeWrite(-1);
+static atomic<bool> publishing(false);
+static string socketPath;
+static thread publisherThread;
+
+// Wake the publisher after changes were logged
+void notifyEventPublisher() {
+    int fd = wakeWrite.load();
+    if (fd >= 0) {
+        char c = 1;
+        // Non-blocking: a full pipe already means a wake-up is pending
+        ssize_t ignored = write(fd, &c, 1);
+        (void)ignored;
+    }
+}
+
+// Read the SUBSCRIBE line; any later input is discarded. Marks the
+// subscriber closed on hang-up or a bad request.
+static void readFromSubscriber(Subscriber& subscriber) {
+    char buffer[256];
+    ssize_t count = recv(subscriber.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+
+    if (count == 0 || (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        subscriber.closed = true;
+        return;
+    }
+    if (count < 0 || subscriber.subscribed) {
+        return;
+    }
+
+    subscriber.request.append(buffer, (size_t)count);
+    size_t end = subscriber.request.find('\n');
+    if (end == string::npos) {
+        if (subscriber.request.size() > 256) {
+            subscriber.closed = true;
+        }
+        return;
+    }
+
+    istringstream in(subscriber.request.substr(0, end));
+    string verb;
+    long long sequence = -1;
+    in >> verb >> sequence;
+
+    if (verb != "SUBSCRIBE" || in.fail() || sequence < 0) {
+        string error = "ERROR expected SUBSCRIBE <sequence>\n";
+        send(subscriber.fd, error.data(), error.size(), SEND_FLAGS | MSG_DONTWAIT);
+        subscriber.closed = true;
+        return;
+    }
+
+    // The offset is found by scanning the log on the first read
+    subscriber.subscribed = true;
+    subscriber.cursor = {sequence, 0};
+    subscriber.request.clear();
+}
+
+// Queue the next batch if everything queued has been sent, then send as much
+// as the socket takes. Returns true if more events are waiting in the log.
+static bool pumpSubscriber(Subscriber& subscriber, const string& logPath, size_t batch) {
+    bool more = false;
+
+    if (subscriber.sent == subscriber.pending.size()) {
+        vector<ChangeLogEntry> entries;
+        subscriber.pending.clear();
+        subscriber.sent = 0;
+
+        if (readChangeLog(logPath, subscriber.cursor, batch, entries)) {
+            for (const auto& entry : entries) {
+                subscriber.pending += formatEvent(entry);
+            }
+            more = entries.size() == batch;
+        }
+    }
+
+    while (subscriber.sent < subscriber.pending.size()) {
+        ssize_t count = send(subscriber.fd, subscriber.pending.data() + subscriber.sent,
+                             subscriber.pending.size() - subscriber.sent, SEND_FLAGS | MSG_DONTWAIT);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                subscriber.closed = true;
+            }
+            return false;  // Socket full: poll for POLLOUT
+        }
+        subscriber.sent += (size_t)count;
+    }
+    return more;
+}
+
+// Publisher thread: accept subscribers and send them events
+static void publishEvents(int listenFd, int wakeFd, string logPath, size_t batch) {
+    vector<Subscriber> subscribers;
+    int timeout = 0;
+
+    while (publishing) {
+        vector<pollfd> fds;
+        fds.push_back({listenFd, POLLIN, 0});
+        fds.push_back({wakeFd, POLLIN, 0});
+        for (const auto& subscriber : subscribers) {
+            short events = POLLIN;
+            if (subscriber.sent < subscriber.pending.size()) {
+                events |= POLLOUT;
+            }
+            fds.push_back({subscriber.fd, events, 0});
+        }
+
+        // Changes stored by another process (command mode) send no wake-up,
+        // so the log is checked at least once a second
+        if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR) {
+            break;
+        }
+        if (!publishing) {
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            char drain[64];
+            while (read(wakeFd, drain, sizeof(drain)) > 0) {
+            }
+        }
+
+        for (size_t i = 0; i < subscribers.size(); i++) {
+            if (fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR)) {
+                readFromSubscriber(subscribers[i]);
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int client;
+            while ((client = accept(listenFd, nullptr, nullptr)) >= 0) {
+                fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+                subscribers.push_back({client, false, "", {0, 0}, "", 0, false});
+            }
+        }
+
+        timeout = 1000;
+        {
+            ProfileSpan span("events", "publishEvents");
+            for (auto& subscriber : subscribers) {
+                if (subscriber.subscribed && !subscriber.closed && pumpSubscriber(subscriber, logPath, batch)) {
+                    timeout = 0;  // Behind: send the next batch straight away
+                }
+            }
+        }
+
+        for (auto& subscriber : subscribers) {
+            if (subscriber.closed) {
+                close(subscriber.fd);
+            }
+        }
+        subscribers.erase(remove_if(subscribers.begin(), subscribers.end(),
+                                    [](const Subscriber& subscriber) { return subscriber.closed; }),
+                          subscribers.end());
+    }
+
+    for (const auto& subscriber : subscribers) {
+        close(subscriber.fd);
+    }
+}
+
+// Start publishing on event_socket, if set
+void startEventPublisher() {
+    string path = getConfigString("event_socket", "");
+    if (path.empty() || publishing) {
+        return;
+    }
+    if (!changeLogEnabled()) {
+        cout << "Warning: event_socket is set but change_log is off; no events are published." << endl;
+        return;
+    }
+
+    int fd = listenOnLocalSocket(path);
+    int pipeFds[2];
+    if (fd < 0) {
+        return;
+    }
+    if (pipe(pipeFds) != 0) {
+        cout << "Error: Could not create the event publisher's wake-up pipe." << endl;
+        close(fd);
+        unlink(path.c_str());
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(pipeFds[0], F_SETFL, fcntl(pipeFds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(pipeFds[1], F_SETFL, fcntl(pipeFds[1], F_GETFL) | O_NONBLOCK);
+
+    size_t batch = (size_t)max(1LL, getConfigInt("event_batch", 1000));
+    listenSocket = fd;
+    socketPath = path;
+    wakeRead = pipeFds[0];
+    wakeWrite = pipeFds[1];
+    publishing = true;
+    publisherThread = thread(publishEvents, fd, pipeFds[0], dataPath(CHANGE_LOG_FILE), batch);
+}
+
+// Stop publishing and remove the socket file
+void stopEventPublisher() {
+    if (!publishing) {
+        return;
+    }
+    publishing = false;
+    notifyEventPublisher();
+    publisherThread.join();
+
+    int fd = wakeWrite.exchange(-1);
+    close(fd);
+    close(wakeRead);
+    close(listenSocket);
+    unlink(socketPath.c_str());
+    wakeRead = -1;
+    listenSocket = -1;
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <string>
+
+using namespace std;
+
+// Change-data-capture stream. With event_socket=<path> in tourmate.conf, a
+// subscriber connects to that local socket and sends "SUBSCRIBE <sequence>\n".
+// It then receives every change stored after that sequence (0 for all of
+// them), followed by each new one as it is stored, one line per event:
+//
+//   <sequence>|vehicle.add|<vehicle record>
+//   <sequence>|vehicle.update|<vehicle record>
+//   <sequence>|vehicle.delete|<vehicle ID>
+//   <sequence>|sale.add|<sale record>
+//
+// Events are read from the change log (see changelog.h), which event_socket
+// switches on, so a subscriber that reconnects with the last sequence it
+// handled misses nothing. Storing a change only wakes the publisher thread;
+// it sends each subscriber up to event_batch events at a time, as fast as
+// that subscriber's socket takes them, so a slow or stalled subscriber never
+// holds up the menus or the other subscribers.
+
+// Start publishing on event_socket, if set
+void startEventPublisher();
+
+// Stop publishing and remove the socket file
+void stopEventPublisher();
+
+// Wake the publisher after changes were logged; never blocks
+void notifyEventPublisher();
+
+#endif // EVENTS_H
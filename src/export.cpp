@@ -0,0 +1,386 @@
+#include "export.h"
+#include "vehicleindex.h"
+#include "profile.h"
+#include "fileutil.h"
+#include <iostream>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <charconv>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <string_view>
+
+using namespace std;
+
+// Size of the block handed to the output stream per write
+static const size_t EXPORT_BUFFER_BYTES = 1 << 20;
+
+// Formats rows into one large buffer and writes it out a block at a time
+class ExportWriter {
+private:
+    ostream& out;
+    unique_ptr<char[]> buffer;
+    size_t used;
+
+    // Make room for at least bytes more characters
+    void reserve(size_t bytes) {
+        if (EXPORT_BUFFER_BYTES - used < bytes) {
+            flush();
+        }
+    }
+
+public:
+    explicit ExportWriter(ostream& out) : out(out), buffer(new char[EXPORT_BUFFER_BYTES]), used(0) {
+    }
+
+    ~ExportWriter() {
+        flush();
+    }
+
+    void flush() {
+        if (used > 0) {
+            out.write(buffer.get(), used);
+            used = 0;
+        }
+    }
+
+    void put(char c) {
+        reserve(1);
+        buffer[used++] = c;
+    }
+
+    void write(string_view text) {
+        if (text.size() > EXPORT_BUFFER_BYTES) {
+            flush();
+            out.write(text.data(), text.size());
+            return;
+        }
+        reserve(text.size());
+        memcpy(buffer.get() + used, text.data(), text.size());
+        used += text.size();
+    }
+
+    void integer(long long value) {
+        reserve(24);
+        used = to_chars(buffer.get() + used, buffer.get() + EXPORT_BUFFER_BYTES, value).ptr - buffer.get();
+    }
+
+    // Shortest text that reads back as the same double, as stored in the
+    // data files, so a dump loses no precision
+    void number(double value) {
+        reserve(SCHEMA_NUMBER_TEXT_BYTES);
+        used = formatDoubleText(buffer.get() + used, buffer.get() + used + SCHEMA_NUMBER_TEXT_BYTES, value) -
+               buffer.get();
+    }
+
+    // CSV field, quoted only when it holds a separator, quote or line break
+    void csvText(string_view text) {
+        if (text.find_first_of(",\"\r\n") == string_view::npos) {
+            write(text);
+            return;
+        }
+        put('"');
+        for (char c : text) {
+            if (c == '"') {
+                put('"');
+            }
+            put(c);
+        }
+        put('"');
+    }
+
+    // JSON string literal
+    void jsonText(string_view text) {
+        static const char HEX[] = "0123456789abcdef";
+        size_t start = 0;
+
+        put('"');
+        for (size_t i = 0; i < text.size(); i++) {
+            unsigned char c = (unsigned char)text[i];
+            if (c != '"' && c != '\\' && c >= 0x20) {
+                continue;
+            }
+            write(text.substr(start, i - start));
+            if (c == '"' || c == '\\') {
+                put('\\');
+                put((char)c);
+            } else {
+                char escape[] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xF]};
+                write(string_view(escape, sizeof(escape)));
+            }
+            start = i + 1;
+        }
+        write(text.substr(start));
+        put('"');
+    }
+
+    // One field by type: text is quoted as needed, numbers are written as is
+    // (years as integers, rates and amounts in full precision)
+    void csvValue(string_view text) {
+        csvText(text);
+    }
+
+    void csvValue(int value) {
+        integer(value);
+    }
+
+    void csvValue(double value) {
+        number(value);
+    }
+
+    void jsonValue(string_view text) {
+        jsonText(text);
+    }
+
+    void jsonValue(int value) {
+        integer(value);
+    }
+
+    // JSON has no NaN or infinity
+    void jsonValue(double value) {
+        if (isfinite(value)) {
+            number(value);
+        } else {
+            write("null");
+        }
+    }
+
+    // "name": prefix of a JSON member
+    void jsonKey(string_view name, bool first) {
+        write(first ? "{\"" : ",\"");
+        write(name);
+        write("\":");
+    }
+};
+
+// Parse a format name
+bool parseExportFormat(const string& text, ExportFormat& format) {
+    if (text == "csv") {
+        format = EXPORT_CSV;
+    } else if (text == "jsonl" || text == "json") {
+        format = EXPORT_JSONL;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Columns come from the record schema (schema.h), whose names follow the
+// query language so exports and filters line up
+template <class Record>
+static void writeHeader(ExportWriter& writer, ExportFormat format) {
+    if (format == EXPORT_CSV) {
+        static const string header = schemaColumnList<Record>(',') + "\n";
+        writer.write(header);
+    }
+}
+
+// Works on Vehicle, Sales and SalesView
+template <class Record>
+static void writeRecord(ExportWriter& writer, const Record& record, ExportFormat format) {
+    bool first = true;
+
+    forEachSchemaField<Record>([&](const auto& field) {
+        if (format == EXPORT_CSV) {
+            if (!first) {
+                writer.put(',');
+            }
+            writer.csvValue(field.of(record));
+        } else {
+            writer.jsonKey(field.name, first);
+            writer.jsonValue(field.of(record));
+        }
+        first = false;
+    });
+
+    if (format == EXPORT_JSONL) {
+        writer.put('}');
+    }
+    writer.put('\n');
+}
+
+// Open the export target; "-" is standard output
+static ostream* openExport(const string& fileName, ofstream& file) {
+    if (fileName == "-") {
+        return &cout;
+    }
+
+    file.open(fileName, ios::binary | ios::trunc);
+    if (!file.is_open()) {
+        return nullptr;
+    }
+    return &file;
+}
+
+// Write out what is buffered and close the file, removing it (unless it is a
+// device or pipe) if the export failed or any write did. Returns result, or -3 if the output failed.
+static long long finishExport(ExportWriter& writer, ostream& out, ofstream& file, const string& fileName,
+                              long long result) {
+    writer.flush();
+    out.flush();
+    if (file.is_open()) {
+        file.close();
+    }
+
+    if (out.fail() && result >= 0) {
+        result = -3;
+    }
+    if (result < 0 && fileName != "-" && regularFileExists(fileName)) {
+        remove(fileName.c_str());
+    }
+    return result;
+}
+
+// Stream matching vehicles
+long long exportVehicles(const Query& query, const SortOrder& order, ExportFormat format, const string& fileName) {
+    ProfileSpan span("report", "exportVehicles");
+    ofstream file;
+    ostream* out = openExport(fileName, file);
+    long long rows = 0;
+
+    if (out == nullptr) {
+        return -1;
+    }
+
+    ExportWriter writer(*out);
+    writeHeader<Vehicle>(writer, format);
+
+    if (!order.field.empty()) {
+        bool sorted = runSortedVehicleQuery(query, order, [&writer, &rows, format](const Vehicle& vehicle) {
+            writeRecord(writer, vehicle, format);
+            rows++;
+        });
+        return finishExport(writer, *out, file, fileName, sorted ? rows : -2);
+    }
+
+    {
+        LockedVehicleIndex index = vehicleIndex();
+        string plan;
+        vector<const Vehicle*> matches = query.predicates.empty() ? index->all() : runVehicleQuery(*index, query, plan);
+        for (const Vehicle* vehicle : matches) {
+            writeRecord(writer, *vehicle, format);
+            rows++;
+        }
+    }
+
+    return finishExport(writer, *out, file, fileName, rows);
+}
+
+// Stream matching sales, one partition at a time
+long long exportSales(const Query& query, const SortOrder& order, ExportFormat format, const string& fileName) {
+    ProfileSpan span("report", "exportSales");
+    ofstream file;
+    ostream* out = openExport(fileName, file);
+    long long rows = 0;
+
+    if (out == nullptr) {
+        return -1;
+    }
+
+    ExportWriter writer(*out);
+    writeHeader<Sales>(writer, format);
+
+    if (!order.field.empty()) {
+        bool sorted = runSortedSalesQuery(query, order, [&writer, &rows, format](const Sales& sale) {
+            writeRecord(writer, sale, format);
+            rows++;
+        });
+        return finishExport(writer, *out, file, fileName, sorted ? rows : -2);
+    }
+
+    if (query.predicates.empty()) {
+        // Unfiltered exports format straight from the partition text
+        forEachSaleViewInFile([&writer, &rows, format](const SalesView& sale) {
+            writeRecord(writer, sale, format);
+            rows++;
+        });
+    } else {
+        string plan;
+        runSalesQuery(query, [&writer, &rows, format](const Sales& sale) {
+            writeRecord(writer, sale, format);
+            rows++;
+        }, plan);
+    }
+
+    return finishExport(writer, *out, file, fileName, rows);
+}
+
+// Message for a failed export's return code
+string exportErrorMessage(long long result, const string& fileName) {
+    if (result == -2) {
+        return "Error: Could not write or read the temporary sort files (check sort_temp_dir).";
+    }
+    if (result == -3) {
+        return fileName == "-" ? "Error: Could not write the export to standard output."
+                               : "Error: Could not write " + fileName + "; the incomplete export was discarded.";
+    }
+    return "Error: Could not open " + fileName + " for writing.";
+}
+
+// Interactive export
+void exportData() {
+    int table, formatChoice;
+    string fileName, filter, sortText;
+    Query query;
+    SortOrder order;
+    string error;
+
+    cout << "\n===== EXPORT DATA =====\n";
+    cout << "1. Vehicles\n";
+    cout << "2. Sales\n";
+    cout << "Enter your choice: ";
+
+    if (!(cin >> table) || (table != 1 && table != 2)) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid choice." << endl;
+        return;
+    }
+
+    cout << "Format (1. CSV, 2. JSON Lines): ";
+    if (!(cin >> formatChoice) || (formatChoice != 1 && formatChoice != 2)) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid format." << endl;
+        return;
+    }
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+
+    ExportFormat format = formatChoice == 1 ? EXPORT_CSV : EXPORT_JSONL;
+    string defaultName = string(table == 1 ? "vehicles" : "sales") + (format == EXPORT_CSV ? ".csv" : ".jsonl");
+
+    cout << "Output file (Enter for " << defaultName << "): ";
+    getline(cin, fileName);
+    if (fileName.empty()) {
+        fileName = defaultName;
+    }
+
+    cout << "Filter query (Enter for all rows): ";
+    getline(cin, filter);
+    if (!filter.empty()) {
+        bool parsed = table == 1 ? parseVehicleQuery(filter, query, error) : parseSalesQuery(filter, query, error);
+        if (!parsed) {
+            cout << "Invalid query: " << error << endl;
+            return;
+        }
+    }
+
+    cout << "Sort by field, optionally with asc/desc (Enter for file order): ";
+    getline(cin, sortText);
+    bool parsed = table == 1 ? parseVehicleSortOrder(sortText, order, error) : parseSalesSortOrder(sortText, order, error);
+    if (!parsed) {
+        cout << "Invalid sort order: " << error << endl;
+        return;
+    }
+
+    long long rows = table == 1 ? exportVehicles(query, order, format, fileName)
+                                : exportSales(query, order, format, fileName);
+
+    if (rows < 0) {
+        cout << exportErrorMessage(rows, fileName) << endl;
+        return;
+    }
+    cout << "Exported " << rows << " row(s) to " << fileName << "." << endl;
+}
@@ -0,0 +1,35 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <string>
+#include "query.h"
+
+using namespace std;
+
+// Output formats for table exports
+enum ExportFormat {
+    EXPORT_CSV,    // RFC 4180 CSV with a header row
+    EXPORT_JSONL   // One JSON object per line
+};
+
+// "csv" or "jsonl"/"json"
+bool parseExportFormat(const string& text, ExportFormat& format);
+
+// Stream every vehicle or sale matching query (no predicates = all) to
+// fileName, or to standard output for "-". Rows are formatted into a large
+// buffer and written in blocks, and sales are read partition by partition,
+// so exports never hold the table in memory. With a sort field the rows go
+// through an external merge sort (see extsort.h) first. Returns the rows
+// written, -1 if the output could not be opened, -2 if the sort failed or -3
+// if the output could not be written. A regular file left incomplete by a
+// failure is removed.
+long long exportVehicles(const Query& query, const SortOrder& order, ExportFormat format, const string& fileName);
+long long exportSales(const Query& query, const SortOrder& order, ExportFormat format, const string& fileName);
+
+// Message for a failed export's return code
+string exportErrorMessage(long long result, const string& fileName);
+
+// Interactive export
+void exportData();
+
+#endif // EXPORT_H
@@ -0,0 +1,290 @@
+#include "extsort.h"
+#include "config.h"
+#include "profile.h"
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <queue>
+#include <memory>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Buffer size for reading and writing run files
+static const size_t RUN_IO_BUFFER_BYTES = 1 << 16;
+
+static atomic<unsigned> nextRunNumber(0);
+
+// sort_memory_bytes, at least 64 KiB
+static size_t sortMemoryBudget() {
+    static size_t budget = (size_t)max(64LL * 1024, getConfigInt("sort_memory_bytes", 16LL * 1024 * 1024));
+    return budget;
+}
+
+// A new run file name in sort_temp_dir, unique to this process
+static string newRunFile() {
+    string directory = getConfigString("sort_temp_dir", "");
+#ifdef _WIN32
+    int pid = _getpid();
+#else
+    int pid = (int)getpid();
+#endif
+    string name = "tourmate.sort." + to_string(pid) + "." + to_string(nextRunNumber++) + ".run";
+
+    if (directory.empty()) {
+        return name;
+    }
+    char last = directory.back();
+    return last == '/' || last == '\\' ? directory + name : directory + "/" + name;
+}
+
+// Run files hold length-prefixed keys and records
+class RunWriter {
+private:
+    ofstream file;
+    unique_ptr<char[]> ioBuffer;
+
+    void writeField(const string& text) {
+        uint32_t length = (uint32_t)text.size();
+        file.write((const char*)&length, sizeof(length));
+        file.write(text.data(), text.size());
+    }
+
+public:
+    explicit RunWriter(const string& path) : ioBuffer(new char[RUN_IO_BUFFER_BYTES]) {
+        file.rdbuf()->pubsetbuf(ioBuffer.get(), RUN_IO_BUFFER_BYTES);
+        file.open(path, ios::binary | ios::trunc);
+    }
+
+    bool isOpen() const {
+        return file.is_open();
+    }
+
+    void write(const string& key, const string& record) {
+        writeField(key);
+        writeField(record);
+    }
+
+    // True if everything was written
+    bool close() {
+        file.close();
+        return !file.fail();
+    }
+};
+
+class RunReader {
+private:
+    ifstream file;
+    unique_ptr<char[]> ioBuffer;
+    bool damaged;
+
+    bool readField(string& text) {
+        uint32_t length;
+        if (!file.read((char*)&length, sizeof(length))) {
+            return false;
+        }
+        text.resize(length);
+        return length == 0 || file.read(&text[0], length);
+    }
+
+public:
+    explicit RunReader(const string& path) : ioBuffer(new char[RUN_IO_BUFFER_BYTES]), damaged(false) {
+        file.rdbuf()->pubsetbuf(ioBuffer.get(), RUN_IO_BUFFER_BYTES);
+        file.open(path, ios::binary);
+        damaged = !file.is_open();
+    }
+
+    // Next key and record; false at the end of the run or if it is damaged
+    bool next(string& key, string& record) {
+        if (damaged || file.peek() == EOF) {
+            return false;
+        }
+        if (!readField(key) || !readField(record)) {
+            damaged = true;
+            return false;
+        }
+        return true;
+    }
+
+    bool isDamaged() const {
+        return damaged;
+    }
+};
+
+// Constructor
+ExternalSorter::ExternalSorter(bool descending)
+    : descending(descending), memoryBudget(sortMemoryBudget()), bufferedBytes(0), spilledRuns(0), ok(true) {
+}
+
+// Remove any run files left
+ExternalSorter::~ExternalSorter() {
+    for (const auto& file : runFiles) {
+        remove(file.c_str());
+    }
+}
+
+// True if key a sorts before key b
+bool ExternalSorter::before(const string& a, const string& b) const {
+    return descending ? b < a : a < b;
+}
+
+// Sort the buffered records, keeping input order among equal keys
+void ExternalSorter::sortBuffer() {
+    stable_sort(buffer.begin(), buffer.end(), [this](const Item& a, const Item& b) {
+        return before(a.key, b.key);
+    });
+}
+
+// Sort the buffer and write it out as the next run
+bool ExternalSorter::spill() {
+    ProfileSpan span("file", "extsort.spill");
+    sortBuffer();
+
+    string path = newRunFile();
+    RunWriter writer(path);
+    if (!writer.isOpen()) {
+        return false;
+    }
+    runFiles.push_back(path);
+    spilledRuns++;
+
+    for (const auto& item : buffer) {
+        writer.write(item.key, item.record);
+    }
+    buffer.clear();
+    bufferedBytes = 0;
+    return writer.close();
+}
+
+// Add one record
+bool ExternalSorter::add(string key, string record) {
+    if (!ok) {
+        return false;
+    }
+
+    bufferedBytes += sizeof(Item) + key.capacity() + record.capacity();
+    buffer.push_back({move(key), move(record)});
+
+    if (bufferedBytes >= memoryBudget) {
+        ok = spill();
+    }
+    return ok;
+}
+
+// k-way merge: a heap holds the head of each run, and equal keys are taken
+// from the earlier run first so input order is kept
+bool ExternalSorter::mergeRuns(const vector<string>& files, const function<void(Item&)>& visit) {
+    vector<unique_ptr<RunReader>> readers;
+    vector<Item> heads(files.size());
+
+    auto later = [this, &heads](size_t a, size_t b) {
+        if (before(heads[b].key, heads[a].key)) {
+            return true;
+        }
+        return !before(heads[a].key, heads[b].key) && b < a;
+    };
+    priority_queue<size_t, vector<size_t>, decltype(later)> heap(later);
+
+    for (size_t i = 0; i < files.size(); i++) {
+        readers.emplace_back(new RunReader(files[i]));
+        if (readers[i]->next(heads[i].key, heads[i].record)) {
+            heap.push(i);
+        }
+    }
+
+    while (!heap.empty()) {
+        size_t run = heap.top();
+        heap.pop();
+        visit(heads[run]);
+        if (readers[run]->next(heads[run].key, heads[run].record)) {
+            heap.push(run);
+        }
+    }
+
+    for (const auto& reader : readers) {
+        if (reader->isDamaged()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Visit the records in key order
+bool ExternalSorter::finish(const function<void(const string& record)>& visit) {
+    ProfileSpan span("file", "extsort.finish");
+
+    // Everything fit in memory
+    if (ok && runFiles.empty()) {
+        sortBuffer();
+        for (const auto& item : buffer) {
+            visit(item.record);
+        }
+        buffer.clear();
+        bufferedBytes = 0;
+        return true;
+    }
+
+    if (ok && !buffer.empty()) {
+        ok = spill();
+    }
+
+    // Too many runs to merge at once: merge the earliest ones into one run
+    // that takes their place, so input order among equal keys still holds
+    while (ok && runFiles.size() > SORT_MERGE_FAN_IN) {
+        vector<string> group(runFiles.begin(), runFiles.begin() + SORT_MERGE_FAN_IN);
+        string path = newRunFile();
+        RunWriter writer(path);
+
+        ok = writer.isOpen() && mergeRuns(group, [&writer](Item& item) {
+            writer.write(item.key, item.record);
+        });
+        ok = writer.close() && ok;
+
+        for (const auto& file : group) {
+            remove(file.c_str());
+        }
+        runFiles.erase(runFiles.begin(), runFiles.begin() + SORT_MERGE_FAN_IN);
+        runFiles.insert(runFiles.begin(), path);
+    }
+
+    if (ok) {
+        ok = mergeRuns(runFiles, [&visit](Item& item) {
+            visit(item.record);
+        });
+    }
+
+    for (const auto& file : runFiles) {
+        remove(file.c_str());
+    }
+    runFiles.clear();
+    return ok;
+}
+
+size_t ExternalSorter::runCount() const {
+    return spilledRuns;
+}
+
+// Flip the sign bit of non-negative numbers and every bit of negative ones,
+// then write the bits most significant byte first
+string encodeSortNumber(double value) {
+    if (value == 0.0) {
+        value = 0.0;  // -0.0 sorts with 0.0
+    }
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bits = (bits & 0x8000000000000000ULL) ? ~bits : bits | 0x8000000000000000ULL;
+
+    string key(8, '\0');
+    for (int i = 7; i >= 0; i--) {
+        key[i] = (char)(bits & 0xFF);
+        bits >>= 8;
+    }
+    return key;
+}
@@ -0,0 +1,65 @@
+#ifndef EXTSORT_H
+#define EXTSORT_H
+
+#include <string>
+#include <vector>
+#include <functional>
+
+using namespace std;
+
+// Sorted listings and exports go through an external merge sort, so a table
+// of any size is sorted in bounded memory. Records are buffered until they
+// take sort_memory_bytes (tourmate.conf, default 16 MiB), then that run is
+// sorted and written to a temporary file in sort_temp_dir (default: the
+// working directory). Once every record is in, the runs are merged k-way,
+// at most SORT_MERGE_FAN_IN at a time. A table that fits in the budget is
+// sorted in memory and never touches the disk. Records with equal keys keep
+// their input order.
+
+// Most runs merged in one pass; more are first merged into larger runs
+const size_t SORT_MERGE_FAN_IN = 64;
+
+// Sorts (key, record) pairs by key. Keys compare bytewise; encodeSortNumber
+// turns a number into a key that compares in numeric order.
+class ExternalSorter {
+private:
+    struct Item {
+        string key;
+        string record;
+    };
+
+    bool descending;
+    size_t memoryBudget;
+    size_t bufferedBytes;
+    vector<Item> buffer;
+    vector<string> runFiles;   // In input order
+    size_t spilledRuns;
+    bool ok;
+
+    bool before(const string& a, const string& b) const;
+    void sortBuffer();
+    bool spill();
+    bool mergeRuns(const vector<string>& files, const function<void(Item&)>& visit);
+
+public:
+    explicit ExternalSorter(bool descending);
+    ~ExternalSorter();
+
+    ExternalSorter(const ExternalSorter&) = delete;
+    ExternalSorter& operator=(const ExternalSorter&) = delete;
+
+    // Add one record; false once a run could not be written
+    bool add(string key, string record);
+
+    // Visit the records in key order. False if a run could not be written or
+    // read back; records already visited are then only part of the output.
+    bool finish(const function<void(const string& record)>& visit);
+
+    // Runs spilled to disk so far
+    size_t runCount() const;
+};
+
+// Key for a number that compares bytewise in numeric order
+string encodeSortNumber(double value);
+
+#endif // EXTSORT_H
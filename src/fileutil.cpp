@@ -0,0 +1,170 @@
+#include "fileutil.h"
+#include <cstdio>
+#include <fstream>
+#include <sys/stat.h>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/file.h>
+#include <cerrno>
+#endif
+
+using namespace std;
+
+// True if the file exists and can be opened for reading
+bool fileExists(const string& path) {
+    ifstream file(path);
+    return file.is_open();
+}
+
+// Lock a lock file, creating it if needed
+FileLock::FileLock(const string& path, FileLockMode mode) : fd(-1), taken(false), contended(false) {
+#ifndef _WIN32
+    fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd >= 0) {
+        int operation = mode == FILE_LOCK_SHARED ? LOCK_SH : mode == FILE_LOCK_EXCLUSIVE ? LOCK_EX : LOCK_EX | LOCK_NB;
+        taken = flock(fd, operation) == 0;
+        contended = !taken && errno == EWOULDBLOCK;
+    }
+#else
+    (void)path;
+    (void)mode;
+#endif
+}
+
+FileLock::~FileLock() {
+#ifndef _WIN32
+    if (fd >= 0) {
+        if (taken) {
+            flock(fd, LOCK_UN);
+        }
+        close(fd);
+    }
+#endif
+}
+
+bool FileLock::busy() const {
+    return contended;
+}
+
+// Move 'from' over 'to', replacing any existing file
+bool replaceFile(const string& from, const string& to) {
+    #ifdef _WIN32
+    // rename() does not overwrite on Windows
+    remove(to.c_str());
+    #endif
+    return rename(from.c_str(), to.c_str()) == 0;
+}
+
+// True if the path names an existing directory
+bool directoryExists(const string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && (info.st_mode & S_IFMT) == S_IFDIR;
+}
+
+// True if the path names an existing regular file
+bool regularFileExists(const string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && (info.st_mode & S_IFMT) == S_IFREG;
+}
+
+// File times in nanoseconds; Windows only keeps seconds
+#if defined(_WIN32)
+#define STAT_NANOS(info, field) ((long long)(info).st_##field##time * 1000000000LL)
+#elif defined(__APPLE__)
+#define STAT_NANOS(info, field) \
+    ((long long)(info).st_##field##timespec.tv_sec * 1000000000LL + (info).st_##field##timespec.tv_nsec)
+#else
+#define STAT_NANOS(info, field) \
+    ((long long)(info).st_##field##tim.tv_sec * 1000000000LL + (info).st_##field##tim.tv_nsec)
+#endif
+
+// Size and modification time of a file
+bool fileStamp(const string& path, long long& size, long long& modified) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return false;
+    }
+    size = (long long)info.st_size;
+    modified = STAT_NANOS(info, m);
+    return true;
+}
+
+// Size, inode, modification and status change times of a file
+string fileChangeStamp(const string& path) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return "";
+    }
+    return to_string((long long)info.st_size) + ":" + to_string((long long)info.st_ino) + ":" +
+           to_string(STAT_NANOS(info, m)) + ":" + to_string(STAT_NANOS(info, c));
+}
+
+// Flush a file's contents to disk
+bool syncFile(const string& path) {
+#ifdef _WIN32
+    int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+    bool ok = fd >= 0 && _commit(fd) == 0;
+    if (fd >= 0) {
+        _close(fd);
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    bool ok = fd >= 0 && fsync(fd) == 0;
+    if (fd >= 0) {
+        close(fd);
+    }
+#endif
+    return ok;
+}
+
+// Flush a directory's entries to disk
+bool syncDirectory(const string& path) {
+#ifdef _WIN32
+    (void)path;
+    return true;
+#else
+    return syncFile(path.empty() ? "." : path);
+#endif
+}
+
+// Directory part of a path
+string directoryOf(const string& path) {
+    size_t slash = path.find_last_of("/\\");
+    return slash == string::npos ? "" : path.substr(0, slash + 1);
+}
+
+// Sync, move over the target, then sync the directory entry
+bool replaceFileDurably(const string& from, const string& to) {
+    return syncFile(from) && replaceFile(from, to) && syncDirectory(directoryOf(to));
+}
+
+static thread_local string dataDirectory;
+static thread_local bool readOnlyData = false;
+
+// Path of a data file in the current thread's data directory
+string dataPath(const string& fileName) {
+    if (dataDirectory.empty()) {
+        return fileName;
+    }
+    char last = dataDirectory.back();
+    return last == '/' || last == '\\' ? dataDirectory + fileName : dataDirectory + "/" + fileName;
+}
+
+// True inside a DataDirectoryScope
+bool dataIsReadOnly() {
+    return readOnlyData;
+}
+
+DataDirectoryScope::DataDirectoryScope(const string& directory)
+    : previous(dataDirectory), previousReadOnly(readOnlyData) {
+    dataDirectory = directory == "." ? "" : directory;
+    readOnlyData = true;
+}
+
+DataDirectoryScope::~DataDirectoryScope() {
+    dataDirectory = previous;
+    readOnlyData = previousReadOnly;
+}
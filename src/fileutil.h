@@ -0,0 +1,97 @@
+#ifndef FILEUTIL_H
+#define FILEUTIL_H
+
+#include <string>
+
+using namespace std;
+
+// True if the file exists and can be opened for reading
+bool fileExists(const string& path);
+
+// Move 'from' over 'to', replacing any existing file
+bool replaceFile(const string& from, const string& to);
+
+// True if the path names an existing directory
+bool directoryExists(const string& path);
+
+// True if the path names an existing regular file (not a device or pipe)
+bool regularFileExists(const string& path);
+
+// Size in bytes and modification time of a file, in nanoseconds where the
+// platform keeps them; false if it does not exist
+bool fileStamp(const string& path, long long& size, long long& modified);
+
+// Size, inode, and modification and status change times (nanoseconds where
+// the platform keeps them) of a file as one string, so a write or a file
+// replaced by rename shows as a different stamp; "" if it does not exist
+string fileChangeStamp(const string& path);
+
+// Flush a file's contents to disk; false if it cannot be opened or synced
+bool syncFile(const string& path);
+
+// Flush a directory's entries (new and renamed files) to disk. Windows has
+// no directory sync, so this always succeeds there.
+bool syncDirectory(const string& path);
+
+// Directory part of a path, with its trailing separator ("" for none)
+string directoryOf(const string& path);
+
+// Sync 'from', move it over 'to' and sync the directory, so that after a
+// power loss 'to' holds either its old or its complete new contents
+bool replaceFileDurably(const string& from, const string& to);
+
+// How a FileLock takes its lock
+enum FileLockMode {
+    FILE_LOCK_SHARED,
+    FILE_LOCK_EXCLUSIVE,
+    FILE_LOCK_TRY_EXCLUSIVE    // Give up at once if another holder has it
+};
+
+// Holds a flock on a lock file, created if needed, until destroyed. Each
+// FileLock opens the file itself, so threads of one process exclude each
+// other just as processes do. If the file cannot be created (a read-only
+// data directory) nothing is locked; Windows does not lock either.
+class FileLock {
+private:
+    int fd;
+    bool taken;
+    bool contended;
+
+public:
+    FileLock(const string& path, FileLockMode mode);
+    ~FileLock();
+
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+    // True if FILE_LOCK_TRY_EXCLUSIVE gave up because another holder has the lock
+    bool busy() const;
+};
+
+// Data files are found in the calling thread's data directory: the working
+// directory unless a DataDirectoryScope on this thread says otherwise. Branch
+// fan-out uses this to read each depot's tables from its own directory.
+// Data reached through a scope is only read: a legacy sales.txt or
+// vehicles.txt there is read as it is, never migrated or converted.
+
+// Path of a data file in the current thread's data directory
+string dataPath(const string& fileName);
+
+// True while a DataDirectoryScope is active on this thread
+bool dataIsReadOnly();
+
+// Points this thread's data files at a directory until the scope ends
+class DataDirectoryScope {
+private:
+    string previous;
+    bool previousReadOnly;
+
+public:
+    explicit DataDirectoryScope(const string& directory);
+    ~DataDirectoryScope();
+
+    DataDirectoryScope(const DataDirectoryScope&) = delete;
+    DataDirectoryScope& operator=(const DataDirectoryScope&) = delete;
+};
+
+#endif // FILEUTIL_H
@@ -0,0 +1,122 @@
+#include "fleetstatus.h"
+#include "vehicleindex.h"
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <algorithm>
+
+using namespace std;
+
+static FleetCounts sharedCounts;
+static mutex sharedCountsLock;
+
+FleetCounts::FleetCounts() : ready(false), total(0) {
+}
+
+// Drop a counter once it reaches zero, so removed statuses disappear
+template <class Key>
+static void addTo(map<Key, size_t>& counts, const Key& key, int delta) {
+    size_t& value = counts[key];
+    value += delta;
+    if (value == 0) {
+        counts.erase(key);
+    }
+}
+
+// Count a vehicle in or out
+void FleetCounts::count(const Vehicle& vehicle, int delta) {
+    total += delta;
+    addTo(byStatus, vehicle.getStatus(), delta);
+    addTo(byType, vehicle.getType(), delta);
+    addTo(byTypeAndStatus, make_pair(vehicle.getType(), vehicle.getStatus()), delta);
+}
+
+// Replace the counters
+void publishFleetCounts(const FleetCounts& counts) {
+    lock_guard<mutex> guard(sharedCountsLock);
+    sharedCounts = counts;
+    sharedCounts.ready = true;
+}
+
+// Move one vehicle between counters
+void adjustFleetCounts(const Vehicle* before, const Vehicle* after) {
+    lock_guard<mutex> guard(sharedCountsLock);
+
+    if (!sharedCounts.ready) {
+        return;
+    }
+    if (before != nullptr) {
+        sharedCounts.count(*before, -1);
+    }
+    if (after != nullptr) {
+        sharedCounts.count(*after, 1);
+    }
+}
+
+// Mark the counters stale
+void resetFleetCounts() {
+    lock_guard<mutex> guard(sharedCountsLock);
+    sharedCounts = FleetCounts();
+}
+
+// Copy of the current counters
+FleetCounts fleetCounts() {
+    lock_guard<mutex> guard(sharedCountsLock);
+    return sharedCounts;
+}
+
+// One-line fleet summary for the main menu
+void printFleetSummaryLine() {
+    FleetCounts counts = fleetCounts();
+
+    if (!counts.ready) {
+        return;
+    }
+
+    cout << "Fleet: " << counts.total << " vehicle(s)";
+    for (const auto& status : counts.byStatus) {
+        cout << " | " << status.first << " " << status.second;
+    }
+    cout << "\n\n";
+}
+
+// Counts per type and status
+void printFleetDashboard() {
+    // Loads the index (and so the counters) on first use only
+    vehicleIndex();
+    FleetCounts counts = fleetCounts();
+
+    cout << "\n===== FLEET DASHBOARD =====\n";
+    if (counts.total == 0) {
+        cout << "No vehicles found." << endl;
+        return;
+    }
+
+    // One column per status, wide enough for its name
+    size_t typeWidth = 6;
+    for (const auto& type : counts.byType) {
+        typeWidth = max(typeWidth, type.first.size() + 2);
+    }
+
+    cout << left << setw(typeWidth) << "Type";
+    for (const auto& status : counts.byStatus) {
+        cout << right << setw(max<size_t>(8, status.first.size() + 2)) << status.first;
+    }
+    cout << right << setw(8) << "Total" << "\n";
+
+    for (const auto& type : counts.byType) {
+        cout << left << setw(typeWidth) << type.first;
+        for (const auto& status : counts.byStatus) {
+            auto cell = counts.byTypeAndStatus.find(make_pair(type.first, status.first));
+            cout << right << setw(max<size_t>(8, status.first.size() + 2))
+                 << (cell != counts.byTypeAndStatus.end() ? cell->second : 0);
+        }
+        cout << right << setw(8) << type.second << "\n";
+    }
+
+    cout << left << setw(typeWidth) << "Total";
+    for (const auto& status : counts.byStatus) {
+        cout << right << setw(max<size_t>(8, status.first.size() + 2)) << status.second;
+    }
+    cout << right << setw(8) << counts.total << endl;
+}
@@ -0,0 +1,48 @@
+#ifndef FLEETSTATUS_H
+#define FLEETSTATUS_H
+
+#include <string>
+#include <map>
+#include <utility>
+#include "vehicle.h"
+
+using namespace std;
+
+// Vehicle counts per status, per type and per (type, status). They are
+// published when the shared vehicle index is built and then adjusted by every
+// stored add, update and delete (a sale or a return marks its vehicle Rented
+// or Available through a vehicle update), so showing them reads no file. They
+// have their own lock, so the main menu never waits for the index to load.
+struct FleetCounts {
+    bool ready;    // False until the vehicle index has been loaded
+    size_t total;
+    map<string, size_t> byStatus;
+    map<string, size_t> byType;
+    map<pair<string, string>, size_t> byTypeAndStatus;  // (type, status)
+
+    FleetCounts();
+
+    // Count a vehicle in (delta 1) or out (delta -1)
+    void count(const Vehicle& vehicle, int delta);
+};
+
+// Replace the counters (after the vehicle index is built)
+void publishFleetCounts(const FleetCounts& counts);
+
+// Move one vehicle between counters; either side may be null (add or delete)
+void adjustFleetCounts(const Vehicle* before, const Vehicle* after);
+
+// Mark the counters stale (the vehicle index was dropped)
+void resetFleetCounts();
+
+// Copy of the current counters
+FleetCounts fleetCounts();
+
+// One-line fleet summary for the main menu; prints nothing until the
+// counters are ready
+void printFleetSummaryLine();
+
+// Counts per type and status, loading the vehicle index if it is not loaded
+void printFleetDashboard();
+
+#endif // FLEETSTATUS_H
@@ -0,0 +1,545 @@
+// Load generator: replays an operation trace recorded by the menus (see
+// trace.h), or a synthetic mix, against a data directory at a chosen
+// concurrency and rate, then reports latency percentiles per operation type.
+// Build with "make loadgen". Replay writes to the data directory, so point
+// --dir at a copy of the real data.
+//
+//   tourmate_loadgen replay <trace file> [options]
+//   tourmate_loadgen synthetic [--ops N] [--mix type=weight,...] [options]
+//
+// Options: --threads N (default 4), --rate <ops per second> or --rate recorded
+// (default 0: as fast as possible), --dir <data directory>.
+#include "vehicle.h"
+#include "sales.h"
+#include "vehicleindex.h"
+#include "query.h"
+#include "reports.h"
+#include "topk.h"
+#include "rollup.h"
+#include "dates.h"
+#include "trace.h"
+#include "txlog.h"
+#include "profile.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <shared_mutex>
+#include <random>
+#include <cmath>
+#include <cstdlib>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+// One replayable operation type. The program itself is single-user, so
+// operations that change tables (or lazily refresh shared state) hold the
+// exclusive lock while everything else runs side by side under a shared lock.
+struct OperationType {
+    const char* name;
+    bool exclusive;
+    bool (*run)(const string& args);
+};
+
+static int traceDay(const string& date) {
+    return date.empty() ? INVALID_DAY : dateToDayNumber(date);
+}
+
+static bool runVehicleList(const string& args) {
+    if (args.empty()) {
+        loadVehiclesFromFile();
+        return true;
+    }
+    SortOrder order;
+    string error;
+    return parseVehicleSortOrder(args, order, error) &&
+           runSortedVehicleQuery(Query(), order, [](const Vehicle&) {});
+}
+
+static bool runVehicleAdd(const string& args) {
+    Vehicle vehicle = Vehicle::fromString(args);
+    if (vehicle.getVehicleId().empty()) {
+        return false;
+    }
+    return saveVehicleChange(CHANGE_INSERT, vehicle);
+}
+
+static bool runVehicleUpdate(const string& args) {
+    Vehicle vehicle = Vehicle::fromString(args);
+    if (vehicle.getVehicleId().empty()) {
+        return false;
+    }
+    return saveVehicleChange(CHANGE_UPDATE, vehicle);
+}
+
+static bool runVehicleDelete(const string& args) {
+    Vehicle vehicle;
+    vehicle.setVehicleId(args);
+    return saveVehicleChange(CHANGE_DELETE, vehicle);
+}
+
+static bool runVehicleQueryOp(const string& args) {
+    Query query;
+    string error, plan;
+    if (!parseVehicleQuery(args, query, error)) {
+        return false;
+    }
+    runCachedVehicleQuery(query, plan);
+    return true;
+}
+
+static bool runVehicleFuzzy(const string& args) {
+    vector<string> fields = splitTraceArgs(args, 2);
+    findVehiclesFuzzy(fields[0], atoi(fields[1].c_str()));
+    return true;
+}
+
+static bool runVehicleRates(const string& args) {
+    vector<string> fields = splitTraceArgs(args, 4);
+    vehicleIndex()->idsByRate(fields[2], fields[3], atof(fields[0].c_str()), atof(fields[1].c_str()));
+    return true;
+}
+
+static bool runVehicleCheapest(const string& args) {
+    vector<string> fields = splitTraceArgs(args, 2);
+    vehicleIndex()->rateExtreme(fields[0], fields[1], false);
+    return true;
+}
+
+static bool runSaleList(const string& args) {
+    if (args.empty()) {
+        loadSalesFromFile();
+        return true;
+    }
+    SortOrder order;
+    string error;
+    return parseSalesSortOrder(args, order, error) &&
+           runSortedSalesQuery(Query(), order, [](const Sales&) {});
+}
+
+static bool runSaleAdd(const string& args) {
+    Sales sale = Sales::fromString(args);
+    return !sale.getSaleId().empty() && commitBooking(sale);
+}
+
+static bool runSaleQueryOp(const string& args) {
+    Query query;
+    string error, plan;
+    long long count = 0;
+    if (!parseSalesQuery(args, query, error)) {
+        return false;
+    }
+    runCachedSalesQuery(query, [&count](const Sales&) { count++; }, plan);
+    return true;
+}
+
+// Fuzzy lookup, then read back the partitions holding the matches as the menu does
+static bool runSaleFuzzy(const string& args) {
+    vector<string> fields = splitTraceArgs(args, 2);
+    set<string> partitions;
+
+    for (const auto& match : findCustomersFuzzy(fields[0], atoi(fields[1].c_str()))) {
+        for (const auto& posting : match.ids) {
+            partitions.insert(posting.substr(0, posting.find('|')));
+        }
+    }
+    for (const auto& key : partitions) {
+        forEachSaleViewInPartition(key, [](const SalesView&) {});
+    }
+    return true;
+}
+
+// Loads every sale as the report does, without writing the report file
+static bool runSalesReport(const string&) {
+    return !loadSalesFromFile().empty();
+}
+
+static bool runUtilization(const string& args) {
+    vector<string> fields = splitTraceArgs(args, 2);
+    computeFleetUtilization(traceDay(fields[0]), traceDay(fields[1]));
+    return true;
+}
+
+static bool runTopK(const string& args) {
+    vector<string> fields = splitTraceArgs(args, 2);
+    size_t k = (size_t)atoll(fields[1].c_str());
+    if (fields[0] == "customers") {
+        topCustomersBySpend(k);
+    } else if (fields[0] == "vehicles") {
+        topVehiclesByRevenue(k);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Same range lookups as the rollup screen: one range, or per day, week or month
+static bool runRollup(const string& args) {
+    vector<string> fields = splitTraceArgs(args, 3);
+    RollupSummary rollup = salesRollup();
+    int option = atoi(fields[0].c_str());
+    int fromDay = fields[1].empty() ? rollup.firstDay : traceDay(fields[1]);
+    int toDay = fields[2].empty() ? rollup.lastDay : traceDay(fields[2]);
+
+    if (rollup.empty || fromDay == INVALID_DAY || toDay == INVALID_DAY || option < 1 || option > 4) {
+        return false;
+    }
+
+    if (option == 1) {
+        rollupRangeTotals(fromDay, toDay);
+    } else {
+        rollupPeriodTotals(fromDay, toDay, option == 2 ? PERIOD_DAY : option == 3 ? PERIOD_WEEK : PERIOD_MONTH);
+    }
+    return true;
+}
+
+static const vector<OperationType>& operationTypes() {
+    static const vector<OperationType> types = {
+        {"vehicle.list", false, runVehicleList},
+        {"vehicle.add", true, runVehicleAdd},
+        {"vehicle.update", true, runVehicleUpdate},
+        {"vehicle.delete", true, runVehicleDelete},
+        {"vehicle.query", false, runVehicleQueryOp},
+        {"vehicle.fuzzy", false, runVehicleFuzzy},
+        {"vehicle.rates", false, runVehicleRates},
+        {"vehicle.cheapest", false, runVehicleCheapest},
+        {"sale.list", false, runSaleList},
+        {"sale.add", true, runSaleAdd},
+        {"sale.query", false, runSaleQueryOp},
+        {"sale.fuzzy", false, runSaleFuzzy},
+        {"report.sales", false, runSalesReport},
+        {"report.utilization", false, runUtilization},
+        {"report.topk", false, runTopK},
+        {"report.rollup", false, runRollup},
+    };
+    return types;
+}
+
+static int operationIndex(const string& name) {
+    const auto& types = operationTypes();
+    for (size_t i = 0; i < types.size(); i++) {
+        if (name == types[i].name) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+// Default synthetic mix: mostly searches, some bookings and updates, few full scans
+static const char* const DEFAULT_MIX =
+    "vehicle.query=25,vehicle.rates=8,vehicle.cheapest=5,vehicle.fuzzy=5,vehicle.update=6,"
+    "vehicle.add=2,vehicle.list=1,sale.query=20,sale.fuzzy=5,sale.add=8,sale.list=1,"
+    "report.rollup=8,report.topk=3,report.utilization=2,report.sales=1";
+
+// Parse "type=weight,type=weight"
+static bool parseMix(const string& text, vector<pair<int, double>>& mix) {
+    size_t start = 0;
+
+    while (start < text.size()) {
+        size_t comma = text.find(',', start);
+        string part = text.substr(start, comma == string::npos ? string::npos : comma - start);
+        size_t equals = part.find('=');
+        int type = operationIndex(part.substr(0, equals));
+        double weight = equals == string::npos ? 1.0 : atof(part.c_str() + equals + 1);
+
+        if (type < 0) {
+            cout << "Error: Unknown operation type '" << part.substr(0, equals) << "'." << endl;
+            return false;
+        }
+        if (weight > 0) {
+            mix.push_back({type, weight});
+        }
+        start = comma == string::npos ? text.size() : comma + 1;
+    }
+
+    return !mix.empty();
+}
+
+// Change one letter, so fuzzy searches have something to tolerate
+static string withTypo(const string& text, mt19937& rng) {
+    string result = text;
+    if (!result.empty()) {
+        result[rng() % result.size()] = (char)('a' + rng() % 26);
+    }
+    return result;
+}
+
+// Build a synthetic trace from the vehicles and a sample of the sales on file
+static bool buildSyntheticTrace(size_t count, const vector<pair<int, double>>& mix, vector<TraceEntry>& entries) {
+    vector<Vehicle> vehicles;
+    {
+        LockedVehicleIndex index = vehicleIndex();
+        for (const Vehicle* vehicle : index->all()) {
+            vehicles.push_back(*vehicle);
+        }
+    }
+
+    // Reservoir sample of stored sales
+    const size_t SAMPLE_SIZE = 1000;
+    vector<Sales> sales;
+    long long seen = 0;
+    mt19937 rng(12345);
+    forEachSaleInFile([&](const Sales& sale) {
+        seen++;
+        if (sales.size() < SAMPLE_SIZE) {
+            sales.push_back(sale);
+        } else {
+            size_t slot = (size_t)(rng() % seen);
+            if (slot < SAMPLE_SIZE) {
+                sales[slot] = sale;
+            }
+        }
+    });
+
+    if (vehicles.empty() || sales.empty()) {
+        cout << "Error: The synthetic mix needs vehicles and sales on file to draw from." << endl;
+        return false;
+    }
+
+    vector<double> weights;
+    for (const auto& entry : mix) {
+        weights.push_back(entry.second);
+    }
+    discrete_distribution<size_t> pick(weights.begin(), weights.end());
+    long long added = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const string type = operationTypes()[mix[pick(rng)].first].name;
+        const Vehicle& vehicle = vehicles[rng() % vehicles.size()];
+        const Sales& sale = sales[rng() % sales.size()];
+        string args;
+
+        if (type == "vehicle.add") {
+            added++;
+            args = Vehicle("LG" + to_string(added), vehicle.getMakeModel(), vehicle.getYear(), vehicle.getType(),
+                           "LG-" + to_string(added), "Available", vehicle.getRatePerDay()).toString();
+        } else if (type == "vehicle.update") {
+            Vehicle changed = vehicle;
+            changed.setRatePerDay(floor(vehicle.getRatePerDay() * (0.9 + (rng() % 21) / 100.0)));
+            args = changed.toString();
+        } else if (type == "vehicle.delete") {
+            args = added > 0 ? "LG" + to_string(added--) : vehicle.getVehicleId();
+        } else if (type == "vehicle.query") {
+            args = "type=\"" + vehicle.getType() + "\" AND status=\"" + vehicle.getStatus() +
+                   "\" AND rate<" + to_string((int)vehicle.getRatePerDay() + 20);
+        } else if (type == "vehicle.fuzzy") {
+            args = withTypo(vehicle.getMakeModel(), rng) + "|2";
+        } else if (type == "vehicle.rates") {
+            double low = floor(vehicle.getRatePerDay() * 0.8);
+            args = to_string(low) + "|" + to_string(low + 40) + "|" + vehicle.getType() + "|";
+        } else if (type == "vehicle.cheapest") {
+            args = vehicle.getType() + "|Available";
+        } else if (type == "sale.add") {
+            args = Sales("LS" + to_string(i + 1), vehicle.getVehicleId(), sale.getCustomerName(),
+                         sale.getCustomerContact(), sale.getStartDate(), sale.getEndDate(),
+                         sale.getAmount(), "Pending").toString();
+        } else if (type == "sale.query") {
+            switch (rng() % 3) {
+                case 0: args = "customer=\"" + sale.getCustomerName() + "\""; break;
+                case 1: args = "vehicle=\"" + sale.getVehicleId() + "\""; break;
+                default: args = "start>=\"" + sale.getStartDate() + "\" AND start<=\"" + sale.getEndDate() + "\"";
+            }
+        } else if (type == "sale.fuzzy") {
+            args = withTypo(sale.getCustomerName(), rng) + "|2";
+        } else if (type == "report.utilization") {
+            args = "|";
+        } else if (type == "report.topk") {
+            args = rng() % 2 ? "customers|20" : "vehicles|20";
+        } else if (type == "report.rollup") {
+            args = to_string(1 + rng() % 4) + "||";
+        }
+
+        entries.push_back({0.0, type, args});
+    }
+
+    return true;
+}
+
+// Latency at a percentile (nearest rank) of sorted samples
+static double percentile(const vector<double>& sorted, double fraction) {
+    size_t rank = (size_t)ceil(fraction * sorted.size());
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || (string(argv[1]) != "replay" && string(argv[1]) != "synthetic") ||
+        (string(argv[1]) == "replay" && argc < 3)) {
+        cout << "Usage: tourmate_loadgen replay <trace file> [--threads N] [--rate R|recorded] [--dir D]\n"
+             << "       tourmate_loadgen synthetic [--ops N] [--mix type=weight,...] [--threads N] [--rate R] [--dir D]"
+             << endl;
+        return 1;
+    }
+
+    bool replay = string(argv[1]) == "replay";
+    int threadCount = 4;
+    double rate = 0.0;
+    bool recordedRate = false;
+    size_t opCount = 1000;
+    string mixText = DEFAULT_MIX;
+    string dataDir;
+
+    for (int i = replay ? 3 : 2; i + 1 < argc; i += 2) {
+        string option = argv[i];
+        string value = argv[i + 1];
+        if (option == "--threads") {
+            threadCount = max(1, atoi(value.c_str()));
+        } else if (option == "--rate") {
+            recordedRate = value == "recorded";
+            rate = recordedRate ? 0.0 : atof(value.c_str());
+        } else if (option == "--ops") {
+            opCount = (size_t)atoll(value.c_str());
+        } else if (option == "--mix") {
+            mixText = value;
+        } else if (option == "--dir") {
+            dataDir = value;
+        } else {
+            cout << "Error: Unknown option " << option << endl;
+            return 1;
+        }
+    }
+
+    // Read the trace before moving to the data directory, so relative paths work
+    vector<TraceEntry> entries;
+    if (replay && !loadTrace(argv[2], entries)) {
+        cout << "Error: Could not open trace " << argv[2] << endl;
+        return 1;
+    }
+
+#ifdef _WIN32
+    bool moved = dataDir.empty() || _chdir(dataDir.c_str()) == 0;
+#else
+    bool moved = dataDir.empty() || chdir(dataDir.c_str()) == 0;
+#endif
+    if (!moved) {
+        cout << "Error: Could not open data directory " << dataDir << endl;
+        return 1;
+    }
+    startProfiling();
+    recoverTransactions();
+
+    if (!replay) {
+        vector<pair<int, double>> mix;
+        if (!parseMix(mixText, mix) || !buildSyntheticTrace(opCount, mix, entries)) {
+            return 1;
+        }
+    }
+
+    vector<int> typeOf(entries.size());
+    long long skipped = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        typeOf[i] = operationIndex(entries[i].type);
+        skipped += typeOf[i] < 0 ? 1 : 0;
+    }
+
+    // Warm the shared tables so the first operations do not pay for loading them
+    vehicleIndex();
+    salesRollup();
+
+    // Latency is measured from each operation's scheduled start, so time spent
+    // queued behind a slow operation counts (as it would for a waiting user)
+    shared_mutex tableLock;
+    atomic<size_t> next(0);
+    vector<vector<double>> latencies(operationTypes().size());
+    vector<long long> errors(operationTypes().size(), 0);
+    mutex resultLock;
+    double firstAtMs = entries.empty() ? 0.0 : entries.front().atMs;
+    Clock::time_point start = Clock::now();
+
+    auto worker = [&]() {
+        vector<pair<int, double>> local;
+        vector<int> failed;
+
+        for (size_t i = next++; i < entries.size(); i = next++) {
+            int type = typeOf[i];
+            if (type < 0) {
+                continue;
+            }
+
+            Clock::time_point scheduled = start;
+            if (recordedRate) {
+                scheduled += chrono::duration_cast<Clock::duration>(
+                    chrono::duration<double, milli>(entries[i].atMs - firstAtMs));
+            } else if (rate > 0) {
+                scheduled += chrono::duration_cast<Clock::duration>(chrono::duration<double>(i / rate));
+            }
+            this_thread::sleep_until(scheduled);
+            Clock::time_point began = (recordedRate || rate > 0) ? scheduled : Clock::now();
+
+            const OperationType& operation = operationTypes()[type];
+            ProfileSpan span("op", operation.name);
+            bool ok;
+            if (operation.exclusive) {
+                unique_lock<shared_mutex> guard(tableLock);
+                ok = operation.run(entries[i].args);
+            } else {
+                shared_lock<shared_mutex> guard(tableLock);
+                ok = operation.run(entries[i].args);
+            }
+
+            local.push_back({type, chrono::duration<double, milli>(Clock::now() - began).count()});
+            if (!ok) {
+                failed.push_back(type);
+            }
+        }
+
+        lock_guard<mutex> guard(resultLock);
+        for (const auto& sample : local) {
+            latencies[sample.first].push_back(sample.second);
+        }
+        for (int type : failed) {
+            errors[type]++;
+        }
+    };
+
+    vector<thread> workers;
+    for (int i = 0; i < threadCount; i++) {
+        workers.emplace_back(worker);
+    }
+    for (auto& running : workers) {
+        running.join();
+    }
+
+    double seconds = chrono::duration<double>(Clock::now() - start).count();
+    checkpointTransactions();
+    writeProfile();
+    long long completed = (long long)entries.size() - skipped;
+
+    cout << (replay ? "Replayed " : "Ran ") << completed << " operation(s) on " << threadCount << " thread(s) in "
+         << fixed << setprecision(2) << seconds << " s (" << setprecision(0)
+         << (seconds > 0 ? completed / seconds : 0.0) << " ops/s)" << endl;
+    if (skipped > 0) {
+        cout << "Skipped " << skipped << " operation(s) of unknown type." << endl;
+    }
+    cout << endl;
+
+    cout << left << setw(20) << "Operation" << right << setw(8) << "Count" << setw(10) << "p50 ms"
+         << setw(10) << "p95 ms" << setw(10) << "p99 ms" << setw(10) << "max ms" << setw(8) << "Errors" << endl;
+    cout << string(76, '-') << endl;
+
+    for (size_t type = 0; type < latencies.size(); type++) {
+        vector<double>& samples = latencies[type];
+        if (samples.empty()) {
+            continue;
+        }
+        sort(samples.begin(), samples.end());
+        cout << left << setw(20) << operationTypes()[type].name << right << setw(8) << samples.size()
+             << setprecision(3) << setw(10) << percentile(samples, 0.50) << setw(10) << percentile(samples, 0.95)
+             << setw(10) << percentile(samples, 0.99) << setw(10) << samples.back()
+             << setw(8) << errors[type] << endl;
+    }
+
+    return 0;
+}
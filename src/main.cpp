@@ -7,6 +7,21 @@
 #include "vehicle.h"
 #include "user.h"
 #include "sales.h"
+#include "rollup.h"
+#include "reports.h"
+#include "topk.h"
+#include "commands.h"
+#include "export.h"
+#include "returns.h"
+#include "branch.h"
+#include "replica.h"
+#include "changelog.h"
+#include "events.h"
+#include "resultcache.h"
+#include "fleetstatus.h"
+#include "txlog.h"
+#include "prefetch.h"
+#include "profile.h"
 
 using namespace std;
 
@@ -29,7 +44,33 @@ void viewCompanyDetails();
 void clearScreen();
 void pressEnterToContinue();
 
-int main() {
+int main(int argc, char* argv[]) {
+    // Profiling spans are recorded from here on if profile_file is set
+    startProfiling();
+    
+    // Finish any booking interrupted by a crash before touching the tables
+    recoverTransactions();
+    
+    // Any arguments select non-interactive command mode
+    if (argc > 1) {
+        int status = runCommand(vector<string>(argv + 1, argv + argc));
+        checkpointTransactions();
+        writeProfile();
+        return status;
+    }
+    
+    // A read replica catches up with its primary before the tables are loaded
+    syncReplica();
+    
+    // Load the tables in the background while the login menu is up
+    startPrefetch();
+    
+    // Serve the change log to replicas if change_log_socket is set
+    startChangeLogServer();
+    
+    // Publish change events to subscribers if event_socket is set
+    startEventPublisher();
+    
     // Start the program
     cout << "\n\n";
     cout << "===============================================\n";
@@ -47,6 +88,12 @@ int main() {
         }
     }
     
+    stopEventPublisher();
+    stopChangeLogServer();
+    finishPrefetch();
+    showPrefetchMessages();
+    checkpointTransactions();
+    writeProfile();
     cout << "\nThank you for using TOUR MATE VEHICLE SYSTEM!\n";
     return 0;
 }
@@ -60,6 +107,7 @@ bool displayLoginMenu() {
     cout << "1. Login\n";
     cout << "2. Exit\n";
     cout << "Enter your choice: ";
+    noteFirstPrompt();
     
     if (!(cin >> choice)) {
         cin.clear();
@@ -101,12 +149,12 @@ bool displayLoginMenu() {
 }
 
 
-// Login function - placeholder 
+// Login function - checks the users table (prefetched in the background)
 bool login(string username, string password) {
-//harcoded password and username
-    if (username == "admin" && password == "admin123") {
+    string role;
+    if (validateUser(username, password, role)) {
         currentUser = username;
-        currentRole = "admin";
+        currentRole = role;
         return true;
     }
     return false;
@@ -115,8 +163,10 @@ bool login(string username, string password) {
 // Display the main menu
 void displayMainMenu() {
     clearScreen();
+    showPrefetchMessages();
     cout << "\n===== MAIN MENU =====\n";
     cout << "Current User: " << currentUser << " (" << currentRole << ")\n\n";
+    printFleetSummaryLine();
     cout << "1. Vehicle Management\n";
     cout << "2. Sales Management\n";
     cout << "3. View Company Details\n";
@@ -182,7 +232,9 @@ void displayVehicleMenu() {
     cout << "3. Update Vehicle\n";
     cout << "4. Delete Vehicle\n";
     cout << "5. Search Vehicle\n";
-    cout << "6. Return to Main Menu\n";
+    cout << "6. Return Due Vehicles (end of day)\n";
+    cout << "7. Fleet Dashboard\n";
+    cout << "8. Return to Main Menu\n";
     cout << "Enter your choice: ";
 }
 
@@ -200,6 +252,9 @@ void handleVehicleMenu() {
     
     cin.ignore(numeric_limits<streamsize>::max(), '\n');
     
+    // On a read replica, apply the primary's latest changes first
+    syncReplica();
+    
     switch (choice) {
         case 1:
             viewAllVehicles();
@@ -222,6 +277,14 @@ void handleVehicleMenu() {
             pressEnterToContinue();
             break;
         case 6:
+            returnDueVehiclesMenu();
+            pressEnterToContinue();
+            break;
+        case 7:
+            printFleetDashboard();
+            pressEnterToContinue();
+            break;
+        case 8:
             // Return to main menu
             break;
         default:
@@ -238,7 +301,12 @@ void displaySalesMenu() {
     cout << "2. View All Sales\n";
     cout << "3. Search Sales\n";
     cout << "4. Generate Sales Report\n";
-    cout << "5. Return to Main Menu\n";
+    cout << "5. Revenue Rollups\n";
+    cout << "6. Fleet Utilization Report\n";
+    cout << "7. Top Customers and Vehicles\n";
+    cout << "8. Export Data (CSV/JSON Lines)\n";
+    cout << "9. All Branches (reports and searches)\n";
+    cout << "10. Return to Main Menu\n";
     cout << "Enter your choice: ";
 }
 
@@ -256,6 +324,9 @@ void handleSalesMenu() {
     
     cin.ignore(numeric_limits<streamsize>::max(), '\n');
     
+    // On a read replica, apply the primary's latest changes first
+    syncReplica();
+    
     switch (choice) {
         case 1:
             addSale();
@@ -274,6 +345,26 @@ void handleSalesMenu() {
             pressEnterToContinue();
             break;
         case 5:
+            displayRevenueRollups();
+            pressEnterToContinue();
+            break;
+        case 6:
+            generateFleetUtilizationReport();
+            pressEnterToContinue();
+            break;
+        case 7:
+            displayTopK();
+            pressEnterToContinue();
+            break;
+        case 8:
+            exportData();
+            pressEnterToContinue();
+            break;
+        case 9:
+            branchMenu();
+            pressEnterToContinue();
+            break;
+        case 10:
             // Return to main menu
             break;
         default:
@@ -291,6 +382,14 @@ void viewCompanyDetails() {
     cout << "Contact: +1234567890\n";
     cout << "Email: info@tourmate.com\n";
     cout << "Website: www.tourmate.com\n";
+    
+    // System status: how long startup took and whether the tables are loaded
+    printStartupStats();
+    printResultCacheStats();
+    if (isReplica()) {
+        syncReplica();
+        printReplicaStatus();
+    }
     pressEnterToContinue();
 }
 
@@ -0,0 +1,259 @@
+#include "partition.h"
+#include "dates.h"
+#include "fileutil.h"
+#include "profile.h"
+#include "prefetch.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+
+using namespace std;
+
+static const string SALES_MANIFEST_FILE = "sales_manifest.txt";
+static const string LEGACY_SALES_FILE = "sales.txt";
+
+// Partition key for a sale (its start-date month)
+string salesPartitionKey(const Sales& sale) {
+    int day = dateToDayNumber(sale.getStartDate());
+    return day == INVALID_DAY ? UNDATED_PARTITION : dayNumberToMonth(day);
+}
+
+// File name holding a partition
+string salesPartitionFile(const string& key) {
+    return dataPath("sales_" + key + ".txt");
+}
+
+// Legacy sales.txt left unmigrated in read-only data, or "" if there is none
+string unmigratedSalesFile() {
+    string legacyFile = dataPath(LEGACY_SALES_FILE);
+    if (!dataIsReadOnly() || fileExists(dataPath(SALES_MANIFEST_FILE)) || !fileExists(legacyFile)) {
+        return "";
+    }
+    return legacyFile;
+}
+
+// Fold one sale into its partition's manifest entry
+void notePartitionSale(vector<SalesPartition>& partitions, const Sales& sale) {
+    string key = salesPartitionKey(sale);
+    auto it = lower_bound(partitions.begin(), partitions.end(), key,
+                          [](const SalesPartition& p, const string& k) { return p.key < k; });
+
+    if (it == partitions.end() || it->key != key) {
+        SalesPartition partition = {key, 0, INVALID_DAY, 0};
+        it = partitions.insert(it, partition);
+    }
+
+    it->rows++;
+    int endDay = dateToDayNumber(sale.getEndDate());
+    if (endDay == INVALID_DAY) {
+        if (it->undatedEnds >= 0) {
+            it->undatedEnds++;
+        }
+    } else if (it->maxEndDay == INVALID_DAY || endDay > it->maxEndDay) {
+        it->maxEndDay = endDay;
+    }
+}
+
+// Write the manifest atomically
+static bool writeSalesManifest(const vector<SalesPartition>& partitions) {
+    string manifestFile = dataPath(SALES_MANIFEST_FILE);
+    string tempFile = manifestFile + ".tmp";
+    ofstream file(tempFile);
+
+    if (!file.is_open()) {
+        cout << "Error: Could not open " << tempFile << " for writing." << endl;
+        return false;
+    }
+
+    for (const auto& partition : partitions) {
+        file << partition.key << "|" << partition.rows << "|"
+             << (partition.maxEndDay == INVALID_DAY ? "" : dayNumberToDate(partition.maxEndDay)) << "|"
+             << (partition.undatedEnds < 0 ? "" : to_string(partition.undatedEnds)) << '\n';
+    }
+    file.close();
+
+    if (file.fail() || !replaceFile(tempFile, manifestFile)) {
+        cout << "Error: Could not update " << manifestFile << "." << endl;
+        return false;
+    }
+    return true;
+}
+
+// Split a legacy single-file sales.txt into monthly partitions. A split that
+// failed is not retried by the same process.
+static vector<SalesPartition> migrateLegacySalesFile() {
+    static set<string> failed;
+    vector<SalesPartition> partitions;
+    map<string, vector<string>> lines;
+    string legacyFile = dataPath(LEGACY_SALES_FILE);
+    ifstream legacy(legacyFile);
+    string line;
+
+    if (!legacy.is_open() || failed.count(legacyFile) > 0) {
+        return partitions;
+    }
+
+    while (getline(legacy, line)) {
+        if (!line.empty()) {
+            Sales sale = Sales::fromString(line);
+            lines[salesPartitionKey(sale)].push_back(line);
+            notePartitionSale(partitions, sale);
+        }
+    }
+    legacy.close();
+
+    // The manifest marks the migration done, so it is written only once every
+    // partition is on disk, and sales.txt is set aside only once it is too
+    vector<string> keys;
+    bool ok = true;
+    for (const auto& entry : lines) {
+        ofstream file(salesPartitionFile(entry.first));
+        for (const auto& row : entry.second) {
+            file << row << '\n';
+        }
+        file.close();
+        ok = ok && !file.fail() && syncFile(salesPartitionFile(entry.first));
+        keys.push_back(entry.first);
+    }
+
+    ok = ok && writeSalesManifest(partitions) && syncSalesPartitions(vector<string>());
+    if (!ok) {
+        // Leave sales.txt in charge; the split is redone on next use
+        remove(dataPath(SALES_MANIFEST_FILE).c_str());
+        for (const auto& key : keys) {
+            remove(salesPartitionFile(key).c_str());
+        }
+        failed.insert(legacyFile);
+        loadMessages() << "Error: Could not split " << legacyFile << " into monthly partitions; it was left as it is."
+                       << endl;
+        return vector<SalesPartition>();
+    }
+    if (!replaceFileDurably(legacyFile, legacyFile + ".migrated")) {
+        loadMessages() << "Warning: Could not rename " << legacyFile << " to " << legacyFile << ".migrated." << endl;
+    }
+
+    loadMessages() << "Note: " << legacyFile << " was split into " << partitions.size()
+         << " monthly partition file(s); the original was kept as " << legacyFile << ".migrated." << endl;
+
+    return partitions;
+}
+
+// Read the manifest, migrating a legacy single-file sales.txt on first use
+vector<SalesPartition> loadSalesManifest() {
+    ProfileSpan span("file", "loadSalesManifest");
+    vector<SalesPartition> partitions;
+    string manifestFile = dataPath(SALES_MANIFEST_FILE);
+    ifstream file(manifestFile);
+    string line;
+
+    if (!file.is_open() && dataIsReadOnly()) {
+        // Read-only data is not migrated; see unmigratedSalesFile
+        return partitions;
+    }
+    if (!file.is_open()) {
+        // Only one thread migrates; a second one reads the manifest it wrote
+        static mutex migrationLock;
+        lock_guard<mutex> guard(migrationLock);
+        return fileExists(manifestFile) ? loadSalesManifest() : migrateLegacySalesFile();
+    }
+
+    while (getline(file, line)) {
+        if (line.empty()) {
+            continue;
+        }
+
+        stringstream ss(line);
+        string key, rows, maxEnd, undatedEnds;
+        getline(ss, key, '|');
+        getline(ss, rows, '|');
+        getline(ss, maxEnd, '|');
+        getline(ss, undatedEnds, '|');
+
+        // Manifests written before the undated end count was kept leave it unknown
+        SalesPartition partition = {key, atoll(rows.c_str()), dateToDayNumber(maxEnd),
+                                    undatedEnds.empty() ? -1 : atoll(undatedEnds.c_str())};
+        partitions.push_back(partition);
+    }
+
+    sort(partitions.begin(), partitions.end(),
+         [](const SalesPartition& a, const SalesPartition& b) { return a.key < b.key; });
+
+    return partitions;
+}
+
+// Write the manifest, unless that would hide a sales.txt not yet migrated
+bool saveSalesManifest(const vector<SalesPartition>& partitions) {
+    ProfileSpan span("file", "saveSalesManifest");
+    string legacyFile = dataPath(LEGACY_SALES_FILE);
+
+    if (!fileExists(dataPath(SALES_MANIFEST_FILE)) && fileExists(legacyFile)) {
+        cout << "Error: " << legacyFile << " has not been split into monthly partitions yet." << endl;
+        return false;
+    }
+    return writeSalesManifest(partitions);
+}
+
+// Flush the partitions' files and the manifest to disk
+bool syncSalesPartitions(const vector<string>& keys) {
+    ProfileSpan span("file", "syncSalesPartitions");
+    bool ok = syncFile(dataPath(SALES_MANIFEST_FILE));
+
+    for (const auto& key : keys) {
+        ok = syncFile(salesPartitionFile(key)) && ok;
+    }
+    return syncDirectory(dataPath("")) && ok;
+}
+
+// Rebuild the given partitions' manifest entries from their files
+bool recountSalesPartitions(const vector<string>& keys) {
+    ProfileSpan span("file", "recountSalesPartitions");
+    unique_lock<shared_mutex> appends(salesAppendLock());
+    vector<SalesPartition> counted;
+    set<string> recounted(keys.begin(), keys.end());
+
+    for (const auto& key : recounted) {
+        ifstream file(salesPartitionFile(key));
+        string line;
+        while (getline(file, line)) {
+            if (!line.empty()) {
+                notePartitionSale(counted, Sales::fromString(line));
+            }
+        }
+    }
+
+    // Entries for other partitions are kept as they are
+    for (const auto& partition : loadSalesManifest()) {
+        if (recounted.count(partition.key) == 0) {
+            counted.push_back(partition);
+        }
+    }
+    sort(counted.begin(), counted.end(),
+         [](const SalesPartition& a, const SalesPartition& b) { return a.key < b.key; });
+
+    return saveSalesManifest(counted);
+}
+
+// True if a partition may hold a rental overlapping [fromDay, toDay]
+bool partitionOverlaps(const SalesPartition& partition, int fromDay, int toDay) {
+    if (partition.key == UNDATED_PARTITION) {
+        return false;
+    }
+
+    int monthStart = dateToDayNumber(partition.key + "-01");
+    if (monthStart == INVALID_DAY || monthStart > toDay) {
+        return false;
+    }
+
+    // Rentals starting in this month reach at most maxEndDay, and their start
+    // dates reach at most the end of the month
+    int latest = firstDayOfNextMonth(monthStart) - 1;
+    if (partition.maxEndDay != INVALID_DAY && partition.maxEndDay > latest) {
+        latest = partition.maxEndDay;
+    }
+    return latest >= fromDay;
+}
@@ -0,0 +1,58 @@
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include <string>
+#include <vector>
+#include "sales.h"
+
+using namespace std;
+
+// Sales are stored in one file per start-date month (sales_YYYY-MM.txt), plus
+// sales_undated.txt for records without a valid start date. The manifest
+// (sales_manifest.txt) lists each partition with its row count, latest end
+// date and number of rows without a valid end date, so date-filtered readers
+// can skip partitions without opening them.
+
+// Partition key for sales without a valid start date
+const string UNDATED_PARTITION = "undated";
+
+// One manifest entry
+struct SalesPartition {
+    string key;        // YYYY-MM or UNDATED_PARTITION
+    long long rows;    // Number of sales stored in the partition
+    int maxEndDay;     // Latest end date in the partition (INVALID_DAY if none)
+    long long undatedEnds;  // Rows whose end date is not a valid date (-1 if unknown)
+};
+
+// Partition key for a sale (its start-date month)
+string salesPartitionKey(const Sales& sale);
+
+// File name holding a partition
+string salesPartitionFile(const string& key);
+
+// Read the manifest, migrating a legacy single-file sales.txt on first use.
+// Read-only data (see DataDirectoryScope) is never migrated: without a
+// manifest this returns no partitions.
+vector<SalesPartition> loadSalesManifest();
+
+// Legacy sales.txt that read-only data holds in place of partitions, or ""
+string unmigratedSalesFile();
+
+// Write the manifest atomically; false if it could not be written
+bool saveSalesManifest(const vector<SalesPartition>& partitions);
+
+// Flush the given partitions' files and the manifest to disk
+bool syncSalesPartitions(const vector<string>& keys);
+
+// Rebuild the given partitions' manifest entries from their files, for a
+// recovery that cannot trust the manifest to match them. False if the
+// manifest could not be written.
+bool recountSalesPartitions(const vector<string>& keys);
+
+// True if a partition may hold a rental overlapping [fromDay, toDay]
+bool partitionOverlaps(const SalesPartition& partition, int fromDay, int toDay);
+
+// Fold one sale into its partition's manifest entry
+void notePartitionSale(vector<SalesPartition>& partitions, const Sales& sale);
+
+#endif // PARTITION_H
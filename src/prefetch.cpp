@@ -0,0 +1,149 @@
+#include "prefetch.h"
+#include "config.h"
+#include "user.h"
+#include "vehicleindex.h"
+#include "salesindex.h"
+#include "rollup.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <functional>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+// Set during static initialisation, as close to process start as we can get
+static const Clock::time_point processStart = Clock::now();
+
+// One background load and its timing (milliseconds since process start)
+struct PrefetchTask {
+    string name;
+    function<void()> load;
+    thread worker;
+    atomic<double> doneAt;
+};
+
+static vector<PrefetchTask> tasks(4);
+static atomic<bool> started(false);
+static atomic<double> firstPromptAt(-1.0);
+
+// Messages of the load running on this thread, if they are held back
+static thread_local ostringstream* heldMessages = nullptr;
+static string finishedMessages;
+static mutex finishedMessagesLock;
+
+static double millisecondsSinceStart() {
+    return chrono::duration<double, milli>(Clock::now() - processStart).count();
+}
+
+// Start the background loads
+void startPrefetch() {
+    if (started || !getConfigBool("prefetch", true)) {
+        return;
+    }
+    started = true;
+
+    tasks[0].name = "users";
+    tasks[0].load = []() { prefetchUsers(); };
+    tasks[1].name = "vehicles";
+    tasks[1].load = []() { vehicleIndex(); };
+    tasks[2].name = "sales index";
+    tasks[2].load = []() { salesIndex(); };
+    tasks[3].name = "revenue rollup";
+    tasks[3].load = []() { salesRollup(); };
+
+    for (auto& task : tasks) {
+        task.doneAt = -1.0;
+        task.worker = thread([&task]() {
+            ostringstream messages;
+            {
+                HeldMessagesScope hold(messages);
+                task.load();
+            }
+            {
+                lock_guard<mutex> guard(finishedMessagesLock);
+                finishedMessages += messages.str();
+            }
+            task.doneAt = millisecondsSinceStart();
+        });
+    }
+}
+
+// Record the first time a prompt is shown
+void noteFirstPrompt() {
+    double unset = -1.0;
+    firstPromptAt.compare_exchange_strong(unset, millisecondsSinceStart());
+}
+
+// Wait for the background loads
+void finishPrefetch() {
+    for (auto& task : tasks) {
+        if (task.worker.joinable()) {
+            task.worker.join();
+        }
+    }
+}
+
+// Stream for messages printed while a table loads
+ostream& loadMessages() {
+    return heldMessages != nullptr ? *heldMessages : cout;
+}
+
+HeldMessagesScope::HeldMessagesScope(ostringstream& messages) : previous(heldMessages) {
+    heldMessages = &messages;
+}
+
+HeldMessagesScope::~HeldMessagesScope() {
+    heldMessages = previous;
+}
+
+// Print the messages the finished background loads held back
+void showPrefetchMessages() {
+    lock_guard<mutex> guard(finishedMessagesLock);
+    if (!finishedMessages.empty()) {
+        cout << finishedMessages << flush;
+        finishedMessages.clear();
+    }
+}
+
+// Print startup timings
+void printStartupStats() {
+    cout << "\n===== STARTUP STATS =====\n";
+    cout << fixed << setprecision(1);
+
+    if (firstPromptAt >= 0) {
+        cout << left << setw(24) << "Time to first prompt" << right << setw(10) << firstPromptAt << " ms\n";
+    }
+
+    if (!started) {
+        cout << "Background prefetch is off; tables load on first use." << endl;
+        return;
+    }
+
+    double readyAt = 0;
+    bool ready = true;
+    for (const auto& task : tasks) {
+        double doneAt = task.doneAt;
+        cout << left << setw(24) << ("  " + task.name) << right << setw(10);
+        if (doneAt < 0) {
+            cout << "loading" << "\n";
+            ready = false;
+        } else {
+            cout << doneAt << " ms\n";
+            readyAt = max(readyAt, doneAt);
+        }
+    }
+
+    if (ready) {
+        cout << left << setw(24) << "Time to ready" << right << setw(10) << readyAt << " ms" << endl;
+    } else {
+        cout << "Still loading in the background." << endl;
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <ostream>
+#include <sstream>
+
+using namespace std;
+
+// Start loading the users table, vehicle index, sales index and revenue
+// rollup on background threads, so the login prompt appears immediately.
+// Each table is built under its own lock, so an operation that needs one
+// before it is ready waits for that table only. Disabled by prefetch=false.
+void startPrefetch();
+
+// Record that the first prompt is on screen (time-to-first-prompt)
+void noteFirstPrompt();
+
+// Wait for the background loads to finish (before exiting)
+void finishPrefetch();
+
+// Stream for warnings and notes printed while a table loads. On a prefetch
+// thread they are held back, so they do not land in the middle of the login
+// prompt, and likewise inside a HeldMessagesScope; anywhere else this is cout.
+ostream& loadMessages();
+
+// Holds this thread's load messages in 'messages' until the scope ends, so
+// loads running side by side do not interleave their output
+class HeldMessagesScope {
+private:
+    ostringstream* previous;
+
+public:
+    explicit HeldMessagesScope(ostringstream& messages);
+    ~HeldMessagesScope();
+
+    HeldMessagesScope(const HeldMessagesScope&) = delete;
+    HeldMessagesScope& operator=(const HeldMessagesScope&) = delete;
+};
+
+// Print the messages the finished background loads held back
+void showPrefetchMessages();
+
+// Print time-to-first-prompt, per-table load times and time-to-ready
+void printStartupStats();
+
+#endif // PREFETCH_H
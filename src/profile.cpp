@@ -0,0 +1,168 @@
+#include "profile.h"
+#include "config.h"
+#include "fileutil.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+
+using namespace std;
+
+atomic<bool> profilingEnabled(false);
+
+// One finished span
+struct ProfileEvent {
+    const char* category;
+    const char* name;
+    long long startMicros;
+    long long durationMicros;
+    int threadId;
+};
+
+static const chrono::steady_clock::time_point profileStart = chrono::steady_clock::now();
+static mutex profileLock;
+static vector<ProfileEvent> ring;
+static unsigned long long recorded = 0;  // Total spans ever recorded; ring slot is recorded % size
+static string profileFile;
+static atomic<int> nextThreadId(1);
+
+// Background writer, woken by a signal or the flush interval
+static thread writer;
+static mutex writerLock;
+static condition_variable writerWake;
+static bool writerStop = false;
+static long long flushSeconds = 0;
+static atomic<int> pendingSignal(0);
+
+// Small stable per-thread number for the "tid" field
+static int profileThreadId() {
+    thread_local int id = nextThreadId++;
+    return id;
+}
+
+// Microseconds since the program started
+long long profileClockMicros() {
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - profileStart).count();
+}
+
+// Record one finished span, overwriting the oldest once the ring is full
+void recordProfileSpan(const char* category, const char* name, long long startMicros, long long durationMicros) {
+    int threadId = profileThreadId();
+    lock_guard<mutex> guard(profileLock);
+
+    if (ring.empty()) {
+        return;
+    }
+    ring[recorded % ring.size()] = {category, name, startMicros, durationMicros, threadId};
+    recorded++;
+}
+
+// Only notes the signal; the writer thread does the work
+static void onProfileSignal(int signalNumber) {
+    pendingSignal = signalNumber;
+}
+
+// Write the buffered spans, oldest first, as a trace-event JSON object. The
+// file is replaced as a whole, so a reader never sees half of one.
+static void dumpProfile() {
+    lock_guard<mutex> guard(profileLock);
+
+    if (!profilingEnabled) {
+        return;
+    }
+
+    string tempFile = profileFile + ".tmp";
+    ofstream file(tempFile, ios::trunc);
+    if (!file.is_open()) {
+        cout << "Error: Could not open " << tempFile << " for writing." << endl;
+        return;
+    }
+
+    unsigned long long first = recorded > ring.size() ? recorded - ring.size() : 0;
+
+    file << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedSpans\":" << first << "},\"traceEvents\":[\n";
+    for (unsigned long long i = first; i < recorded; i++) {
+        const ProfileEvent& event = ring[i % ring.size()];
+        file << "{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category
+             << "\",\"ph\":\"X\",\"ts\":" << event.startMicros << ",\"dur\":" << event.durationMicros
+             << ",\"pid\":1,\"tid\":" << event.threadId << "}" << (i + 1 < recorded ? ",\n" : "\n");
+    }
+    file << "]}\n";
+    file.close();
+
+    if (file.fail() || !replaceFile(tempFile, profileFile)) {
+        cout << "Error: Could not write " << profileFile << "." << endl;
+        remove(tempFile.c_str());
+    }
+}
+
+// Write the profile when asked by a signal or when a flush is due. After
+// SIGINT or SIGTERM the signal is raised again with its default action.
+static void runProfileWriter() {
+    chrono::steady_clock::time_point lastFlush = chrono::steady_clock::now();
+    unique_lock<mutex> lock(writerLock);
+
+    while (!writerStop) {
+        writerWake.wait_for(lock, chrono::milliseconds(200));
+
+        int signalNumber = pendingSignal.exchange(0);
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        bool flushDue = flushSeconds > 0 && now - lastFlush >= chrono::seconds(flushSeconds);
+        if (signalNumber == 0 && !flushDue) {
+            continue;
+        }
+
+        lock.unlock();
+        dumpProfile();
+        lastFlush = now;
+        if (signalNumber == SIGINT || signalNumber == SIGTERM) {
+            signal(signalNumber, SIG_DFL);
+            raise(signalNumber);
+        }
+        lock.lock();
+    }
+}
+
+// Start recording if profile_file is set
+void startProfiling() {
+    {
+        lock_guard<mutex> guard(profileLock);
+
+        profileFile = getConfigString("profile_file", "");
+        if (profileFile.empty() || profilingEnabled) {
+            return;
+        }
+
+        long long capacity = getConfigInt("profile_buffer", 65536);
+        ring.assign(capacity > 0 ? (size_t)capacity : 65536, ProfileEvent());
+        recorded = 0;
+        profilingEnabled = true;
+    }
+
+    flushSeconds = getConfigInt("profile_flush_seconds", 0);
+    signal(SIGINT, onProfileSignal);
+    signal(SIGTERM, onProfileSignal);
+#ifdef SIGUSR1
+    signal(SIGUSR1, onProfileSignal);
+#endif
+    writer = thread(runProfileWriter);
+}
+
+// Stop the background writer and write the buffered spans
+void writeProfile() {
+    {
+        lock_guard<mutex> guard(writerLock);
+        writerStop = true;
+    }
+    writerWake.notify_all();
+    if (writer.joinable()) {
+        writer.join();
+    }
+    dumpProfile();
+}
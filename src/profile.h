@@ -0,0 +1,55 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <atomic>
+
+using namespace std;
+
+// Scoped timing spans written in Chrome trace-event JSON, for opening a run
+// in chrome://tracing or Perfetto. Turned on by profile_file=<path> in
+// tourmate.conf. Spans go into a ring buffer of profile_buffer events
+// (default 65536) that keeps the newest, so profiling can stay on in
+// production. The buffer is written to the file when the program exits, and
+// by a background thread while it runs: on SIGUSR1, every
+// profile_flush_seconds (default 0, off), and on SIGINT or SIGTERM before the
+// program stops. Each write replaces the file as a whole.
+// When profiling is off a span costs one relaxed atomic load.
+
+extern atomic<bool> profilingEnabled;
+
+// Microseconds since the program started
+long long profileClockMicros();
+
+// Record one finished span. category and name must be string literals.
+void recordProfileSpan(const char* category, const char* name, long long startMicros, long long durationMicros);
+
+// Times the enclosing scope, e.g. ProfileSpan span("file", "loadSalesManifest");
+class ProfileSpan {
+private:
+    const char* category;
+    const char* name;
+    long long startMicros;
+
+public:
+    ProfileSpan(const char* category, const char* name)
+        : category(category), name(name),
+          startMicros(profilingEnabled.load(memory_order_relaxed) ? profileClockMicros() : -1) {}
+
+    ~ProfileSpan() {
+        if (startMicros >= 0) {
+            recordProfileSpan(category, name, startMicros, profileClockMicros() - startMicros);
+        }
+    }
+
+    ProfileSpan(const ProfileSpan&) = delete;
+    ProfileSpan& operator=(const ProfileSpan&) = delete;
+};
+
+// Read the profile settings and start recording if profile_file is set
+void startProfiling();
+
+// Stop the background writer and write the buffered spans to profile_file
+// (called on exit)
+void writeProfile();
+
+#endif // PROFILE_H
@@ -0,0 +1,988 @@
+#include "query.h"
+#include "vehicleindex.h"
+#include "salesindex.h"
+#include "salestrees.h"
+#include "partition.h"
+#include "dates.h"
+#include "trace.h"
+#include "profile.h"
+#include "resultcache.h"
+#include "extsort.h"
+#include <iostream>
+#include <algorithm>
+#include <map>
+#include <climits>
+#include <cfloat>
+#include <cmath>
+#include <sstream>
+#include <cctype>
+#include <unordered_set>
+#include <functional>
+
+using namespace std;
+
+// Describes one queryable field of a record type
+template <class Record>
+struct FieldSpec {
+    const char* name;
+    const char* aliases;   // Space-separated alternative names
+    bool numeric;
+    string Record::*textMember;
+    function<double(const Record&)> number;
+
+    // The field's text in place, for string fields
+    const string& text(const Record& record) const { return record.*textMember; }
+};
+
+// String fields compare as text, the rest as numbers
+template <class Record>
+static void setFieldAccess(FieldSpec<Record>& spec, const SchemaField<Record, string>& field) {
+    spec.numeric = false;
+    spec.textMember = field.member;
+}
+
+template <class Record, class Number>
+static void setFieldAccess(FieldSpec<Record>& spec, const SchemaField<Record, Number>& field) {
+    spec.numeric = true;
+    spec.textMember = nullptr;
+    spec.number = [field](const Record& record) { return (double)field.of(record); };
+}
+
+// One field per schema field (see schema.h), under its column name and the
+// given aliases
+template <class Record>
+static vector<FieldSpec<Record>> schemaFieldSpecs(const map<string, const char*>& aliases) {
+    vector<FieldSpec<Record>> fields;
+
+    forEachSchemaField<Record>([&fields, &aliases](const auto& field) {
+        FieldSpec<Record> spec;
+        auto alias = aliases.find(field.name);
+        spec.name = field.name;
+        spec.aliases = alias != aliases.end() ? alias->second : "";
+        setFieldAccess(spec, field);
+        fields.push_back(spec);
+    });
+    return fields;
+}
+
+static const vector<FieldSpec<Vehicle>>& vehicleFields() {
+    static const vector<FieldSpec<Vehicle>> fields = schemaFieldSpecs<Vehicle>({
+        {"id", "vehicleid"},
+        {"make", "model makemodel"},
+        {"reg", "registration registrationnumber"},
+        {"rate", "rateperday price"},
+    });
+    return fields;
+}
+
+static const vector<FieldSpec<Sales>>& salesFields() {
+    static const vector<FieldSpec<Sales>> fields = schemaFieldSpecs<Sales>({
+        {"id", "saleid"},
+        {"vehicle", "vehicleid"},
+        {"customer", "name customername"},
+        {"contact", "customercontact"},
+        {"start", "startdate"},
+        {"end", "enddate"},
+        {"payment", "paymentstatus"},
+    });
+    return fields;
+}
+
+static string toLower(const string& text) {
+    string result = text;
+    transform(result.begin(), result.end(), result.begin(), [](unsigned char c) { return (char)tolower(c); });
+    return result;
+}
+
+static string trim(const string& text) {
+    size_t start = text.find_first_not_of(" \t");
+    if (start == string::npos) {
+        return "";
+    }
+    size_t end = text.find_last_not_of(" \t");
+    return text.substr(start, end - start + 1);
+}
+
+template <class Record>
+static const FieldSpec<Record>* findField(const vector<FieldSpec<Record>>& fields, const string& name) {
+    // Canonical names (as stored in predicates and sort orders) need no lowercasing
+    for (const auto& field : fields) {
+        if (name == field.name) {
+            return &field;
+        }
+    }
+
+    string wanted = toLower(name);
+
+    for (const auto& field : fields) {
+        if (wanted == field.name) {
+            return &field;
+        }
+        string aliases = string(" ") + field.aliases + " ";
+        if (aliases.find(" " + wanted + " ") != string::npos) {
+            return &field;
+        }
+    }
+    return nullptr;
+}
+
+template <class Record>
+static bool addPredicate(const vector<FieldSpec<Record>>& fields, Query& query, const string& fieldName,
+                         CompareOp op, const string& value, string& error) {
+    const FieldSpec<Record>* field = findField(fields, fieldName);
+
+    if (field == nullptr) {
+        error = "Unknown field '" + fieldName + "'";
+        return false;
+    }
+
+    Predicate predicate;
+    predicate.field = field->name;
+    predicate.fieldIndex = (size_t)(field - fields.data());
+    predicate.op = op;
+    predicate.value = value;
+    predicate.number = 0.0;
+    predicate.numeric = field->numeric;
+
+    if (field->numeric) {
+        if (op == OP_CONTAINS) {
+            error = "Field '" + predicate.field + "' is numeric and does not support ~";
+            return false;
+        }
+        try {
+            size_t used = 0;
+            predicate.number = stod(value, &used);
+            if (used != value.size()) {
+                throw invalid_argument(value);
+            }
+        } catch (...) {
+            error = "Field '" + predicate.field + "' needs a number, got '" + value + "'";
+            return false;
+        }
+    }
+
+    query.predicates.push_back(predicate);
+    return true;
+}
+
+// Split on AND (any case) outside double quotes
+static vector<string> splitConjunction(const string& text) {
+    vector<string> parts;
+    string current;
+    bool inQuotes = false;
+
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '"') {
+            inQuotes = !inQuotes;
+        }
+
+        bool atAnd = !inQuotes && i > 0 && isspace((unsigned char)text[i - 1]) && i + 3 < text.size() &&
+                     toLower(text.substr(i, 3)) == "and" && isspace((unsigned char)text[i + 3]);
+
+        if (atAnd) {
+            parts.push_back(current);
+            current.clear();
+            i += 2;
+        } else {
+            current += text[i];
+        }
+    }
+    parts.push_back(current);
+
+    return parts;
+}
+
+template <class Record>
+static bool parseQueryText(const vector<FieldSpec<Record>>& fields, const string& text, Query& query, string& error) {
+    query.predicates.clear();
+
+    for (const auto& rawPart : splitConjunction(text)) {
+        string part = trim(rawPart);
+        size_t opStart = part.find_first_of("<>=!~");
+
+        if (part.empty() || opStart == string::npos || opStart == 0) {
+            error = "Expected 'field op value' but got '" + part + "'";
+            return false;
+        }
+
+        string opText = part.substr(opStart, 1);
+        if (opStart + 1 < part.size() && part[opStart + 1] == '=') {
+            opText += '=';
+        }
+
+        CompareOp op;
+        if (opText == "=" || opText == "==") {
+            op = OP_EQ;
+        } else if (opText == "!=") {
+            op = OP_NE;
+        } else if (opText == "<") {
+            op = OP_LT;
+        } else if (opText == "<=") {
+            op = OP_LE;
+        } else if (opText == ">") {
+            op = OP_GT;
+        } else if (opText == ">=") {
+            op = OP_GE;
+        } else if (opText == "~") {
+            op = OP_CONTAINS;
+        } else {
+            error = "Unknown operator '" + opText + "'";
+            return false;
+        }
+
+        string value = trim(part.substr(opStart + opText.size()));
+        if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+            value = value.substr(1, value.size() - 2);
+        }
+
+        if (!addPredicate(fields, query, trim(part.substr(0, opStart)), op, value, error)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Parse a query for vehicles
+bool parseVehicleQuery(const string& text, Query& query, string& error) {
+    return parseQueryText(vehicleFields(), text, query, error);
+}
+
+// Parse a query for sales
+bool parseSalesQuery(const string& text, Query& query, string& error) {
+    return parseQueryText(salesFields(), text, query, error);
+}
+
+// Add one predicate to a vehicle query
+bool addVehiclePredicate(Query& query, const string& field, CompareOp op, const string& value, string& error) {
+    return addPredicate(vehicleFields(), query, field, op, value, error);
+}
+
+// Add one predicate to a sales query
+bool addSalesPredicate(Query& query, const string& field, CompareOp op, const string& value, string& error) {
+    return addPredicate(salesFields(), query, field, op, value, error);
+}
+
+template <class Record>
+static bool parseSortText(const vector<FieldSpec<Record>>& fields, const string& text, SortOrder& order,
+                          string& error) {
+    string fieldName = trim(text);
+    string direction;
+    size_t split = fieldName.find_first_of(" \t:");
+
+    if (split != string::npos) {
+        direction = toLower(trim(fieldName.substr(split + 1)));
+        fieldName = fieldName.substr(0, split);
+    }
+
+    order.field.clear();
+    order.descending = false;
+    if (fieldName.empty()) {
+        return true;
+    }
+
+    const FieldSpec<Record>* field = findField(fields, fieldName);
+    if (field == nullptr) {
+        error = "Unknown field '" + fieldName + "'";
+        return false;
+    }
+    if (direction != "" && direction != "asc" && direction != "desc") {
+        error = "Expected asc or desc after '" + fieldName + "' but got '" + direction + "'";
+        return false;
+    }
+
+    order.field = field->name;
+    order.descending = direction == "desc";
+    return true;
+}
+
+// Parse a vehicle sort order
+bool parseVehicleSortOrder(const string& text, SortOrder& order, string& error) {
+    return parseSortText(vehicleFields(), text, order, error);
+}
+
+// Parse a sales sort order
+bool parseSalesSortOrder(const string& text, SortOrder& order, string& error) {
+    return parseSortText(salesFields(), text, order, error);
+}
+
+// Numbers are encoded so they compare bytewise in numeric order
+template <class Record>
+static string sortKey(const vector<FieldSpec<Record>>& fields, const Record& record, const SortOrder& order) {
+    const FieldSpec<Record>* field = findField(fields, order.field);
+
+    if (field == nullptr) {
+        return "";
+    }
+    return field->numeric ? encodeSortNumber(field->number(record)) : field->text(record);
+}
+
+string vehicleSortKey(const Vehicle& vehicle, const SortOrder& order) {
+    return sortKey(vehicleFields(), vehicle, order);
+}
+
+string saleSortKey(const Sales& sale, const SortOrder& order) {
+    return sortKey(salesFields(), sale, order);
+}
+
+template <class T>
+static bool compareValues(const T& actual, CompareOp op, const T& expected) {
+    switch (op) {
+        case OP_EQ: return actual == expected;
+        case OP_NE: return actual != expected;
+        case OP_LT: return actual < expected;
+        case OP_LE: return actual <= expected;
+        case OP_GT: return actual > expected;
+        case OP_GE: return actual >= expected;
+        default: return false;
+    }
+}
+
+template <class Record>
+static bool recordMatches(const vector<FieldSpec<Record>>& fields, const Record& record, const Query& query) {
+    for (const auto& predicate : query.predicates) {
+        // Resolved when the predicate was parsed
+        const FieldSpec<Record>& field = fields[predicate.fieldIndex];
+
+        bool match;
+        if (predicate.numeric) {
+            match = compareValues(field.number(record), predicate.op, predicate.number);
+        } else if (predicate.op == OP_CONTAINS) {
+            match = field.text(record).find(predicate.value) != string::npos;
+        } else {
+            match = compareValues(field.text(record), predicate.op, predicate.value);
+        }
+
+        if (!match) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Full predicate evaluation
+bool vehicleMatches(const Vehicle& vehicle, const Query& query) {
+    return recordMatches(vehicleFields(), vehicle, query);
+}
+
+bool saleMatches(const Sales& sale, const Query& query) {
+    return recordMatches(salesFields(), sale, query);
+}
+
+// Format a bound for plan output
+static string boundText(double value) {
+    if (value <= -DBL_MAX || value >= DBL_MAX) {
+        return value < 0 ? "-inf" : "inf";
+    }
+    ostringstream oss;
+    oss << value;
+    return oss.str();
+}
+
+// Run a vehicle query against the vehicle index
+vector<const Vehicle*> runVehicleQuery(const VehicleIndex& index, const Query& query, string& plan) {
+    ProfileSpan span("index", "runVehicleQuery");
+    vector<const Vehicle*> result;
+
+    // Candidate sets from every equality predicate with a hash index
+    vector<pair<const unordered_set<string>*, string>> sets;
+    unordered_set<string> idMatch;
+    bool byId = false;
+
+    // Equality on type/status selects partitions of the ordered indexes;
+    // comparisons on rate/year become inclusive ranges within them
+    string typeValue, statusValue;
+    double rateLow = -DBL_MAX, rateHigh = DBL_MAX;
+    double yearLow = -DBL_MAX, yearHigh = DBL_MAX;
+    bool rateBounded = false, yearBounded = false;
+
+    for (const auto& predicate : query.predicates) {
+        if (predicate.field == "rate" || predicate.field == "year") {
+            double& low = predicate.field == "rate" ? rateLow : yearLow;
+            double& high = predicate.field == "rate" ? rateHigh : yearHigh;
+            bool& bounded = predicate.field == "rate" ? rateBounded : yearBounded;
+
+            switch (predicate.op) {
+                case OP_EQ: low = max(low, predicate.number); high = min(high, predicate.number); break;
+                case OP_LT:
+                case OP_LE: high = min(high, predicate.number); break;
+                case OP_GT:
+                case OP_GE: low = max(low, predicate.number); break;
+                default: continue;
+            }
+            bounded = true;
+            continue;
+        }
+
+        if (predicate.op != OP_EQ) {
+            continue;
+        }
+        if (predicate.field == "type") {
+            typeValue = predicate.value;
+        } else if (predicate.field == "status") {
+            statusValue = predicate.value;
+        }
+
+        if (predicate.field == "id") {
+            // Primary key lookup: at most one candidate
+            if (!byId && index.find(predicate.value) != nullptr) {
+                idMatch.insert(predicate.value);
+            }
+            byId = true;
+            sets.push_back(make_pair(&idMatch, predicate.field + "=" + predicate.value));
+        } else if (VehicleIndex::isIndexed(predicate.field)) {
+            sets.push_back(make_pair(index.idsWith(predicate.field, predicate.value),
+                                     predicate.field + "=" + predicate.value));
+        }
+    }
+
+    // Most selective hash set first
+    sort(sets.begin(), sets.end(), [](const pair<const unordered_set<string>*, string>& a,
+                                      const pair<const unordered_set<string>*, string>& b) {
+        return a.first->size() < b.first->size();
+    });
+    size_t best = sets.empty() ? SIZE_MAX : sets[0].first->size();
+
+    // Ordered range scans give up as soon as they outgrow the best candidate set so far
+    vector<string> rangeIds;
+    string rangePlan;
+    bool useRange = false;
+    string partitionText = (typeValue.empty() ? "" : " type=" + typeValue) +
+                           (statusValue.empty() ? "" : " status=" + statusValue);
+
+    if (rateBounded) {
+        vector<string> ids = index.idsByRate(typeValue, statusValue, rateLow, rateHigh, best);
+        if (ids.size() <= best) {
+            rangeIds.swap(ids);
+            rangePlan = "ordered rate index [" + boundText(rateLow) + ", " + boundText(rateHigh) + "]" + partitionText;
+            best = rangeIds.size();
+            useRange = true;
+        }
+    }
+    if (yearBounded && yearLow <= yearHigh) {
+        int low = yearLow < INT_MIN ? INT_MIN : (int)ceil(yearLow);
+        int high = yearHigh > INT_MAX ? INT_MAX : (int)floor(yearHigh);
+        vector<string> ids = index.idsByYear(typeValue, statusValue, low, high, best);
+        if (ids.size() <= best) {
+            rangeIds.swap(ids);
+            rangePlan = "ordered year index [" + boundText(yearLow) + ", " + boundText(yearHigh) + "]" + partitionText;
+            best = rangeIds.size();
+            useRange = true;
+        }
+    }
+
+    vector<string> candidates;
+
+    if (useRange) {
+        candidates.swap(rangeIds);
+        plan = rangePlan + " -> " + to_string(candidates.size()) + " candidate(s)";
+    } else if (!sets.empty()) {
+        // Probe the other hash sets only for members of the smallest
+        for (const auto& id : *sets[0].first) {
+            bool inAll = true;
+            for (size_t i = 1; i < sets.size() && inAll; i++) {
+                inAll = sets[i].first->count(id) > 0;
+            }
+            if (inAll) {
+                candidates.push_back(id);
+            }
+        }
+
+        plan = "index";
+        for (size_t i = 0; i < sets.size(); i++) {
+            plan += (i == 0 ? " " : " & ") + sets[i].second + " (" + to_string(sets[i].first->size()) + ")";
+        }
+        plan += " -> " + to_string(candidates.size()) + " candidate(s)";
+    } else {
+        plan = "full scan of " + to_string(index.size()) + " vehicle(s)";
+        for (const Vehicle* vehicle : index.all()) {
+            if (vehicleMatches(*vehicle, query)) {
+                result.push_back(vehicle);
+            }
+        }
+        return result;
+    }
+
+    for (const Vehicle* vehicle : index.inFileOrder(candidates)) {
+        if (vehicleMatches(*vehicle, query)) {
+            result.push_back(vehicle);
+        }
+    }
+
+    return result;
+}
+
+// Narrow [from, to] using one date predicate; false if the value is not a date
+static bool narrowDayRange(const Predicate& predicate, int& from, int& to) {
+    int day = dateToDayNumber(predicate.value);
+    if (day == INVALID_DAY) {
+        return false;
+    }
+
+    switch (predicate.op) {
+        case OP_EQ: from = max(from, day); to = min(to, day); return true;
+        case OP_LT: to = min(to, day - 1); return true;
+        case OP_LE: to = min(to, day); return true;
+        case OP_GT: from = max(from, day + 1); return true;
+        case OP_GE: from = max(from, day); return true;
+        default: return false;
+    }
+}
+
+// Answer a sales query from the on-disk trees, for use before the in-memory
+// index is loaded. The tree with the fewest candidates among sale ID and
+// vehicle equality and the start-date range is used, if that is under a
+// quarter of the rows the selected partitions hold; candidates are read by
+// offset. False, with nothing visited, if no tree is worth using.
+static bool runSalesTreeQuery(const Query& query, const unordered_set<string>& selected, long long selectedRows,
+                              int startFrom, int startTo, const function<void(const Sales&)>& visit, string& plan) {
+    struct Lookup {
+        string field, low, high, label;
+    };
+    vector<Lookup> lookups;
+
+    for (const auto& predicate : query.predicates) {
+        if (predicate.op == OP_EQ && (predicate.field == "id" || predicate.field == "vehicle") &&
+            !predicate.value.empty()) {
+            lookups.push_back({predicate.field, predicate.value, predicate.value,
+                               predicate.field + "=" + predicate.value});
+        }
+    }
+    if (startFrom != INT_MIN || startTo != INT_MAX) {
+        string low = startFrom == INT_MIN ? "" : dayNumberToDate(startFrom);
+        string high = startTo == INT_MAX ? "~" : dayNumberToDate(startTo);
+        string label = "start " + (startFrom == INT_MIN ? "..." : low) + ".." + (startTo == INT_MAX ? "..." : high);
+        lookups.push_back({"start", low, high, label});
+    }
+
+    map<string, vector<pair<uint64_t, string>>> best;
+    size_t bestCount = (size_t)max(0LL, selectedRows / 4);
+    string bestField, bestLabel;
+
+    for (const auto& lookup : lookups) {
+        map<string, vector<pair<uint64_t, string>>> found;
+        if (!findSalesInTrees(lookup.field, lookup.low, lookup.high, bestCount, found)) {
+            continue;
+        }
+        size_t count = 0;
+        for (auto partition = found.begin(); partition != found.end();) {
+            if (selected.count(partition->first) == 0) {
+                partition = found.erase(partition);
+            } else {
+                count += partition->second.size();
+                ++partition;
+            }
+        }
+        best.swap(found);
+        bestCount = count;
+        bestField = lookup.field;
+        bestLabel = lookup.label;
+    }
+
+    if (bestField.empty()) {
+        return false;
+    }
+
+    plan = "btree " + bestLabel + " -> " + to_string(bestCount) + " candidate(s) in " + to_string(best.size()) +
+           " partition(s)";
+
+    auto keep = [&query, &visit](const Sales& sale) {
+        if (saleMatches(sale, query)) {
+            visit(sale);
+        }
+    };
+    auto keyOf = [&bestField](const Sales& sale) { return salesTreeKey(bestField, sale); };
+
+    for (const auto& partition : best) {
+        if (readSalesAtOffsets(partition.first, partition.second, keyOf, keep)) {
+            continue;
+        }
+
+        // The partition no longer matches the tree: scan it, and have the
+        // trees rebuilt on next use
+        invalidateSalesTrees();
+        forEachSaleInPartition(partition.first, keep);
+    }
+
+    // Undated sales are not in the start tree but may still match as text
+    if (bestField == "start" && selected.count(UNDATED_PARTITION) > 0) {
+        forEachSaleInPartition(UNDATED_PARTITION, keep);
+    }
+    return true;
+}
+
+// Run a sales query against the partitions and the sales index
+void runSalesQuery(const Query& query, const function<void(const Sales&)>& visit, string& plan) {
+    ProfileSpan span("index", "runSalesQuery");
+    // Date predicates bound the start and end days; partitions outside them are skipped
+    int startFrom = INT_MIN, startTo = INT_MAX, endFrom = INT_MIN, endTo = INT_MAX;
+    bool dated = false;
+
+    for (const auto& predicate : query.predicates) {
+        if (predicate.field == "start") {
+            dated = narrowDayRange(predicate, startFrom, startTo) || dated;
+        } else if (predicate.field == "end") {
+            dated = narrowDayRange(predicate, endFrom, endTo) || dated;
+        }
+    }
+
+    vector<SalesPartition> partitions = loadSalesManifest();
+    unordered_set<string> selected;
+    long long selectedRows = 0;
+
+    // Valid dates are YYYY-MM-DD, so text and date order agree on them; other
+    // text (undated sales) is compared as text and can match any bound
+    for (const auto& partition : partitions) {
+        if ((startFrom != INT_MIN || startTo != INT_MAX) && partition.key != UNDATED_PARTITION) {
+            // Start dates in this partition fall within its month
+            int monthStart = dateToDayNumber(partition.key + "-01");
+            if (monthStart > startTo || firstDayOfNextMonth(monthStart) - 1 < startFrom) {
+                continue;
+            }
+        }
+        if (endFrom != INT_MIN && partition.undatedEnds == 0 &&
+            (partition.maxEndDay == INVALID_DAY || partition.maxEndDay < endFrom)) {
+            // Every end date here is valid and before the range
+            continue;
+        }
+        selected.insert(partition.key);
+        selectedRows += partition.rows;
+    }
+
+    // Until the in-memory index is loaded, the on-disk trees answer
+    // selective lookups without reading whole partitions
+    if (!salesIndexLoaded() && salesTreesEnabled() &&
+        runSalesTreeQuery(query, selected, selectedRows, startFrom, startTo, visit, plan)) {
+        return;
+    }
+
+    // Equality predicates with a hash index; the index is only built when
+    // partition pruning alone cannot narrow the search
+    vector<pair<const vector<uint32_t>*, string>> lists;
+    bool useIndex = false;
+
+    for (const auto& predicate : query.predicates) {
+        if (predicate.op == OP_EQ && SalesIndex::isIndexed(predicate.field)) {
+            useIndex = true;
+        }
+    }
+    if (useIndex && dated && !salesIndexLoaded() && selected.size() < partitions.size()) {
+        useIndex = false;
+    }
+
+    if (useIndex) {
+        SalesIndex& index = salesIndex();
+        for (const auto& predicate : query.predicates) {
+            if (predicate.op == OP_EQ && SalesIndex::isIndexed(predicate.field)) {
+                lists.push_back(make_pair(index.positionsWith(predicate.field, predicate.value),
+                                          predicate.field + "=" + predicate.value));
+            }
+        }
+        sort(lists.begin(), lists.end(), [](const pair<const vector<uint32_t>*, string>& a,
+                                            const pair<const vector<uint32_t>*, string>& b) {
+            return a.first->size() < b.first->size();
+        });
+        useIndex = (long long)lists[0].first->size() <= selectedRows;
+    }
+
+    if (useIndex) {
+        SalesIndex& index = salesIndex();
+
+        // Postings are sorted by position, so intersections are linear merges
+        vector<uint32_t> positions = *lists[0].first;
+        for (size_t i = 1; i < lists.size(); i++) {
+            vector<uint32_t> merged;
+            set_intersection(positions.begin(), positions.end(), lists[i].first->begin(), lists[i].first->end(),
+                             back_inserter(merged));
+            positions.swap(merged);
+        }
+
+        map<string, unordered_set<string>> wanted;
+        for (uint32_t position : positions) {
+            if (selected.count(index.partitionAt(position)) > 0) {
+                wanted[index.partitionAt(position)].insert(index.saleIdAt(position));
+            }
+        }
+
+        plan = "index";
+        for (size_t i = 0; i < lists.size(); i++) {
+            plan += (i == 0 ? " " : " & ") + lists[i].second + " (" + to_string(lists[i].first->size()) + ")";
+        }
+        plan += " -> " + to_string(positions.size()) + " candidate(s) in " + to_string(wanted.size()) +
+                " partition(s)";
+
+        for (const auto& partition : wanted) {
+            const unordered_set<string>& ids = partition.second;
+            forEachSaleInPartition(partition.first, [&](const Sales& sale) {
+                if (ids.count(sale.getSaleId()) > 0 && saleMatches(sale, query)) {
+                    visit(sale);
+                }
+            });
+        }
+        return;
+    }
+
+    if (selected.size() < partitions.size()) {
+        plan = "partition pruning: " + to_string(selected.size()) + " of " + to_string(partitions.size()) +
+               " partition(s), " + to_string(selectedRows) + " row(s)";
+    } else {
+        plan = "full scan of " + to_string(partitions.size()) + " partition(s), " + to_string(selectedRows) +
+               " row(s)";
+    }
+
+    for (const auto& partition : partitions) {
+        if (selected.count(partition.key) > 0) {
+            forEachSaleInPartition(partition.key, [&](const Sales& sale) {
+                if (saleMatches(sale, query)) {
+                    visit(sale);
+                }
+            });
+        }
+    }
+}
+
+// Query back in the syntax parseVehicleQuery/parseSalesQuery accept
+string queryToText(const Query& query) {
+    static const char* const opText[] = {"=", "!=", "<", "<=", ">", ">=", "~"};
+    string text;
+
+    for (const auto& predicate : query.predicates) {
+        if (!text.empty()) {
+            text += " AND ";
+        }
+        text += predicate.field + opText[predicate.op];
+        text += predicate.numeric ? predicate.value : "\"" + predicate.value + "\"";
+    }
+    return text;
+}
+
+// Cache key: sorted predicates, numbers in one format
+string normalizedQueryKey(const Query& query) {
+    static const char* const opText[] = {"=", "!=", "<", "<=", ">", ">=", "~"};
+    vector<string> parts;
+
+    for (const auto& predicate : query.predicates) {
+        string value;
+        if (predicate.numeric) {
+            ostringstream number;
+            number.precision(17);
+            number << predicate.number;
+            value = number.str();
+        } else {
+            value = "\"" + predicate.value + "\"";
+        }
+        parts.push_back(predicate.field + opText[predicate.op] + value);
+    }
+
+    sort(parts.begin(), parts.end());
+    parts.erase(unique(parts.begin(), parts.end()), parts.end());
+
+    string key;
+    for (const auto& part : parts) {
+        key += part + " AND ";
+    }
+    return key;
+}
+
+// Cached matches of one query with the plan that found them
+template <class Record>
+struct CachedQueryResult {
+    vector<Record> records;
+    string plan;
+};
+
+// Run a vehicle query through the result cache
+shared_ptr<const vector<Vehicle>> runCachedVehicleQuery(const Query& query, string& plan) {
+    static ResultCache<CachedQueryResult<Vehicle>> cache;
+    string key = normalizedQueryKey(query);
+    shared_ptr<const CachedQueryResult<Vehicle>> result = cache.find(key);
+
+    if (result) {
+        plan = "cached result (" + result->plan + ")";
+    } else {
+        TableGenerations generations = currentTableGenerations();
+        CachedQueryResult<Vehicle> found;
+        LockedVehicleIndex index = vehicleIndex();
+        for (const Vehicle* vehicle : runVehicleQuery(*index, query, plan)) {
+            found.records.push_back(*vehicle);
+        }
+        found.plan = plan;
+        size_t rows = found.records.size();
+        result = cache.store(key, DEPENDS_ON_VEHICLES, generations, rows, move(found));
+    }
+    return shared_ptr<const vector<Vehicle>>(result, &result->records);
+}
+
+// Run a sales query through the result cache. Matches are still streamed to
+// 'visit' on a miss; they are collected only up to query_cache_rows.
+void runCachedSalesQuery(const Query& query, const function<void(const Sales&)>& visit, string& plan) {
+    static ResultCache<CachedQueryResult<Sales>> cache;
+    string key = normalizedQueryKey(query);
+    shared_ptr<const CachedQueryResult<Sales>> cached = cache.find(key);
+
+    if (cached) {
+        plan = "cached result (" + cached->plan + ")";
+        for (const auto& sale : cached->records) {
+            visit(sale);
+        }
+        return;
+    }
+
+    TableGenerations generations = currentTableGenerations();
+    CachedQueryResult<Sales> found;
+    size_t limit = resultCacheRowLimit();
+    size_t rows = 0;
+
+    runSalesQuery(query, [&](const Sales& sale) {
+        if (++rows <= limit) {
+            found.records.push_back(sale);
+        } else if (!found.records.empty()) {
+            vector<Sales>().swap(found.records);  // Too many to keep
+        }
+        visit(sale);
+    }, plan);
+
+    found.plan = plan;
+    cache.store(key, DEPENDS_ON_SALES, generations, rows, move(found));
+}
+
+// Sorted vehicle query: matches go through an external sort in the schema's
+// binary form, which reads back without parsing numbers
+bool runSortedVehicleQuery(const Query& query, const SortOrder& order, const function<void(const Vehicle&)>& visit) {
+    ProfileSpan span("report", "runSortedVehicleQuery");
+    ExternalSorter sorter(order.descending);
+    string plan;
+
+    {
+        LockedVehicleIndex index = vehicleIndex();
+        vector<const Vehicle*> matches = query.predicates.empty() ? index->all() : runVehicleQuery(*index, query, plan);
+        for (const Vehicle* vehicle : matches) {
+            if (!sorter.add(vehicleSortKey(*vehicle, order), formatRecordBinary(*vehicle))) {
+                return false;
+            }
+        }
+    }
+
+    Vehicle vehicle;
+    return sorter.finish([&visit, &vehicle](const string& record) {
+        parseRecordBinary(record, vehicle);
+        visit(vehicle);
+    });
+}
+
+// Sorted sales query: sales are read partition by partition into the sorter
+bool runSortedSalesQuery(const Query& query, const SortOrder& order, const function<void(const Sales&)>& visit) {
+    ProfileSpan span("report", "runSortedSalesQuery");
+    ExternalSorter sorter(order.descending);
+    bool added = true;
+    string plan;
+
+    auto add = [&sorter, &order, &added](const Sales& sale) {
+        added = added && sorter.add(saleSortKey(sale, order), formatRecordBinary(sale));
+    };
+    if (query.predicates.empty()) {
+        forEachSaleInFile(add);
+    } else {
+        runSalesQuery(query, add, plan);
+    }
+
+    Sales sale;
+    return added && sorter.finish([&visit, &sale](const string& record) {
+        parseRecordBinary(record, sale);
+        visit(sale);
+    });
+}
+
+// Print every vehicle in sort order
+long long printSortedVehicles(const SortOrder& order) {
+    long long shown = 0;
+
+    cout << "\n===== VEHICLE LIST =====\n";
+    cout << "Sorted by " << order.field << (order.descending ? " (descending)" : "") << "\n\n";
+
+    bool sorted = runSortedVehicleQuery(Query(), order, [&shown](const Vehicle& vehicle) {
+        cout << "Vehicle #" << ++shown << ":" << endl;
+        vehicle.displayDetails();
+        cout << "------------------------" << endl;
+    });
+
+    if (!sorted) {
+        cout << "Error: Could not write or read the temporary sort files (check sort_temp_dir)." << endl;
+        return -1;
+    }
+    cout << "Total vehicles: " << shown << endl;
+    return shown;
+}
+
+// Print every sale in sort order
+long long printSortedSales(const SortOrder& order) {
+    long long shown = 0;
+
+    cout << "\n===== SALES LIST =====\n";
+    cout << "Sorted by " << order.field << (order.descending ? " (descending)" : "") << "\n\n";
+
+    bool sorted = runSortedSalesQuery(Query(), order, [&shown](const Sales& sale) {
+        cout << "Sale #" << ++shown << ":" << endl;
+        sale.displayDetails();
+        cout << "------------------------" << endl;
+    });
+
+    if (!sorted) {
+        cout << "Error: Could not write or read the temporary sort files (check sort_temp_dir)." << endl;
+        return -1;
+    }
+    cout << "Total sales: " << shown << endl;
+    return shown;
+}
+
+// Run a vehicle query and print its matches
+long long printVehicleQuery(const Query& query, bool showPlan) {
+    traceOperation("vehicle.query", queryToText(query));
+    string plan;
+    shared_ptr<const vector<Vehicle>> vehicles = runCachedVehicleQuery(query, plan);
+
+    if (showPlan) {
+        cout << "Query plan: " << plan << endl;
+    }
+
+    cout << "\nSearch Results:\n";
+    for (const Vehicle& vehicle : *vehicles) {
+        cout << "------------------------" << endl;
+        vehicle.displayDetails();
+    }
+
+    if (vehicles->empty()) {
+        cout << "No matching vehicles found." << endl;
+    }
+    return (long long)vehicles->size();
+}
+
+// Run a sales query and print its matches
+long long printSalesQuery(const Query& query, bool showPlan) {
+    traceOperation("sale.query", queryToText(query));
+    string plan;
+    long long count = 0;
+
+    cout << "\nSearch Results:\n";
+    runCachedSalesQuery(query, [&count](const Sales& sale) {
+        count++;
+        cout << "------------------------" << endl;
+        sale.displayDetails();
+    }, plan);
+
+    if (count == 0) {
+        cout << "No matching sales found." << endl;
+    }
+    if (showPlan) {
+        cout << "\nQuery plan: " << plan << endl;
+    }
+    return count;
+}
+
+// Query syntax help shown by the menus and command mode
+void printQueryHelp() {
+    cout << "Combine conditions with AND, e.g. type=SUV AND status=Available AND rate<80\n";
+    cout << "Operators: =  !=  <  <=  >  >=  ~ (contains). Quote values containing AND.\n";
+    cout << "Vehicle fields: id, make, year, type, reg, status, rate\n";
+    cout << "Sales fields: id, vehicle, customer, contact, start, end, amount, payment\n";
+}
@@ -0,0 +1,111 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <memory>
+#include "vehicle.h"
+#include "sales.h"
+
+using namespace std;
+
+class VehicleIndex;
+
+// Comparison operators accepted in query predicates
+enum CompareOp {
+    OP_EQ,        // =
+    OP_NE,        // !=
+    OP_LT,        // <
+    OP_LE,        // <=
+    OP_GT,        // >
+    OP_GE,        // >=
+    OP_CONTAINS   // ~ (substring)
+};
+
+// One "field op value" condition
+struct Predicate {
+    string field;    // Canonical field name
+    size_t fieldIndex;  // Position of the field in its record type's field list
+    CompareOp op;
+    string value;
+    double number;   // Parsed value for numeric fields
+    bool numeric;
+};
+
+// A conjunction of predicates, e.g. "type=SUV AND status=Available AND rate<80"
+struct Query {
+    vector<Predicate> predicates;
+};
+
+// Sort order for listings and exports: one field, ascending or descending
+struct SortOrder {
+    string field;             // Canonical field name; empty keeps file order
+    bool descending = false;
+};
+
+// Parse a query for vehicles. Fields: id, make, year, type, reg, status, rate.
+bool parseVehicleQuery(const string& text, Query& query, string& error);
+
+// Parse a query for sales. Fields: id, vehicle, customer, contact, start, end, amount, payment.
+bool parseSalesQuery(const string& text, Query& query, string& error);
+
+// Add one predicate to a vehicle or sales query (used by the single-field search menus)
+bool addVehiclePredicate(Query& query, const string& field, CompareOp op, const string& value, string& error);
+bool addSalesPredicate(Query& query, const string& field, CompareOp op, const string& value, string& error);
+
+// Parse "field", "field asc", "field desc" or "field:desc", with the same
+// field names as queries. Empty text keeps file order.
+bool parseVehicleSortOrder(const string& text, SortOrder& order, string& error);
+bool parseSalesSortOrder(const string& text, SortOrder& order, string& error);
+
+// Key that orders records by the sort field for an ExternalSorter (extsort.h)
+string vehicleSortKey(const Vehicle& vehicle, const SortOrder& order);
+string saleSortKey(const Sales& sale, const SortOrder& order);
+
+// Full predicate evaluation
+bool vehicleMatches(const Vehicle& vehicle, const Query& query);
+bool saleMatches(const Sales& sale, const Query& query);
+
+// Run a vehicle query: intersect the hash indexes of the most selective
+// equality predicates, then check the remaining predicates on the candidates.
+// Scans the table only when no predicate can use an index. The matches point
+// into the index, so the caller holds its lock (see vehicleIndex) throughout.
+vector<const Vehicle*> runVehicleQuery(const VehicleIndex& index, const Query& query, string& plan);
+
+// Run a sales query: use start/end date predicates to prune partitions and the
+// sales hash indexes for equality predicates, whichever touches fewer rows.
+void runSalesQuery(const Query& query, const function<void(const Sales&)>& visit, string& plan);
+
+// Run a vehicle or sales query through the result cache (see resultcache.h).
+// A repeated query returns the cached matches while the table is unchanged;
+// the plan then reads "cached result (<original plan>)".
+shared_ptr<const vector<Vehicle>> runCachedVehicleQuery(const Query& query, string& plan);
+void runCachedSalesQuery(const Query& query, const function<void(const Sales&)>& visit, string& plan);
+
+// Run a vehicle or sales query (no predicates = every record) and visit the
+// matches in sort order, through an external merge sort (see extsort.h).
+// False if a sort run could not be written or read back.
+bool runSortedVehicleQuery(const Query& query, const SortOrder& order, const function<void(const Vehicle&)>& visit);
+bool runSortedSalesQuery(const Query& query, const SortOrder& order, const function<void(const Sales&)>& visit);
+
+// Query in text form, e.g. for recording it in an operation trace
+string queryToText(const Query& query);
+
+// Cache key: the query's predicates in a fixed order, with numbers in one
+// format, so "rate<80 AND type=Van" and "type=Van AND rate<80.0" match
+string normalizedQueryKey(const Query& query);
+
+// Run a query and print its matches, returning how many there were
+long long printVehicleQuery(const Query& query, bool showPlan);
+long long printSalesQuery(const Query& query, bool showPlan);
+
+// Print every vehicle or sale in sort order, returning how many there were
+// (-1 if the sort failed)
+long long printSortedVehicles(const SortOrder& order);
+long long printSortedSales(const SortOrder& order);
+
+// Query syntax help shown by the menus and command mode
+void printQueryHelp();
+
+#endif // QUERY_H
@@ -0,0 +1,143 @@
+// Sales query check: fills an empty data directory with sales across several
+// months, including undated starts, unparsable ends and rentals that end
+// before they start, then compares each query's results through partition
+// pruning, the on-disk trees and the in-memory index against a full scan.
+// Build with "make check" and run tourmate_querycheck <empty directory>;
+// exits nonzero if any query disagrees.
+#include "sales.h"
+#include "query.h"
+#include "salesindex.h"
+#include "fileutil.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Sorted IDs of the sales a query returns, through the planner or a full scan
+static vector<string> matchingIds(const Query& query, bool planned, string& plan) {
+    vector<string> ids;
+    auto keep = [&ids](const Sales& sale) { ids.push_back(sale.getSaleId()); };
+
+    if (planned) {
+        runSalesQuery(query, keep, plan);
+    } else {
+        forEachSaleInFile([&](const Sales& sale) {
+            if (saleMatches(sale, query)) {
+                keep(sale);
+            }
+        });
+    }
+    sort(ids.begin(), ids.end());
+    return ids;
+}
+
+// Run every query and report the ones that disagree with a full scan
+static int checkQueries(const vector<string>& queries, const string& phase) {
+    int failures = 0;
+
+    for (const auto& text : queries) {
+        Query query;
+        string error, plan;
+        if (!parseSalesQuery(text, query, error)) {
+            cout << "Error: " << text << ": " << error << endl;
+            failures++;
+            continue;
+        }
+
+        vector<string> expected = matchingIds(query, false, plan);
+        vector<string> actual = matchingIds(query, true, plan);
+        if (actual != expected) {
+            cout << "FAIL (" << phase << ") " << text << ": " << actual.size() << " row(s), expected "
+                 << expected.size() << " [" << plan << "]" << endl;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        cout << "Usage: tourmate_querycheck <empty directory>" << endl;
+        return 1;
+    }
+
+#ifdef _WIN32
+    bool moved = _chdir(argv[1]) == 0;
+#else
+    bool moved = chdir(argv[1]) == 0;
+#endif
+    if (!moved) {
+        cout << "Error: Could not open directory " << argv[1] << endl;
+        return 1;
+    }
+    if (fileExists("sales_manifest.txt") || fileExists("sales.txt")) {
+        cout << "Error: " << argv[1] << " already holds sales; use an empty directory." << endl;
+        return 1;
+    }
+
+    // Three rentals a day over four months, plus the awkward rows
+    vector<Sales> sales;
+    int next = 1;
+    auto add = [&sales, &next](const string& start, const string& end) {
+        string id = "S" + to_string(next++);
+        sales.push_back(Sales(id, "V" + to_string(next % 7), "Customer " + id, "077", start, end, 100, "Paid"));
+    };
+    for (int month = 1; month <= 4; month++) {
+        for (int day = 1; day <= 28; day++) {
+            char start[16], end[16], early[16];
+            snprintf(start, sizeof(start), "2024-%02d-%02d", month, day);
+            snprintf(end, sizeof(end), "2024-%02d-%02d", month + (day > 20 ? 1 : 0), day > 20 ? day - 20 : day + 3);
+            snprintf(early, sizeof(early), "2023-12-%02d", day);
+            add(start, end);
+            add(start, start);
+            add(start, day % 5 == 0 ? "later" : early);  // Ends unknown or before the start
+        }
+    }
+    add("soon", "2024-01-05");
+    add("soon", "2024-03-30");
+    add("", "2023-11-01");
+    add("tbd", "later");
+    add("2024-02-10", "");
+
+    if (!appendSalesToFile(sales)) {
+        cout << "Error: Could not store the test sales." << endl;
+        return 1;
+    }
+
+    vector<string> queries = {
+        "end=2024-01-05",
+        "end>=2024-03-01",
+        "end>2024-04-30",
+        "end<2024-01-01",
+        "end<=2023-12-05",
+        "end=later",
+        "start=2024-02-10",
+        "start>=2024-03-15",
+        "start<2024-01-10",
+        "start>=2024-02-01 AND start<=2024-02-29",
+        "start>=2024-02-01 AND end<2024-01-01",
+        "start<=2024-01-31 AND end>=2024-02-01",
+        "start>2024-04-30",
+        "start=soon",
+        "start>2024-12-31",
+        "start<2024-01-01 AND end=2024-01-05",
+        "vehicle=V3 AND end>=2024-04-01",
+        "id=S340",
+    };
+
+    // Before the in-memory index exists, pruning and the on-disk trees answer
+    int failures = checkQueries(queries, "trees");
+    salesIndex();
+    failures += checkQueries(queries, "index");
+
+    cout << queries.size() << " queries checked, " << failures << " failure(s)" << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,272 @@
+#include "replica.h"
+#include "changelog.h"
+#include "txlog.h"
+#include "vehicle.h"
+#include "sales.h"
+#include "partition.h"
+#include "config.h"
+#include "fileutil.h"
+#include "profile.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <ctime>
+#include <mutex>
+#include <set>
+#include <unordered_set>
+#include <fcntl.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/file.h>
+#endif
+
+using namespace std;
+
+static const string REPLICA_POSITION_FILE = "replica_position.txt";
+static const string REPLICA_LOCK_FILE = "replica.lock";
+static const string SOCKET_PREFIX = "unix:";
+
+// How far this copy has got
+struct ReplicaPosition {
+    ChangeLogCursor cursor;     // Last change applied
+    long long primarySequence;  // Primary's latest change at the last sync
+    long long syncedAt;         // time() of the last successful sync, 0 if never
+};
+
+static mutex replicaLock;
+static bool firstSync = true;
+static long long knownSequence = -1;  // Where this process last left the copy
+
+// Holds replica.lock so two processes never apply changes to one copy at once
+class ReplicaFileLock {
+private:
+    int fd;
+
+public:
+    ReplicaFileLock() : fd(-1) {
+#ifndef _WIN32
+        fd = open(REPLICA_LOCK_FILE.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd >= 0) {
+            flock(fd, LOCK_EX);
+        }
+#endif
+    }
+
+    ~ReplicaFileLock() {
+#ifndef _WIN32
+        if (fd >= 0) {
+            flock(fd, LOCK_UN);
+            close(fd);
+        }
+#endif
+    }
+};
+
+// replica_of setting
+static string replicaSource() {
+    return getConfigString("replica_of", "");
+}
+
+// True if replica_of is set
+bool isReplica() {
+    static bool replica = !replicaSource().empty();
+    return replica;
+}
+
+// replica_position.txt: "sequence|offset|primarySequence|syncedAt"
+static ReplicaPosition loadReplicaPosition() {
+    ReplicaPosition position = {{0, 0}, 0, 0};
+    ifstream file(REPLICA_POSITION_FILE);
+    string line;
+
+    if (getline(file, line)) {
+        replace(line.begin(), line.end(), '|', ' ');
+        istringstream in(line);
+        in >> position.cursor.sequence >> position.cursor.offset >> position.primarySequence >> position.syncedAt;
+    }
+    return position;
+}
+
+// Write the position atomically
+static bool saveReplicaPosition(const ReplicaPosition& position) {
+    string tempFile = REPLICA_POSITION_FILE + ".tmp";
+    ofstream file(tempFile);
+
+    if (!file.is_open()) {
+        cout << "Error: Could not open " << tempFile << " for writing." << endl;
+        return false;
+    }
+    file << position.cursor.sequence << "|" << position.cursor.offset << "|" << position.primarySequence << "|"
+         << position.syncedAt << '\n';
+    file.close();
+
+    return replaceFile(tempFile, REPLICA_POSITION_FILE);
+}
+
+// Fetch up to 'limit' changes after the cursor from the primary's log
+static bool fetchChanges(ChangeLogCursor& cursor, size_t limit, vector<ChangeLogEntry>& entries,
+                         long long& primarySequence) {
+    string source = replicaSource();
+
+    if (source.compare(0, SOCKET_PREFIX.size(), SOCKET_PREFIX) == 0) {
+        return requestChangeLog(source.substr(SOCKET_PREFIX.size()), cursor, limit, entries, primarySequence);
+    }
+
+    // A primary that has not logged anything yet has no log file
+    DataDirectoryScope scope(source);
+    string path = dataPath(CHANGE_LOG_FILE);
+    if (!readChangeLog(path, cursor, limit, entries) && !(directoryExists(source) && !fileExists(path))) {
+        return false;
+    }
+    primarySequence = lastLoggedSequence(path);
+    return true;
+}
+
+// Drop sales that are already stored. Needed for the first batch after a
+// start only: a crash after applying a batch but before saving the position
+// leaves that batch applied, and it is fetched again.
+static void dropStoredSales(vector<TxChange>& changes) {
+    set<string> partitions;
+    for (const auto& change : changes) {
+        if (change.table == TX_SALES) {
+            partitions.insert(salesPartitionKey(Sales::fromString(change.record)));
+        }
+    }
+    if (partitions.empty()) {
+        return;
+    }
+
+    unordered_set<string> stored;
+    for (const auto& key : partitions) {
+        forEachSaleViewInPartition(key, [&stored](const SalesView& view) {
+            stored.insert(string(view.getSaleId()));
+        });
+    }
+
+    vector<TxChange> kept;
+    for (const auto& change : changes) {
+        if (change.table != TX_SALES || stored.count(recordKey(change.record)) == 0) {
+            kept.push_back(change);
+        }
+    }
+    changes.swap(kept);
+}
+
+// Apply everything the primary has logged since the last sync
+long long syncReplica() {
+    if (!isReplica()) {
+        return 0;
+    }
+
+    ProfileSpan span("replica", "syncReplica");
+    lock_guard<mutex> guard(replicaLock);
+    ReplicaFileLock fileLock;
+    ReplicaPosition position = loadReplicaPosition();
+
+    // Another process has applied changes since this one last synced, so the
+    // tables held in memory here are out of date
+    if (knownSequence >= 0 && position.cursor.sequence != knownSequence) {
+        resetVehicleCaches();
+        resetSalesCaches();
+    }
+    knownSequence = position.cursor.sequence;
+
+    size_t batch = (size_t)max(1LL, getConfigInt("replica_batch", 5000));
+    long long applied = 0;
+
+    while (true) {
+        vector<ChangeLogEntry> entries;
+        ChangeLogCursor next = position.cursor;
+
+        if (!fetchChanges(next, batch, entries, position.primarySequence)) {
+            cout << "Warning: Could not read the primary's change log from " << replicaSource()
+                 << "; showing data as of change " << position.cursor.sequence << "." << endl;
+            return -1;
+        }
+        if (entries.empty()) {
+            break;
+        }
+
+        vector<TxChange> changes;
+        changes.reserve(entries.size());
+        for (const auto& entry : entries) {
+            changes.push_back(entry.change);
+        }
+        if (firstSync) {
+            dropStoredSales(changes);
+        }
+        if (!changes.empty() && !commitTransaction(changes)) {
+            return -1;
+        }
+
+        firstSync = false;
+        position.cursor = next;
+        knownSequence = next.sequence;
+        applied += (long long)entries.size();
+        saveReplicaPosition(position);
+
+        if (entries.size() < batch) {
+            break;
+        }
+    }
+
+    firstSync = false;
+    position.syncedAt = (long long)time(nullptr);
+    saveReplicaPosition(position);
+    return applied;
+}
+
+// Refuse a change on a replica
+bool refuseChangeOnReplica() {
+    if (!isReplica()) {
+        return false;
+    }
+    cout << "This is a read-only replica of " << replicaSource() << ". Make this change on the primary." << endl;
+    return true;
+}
+
+// Record the primary's current position so only later changes are applied
+bool seedReplica() {
+    if (!isReplica()) {
+        cout << "Error: replica_of is not set in tourmate.conf." << endl;
+        return false;
+    }
+
+    lock_guard<mutex> guard(replicaLock);
+    ReplicaFileLock fileLock;
+    ReplicaPosition position = {{0, 0}, 0, 0};
+    vector<ChangeLogEntry> entries;
+    ChangeLogCursor probe = {0, 0};
+
+    if (!fetchChanges(probe, 1, entries, position.primarySequence)) {
+        cout << "Error: Could not read the primary's change log from " << replicaSource() << "." << endl;
+        return false;
+    }
+
+    // The offset is left at 0; the first sync finds the position by scanning
+    position.cursor.sequence = position.primarySequence;
+    position.syncedAt = (long long)time(nullptr);
+    knownSequence = position.cursor.sequence;
+    firstSync = false;
+    return saveReplicaPosition(position);
+}
+
+// Print the position reached, the primary's latest change and the lag
+void printReplicaStatus() {
+    ReplicaPosition position = loadReplicaPosition();
+
+    cout << "\nReplica of: " << replicaSource() << endl;
+    cout << "Applied through change: " << position.cursor.sequence << endl;
+    cout << "Primary's latest change: " << position.primarySequence << endl;
+    cout << "Lag: " << max(0LL, position.primarySequence - position.cursor.sequence) << " change(s)" << endl;
+
+    if (position.syncedAt > 0) {
+        time_t syncedAt = (time_t)position.syncedAt;
+        char text[32];
+        strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", localtime(&syncedAt));
+        cout << "Last synced: " << text << endl;
+    } else {
+        cout << "Last synced: never" << endl;
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef REPLICA_H
+#define REPLICA_H
+
+#include <string>
+
+using namespace std;
+
+// Read replica. With replica_of=<primary data directory> (shared, e.g. a
+// network mount) or replica_of=unix:<socket path> in tourmate.conf, this
+// instance keeps its own copy of the tables by applying the primary's change
+// log (see changelog.h) in transactions of up to replica_batch changes. It
+// catches up at startup, before every menu action and before every command,
+// so a report or search sees every change the primary had logged when it
+// began. Adding, updating or deleting vehicles, recording sales and return
+// sweeps are refused: those are made on the primary. The position reached
+// is kept in replica_position.txt.
+
+// True if replica_of is set
+bool isReplica();
+
+// Apply everything the primary has logged since the last sync. Returns the
+// number of changes applied, or -1 if the primary's log could not be read
+// (the copy is left as it was).
+long long syncReplica();
+
+// If this is a replica, say the change must be made on the primary and return true
+bool refuseChangeOnReplica();
+
+// Start a replica from a copy of the primary's data files: record the
+// primary's current position so only later changes are applied
+bool seedReplica();
+
+// Print the position reached, the primary's latest change and the lag
+void printReplicaStatus();
+
+#endif // REPLICA_H
@@ -0,0 +1,197 @@
+#include "reports.h"
+#include "sales.h"
+#include "dates.h"
+#include "trace.h"
+#include "profile.h"
+#include "resultcache.h"
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <unordered_map>
+
+using namespace std;
+
+// Constructor
+UtilizationStats::UtilizationStats() {
+    rentals = 0;
+    rentedDays = 0;
+    revenue = 0.0;
+}
+
+long long FleetUtilization::periodDays() const {
+    return toDay >= fromDay ? (long long)toDay - fromDay + 1 : 0;
+}
+
+// Hash-join all sales to vehicles in one pass over the sales file
+static FleetUtilization joinFleetUtilization(int fromDay, int toDay) {
+    ProfileSpan span("report", "computeFleetUtilization");
+    FleetUtilization result;
+    result.vehicles = loadVehiclesFromFile();
+    result.perVehicle.assign(result.vehicles.size(), UtilizationStats());
+    result.unmatchedSales = 0;
+    result.unmatchedRevenue = 0.0;
+    result.undatedSales = 0;
+
+    // Build side: vehicleId -> position in the vehicle list
+    unordered_map<string, size_t> vehicleIndex;
+    vehicleIndex.reserve(result.vehicles.size());
+    for (size_t i = 0; i < result.vehicles.size(); i++) {
+        vehicleIndex.emplace(result.vehicles[i].getVehicleId(), i);
+    }
+
+    bool clipped = fromDay != INVALID_DAY && toDay != INVALID_DAY;
+    int firstSeen = INVALID_DAY;
+    int lastSeen = INVALID_DAY;
+
+    // Probe side: stream sales once. Sales overlapping the period count in full
+    // towards rentals and revenue; rented days are clipped to the period.
+    auto probe = [&](const Sales& sale) {
+        int start = dateToDayNumber(sale.getStartDate());
+        int end = dateToDayNumber(sale.getEndDate());
+        bool dated = start != INVALID_DAY && end != INVALID_DAY && end >= start;
+
+        if (clipped) {
+            if (!dated || end < fromDay || start > toDay) {
+                return;
+            }
+            start = start < fromDay ? fromDay : start;
+            end = end > toDay ? toDay : end;
+        } else if (dated) {
+            firstSeen = (firstSeen == INVALID_DAY || start < firstSeen) ? start : firstSeen;
+            lastSeen = (lastSeen == INVALID_DAY || end > lastSeen) ? end : lastSeen;
+        }
+
+        auto it = vehicleIndex.find(sale.getVehicleId());
+        if (it == vehicleIndex.end()) {
+            result.unmatchedSales++;
+            result.unmatchedRevenue += sale.getAmount();
+            return;
+        }
+
+        UtilizationStats& stats = result.perVehicle[it->second];
+        stats.rentals++;
+        stats.revenue += sale.getAmount();
+        if (dated) {
+            stats.rentedDays += (long long)end - start + 1;
+        } else {
+            result.undatedSales++;
+        }
+    };
+
+    // A chosen period only needs the partitions that can overlap it
+    if (clipped) {
+        forEachSaleInDateRange(fromDay, toDay, probe);
+    } else {
+        forEachSaleInFile(probe);
+    }
+
+    result.fromDay = clipped ? fromDay : firstSeen;
+    result.toDay = clipped ? toDay : lastSeen;
+
+    return result;
+}
+
+// Cached join, per period, until a vehicle or sale changes
+FleetUtilization computeFleetUtilization(int fromDay, int toDay) {
+    static ResultCache<FleetUtilization> cache;
+    string key = to_string(fromDay) + "|" + to_string(toDay);
+    shared_ptr<const FleetUtilization> cached = cache.find(key);
+    if (cached) {
+        return *cached;
+    }
+
+    TableGenerations generations = currentTableGenerations();
+    FleetUtilization result = joinFleetUtilization(fromDay, toDay);
+    size_t rows = result.vehicles.size();
+    return *cache.store(key, DEPENDS_ON_VEHICLES | DEPENDS_ON_SALES, generations, rows, move(result));
+}
+
+static double utilizationPercent(long long rentedDays, long long availableDays) {
+    return availableDays > 0 ? 100.0 * rentedDays / availableDays : 0.0;
+}
+
+// Interactive per-vehicle and per-type utilization report
+void generateFleetUtilizationReport() {
+    cout << "\n===== FLEET UTILIZATION REPORT =====\n";
+
+    int fromDay = readOptionalDay("From Date (YYYY-MM-DD, Enter for all history): ", INVALID_DAY);
+    int toDay = INVALID_DAY;
+    if (fromDay != INVALID_DAY) {
+        toDay = readOptionalDay("To Date (YYYY-MM-DD, Enter for today): ", todayDayNumber());
+        if (fromDay > toDay) {
+            cout << "From date must not be after to date." << endl;
+            return;
+        }
+    }
+
+    traceOperation("report.utilization", (fromDay == INVALID_DAY ? "" : dayNumberToDate(fromDay)) + "|" +
+                                         (toDay == INVALID_DAY ? "" : dayNumberToDate(toDay)));
+    FleetUtilization report = computeFleetUtilization(fromDay, toDay);
+
+    if (report.vehicles.empty()) {
+        cout << "No vehicles found in the system." << endl;
+        return;
+    }
+
+    long long periodDays = report.periodDays();
+
+    if (periodDays > 0) {
+        cout << "\nPeriod: " << dayNumberToDate(report.fromDay) << " to " << dayNumberToDate(report.toDay)
+             << " (" << periodDays << " days)" << endl;
+    } else {
+        cout << "\nPeriod: no dated rentals on record" << endl;
+    }
+
+    cout << "\nPER VEHICLE\n";
+    cout << left << setw(8) << "ID" << setw(24) << "Make/Model" << setw(12) << "Type"
+         << right << setw(9) << "Rentals" << setw(8) << "Days"
+         << setw(14) << "Revenue($)" << setw(9) << "Util%" << endl;
+    cout << string(84, '-') << endl;
+
+    // Per-type rollup, ordered by type name
+    map<string, pair<long long, UtilizationStats>> perType;
+
+    for (size_t i = 0; i < report.vehicles.size(); i++) {
+        const Vehicle& vehicle = report.vehicles[i];
+        const UtilizationStats& stats = report.perVehicle[i];
+
+        cout << left << setw(8) << vehicle.getVehicleId()
+             << setw(24) << vehicle.getMakeModel().substr(0, 23)
+             << setw(12) << vehicle.getType().substr(0, 11)
+             << right << setw(9) << stats.rentals
+             << setw(8) << stats.rentedDays
+             << fixed << setprecision(2) << setw(14) << stats.revenue
+             << setprecision(1) << setw(9) << utilizationPercent(stats.rentedDays, periodDays) << endl;
+
+        auto& typeEntry = perType[vehicle.getType()];
+        typeEntry.first++;
+        typeEntry.second.rentals += stats.rentals;
+        typeEntry.second.rentedDays += stats.rentedDays;
+        typeEntry.second.revenue += stats.revenue;
+    }
+
+    cout << "\nPER VEHICLE TYPE\n";
+    cout << left << setw(16) << "Type" << right << setw(10) << "Vehicles" << setw(9) << "Rentals"
+         << setw(10) << "Days" << setw(14) << "Revenue($)" << setw(9) << "Util%" << endl;
+    cout << string(68, '-') << endl;
+
+    for (const auto& entry : perType) {
+        const UtilizationStats& stats = entry.second.second;
+        cout << left << setw(16) << entry.first.substr(0, 15)
+             << right << setw(10) << entry.second.first
+             << setw(9) << stats.rentals
+             << setw(10) << stats.rentedDays
+             << fixed << setprecision(2) << setw(14) << stats.revenue
+             << setprecision(1) << setw(9)
+             << utilizationPercent(stats.rentedDays, entry.second.first * periodDays) << endl;
+    }
+
+    if (report.unmatchedSales > 0) {
+        cout << "\nNote: " << report.unmatchedSales << " sale(s) worth $" << fixed << setprecision(2)
+             << report.unmatchedRevenue << " reference vehicles no longer in the fleet." << endl;
+    }
+    if (report.undatedSales > 0) {
+        cout << "Note: " << report.undatedSales
+             << " sale(s) without valid dates count towards revenue but not rented days." << endl;
+    }
+}
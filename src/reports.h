@@ -0,0 +1,40 @@
+#ifndef REPORTS_H
+#define REPORTS_H
+
+#include <string>
+#include <vector>
+#include "vehicle.h"
+
+using namespace std;
+
+// Rental activity for one vehicle (or one vehicle type) over a period
+struct UtilizationStats {
+    long long rentals;
+    long long rentedDays;
+    double revenue;
+
+    UtilizationStats();
+};
+
+// Result of joining sales to vehicles on vehicleId
+struct FleetUtilization {
+    vector<Vehicle> vehicles;
+    vector<UtilizationStats> perVehicle;  // Parallel to vehicles
+    int fromDay;                          // Inclusive period used for utilization
+    int toDay;
+    long long unmatchedSales;             // Sales whose vehicle no longer exists
+    double unmatchedRevenue;
+    long long undatedSales;               // Sales without usable start/end dates
+
+    long long periodDays() const;
+};
+
+// Hash-join all sales to vehicles in one pass over the sales file.
+// Pass INVALID_DAY for either bound to use the span of the sales history.
+// Results are cached per period until a vehicle or sale changes.
+FleetUtilization computeFleetUtilization(int fromDay, int toDay);
+
+// Interactive per-vehicle and per-type utilization report
+void generateFleetUtilizationReport();
+
+#endif // REPORTS_H
@@ -0,0 +1,277 @@
+#include "resultcache.h"
+#include "txlog.h"
+#include "config.h"
+#include "fileutil.h"
+#include "vehicle.h"
+#include "sales.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/file.h>
+#endif
+
+using namespace std;
+
+// Write counters shared by every process using the data directory: one
+// fixed-width line per table, vehicles first
+static const string GENERATION_FILE = "tourmate.generations";
+static const size_t GENERATION_LINE = 21;  // 20 digits and a newline
+
+static atomic<unsigned long long> vehicleGeneration(0);
+static atomic<unsigned long long> salesGeneration(0);
+static atomic<long long> cacheHits(0);
+static atomic<long long> cacheMisses(0);
+
+// Last seen stamp of each table's files ("" until first checked), and the
+// vehicle store's layout version it was taken at
+static mutex stampLock;
+static string vehicleStamp;
+static string salesStamp;
+static unsigned long long vehicleStampLayout = 0;
+
+// Shared write counter each stamp was taken at (-1 if unknown)
+static long long vehicleStampWrites = -1;
+static long long salesStampWrites = -1;
+
+// Layout version of a table's store (see RecordStore::layoutVersion)
+static unsigned long long tableLayout(char table) {
+    return table == TX_VEHICLES ? vehicleStoreLayout() : 0;
+}
+
+// Read a table's shared write counter, adding 'bump' to it under the file
+// lock first if it is not 0. Returns the value before the bump; -1 if the
+// file cannot be used.
+static long long sharedWriteCount(char table, int bump) {
+    string path = dataPath(GENERATION_FILE);
+    long long offset = table == TX_VEHICLES ? 0 : (long long)GENERATION_LINE;
+    char line[GENERATION_LINE + 1] = {0};
+
+#ifdef _WIN32
+    int fd = bump != 0 ? _open(path.c_str(), _O_RDWR | _O_CREAT | _O_BINARY, 0644) : _open(path.c_str(), _O_RDONLY | _O_BINARY);
+    if (fd < 0) {
+        return -1;
+    }
+    _lseeki64(fd, offset, SEEK_SET);
+    int got = _read(fd, line, (unsigned)GENERATION_LINE);
+#else
+    int fd = bump != 0 ? open(path.c_str(), O_RDWR | O_CREAT, 0644) : open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    flock(fd, bump != 0 ? LOCK_EX : LOCK_SH);
+    ssize_t got = pread(fd, line, GENERATION_LINE, (off_t)offset);
+#endif
+
+    // A missing line (a new file) counts as 0
+    long long count = got == (decltype(got))GENERATION_LINE ? atoll(line) : 0;
+    if (bump != 0) {
+        snprintf(line, sizeof(line), "%020lld\n", count + bump);
+#ifdef _WIN32
+        _lseeki64(fd, offset, SEEK_SET);
+        if (_write(fd, line, (unsigned)GENERATION_LINE) != (int)GENERATION_LINE) {
+            count = -1;
+        }
+#else
+        if (pwrite(fd, line, GENERATION_LINE, (off_t)offset) != (ssize_t)GENERATION_LINE) {
+            count = -1;
+        }
+#endif
+    }
+
+#ifdef _WIN32
+    _close(fd);
+#else
+    flock(fd, LOCK_UN);
+    close(fd);
+#endif
+    return count;
+}
+
+// Shared write counter and size, inode and modification and change times of
+// every file a table is stored in, taken while none of them is being moved by
+// this process; "" if one was. The files' times alone can miss a same-size
+// write made by another process within the file system's timestamp
+// granularity; the counter, bumped by every write, cannot.
+static string tableFileStamp(char table, unsigned long long& layout, long long writes) {
+    static const vector<string> vehicleFiles = {"vehicles.txt", "vehicles.txt.delta",
+                                                "vehicles.txt.delta.compacting", "vehicles.dat"};
+    static const vector<string> salesFiles = {"sales_manifest.txt"};
+    string stamp = to_string(writes) + "|";
+
+    layout = tableLayout(table);
+    for (const auto& file : table == TX_VEHICLES ? vehicleFiles : salesFiles) {
+        stamp += fileChangeStamp(dataPath(file)) + "|";
+    }
+    return layout % 2 == 0 && tableLayout(table) == layout ? stamp : "";
+}
+
+// Remember the stamp this process last saw a table's files at
+static void setKnownStamp(char table, const string& stamp, unsigned long long layout, long long writes) {
+    lock_guard<mutex> guard(stampLock);
+    (table == TX_VEHICLES ? vehicleStamp : salesStamp) = stamp;
+    (table == TX_VEHICLES ? vehicleStampWrites : salesStampWrites) = writes;
+    if (table == TX_VEHICLES) {
+        vehicleStampLayout = layout;
+    }
+}
+
+// Current generations
+TableGenerations currentTableGenerations() {
+    refreshVehicleCaches();
+    refreshSalesCaches();
+    return {vehicleGeneration.load(), salesGeneration.load()};
+}
+
+// Bump a table's generation once its in-memory copy changed
+void noteTableChanged(char table) {
+    if (table == TX_VEHICLES) {
+        vehicleGeneration++;
+    } else if (table == TX_SALES) {
+        salesGeneration++;
+    }
+
+    // A compaction moving the files now is noticed by its layout version
+    unsigned long long layout;
+    long long writes = resultCachingAllowed() ? sharedWriteCount(table, 0) : -1;
+    string stamp = resultCachingAllowed() ? tableFileStamp(table, layout, writes) : "";
+    if (!stamp.empty()) {
+        setKnownStamp(table, stamp, layout, writes);
+    }
+}
+
+// Bump a table's generation and shared write counter once a change is stored
+void noteTableStored(char table) {
+    if (table == TX_VEHICLES) {
+        vehicleGeneration++;
+    } else if (table == TX_SALES) {
+        salesGeneration++;
+    }
+    if (!resultCachingAllowed()) {
+        return;
+    }
+
+    long long before = sharedWriteCount(table, 1);
+    long long known;
+    {
+        lock_guard<mutex> guard(stampLock);
+        known = table == TX_VEHICLES ? vehicleStampWrites : salesStampWrites;
+    }
+
+    // Another process wrote since this one last looked: keep the old stamp, so
+    // the next lookup drops the in-memory table instead of taking this
+    // process's view of the files as current
+    if (before >= 0 && known >= 0 && before != known) {
+        return;
+    }
+
+    unsigned long long layout;
+    long long writes = before >= 0 ? before + 1 : -1;
+    string stamp = tableFileStamp(table, layout, writes);
+    if (!stamp.empty()) {
+        setKnownStamp(table, stamp, layout, writes);
+    }
+}
+
+// True if the table's files changed since this process last looked
+bool tableFilesChanged(char table) {
+    if (!resultCachingAllowed()) {
+        return false;
+    }
+
+    unsigned long long layout;
+    long long writes = sharedWriteCount(table, 0);
+    string stamp = tableFileStamp(table, layout, writes);
+    if (stamp.empty()) {
+        return false;
+    }
+
+    {
+        lock_guard<mutex> guard(stampLock);
+        string& known = table == TX_VEHICLES ? vehicleStamp : salesStamp;
+        if (known == stamp) {
+            return false;
+        }
+
+        // A first look, or a compaction here since the last one, only sets
+        // the stamp to compare against
+        bool baseline = known.empty() || (table == TX_VEHICLES && layout != vehicleStampLayout);
+        known = stamp;
+        (table == TX_VEHICLES ? vehicleStampWrites : salesStampWrites) = writes;
+        if (table == TX_VEHICLES) {
+            vehicleStampLayout = layout;
+        }
+        if (baseline) {
+            return false;
+        }
+    }
+
+    if (table == TX_VEHICLES) {
+        vehicleGeneration++;
+    } else {
+        salesGeneration++;
+    }
+    return true;
+}
+
+// query_cache_size
+size_t resultCacheCapacity() {
+    static size_t capacity = (size_t)max(0LL, getConfigInt("query_cache_size", 64));
+    return capacity;
+}
+
+// query_cache_rows
+size_t resultCacheRowLimit() {
+    static size_t rows = (size_t)max(0LL, getConfigInt("query_cache_rows", 10000));
+    return rows;
+}
+
+// Only the working directory's tables are tracked
+bool resultCachingAllowed() {
+    return dataPath("").empty();
+}
+
+// Count a lookup
+void noteResultCacheLookup(bool hit) {
+    if (hit) {
+        cacheHits++;
+    } else {
+        cacheMisses++;
+    }
+}
+
+// Print lookups, hits and the hit rate since startup
+void printResultCacheStats() {
+    long long hits = cacheHits.load();
+    long long lookups = hits + cacheMisses.load();
+
+    cout << "\n===== RESULT CACHE =====\n";
+    if (resultCacheCapacity() == 0) {
+        cout << "Result caching is off (query_cache_size=0)." << endl;
+        return;
+    }
+    cout << left << setw(24) << "Lookups" << right << setw(10) << lookups << "\n";
+    cout << left << setw(24) << "Hits" << right << setw(10) << hits << "\n";
+    cout << left << setw(24) << "Hit rate" << right << setw(10) << fixed << setprecision(1)
+         << (lookups > 0 ? 100.0 * hits / lookups : 0.0) << " %" << endl;
+}
+
+// True if none of the tables the result depends on has changed
+bool generationsCurrent(unsigned tables, const TableGenerations& generations, const TableGenerations& now) {
+    if ((tables & DEPENDS_ON_VEHICLES) && generations.vehicles != now.vehicles) {
+        return false;
+    }
+    if ((tables & DEPENDS_ON_SALES) && generations.sales != now.sales) {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,147 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+using namespace std;
+
+// Search and report results are kept in small LRU caches keyed by the
+// normalized query. Every stored change to a table bumps that table's
+// generation counter. A cached result remembers the generations it was
+// computed from and is dropped as soon as one of the tables it depends on has
+// moved on, so repeating a search is instant. query_cache_size in
+// tourmate.conf (default 64, 0 turns caching off) bounds the entries per
+// cache, and results of more than query_cache_rows rows (default 10000) are
+// not kept.
+//
+// Another process sharing the data directory (a second terminal, or
+// "tourmate return" run by a scheduled task) does not touch this process's
+// counters, so each table's generation also follows a stamp of its files:
+// the partition manifest for sales and the vehicle store for vehicles. The
+// stamp holds each file's size, inode and nanosecond modification and change
+// times, and a per-table write counter in tourmate.generations that every
+// stored change bumps under a file lock. A change made elsewhere is noticed
+// at the next lookup, however soon after this process's own write it lands.
+
+// Table generations a result was computed from
+struct TableGenerations {
+    unsigned long long vehicles;
+    unsigned long long sales;
+};
+
+// Tables a cached result depends on
+const unsigned DEPENDS_ON_VEHICLES = 1;
+const unsigned DEPENDS_ON_SALES = 2;
+
+// Current generations, after dropping the in-memory tables of any table
+// another process has changed. Read them before computing a result to be
+// cached, so a change stored while it is computed leaves the entry already stale.
+TableGenerations currentTableGenerations();
+
+// Bump a table's generation (TX_VEHICLES or TX_SALES) once its in-memory copy
+// changed (a reset), and stamp its files as they are now
+void noteTableChanged(char table);
+
+// Bump a table's generation and its shared write counter once a change to it
+// is stored, and stamp its files as this process left them, unless another
+// process has written to the table since this one last looked
+void noteTableStored(char table);
+
+// True if the table's files have changed since this process last stored to
+// or checked them, bumping its generation if so. Always false on a thread
+// reading another branch's directory.
+bool tableFilesChanged(char table);
+
+// query_cache_size and query_cache_rows
+size_t resultCacheCapacity();
+size_t resultCacheRowLimit();
+
+// False on a thread reading another branch's directory: generations only
+// track the working directory's tables
+bool resultCachingAllowed();
+
+// Count a lookup towards the hit rate shown under Company Details
+void noteResultCacheLookup(bool hit);
+
+// Print lookups, hits and the hit rate since startup
+void printResultCacheStats();
+
+// True if a result computed from 'generations' is still current for 'tables'
+bool generationsCurrent(unsigned tables, const TableGenerations& generations, const TableGenerations& now);
+
+// One LRU cache of results of one type
+template <class Value>
+class ResultCache {
+private:
+    struct Entry {
+        string key;
+        unsigned tables;
+        TableGenerations generations;
+        shared_ptr<const Value> value;
+    };
+
+    mutex lock;
+    list<Entry> entries;  // Most recently used first
+    unordered_map<string, typename list<Entry>::iterator> byKey;
+
+public:
+    // Cached result for a key, or null if there is none or it is stale
+    shared_ptr<const Value> find(const string& key) {
+        if (resultCacheCapacity() == 0 || !resultCachingAllowed()) {
+            return nullptr;
+        }
+
+        TableGenerations now = currentTableGenerations();
+        lock_guard<mutex> guard(lock);
+        auto found = byKey.find(key);
+
+        if (found == byKey.end()) {
+            noteResultCacheLookup(false);
+            return nullptr;
+        }
+        if (!generationsCurrent(found->second->tables, found->second->generations, now)) {
+            entries.erase(found->second);
+            byKey.erase(found);
+            noteResultCacheLookup(false);
+            return nullptr;
+        }
+
+        entries.splice(entries.begin(), entries, found->second);
+        noteResultCacheLookup(true);
+        return found->second->value;
+    }
+
+    // Keep a result computed from 'generations' unless it has more than
+    // query_cache_rows rows. Returns the result either way.
+    shared_ptr<const Value> store(const string& key, unsigned tables, const TableGenerations& generations,
+                                  size_t rows, Value value) {
+        shared_ptr<const Value> shared = make_shared<const Value>(move(value));
+        size_t capacity = resultCacheCapacity();
+
+        if (capacity == 0 || rows > resultCacheRowLimit() || !resultCachingAllowed()) {
+            return shared;
+        }
+
+        lock_guard<mutex> guard(lock);
+        auto found = byKey.find(key);
+        if (found != byKey.end()) {
+            entries.erase(found->second);
+            byKey.erase(found);
+        }
+
+        entries.push_front({key, tables, generations, shared});
+        byKey[key] = entries.begin();
+
+        while (entries.size() > capacity) {
+            byKey.erase(entries.back().key);
+            entries.pop_back();
+        }
+        return shared;
+    }
+};
+
+#endif // RESULTCACHE_H
@@ -0,0 +1,26 @@
+#ifndef RETURNS_H
+#define RETURNS_H
+
+#include <string>
+
+using namespace std;
+
+// Outcome of an end-of-day return sweep
+struct ReturnSweep {
+    long long rented;      // Vehicles marked Rented before the sweep
+    long long returned;    // Set back to Available
+    long long stillOut;    // Latest rental has not ended yet
+    long long unknown;     // No sale, or no valid end date, to go by
+    bool committed;        // False if the changes could not be written
+};
+
+// Set every Rented vehicle whose latest rental ended before asOfDay back to
+// Available. Finds each rented vehicle's latest end date in one pass over the
+// sales, then commits all the status changes as one transaction: one log
+// write and one append to the vehicle store.
+ReturnSweep returnDueVehicles(int asOfDay);
+
+// Interactive return sweep (asks for the as-of date, default today)
+void returnDueVehiclesMenu();
+
+#endif // RETURNS_H
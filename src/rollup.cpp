@@ -0,0 +1,426 @@
+#include "rollup.h"
+#include "dates.h"
+#include "trace.h"
+#include "profile.h"
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <cmath>
+#include <mutex>
+
+using namespace std;
+
+// Constructor
+RevenueTotals::RevenueTotals() {
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        revenueCents[i] = 0;
+        count[i] = 0;
+    }
+}
+
+long long RevenueTotals::totalRevenueCents() const {
+    return revenueCents[BUCKET_PAID] + revenueCents[BUCKET_PENDING] + revenueCents[BUCKET_OTHER];
+}
+
+long long RevenueTotals::totalCount() const {
+    return count[BUCKET_PAID] + count[BUCKET_PENDING] + count[BUCKET_OTHER];
+}
+
+RevenueTotals& RevenueTotals::operator+=(const RevenueTotals& other) {
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        revenueCents[i] += other.revenueCents[i];
+        count[i] += other.count[i];
+    }
+    return *this;
+}
+
+RevenueTotals RevenueTotals::operator-(const RevenueTotals& other) const {
+    RevenueTotals result = *this;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        result.revenueCents[i] -= other.revenueCents[i];
+        result.count[i] -= other.count[i];
+    }
+    return result;
+}
+
+// Map a payment status string to its rollup bucket
+PaymentBucket paymentBucketFor(const string& paymentStatus) {
+    if (paymentStatus == "Paid") {
+        return BUCKET_PAID;
+    } else if (paymentStatus == "Pending") {
+        return BUCKET_PENDING;
+    }
+    return BUCKET_OTHER;
+}
+
+// Days that get dense buckets: 1970-01-01 to 2099-12-31
+static const int DENSE_FIRST_DAY = 0;
+static const int DENSE_LAST_DAY = dateToDayNumber("2099-12-31");
+
+// Constructor
+RevenueRollup::RevenueRollup() {
+    clear();
+}
+
+// Drop all buckets
+void RevenueRollup::clear() {
+    firstDay = 0;
+    buckets.clear();
+    prefix.assign(1, RevenueTotals());
+    dirtyFrom = 0;
+    outliers.clear();
+    outlierCount = 0;
+    undatedCount = 0;
+    loaded = false;
+}
+
+// Add one sale to its day bucket
+void RevenueRollup::addSale(const Sales& sale) {
+    int day = dateToDayNumber(sale.getStartDate());
+
+    if (day == INVALID_DAY) {
+        undatedCount++;
+        return;
+    }
+
+    PaymentBucket bucket = paymentBucketFor(sale.getPaymentStatus());
+    long long cents = llround(sale.getAmount() * 100.0);
+
+    if (day < DENSE_FIRST_DAY || day > DENSE_LAST_DAY) {
+        RevenueTotals& totals = outliers[day];
+        totals.revenueCents[bucket] += cents;
+        totals.count[bucket]++;
+        outlierCount++;
+        return;
+    }
+
+    if (buckets.empty()) {
+        firstDay = day;
+        buckets.resize(1);
+    } else if (day < firstDay) {
+        // Grow the bucket array towards the past
+        buckets.insert(buckets.begin(), firstDay - day, RevenueTotals());
+        firstDay = day;
+        dirtyFrom = 0;
+    } else if (day - firstDay >= (int)buckets.size()) {
+        buckets.resize(day - firstDay + 1);
+    }
+
+    size_t index = day - firstDay;
+    buckets[index].revenueCents[bucket] += cents;
+    buckets[index].count[bucket]++;
+
+    // Only prefix entries after this bucket are affected
+    if (index < dirtyFrom) {
+        dirtyFrom = index;
+    }
+}
+
+// Rebuild prefix sums from the first bucket that changed
+void RevenueRollup::refreshPrefix() {
+    prefix.resize(buckets.size() + 1);
+
+    for (size_t i = dirtyFrom; i < buckets.size(); i++) {
+        prefix[i + 1] = prefix[i];
+        prefix[i + 1] += buckets[i];
+    }
+
+    dirtyFrom = buckets.size();
+}
+
+// Totals for the inclusive day range [fromDay, toDay]
+RevenueTotals RevenueRollup::rangeTotals(int fromDay, int toDay) {
+    RevenueTotals totals;
+
+    for (auto outlier = outliers.lower_bound(fromDay); outlier != outliers.end() && outlier->first <= toDay; ++outlier) {
+        totals += outlier->second;
+    }
+
+    if (buckets.empty()) {
+        return totals;
+    }
+
+    if (fromDay < firstDay) {
+        fromDay = firstDay;
+    }
+    int lastDay = firstDay + (int)buckets.size() - 1;
+    if (toDay > lastDay) {
+        toDay = lastDay;
+    }
+    if (fromDay > toDay) {
+        return totals;
+    }
+
+    if (dirtyFrom < buckets.size()) {
+        refreshPrefix();
+    }
+
+    totals += prefix[toDay - firstDay + 1] - prefix[fromDay - firstDay];
+    return totals;
+}
+
+// Each day in [fromDay, toDay] that has sales, in day order
+void RevenueRollup::dailyTotals(int fromDay, int toDay, vector<pair<int, RevenueTotals>>& days) const {
+    auto outlier = outliers.lower_bound(fromDay);
+    days.clear();
+
+    // Outliers before the dense buckets, then the buckets, then the later outliers
+    for (; outlier != outliers.end() && outlier->first <= toDay && (buckets.empty() || outlier->first < firstDay);
+         ++outlier) {
+        days.push_back(*outlier);
+    }
+
+    if (!buckets.empty()) {
+        int first = fromDay < firstDay ? firstDay : fromDay;
+        int lastDay = firstDay + (int)buckets.size() - 1;
+        int last = toDay > lastDay ? lastDay : toDay;
+        for (int day = first; day <= last; day++) {
+            const RevenueTotals& totals = buckets[day - firstDay];
+            if (totals.totalCount() > 0) {
+                days.push_back(make_pair(day, totals));
+            }
+        }
+    }
+
+    for (; outlier != outliers.end() && outlier->first <= toDay; ++outlier) {
+        days.push_back(*outlier);
+    }
+}
+
+// Getters
+bool RevenueRollup::isEmpty() const {
+    return buckets.empty() && outliers.empty();
+}
+
+int RevenueRollup::getFirstDay() const {
+    if (buckets.empty() && !outliers.empty()) {
+        return outliers.begin()->first;
+    }
+    return firstDay;
+}
+
+int RevenueRollup::getLastDay() const {
+    if (buckets.empty() && !outliers.empty()) {
+        return outliers.rbegin()->first;
+    }
+    return firstDay + (int)buckets.size() - 1;
+}
+
+long long RevenueRollup::getOutlierCount() const {
+    return outlierCount;
+}
+
+long long RevenueRollup::getUndatedCount() const {
+    return undatedCount;
+}
+
+bool RevenueRollup::isLoaded() const {
+    return loaded;
+}
+
+void RevenueRollup::setLoaded(bool value) {
+    loaded = value;
+}
+
+// Shared rollup instance, guarded so a background prefetch can build it
+static RevenueRollup rollupInstance;
+static mutex rollupLock;
+
+// Lock the shared rollup, building it from file first if needed
+static unique_lock<mutex> lockLoadedRollup() {
+    refreshSalesCaches();
+    shared_lock<shared_mutex> appends(salesAppendLock(), defer_lock);
+    unique_lock<mutex> guard(rollupLock);
+    
+    if (!rollupInstance.isLoaded()) {
+        // Scan with appends held off, so no sale is counted twice
+        guard.unlock();
+        appends.lock();
+        guard.lock();
+    }
+    if (!rollupInstance.isLoaded()) {
+        ProfileSpan span("index", "buildSalesRollup");
+        rollupInstance.clear();
+        forEachSaleInFile([](const Sales& sale) {
+            rollupInstance.addSale(sale);
+        });
+        rollupInstance.setLoaded(true);
+    }
+    return guard;
+}
+
+// Summary of the shared rollup, building it first if needed
+RollupSummary salesRollup() {
+    unique_lock<mutex> guard = lockLoadedRollup();
+    RollupSummary summary = {rollupInstance.isEmpty(), 0, 0, rollupInstance.getOutlierCount(),
+                             rollupInstance.getUndatedCount()};
+    
+    if (!summary.empty) {
+        summary.firstDay = rollupInstance.getFirstDay();
+        summary.lastDay = rollupInstance.getLastDay();
+    }
+    return summary;
+}
+
+// Range totals of the shared rollup; the lazy prefix rebuild happens under the lock
+RevenueTotals rollupRangeTotals(int fromDay, int toDay) {
+    unique_lock<mutex> guard = lockLoadedRollup();
+    return rollupInstance.rangeTotals(fromDay, toDay);
+}
+
+// Monday-based week start for a day number (1970-01-01 was a Thursday)
+static int weekStart(int day) {
+    int weekday = ((day + 3) % 7 + 7) % 7;
+    return day - weekday;
+}
+
+// Periods with sales in a range of the shared rollup, all under one lock
+vector<pair<int, RevenueTotals>> rollupPeriodTotals(int fromDay, int toDay, RollupPeriod period) {
+    vector<pair<int, RevenueTotals>> days;
+    {
+        unique_lock<mutex> guard = lockLoadedRollup();
+        rollupInstance.dailyTotals(fromDay, toDay, days);
+    }
+    if (period == PERIOD_DAY) {
+        return days;
+    }
+
+    vector<pair<int, RevenueTotals>> periods;
+    for (const auto& day : days) {
+        int start = period == PERIOD_WEEK ? weekStart(day.first) : firstDayOfMonth(day.first);
+        if (start < fromDay) {
+            start = fromDay;
+        }
+        if (periods.empty() || periods.back().first != start) {
+            periods.push_back(make_pair(start, RevenueTotals()));
+        }
+        periods.back().second += day.second;
+    }
+    return periods;
+}
+
+// Keep the shared rollup current after a sale is recorded
+void updateSalesRollup(const Sales& sale) {
+    lock_guard<mutex> guard(rollupLock);
+    
+    // Nothing to do until someone asks for a rollup; it will be built from file then
+    if (rollupInstance.isLoaded()) {
+        rollupInstance.addSale(sale);
+    }
+}
+
+// Drop the shared rollup (it is rebuilt on next use)
+void resetSalesRollup() {
+    lock_guard<mutex> guard(rollupLock);
+    rollupInstance.clear();
+}
+
+static void printRollupHeader(const string& periodLabel) {
+    cout << left << setw(12) << periodLabel
+         << right << setw(8) << "Sales"
+         << setw(8) << "Paid"
+         << setw(9) << "Pending"
+         << setw(15) << "Received($)"
+         << setw(15) << "Pending($)"
+         << setw(15) << "Total($)" << endl;
+    cout << string(82, '-') << endl;
+}
+
+static void printRollupRow(const string& period, const RevenueTotals& totals) {
+    cout << left << setw(12) << period
+         << right << setw(8) << totals.totalCount()
+         << setw(8) << totals.count[BUCKET_PAID]
+         << setw(9) << totals.count[BUCKET_PENDING]
+         << fixed << setprecision(2)
+         << setw(15) << totals.revenueCents[BUCKET_PAID] / 100.0
+         << setw(15) << totals.revenueCents[BUCKET_PENDING] / 100.0
+         << setw(15) << totals.totalRevenueCents() / 100.0 << endl;
+}
+
+// Interactive revenue rollup screen (daily, weekly, monthly, date range)
+void displayRevenueRollups() {
+    RollupSummary rollup = salesRollup();
+
+    if (rollup.empty) {
+        cout << "No dated sales available for revenue rollups." << endl;
+        return;
+    }
+
+    int option;
+
+    cout << "\n===== REVENUE ROLLUPS =====\n";
+    cout << "Sales on record from " << dayNumberToDate(rollup.firstDay)
+         << " to " << dayNumberToDate(rollup.lastDay) << endl;
+    cout << "1. Date Range Totals\n";
+    cout << "2. Daily Revenue\n";
+    cout << "3. Weekly Revenue\n";
+    cout << "4. Monthly Trend\n";
+    cout << "Enter your choice: ";
+
+    if (!(cin >> option)) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid input. Please enter a number." << endl;
+        return;
+    }
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+
+    if (option < 1 || option > 4) {
+        cout << "Invalid rollup option." << endl;
+        return;
+    }
+
+    int fromDay = readOptionalDay("From Date (YYYY-MM-DD, Enter for earliest): ", rollup.firstDay);
+    int toDay = readOptionalDay("To Date (YYYY-MM-DD, Enter for latest): ", rollup.lastDay);
+
+    if (fromDay > toDay) {
+        cout << "From date must not be after to date." << endl;
+        return;
+    }
+
+    traceOperation("report.rollup", to_string(option) + "|" + dayNumberToDate(fromDay) + "|" + dayNumberToDate(toDay));
+    cout << endl;
+
+    switch (option) {
+        case 1: {
+            RevenueTotals totals = rollupRangeTotals(fromDay, toDay);
+            cout << "Period: " << dayNumberToDate(fromDay) << " to " << dayNumberToDate(toDay) << endl;
+            cout << "Total Number of Sales: " << totals.totalCount() << endl;
+            cout << "Paid Sales: " << totals.count[BUCKET_PAID] << endl;
+            cout << "Pending Payments: " << totals.count[BUCKET_PENDING] << endl;
+            cout << "Other Status: " << totals.count[BUCKET_OTHER] << endl;
+            cout << "Total Sales Amount: $" << fixed << setprecision(2) << totals.totalRevenueCents() / 100.0 << endl;
+            cout << "Total Amount Received: $" << fixed << setprecision(2) << totals.revenueCents[BUCKET_PAID] / 100.0 << endl;
+            cout << "Total Amount Pending: $" << fixed << setprecision(2) << totals.revenueCents[BUCKET_PENDING] / 100.0 << endl;
+            break;
+        }
+        case 2:
+            // Only periods with sales, so long ranges stay readable
+            printRollupHeader("Day");
+            for (const auto& day : rollupPeriodTotals(fromDay, toDay, PERIOD_DAY)) {
+                printRollupRow(dayNumberToDate(day.first), day.second);
+            }
+            break;
+        case 3:
+            printRollupHeader("Week of");
+            for (const auto& week : rollupPeriodTotals(fromDay, toDay, PERIOD_WEEK)) {
+                printRollupRow(dayNumberToDate(week.first), week.second);
+            }
+            break;
+        case 4:
+            printRollupHeader("Month");
+            for (const auto& month : rollupPeriodTotals(fromDay, toDay, PERIOD_MONTH)) {
+                printRollupRow(dayNumberToMonth(month.first), month.second);
+            }
+            break;
+    }
+
+    if (rollup.undatedCount > 0) {
+        cout << "\nNote: " << rollup.undatedCount
+             << " sale(s) without a valid YYYY-MM-DD start date are not included." << endl;
+    }
+    if (rollup.outlierCount > 0) {
+        cout << "Note: " << rollup.outlierCount
+             << " sale(s) dated before 1970 or after 2099 are only counted when the range covers their date." << endl;
+    }
+}
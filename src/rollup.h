@@ -0,0 +1,123 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include "sales.h"
+
+using namespace std;
+
+// Payment status buckets tracked by the revenue rollups
+enum PaymentBucket {
+    BUCKET_PAID = 0,
+    BUCKET_PENDING = 1,
+    BUCKET_OTHER = 2,
+    BUCKET_COUNT = 3
+};
+
+// Revenue (in cents, so prefix differences stay exact) and sale counts per payment bucket
+struct RevenueTotals {
+    long long revenueCents[BUCKET_COUNT];
+    long long count[BUCKET_COUNT];
+
+    RevenueTotals();
+
+    long long totalRevenueCents() const;
+    long long totalCount() const;
+
+    RevenueTotals& operator+=(const RevenueTotals& other);
+    RevenueTotals operator-(const RevenueTotals& other) const;
+};
+
+// Per-day revenue buckets keyed by sale start date, with prefix sums so any
+// date range total is two lookups instead of a scan of the sales history.
+// Only days from 1970 to 2099 get dense buckets; a sale dated outside them
+// (a typo like 0202-01-01 or 9999-12-31) goes into a sparse map instead, so
+// one bad date cannot stretch the buckets over centuries.
+class RevenueRollup {
+private:
+    int firstDay;                   // Day number of buckets[0]
+    vector<RevenueTotals> buckets;  // One bucket per calendar day
+    vector<RevenueTotals> prefix;   // prefix[i] = sum of buckets[0..i-1]
+    size_t dirtyFrom;               // First prefix entry that needs rebuilding
+    map<int, RevenueTotals> outliers;  // Days outside the dense range
+    long long outlierCount;
+    long long undatedCount;         // Sales whose start date could not be parsed
+    bool loaded;
+
+    void refreshPrefix();
+
+public:
+    // Constructor
+    RevenueRollup();
+
+    // Drop all buckets
+    void clear();
+
+    // Add one sale to its day bucket
+    void addSale(const Sales& sale);
+
+    // Totals for the inclusive day range [fromDay, toDay]
+    RevenueTotals rangeTotals(int fromDay, int toDay);
+
+    // Each day in [fromDay, toDay] that has sales, with its totals, in day order
+    void dailyTotals(int fromDay, int toDay, vector<pair<int, RevenueTotals>>& days) const;
+
+    // Getters. Empty means no dated sale at all; the first and last day are
+    // those of the dense buckets, or of the outliers if every sale is one.
+    bool isEmpty() const;
+    int getFirstDay() const;
+    int getLastDay() const;
+    long long getOutlierCount() const;
+    long long getUndatedCount() const;
+    bool isLoaded() const;
+
+    void setLoaded(bool value);
+};
+
+// Map a payment status string to its rollup bucket
+PaymentBucket paymentBucketFor(const string& paymentStatus);
+
+// Extent of the shared rollup, copied while its lock is held
+struct RollupSummary {
+    bool empty;             // No dated sale, in the dense buckets or among the outliers
+    int firstDay;
+    int lastDay;
+    long long outlierCount;
+    long long undatedCount;
+};
+
+// The shared rollup over all sales is built from file on first use and only
+// read or changed under its lock; callers get copies, never the rollup itself.
+
+// Summary of the shared rollup, building it first if needed
+RollupSummary salesRollup();
+
+// Totals of the shared rollup for the inclusive day range [fromDay, toDay]
+RevenueTotals rollupRangeTotals(int fromDay, int toDay);
+
+// Periods the rollup views total by
+enum RollupPeriod {
+    PERIOD_DAY,
+    PERIOD_WEEK,    // Monday to Sunday
+    PERIOD_MONTH
+};
+
+// Totals of the shared rollup for each period in [fromDay, toDay] that has
+// sales, in day order, keyed by the period's first day within the range
+// (one lock for the whole range)
+vector<pair<int, RevenueTotals>> rollupPeriodTotals(int fromDay, int toDay, RollupPeriod period);
+
+// Keep the shared rollup current after a sale is stored (appendSalesToFile
+// calls it with salesAppendLock held)
+void updateSalesRollup(const Sales& sale);
+
+// Drop the shared rollup (it is rebuilt from file on next use)
+void resetSalesRollup();
+
+// Interactive revenue rollup screen (daily, weekly, monthly, date range)
+void displayRevenueRollups();
+
+#endif // ROLLUP_H
@@ -1,5 +1,22 @@
 #include "sales.h"
 #include "vehicle.h"
+#include "rollup.h"
+#include "dates.h"
+#include "partition.h"
+#include "fileutil.h"
+#include "bktree.h"
+#include "salesindex.h"
+#include "salestrees.h"
+#include "query.h"
+#include "arena.h"
+#include "config.h"
+#include "txlog.h"
+#include "trace.h"
+#include "profile.h"
+#include "changelog.h"
+#include "replica.h"
+#include "resultcache.h"
+#include "customers.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -7,6 +24,10 @@
 #include <limits>
 #include <algorithm>
 #include <ctime>
+#include <map>
+#include <unordered_map>
+#include <cstdio>
+#include <mutex>
 
 using namespace std;
 
@@ -36,27 +57,27 @@ Sales::Sales() {
 }
 
 // Getters
-string Sales::getSaleId() const {
+const string& Sales::getSaleId() const {
     return saleId;
 }
 
-string Sales::getVehicleId() const {
+const string& Sales::getVehicleId() const {
     return vehicleId;
 }
 
-string Sales::getCustomerName() const {
+const string& Sales::getCustomerName() const {
     return customerName;
 }
 
-string Sales::getCustomerContact() const {
+const string& Sales::getCustomerContact() const {
     return customerContact;
 }
 
-string Sales::getStartDate() const {
+const string& Sales::getStartDate() const {
     return startDate;
 }
 
-string Sales::getEndDate() const {
+const string& Sales::getEndDate() const {
     return endDate;
 }
 
@@ -64,7 +85,7 @@ double Sales::getAmount() const {
     return amount;
 }
 
-string Sales::getPaymentStatus() const {
+const string& Sales::getPaymentStatus() const {
     return paymentStatus;
 }
 
@@ -115,99 +136,446 @@ void Sales::displayDetails() const {
 
 // String representation for file storage
 string Sales::toString() const {
-    ostringstream oss;
-    oss << saleId << "|" << vehicleId << "|" << customerName << "|" 
-        << customerContact << "|" << startDate << "|" << endDate << "|" 
-        << amount << "|" << paymentStatus;
-    return oss.str();
+    return formatRecordText(*this);
 }
 
 // Create sales from string (read from file)
-Sales Sales::fromString(string str) {
+Sales Sales::fromString(const string& str) {
     Sales sale;
-    stringstream ss(str);
-    string token;
-    
-    // Parse sale ID
-    if (getline(ss, token, '|')) {
-        sale.setSaleId(token);
+    parseRecordText(str, sale);
+    return sale;
+}
+
+// Overwrite every field from a view, reusing this object's string buffers
+void Sales::assign(const SalesView& view) {
+    assignRecordFields(*this, view);
+}
+
+SalesView::SalesView() : values() {
+    get<schemaFieldIndex<Sales>("payment")>(values) = "Pending";
+}
+
+// Parse one record; fields the line does not have keep their defaults
+void SalesView::parse(string_view line) {
+    *this = SalesView();
+    parseRecordText(line, *this);
+}
+
+// Arena mode (the default) loads each partition file as one block and hands
+// out views into it; record_arena=false reads line by line instead
+static bool recordArenaEnabled() {
+    static bool enabled = getConfigBool("record_arena", true);
+    return enabled;
+}
+
+// Visit every record of one sales file as a view, with the byte offset of
+// the record in the file
+template <class Visit>
+static void scanSalesFile(const string& fileName, RecordArena& arena, const Visit& visit) {
+    ProfileSpan span("parse", "scanSalesFile");
+    SalesView view;
+    
+    if (recordArenaEnabled()) {
+        string_view contents;
+        string_view line;
+        size_t offset = 0;
+        
+        if (!readFileIntoArena(fileName, arena, contents)) {
+            return;
+        }
+        size_t start = offset;
+        while (nextLine(contents, offset, line)) {
+            if (!line.empty()) {
+                view.parse(line);
+                visit(view, (uint64_t)start);
+            }
+            start = offset;
+        }
+        arena.reset();
+        return;
     }
     
-    // Parse vehicle ID
-    if (getline(ss, token, '|')) {
-        sale.setVehicleId(token);
-    }
+    ifstream file(fileName, ios::binary);
+    string line;
+    uint64_t start = 0;
     
-    // Parse customer name
-    if (getline(ss, token, '|')) {
-        sale.setCustomerName(token);
+    while (getline(file, line)) {
+        uint64_t next = start + line.size() + 1;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty()) {
+            view.parse(line);
+            visit(view, start);
+        }
+        start = next;
+    }
+}
+
+// Stream one partition file as views
+void forEachSaleViewInPartition(const string& key, const function<void(const SalesView&)>& visit) {
+    RecordArena arena;
+    scanSalesFile(salesPartitionFile(key), arena, [&visit](const SalesView& view, uint64_t) { visit(view); });
+}
+
+// Stream every partition as views, reusing one arena block between files.
+// Read-only data that was never split is streamed from its sales.txt.
+bool forEachSaleViewInFile(const function<void(const SalesView&)>& visit) {
+    vector<SalesPartition> partitions = loadSalesManifest();
+    RecordArena arena;
+    
+    string legacyFile = partitions.empty() ? unmigratedSalesFile() : "";
+    if (!legacyFile.empty()) {
+        scanSalesFile(legacyFile, arena, [&visit](const SalesView& view, uint64_t) { visit(view); });
+        return true;
     }
     
-    // Parse customer contact
-    if (getline(ss, token, '|')) {
-        sale.setCustomerContact(token);
+    for (const auto& partition : partitions) {
+        scanSalesFile(salesPartitionFile(partition.key), arena,
+                      [&visit](const SalesView& view, uint64_t) { visit(view); });
     }
     
-    // Parse start date
-    if (getline(ss, token, '|')) {
-        sale.setStartDate(token);
+    return !partitions.empty();
+}
+
+// Stream every partition with each record's byte offset in its partition file
+bool forEachSaleInFileWithOffsets(const function<void(const Sales&, uint64_t)>& visit) {
+    vector<SalesPartition> partitions = loadSalesManifest();
+    RecordArena arena;
+    Sales sale;
+    
+    for (const auto& partition : partitions) {
+        scanSalesFile(salesPartitionFile(partition.key), arena, [&sale, &visit](const SalesView& view, uint64_t offset) {
+            sale.assign(view);
+            visit(sale, offset);
+        });
     }
     
-    // Parse end date
-    if (getline(ss, token, '|')) {
-        sale.setEndDate(token);
+    return !partitions.empty();
+}
+
+// Read sales by byte offset from one partition file. Nothing is visited
+// unless every record found carries the expected sale ID.
+bool readSalesAtOffsets(const string& key, const vector<pair<uint64_t, string>>& records,
+                        const function<void(const Sales&)>& visit) {
+    return readSalesAtOffsets(key, records, [](const Sales& sale) { return sale.getSaleId(); }, visit);
+}
+
+// Same, checking each record against a key computed from it
+bool readSalesAtOffsets(const string& key, const vector<pair<uint64_t, string>>& records,
+                        const function<string(const Sales&)>& keyOf, const function<void(const Sales&)>& visit) {
+    ProfileSpan span("file", "readSalesAtOffsets");
+    ifstream file(salesPartitionFile(key), ios::binary);
+    vector<Sales> found;
+    string line;
+    
+    if (!file.is_open()) {
+        return false;
     }
     
-    // Parse amount
-    if (getline(ss, token, '|')) {
-        sale.setAmount(stod(token));
+    found.reserve(records.size());
+    for (const auto& record : records) {
+        file.clear();
+        file.seekg((streamoff)record.first);
+        if (!getline(file, line)) {
+            return false;
+        }
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        found.push_back(Sales::fromString(line));
+        if (keyOf(found.back()) != record.second) {
+            return false;
+        }
     }
     
-    // Parse payment status
-    if (getline(ss, token, '|')) {
-        sale.setPaymentStatus(token);
+    for (const auto& sale : found) {
+        visit(sale);
     }
+    return true;
+}
+
+// Stream one partition file. The same Sales object is refilled for every
+// record, so visitors must copy it to keep it.
+void forEachSaleInPartition(const string& key, const function<void(const Sales&)>& visit) {
+    Sales sale;
     
-    return sale;
+    forEachSaleViewInPartition(key, [&sale, &visit](const SalesView& view) {
+        sale.assign(view);
+        visit(sale);
+    });
+}
+
+// Fuzzy customer name index. Postings are "partitionKey|saleId" so matched
+// sales can be read back from just the partitions that hold them. Every read
+// and write holds customerNameIndexLock.
+static FuzzyIndex customerNameIndex;
+static mutex customerNameIndexLock;
+
+static string customerPosting(const Sales& sale) {
+    return salesPartitionKey(sale) + "|" + sale.getSaleId();
+}
+
+// Search the index, building it first if needed
+static vector<FuzzyMatch> searchCustomerIndex(const string& searchTerm, int maxDistance) {
+    refreshSalesCaches();
+    shared_lock<shared_mutex> appends(salesAppendLock(), defer_lock);
+    unique_lock<mutex> guard(customerNameIndexLock);
+    if (!customerNameIndex.isLoaded()) {
+        // Scan with appends held off
+        guard.unlock();
+        appends.lock();
+        guard.lock();
+    }
+    if (!customerNameIndex.isLoaded()) {
+        ProfileSpan span("index", "buildCustomerNameIndex");
+        forEachSaleInFile([](const Sales& sale) {
+            customerNameIndex.add(customerPosting(sale), sale.getCustomerName());
+        });
+        customerNameIndex.setLoaded(true);
+    }
+    return customerNameIndex.search(searchTerm, maxDistance);
 }
 
 // Load sales from file
 vector<Sales> loadSalesFromFile() {
+    ProfileSpan span("file", "loadSalesFromFile");
     vector<Sales> sales;
-    ifstream file("sales.txt");
-    string line;
     
-    if (file.is_open()) {
-        while (getline(file, line)) {
-            if (!line.empty()) {
-                Sales sale = Sales::fromString(line);
-                sales.push_back(sale);
-            }
+    bool found = forEachSaleInFile([&sales](const Sales& sale) {
+        sales.push_back(sale);
+    });
+    
+    if (!found) {
+        cout << "Warning: No sales files found. A new file will be created when sales are added." << endl;
+    }
+    
+    return sales;
+}
+
+// Stream sales from file one record at a time without keeping them in memory
+bool forEachSaleInFile(const function<void(const Sales&)>& visit) {
+    Sales sale;
+    
+    return forEachSaleViewInFile([&sale, &visit](const SalesView& view) {
+        sale.assign(view);
+        visit(sale);
+    });
+}
+
+// Stream only the partitions that may hold rentals overlapping [fromDay, toDay].
+// Callers still filter individual records; undated sales are never visited.
+bool forEachSaleInDateRange(int fromDay, int toDay, const function<void(const Sales&)>& visit) {
+    vector<SalesPartition> partitions = loadSalesManifest();
+    RecordArena arena;
+    Sales sale;
+    
+    for (const auto& partition : partitions) {
+        if (partitionOverlaps(partition, fromDay, toDay)) {
+            scanSalesFile(salesPartitionFile(partition.key), arena, [&sale, &visit](const SalesView& view, uint64_t) {
+                sale.assign(view);
+                visit(sale);
+            });
+        }
+    }
+    
+    return !partitions.empty();
+}
+
+// Save sales to file (rewrites every partition)
+bool saveSalesToFile(const vector<Sales>& sales) {
+    ProfileSpan span("file", "saveSalesToFile");
+    UnloggedChange unlogged;
+    unique_lock<shared_mutex> appends(salesAppendLock());
+    vector<SalesPartition> oldPartitions = loadSalesManifest();
+    vector<SalesPartition> partitions;
+    map<string, vector<const Sales*>> byPartition;
+    
+    for (const auto& sale : sales) {
+        byPartition[salesPartitionKey(sale)].push_back(&sale);
+        notePartitionSale(partitions, sale);
+    }
+    
+    // Every partition is written out before any is replaced, so a failed
+    // write leaves the old table in place
+    bool ok = true;
+    for (const auto& entry : byPartition) {
+        string tempFile = salesPartitionFile(entry.first) + ".tmp";
+        ofstream file(tempFile);
+        
+        for (const auto* sale : entry.second) {
+            file << sale->toString() << '\n';
         }
         file.close();
-    } else {
-        cout << "Warning: Could not open sales.txt. A new file will be created when sales are added." << endl;
+        if (file.fail()) {
+            cout << "Error: Could not write " << tempFile << "." << endl;
+            ok = false;
+            break;
+        }
+    }
+    if (!ok) {
+        for (const auto& entry : byPartition) {
+            remove((salesPartitionFile(entry.first) + ".tmp").c_str());
+        }
+        return false;
     }
     
-    return sales;
+    for (const auto& entry : byPartition) {
+        string fileName = salesPartitionFile(entry.first);
+        if (!replaceFileDurably(fileName + ".tmp", fileName)) {
+            cout << "Error: Could not replace " << fileName << "." << endl;
+            ok = false;
+        }
+    }
+    
+    // The manifest is written only once every partition is in place
+    ok = ok && saveSalesManifest(partitions) && syncSalesPartitions(vector<string>());
+    
+    // Drop partitions that no longer hold any sales
+    if (ok) {
+        for (const auto& partition : oldPartitions) {
+            if (byPartition.find(partition.key) == byPartition.end()) {
+                remove(salesPartitionFile(partition.key).c_str());
+            }
+        }
+    }
+    
+    // Rebuilt from the new partitions on next use
+    {
+        lock_guard<mutex> guard(customerNameIndexLock);
+        customerNameIndex.clear();
+    }
+    resetSalesIndex();
+    invalidateSalesTrees();
+    noteTableStored(TX_SALES);
+    return ok;
+}
+
+// Appends against index and rollup builds
+shared_mutex& salesAppendLock() {
+    static shared_mutex lock;
+    return lock;
 }
 
-// Save sales to file
-void saveSalesToFile(const vector<Sales>& sales) {
-    ofstream file("sales.txt");
+// Append one sale to its month's partition only
+bool appendSaleToFile(const Sales& sale) {
+    return appendSalesToFile(vector<Sales>(1, sale));
+}
+
+// Append sales to their months' partitions: one write per partition and one
+// manifest update for the whole batch
+bool appendSalesToFile(const vector<Sales>& sales) {
+    ProfileSpan span("file", "appendSaleToFile");
+    unique_lock<shared_mutex> appends(salesAppendLock());
+    SalesTreeAppend trees;
+    vector<SalesPartition> partitions = loadSalesManifest();
+    map<string, vector<size_t>> byPartition;  // Positions in 'sales'
+    vector<TxChange> logged;
+    vector<uint64_t> offsets(sales.size(), 0);
     
-    if (file.is_open()) {
-        for (const auto& sale : sales) {
-            file << sale.toString() << endl;
+    for (size_t i = 0; i < sales.size(); i++) {
+        byPartition[salesPartitionKey(sales[i])].push_back(i);
+        logged.push_back({TX_SALES, CHANGE_INSERT, sales[i].toString()});
+    }
+    
+    for (const auto& entry : byPartition) {
+        string fileName = salesPartitionFile(entry.first);
+        ofstream file(fileName, ios::app | ios::binary);
+        
+        if (!file.is_open()) {
+            cout << "Error: Could not open " << fileName << " for writing." << endl;
+            return false;
         }
+        
+        // Note where each record lands so it can be read back by offset
+        file.seekp(0, ios::end);
+        uint64_t offset = (uint64_t)file.tellp();
+        string text;
+        for (size_t i : entry.second) {
+            offsets[i] = offset;
+            text += logged[i].record + '\n';
+            offset += logged[i].record.size() + 1;
+        }
+        file << text;
         file.close();
-    } else {
-        cout << "Error: Could not open sales.txt for writing." << endl;
+        if (file.fail()) {
+            cout << "Error: Could not write to " << fileName << "." << endl;
+            return false;
+        }
+    }
+    
+    for (const auto& sale : sales) {
+        notePartitionSale(partitions, sale);
+    }
+    bool saved = saveSalesManifest(partitions);
+    trees.stored(sales, offsets);
+    saved = logChanges(logged) && saved;
+    
+    for (size_t i = 0; i < sales.size(); i++) {
+        noteSaleStored(sales[i], offsets[i]);
+        updateSalesRollup(sales[i]);
     }
+    
+    lock_guard<mutex> guard(customerNameIndexLock);
+    for (const auto& sale : sales) {
+        if (customerNameIndex.isLoaded()) {
+            customerNameIndex.add(customerPosting(sale), sale.getCustomerName());
+        }
+    }
+    noteTableStored(TX_SALES);
+    return saved;
+}
+
+// Drop the sales indexes and rollup (rebuilt from file on next use)
+void resetSalesCaches() {
+    {
+        lock_guard<mutex> guard(customerNameIndexLock);
+        customerNameIndex.clear();
+    }
+    resetSalesIndex();
+    invalidateSalesTrees();
+    resetSalesRollup();
+    noteTableChanged(TX_SALES);
+}
+
+// Drop the sales indexes and rollup if another process changed the files
+void refreshSalesCaches() {
+    if (tableFilesChanged(TX_SALES)) {
+        resetSalesCaches();
+    }
+}
+
+// Number of stored sales, from the partition manifest
+long long countStoredSales() {
+    long long total = 0;
+    
+    for (const auto& partition : loadSalesManifest()) {
+        total += partition.rows;
+    }
+    
+    return total;
 }
 
-// View all sales
+// View all sales, in file order or sorted by a field
 void viewAllSales() {
+    string sortText, error;
+    SortOrder order;
+    
+    cout << "Sort by field, optionally with asc/desc (Enter for file order): ";
+    getline(cin, sortText);
+    if (!parseSalesSortOrder(sortText, order, error)) {
+        cout << "Invalid sort order: " << error << endl;
+        return;
+    }
+    
+    // Sorted listings go through an external sort instead of loading the table
+    if (!order.field.empty()) {
+        traceOperation("sale.list", order.field + (order.descending ? " desc" : ""));
+        printSortedSales(order);
+        return;
+    }
+    
+    traceOperation("sale.list");
     vector<Sales> sales = loadSalesFromFile();
     
     if (sales.empty()) {
@@ -227,7 +595,10 @@ void viewAllSales() {
 
 // Add a new sale
 void addSale() {
-    vector<Sales> sales = loadSalesFromFile();
+    if (refuseChangeOnReplica()) {
+        return;
+    }
+    
     vector<Vehicle> vehicles = loadVehiclesFromFile();
     Sales newSale;
     string input;
@@ -241,7 +612,7 @@ void addSale() {
     cout << "\n===== ADD NEW SALE =====\n";
     
     // Generate a sale ID
-    string saleId = "S" + to_string(sales.size() + 1);
+    string saleId = "S" + to_string(countStoredSales() + 1);
     newSale.setSaleId(saleId);
     
     // Show available vehicles
@@ -306,31 +677,88 @@ void addSale() {
     getline(cin, input);
     newSale.setPaymentStatus(input);
     
-    // Add the new sale to the vector
-    sales.push_back(newSale);
+    if (!commitBooking(newSale)) {
+        cout << "Error: The sale could not be recorded." << endl;
+        return;
+    }
+    traceOperation("sale.add", newSale.toString());
     
-    // Update vehicle status to 'Rented'
-    it->setStatus("Rented");
-    saveVehiclesToFile(vehicles);
+    cout << "\nSale added successfully with ID: " << saleId << endl;
+}
+
+// Store a sale and mark its vehicle 'Rented' as one transaction, so a crash
+// cannot leave one without the other
+bool commitBooking(const Sales& sale) {
+    ProfileSpan span("tx", "commitBooking");
+    vector<TxChange> changes;
+    Vehicle vehicle;
+    
+    if (findVehicleById(sale.getVehicleId(), vehicle)) {
+        vehicle.setStatus("Rented");
+        changes.push_back({TX_VEHICLES, CHANGE_UPDATE, vehicle.toString()});
+    }
+    changes.push_back({TX_SALES, CHANGE_INSERT, sale.toString()});
+    
+    return commitTransaction(changes);
+}
+
+// Fuzzy customer name lookup through the BK-tree index
+vector<FuzzyMatch> findCustomersFuzzy(const string& searchTerm, int maxDistance) {
+    ProfileSpan span("index", "findCustomersFuzzy");
+    return searchCustomerIndex(searchTerm, maxDistance);
+}
+
+// Ranked fuzzy customer name search through the BK-tree index
+static void searchSalesFuzzy(const string& searchTerm, int maxDistance) {
+    traceOperation("sale.fuzzy", searchTerm + "|" + to_string(maxDistance));
+    vector<FuzzyMatch> matches = findCustomersFuzzy(searchTerm, maxDistance);
     
-    // Save the updated sales to file
-    saveSalesToFile(sales);
+    if (matches.empty()) {
+        cout << "\nNo customers within " << maxDistance << " edit(s) of \"" << searchTerm << "\"." << endl;
+        return;
+    }
     
-    cout << "\nSale added successfully with ID: " << saleId << endl;
+    // Read back only the partitions holding matched sales
+    map<string, unordered_map<string, Sales>> wanted;
+    for (const auto& match : matches) {
+        for (const auto& posting : match.ids) {
+            size_t bar = posting.find('|');
+            wanted[posting.substr(0, bar)][posting.substr(bar + 1)] = Sales();
+        }
+    }
+    
+    for (auto& partition : wanted) {
+        auto& salesById = partition.second;
+        forEachSaleInPartition(partition.first, [&salesById](const Sales& sale) {
+            auto it = salesById.find(sale.getSaleId());
+            if (it != salesById.end()) {
+                it->second = sale;
+            }
+        });
+    }
+    
+    cout << "\nSearch Results (closest first):\n";
+    
+    for (const auto& match : matches) {
+        cout << "\n\"" << match.term << "\" (distance " << match.distance << ", "
+             << match.ids.size() << " sale(s))" << endl;
+        for (const auto& posting : match.ids) {
+            size_t bar = posting.find('|');
+            cout << "------------------------" << endl;
+            wanted[posting.substr(0, bar)][posting.substr(bar + 1)].displayDetails();
+        }
+    }
 }
 
 // Search for sales
 void searchSales() {
-    vector<Sales> sales = loadSalesFromFile();
-    
-    if (sales.empty()) {
+    if (countStoredSales() == 0) {
         cout << "No sales found in the system." << endl;
         return;
     }
     
     int searchOption;
     string searchTerm;
-    bool found = false;
     
     cout << "\n===== SEARCH SALES =====\n";
     cout << "Search by:\n";
@@ -338,95 +766,168 @@ void searchSales() {
     cout << "2. Vehicle ID\n";
     cout << "3. Customer Name\n";
     cout << "4. Payment Status\n";
+    cout << "5. Start Date Range\n";
+    cout << "6. Customer Name (fuzzy, tolerates typos)\n";
+    cout << "7. Combined Query\n";
+    cout << "8. Customer History\n";
     cout << "Enter your choice: ";
     
     cin >> searchOption;
     cin.ignore(numeric_limits<streamsize>::max(), '\n');
     
-    cout << "Enter search term: ";
-    getline(cin, searchTerm);
+    if (searchOption < 1 || searchOption > 8) {
+        cout << "Invalid search option." << endl;
+        return;
+    }
     
-    cout << "\nSearch Results:\n";
+    if (searchOption == 8) {
+        customerHistory();
+        return;
+    }
     
-    for (const auto& sale : sales) {
-        bool match = false;
+    Query query;
+    string error;
+    
+    if (searchOption == 7) {
+        printQueryHelp();
+        cout << "Enter query: ";
+        getline(cin, searchTerm);
+        if (!parseSalesQuery(searchTerm, query, error)) {
+            cout << "Invalid query: " << error << endl;
+            return;
+        }
+        printSalesQuery(query, false);
+        return;
+    }
+    
+    if (searchOption == 6) {
+        cout << "Enter customer name: ";
+        getline(cin, searchTerm);
+        searchSalesFuzzy(searchTerm, readMaxEditDistance(2));
+        return;
+    }
+    
+    if (searchOption == 5) {
+        // Date range searches only open the partitions for the months involved
+        int fromDay = readOptionalDay("From Date (YYYY-MM-DD): ", INVALID_DAY);
+        int toDay = readOptionalDay("To Date (YYYY-MM-DD, Enter for same day): ", fromDay);
+        
+        if (fromDay == INVALID_DAY || fromDay > toDay) {
+            cout << "Invalid date range." << endl;
+            return;
+        }
+        
+        addSalesPredicate(query, "start", OP_GE, dayNumberToDate(fromDay), error);
+        addSalesPredicate(query, "start", OP_LE, dayNumberToDate(toDay), error);
+    } else {
+        cout << "Enter search term: ";
+        getline(cin, searchTerm);
         
         switch (searchOption) {
             case 1: // Sale ID
-                match = sale.getSaleId() == searchTerm;
+                addSalesPredicate(query, "id", OP_EQ, searchTerm, error);
                 break;
             case 2: // Vehicle ID
-                match = sale.getVehicleId() == searchTerm;
+                addSalesPredicate(query, "vehicle", OP_EQ, searchTerm, error);
                 break;
             case 3: // Customer Name
-                match = sale.getCustomerName().find(searchTerm) != string::npos;
+                addSalesPredicate(query, "customer", OP_CONTAINS, searchTerm, error);
                 break;
             case 4: // Payment Status
-                match = sale.getPaymentStatus() == searchTerm;
+                addSalesPredicate(query, "payment", OP_EQ, searchTerm, error);
                 break;
-            default:
-                cout << "Invalid search option." << endl;
-                return;
-        }
-        
-        if (match) {
-            found = true;
-            cout << "------------------------" << endl;
-            sale.displayDetails();
         }
     }
     
-    if (!found) {
-        cout << "No matching sales found." << endl;
-    }
+    printSalesQuery(query, false);
 }
 
-// Generate a sales report
-void generateSalesReport() {
-    vector<Sales> sales = loadSalesFromFile();
-    
-    if (sales.empty()) {
-        cout << "No sales data available for report generation." << endl;
-        return;
+// Totals and detail sections of the sales report
+struct SalesReportData {
+    size_t salesCount;
+    double totalAmount;
+    int paidCount;
+    int pendingCount;
+    double paidAmount;
+    double pendingAmount;
+    string details;  // DETAILED SALES and MONTHLY TREND sections of the report file
+};
+
+// Compute the sales report, or reuse it while no sale has been stored
+static shared_ptr<const SalesReportData> buildSalesReport() {
+    static ResultCache<SalesReportData> cache;
+    shared_ptr<const SalesReportData> cached = cache.find("sales");
+    if (cached) {
+        return cached;
     }
     
-    cout << "\n===== SALES REPORT =====\n";
-    
-    // Calculate total sales amount
-    double totalAmount = 0.0;
-    int paidCount = 0;
-    int pendingCount = 0;
+    TableGenerations generations = currentTableGenerations();
+    vector<Sales> sales = loadSalesFromFile();
+    SalesReportData report = {sales.size(), 0.0, 0, 0, 0.0, 0.0, ""};
     
     for (const auto& sale : sales) {
-        totalAmount += sale.getAmount();
+        report.totalAmount += sale.getAmount();
         
         if (sale.getPaymentStatus() == "Paid") {
-            paidCount++;
+            report.paidCount++;
+            report.paidAmount += sale.getAmount();
         } else if (sale.getPaymentStatus() == "Pending") {
-            pendingCount++;
+            report.pendingCount++;
+            report.pendingAmount += sale.getAmount();
         }
     }
     
-    // Display report
-    cout << "Total Number of Sales: " << sales.size() << endl;
-    cout << "Total Sales Amount: $" << fixed << setprecision(2) << totalAmount << endl;
-    cout << "Paid Sales: " << paidCount << endl;
-    cout << "Pending Payments: " << pendingCount << endl;
+    if (!sales.empty()) {
+        ostringstream details;
+        details << fixed << setprecision(2);
+        details << "DETAILED SALES:\n";
+        for (const auto& sale : sales) {
+            details << "------------------------\n";
+            details << "Sale ID: " << sale.getSaleId() << "\n";
+            details << "Vehicle ID: " << sale.getVehicleId() << "\n";
+            details << "Customer: " << sale.getCustomerName() << "\n";
+            details << "Amount: $" << sale.getAmount() << "\n";
+            details << "Status: " << sale.getPaymentStatus() << "\n";
+        }
+        
+        // Monthly trend from the revenue rollups
+        RollupSummary rollup = salesRollup();
+        if (!rollup.empty) {
+            details << "\nMONTHLY TREND:\n";
+            for (const auto& month : rollupPeriodTotals(rollup.firstDay, rollup.lastDay, PERIOD_MONTH)) {
+                const RevenueTotals& totals = month.second;
+                details << dayNumberToMonth(month.first) << ": " << totals.totalCount() << " sales, $"
+                        << totals.totalRevenueCents() / 100.0
+                        << " (received $" << totals.revenueCents[BUCKET_PAID] / 100.0
+                        << ", pending $" << totals.revenueCents[BUCKET_PENDING] / 100.0 << ")\n";
+            }
+        }
+        report.details = details.str();
+    }
     
-    // Calculate amount received and pending
-    double paidAmount = 0.0;
-    double pendingAmount = 0.0;
+    return cache.store("sales", DEPENDS_ON_SALES, generations, sales.size(), move(report));
+}
+
+// Generate a sales report
+void generateSalesReport() {
+    ProfileSpan span("report", "generateSalesReport");
+    traceOperation("report.sales");
+    shared_ptr<const SalesReportData> report = buildSalesReport();
     
-    for (const auto& sale : sales) {
-        if (sale.getPaymentStatus() == "Paid") {
-            paidAmount += sale.getAmount();
-        } else if (sale.getPaymentStatus() == "Pending") {
-            pendingAmount += sale.getAmount();
-        }
+    if (report->salesCount == 0) {
+        cout << "No sales data available for report generation." << endl;
+        return;
     }
     
-    cout << "Total Amount Received: $" << fixed << setprecision(2) << paidAmount << endl;
-    cout << "Total Amount Pending: $" << fixed << setprecision(2) << pendingAmount << endl;
+    cout << "\n===== SALES REPORT =====\n";
+    
+    // Display report
+    cout << "Total Number of Sales: " << report->salesCount << endl;
+    cout << "Total Sales Amount: $" << fixed << setprecision(2) << report->totalAmount << endl;
+    cout << "Paid Sales: " << report->paidCount << endl;
+    cout << "Pending Payments: " << report->pendingCount << endl;
+    cout << "Total Amount Received: $" << fixed << setprecision(2) << report->paidAmount << endl;
+    cout << "Total Amount Pending: $" << fixed << setprecision(2) << report->pendingAmount << endl;
     
     // Export report to a file
     time_t now = time(0);
@@ -440,25 +941,17 @@ void generateSalesReport() {
     ofstream reportFile(filename);
     
     if (reportFile.is_open()) {
+        ProfileSpan span("report", "salesReport.writeFile");
         reportFile << "TOUR MATE - SALES REPORT\n";
         reportFile << "Date: " << (1900 + ltm->tm_year) << "-" << (1 + ltm->tm_mon) << "-" << ltm->tm_mday << "\n\n";
         
-        reportFile << "Total Number of Sales: " << sales.size() << "\n";
-        reportFile << "Total Sales Amount: $" << fixed << setprecision(2) << totalAmount << "\n";
-        reportFile << "Paid Sales: " << paidCount << "\n";
-        reportFile << "Pending Payments: " << pendingCount << "\n";
-        reportFile << "Total Amount Received: $" << fixed << setprecision(2) << paidAmount << "\n";
-        reportFile << "Total Amount Pending: $" << fixed << setprecision(2) << pendingAmount << "\n\n";
-        
-        reportFile << "DETAILED SALES:\n";
-        for (const auto& sale : sales) {
-            reportFile << "------------------------\n";
-            reportFile << "Sale ID: " << sale.getSaleId() << "\n";
-            reportFile << "Vehicle ID: " << sale.getVehicleId() << "\n";
-            reportFile << "Customer: " << sale.getCustomerName() << "\n";
-            reportFile << "Amount: $" << fixed << setprecision(2) << sale.getAmount() << "\n";
-            reportFile << "Status: " << sale.getPaymentStatus() << "\n";
-        }
+        reportFile << "Total Number of Sales: " << report->salesCount << "\n";
+        reportFile << "Total Sales Amount: $" << fixed << setprecision(2) << report->totalAmount << "\n";
+        reportFile << "Paid Sales: " << report->paidCount << "\n";
+        reportFile << "Pending Payments: " << report->pendingCount << "\n";
+        reportFile << "Total Amount Received: $" << fixed << setprecision(2) << report->paidAmount << "\n";
+        reportFile << "Total Amount Pending: $" << fixed << setprecision(2) << report->pendingAmount << "\n\n";
+        reportFile << report->details;
         
         reportFile.close();
         cout << "\nReport exported to " << filename << endl;
@@ -2,10 +2,18 @@
 #define SALES_H
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <functional>
+#include <cstdint>
+#include <shared_mutex>
+#include "bktree.h"
+#include "schema.h"
 
 using namespace std;
 
+class SalesView;
+
 class Sales {
 private:
     string saleId;
@@ -17,6 +25,8 @@ private:
     double amount;
     string paymentStatus; // Paid, Pending, etc.
 
+    friend struct RecordSchema<Sales>;
+
 public:
     // Constructor
     Sales(string sId, string vId, string custName, string custContact,
@@ -26,14 +36,14 @@ public:
     Sales();
     
     // Getters
-    string getSaleId() const;
-    string getVehicleId() const;
-    string getCustomerName() const;
-    string getCustomerContact() const;
-    string getStartDate() const;
-    string getEndDate() const;
+    const string& getSaleId() const;
+    const string& getVehicleId() const;
+    const string& getCustomerName() const;
+    const string& getCustomerContact() const;
+    const string& getStartDate() const;
+    const string& getEndDate() const;
     double getAmount() const;
-    string getPaymentStatus() const;
+    const string& getPaymentStatus() const;
     
     // Setters
     void setSaleId(string sId);
@@ -45,6 +55,9 @@ public:
     void setAmount(double amt);
     void setPaymentStatus(string status);
     
+    // Overwrite every field from a view, reusing this object's string buffers
+    void assign(const SalesView& view);
+    
     // Display sales details
     void displayDetails() const;
     
@@ -52,7 +65,53 @@ public:
     string toString() const;
     
     // Create sales from string (read from file)
-    static Sales fromString(string str);
+    static Sales fromString(const string& str);
+};
+
+// Stored sale fields, in file order (see schema.h). SalesView takes its
+// fields from this list.
+template <>
+struct RecordSchema<Sales> {
+    static constexpr auto fields = make_tuple(
+        schemaField("id", &Sales::saleId),
+        schemaField("vehicle", &Sales::vehicleId),
+        schemaField("customer", &Sales::customerName),
+        schemaField("contact", &Sales::customerContact),
+        schemaField("start", &Sales::startDate),
+        schemaField("end", &Sales::endDate),
+        schemaField("amount", &Sales::amount),
+        schemaField("payment", &Sales::paymentStatus));
+};
+
+// Non-owning view of one stored sale. Fields point into the text it was
+// parsed from (usually a partition file loaded into a RecordArena), so they
+// stay valid only while that text does.
+class SalesView {
+private:
+    SchemaViewValues<Sales>::type values;   // Sales' fields, strings as views
+
+    template <class, size_t>
+    friend struct SchemaViewField;
+
+public:
+    SalesView();
+
+    // Parse one "a|b|...|h" record; missing fields are left empty
+    void parse(string_view line);
+
+    string_view getSaleId() const { return get<schemaFieldIndex<Sales>("id")>(values); }
+    string_view getVehicleId() const { return get<schemaFieldIndex<Sales>("vehicle")>(values); }
+    string_view getCustomerName() const { return get<schemaFieldIndex<Sales>("customer")>(values); }
+    string_view getCustomerContact() const { return get<schemaFieldIndex<Sales>("contact")>(values); }
+    string_view getStartDate() const { return get<schemaFieldIndex<Sales>("start")>(values); }
+    string_view getEndDate() const { return get<schemaFieldIndex<Sales>("end")>(values); }
+    double getAmount() const { return get<schemaFieldIndex<Sales>("amount")>(values); }
+    string_view getPaymentStatus() const { return get<schemaFieldIndex<Sales>("payment")>(values); }
+};
+
+template <>
+struct RecordSchema<SalesView> {
+    static constexpr auto fields = schemaViewFields<SalesView, Sales>();
 };
 
 // Function prototypes for sales management
@@ -60,7 +119,42 @@ void viewAllSales();
 void addSale();
 void searchSales();
 void generateSalesReport();
+// Store a sale and mark its vehicle 'Rented' as one transaction
+bool commitBooking(const Sales& sale);
+// Customer names within maxDistance edits of searchTerm, closest first;
+// ids are "partitionKey|saleId" postings
+vector<FuzzyMatch> findCustomersFuzzy(const string& searchTerm, int maxDistance);
 vector<Sales> loadSalesFromFile();
-void saveSalesToFile(const vector<Sales>& sales);
+// Replace the whole sales table; false if it could not all be written
+bool saveSalesToFile(const vector<Sales>& sales);
+bool forEachSaleInFile(const function<void(const Sales&)>& visit);
+void forEachSaleInPartition(const string& key, const function<void(const Sales&)>& visit);
+bool forEachSaleViewInFile(const function<void(const SalesView&)>& visit);
+void forEachSaleViewInPartition(const string& key, const function<void(const SalesView&)>& visit);
+bool forEachSaleInDateRange(int fromDay, int toDay, const function<void(const Sales&)>& visit);
+// Stream every sale with the byte offset of its record in its partition file
+bool forEachSaleInFileWithOffsets(const function<void(const Sales&, uint64_t)>& visit);
+// Read (offset, sale ID) records from one partition file; false, with nothing
+// visited, if a record there no longer has the expected ID
+bool readSalesAtOffsets(const string& key, const vector<pair<uint64_t, string>>& records,
+                        const function<void(const Sales&)>& visit);
+// Same for (offset, key) records, where keyOf gives a record's key
+bool readSalesAtOffsets(const string& key, const vector<pair<uint64_t, string>>& records,
+                        const function<string(const Sales&)>& keyOf, const function<void(const Sales&)>& visit);
+// Append sales to their partitions and add them to the in-memory indexes
+// and rollup; false if a file could not be written
+bool appendSaleToFile(const Sales& sale);
+bool appendSalesToFile(const vector<Sales>& sales);
+// Held exclusively while sales are written and the in-memory indexes and
+// rollup updated; builds that scan the partitions hold it shared, so a sale
+// is either seen by the scan or added after it, never both
+shared_mutex& salesAppendLock();
+// Drop the in-memory sales indexes and rollup and mark the on-disk index
+// trees stale, e.g. after another process changed the files
+void resetSalesCaches();
+// Drop them only if another process has changed the sales manifest since
+// this one last stored to or checked it
+void refreshSalesCaches();
+long long countStoredSales();
 
 #endif // SALES_H
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include "salesindex.h"
+#include "partition.h"
+#include "profile.h"
+#include <mutex>
+#include <atomic>
+
+using namespace std;
+
+static const vector<uint32_t> EMPTY_POSITIONS;
+
+// Constructor
+SalesIndex::SalesIndex() {
+    clear();
+}
+
+void SalesIndex::clear() {
+    partitionKeys.clear();
+    partitionIds.clear();
+    partitionOf.clear();
+    saleIds.clear();
+    offsets.clear();
+    customerOf.clear();
+    customers.clear();
+    customerSales.clear();
+    byId.clear();
+    byVehicle.clear();
+    byPayment.clear();
+    loaded = false;
+}
+
+// Index one stored sale
+void SalesIndex::add(const Sales& sale, uint64_t offset) {
+    string key = salesPartitionKey(sale);
+    auto partition = partitionIds.find(key);
+
+    if (partition == partitionIds.end()) {
+        partition = partitionIds.emplace(key, (uint32_t)partitionKeys.size()).first;
+        partitionKeys.push_back(key);
+    }
+
+    uint32_t position = (uint32_t)saleIds.size();
+    partitionOf.push_back(partition->second);
+    saleIds.push_back(sale.getSaleId());
+    offsets.push_back(offset);
+
+    uint32_t customer = customers.intern(sale.getCustomerName(), sale.getCustomerContact());
+    if (customer == customerSales.size()) {
+        customerSales.emplace_back();
+    }
+    customerOf.push_back(customer);
+    customerSales[customer].push_back(position);
+
+    // Positions only grow, so every postings list stays sorted
+    byId[sale.getSaleId()].push_back(position);
+    byVehicle[sale.getVehicleId()].push_back(position);
+    byPayment[sale.getPaymentStatus()].push_back(position);
+}
+
+// True if the field has a hash index
+bool SalesIndex::isIndexed(const string& field) {
+    return field == "id" || field == "vehicle" || field == "payment";
+}
+
+// Sorted positions of sales whose field equals value
+const vector<uint32_t>* SalesIndex::positionsWith(const string& field, const string& value) const {
+    const unordered_map<string, vector<uint32_t>>* index = nullptr;
+
+    if (field == "id") {
+        index = &byId;
+    } else if (field == "vehicle") {
+        index = &byVehicle;
+    } else if (field == "payment") {
+        index = &byPayment;
+    } else {
+        return nullptr;
+    }
+
+    auto it = index->find(value);
+    return it != index->end() ? &it->second : &EMPTY_POSITIONS;
+}
+
+// Partition key stored at a position
+const string& SalesIndex::partitionAt(uint32_t position) const {
+    return partitionKeys[partitionOf[position]];
+}
+
+// Sale ID stored at a position
+const string& SalesIndex::saleIdAt(uint32_t position) const {
+    return saleIds[position];
+}
+
+// Byte offset of the record at a position in its partition file
+uint64_t SalesIndex::offsetAt(uint32_t position) const {
+    return offsets[position];
+}
+
+// Customer ID of the sale at a position
+uint32_t SalesIndex::customerAt(uint32_t position) const {
+    return customerOf[position];
+}
+
+const CustomerDictionary& SalesIndex::customerDictionary() const {
+    return customers;
+}
+
+// Sorted positions of one customer's sales
+const vector<uint32_t>& SalesIndex::positionsOfCustomer(uint32_t customerId) const {
+    return customerId < customerSales.size() ? customerSales[customerId] : EMPTY_POSITIONS;
+}
+
+size_t SalesIndex::size() const {
+    return saleIds.size();
+}
+
+bool SalesIndex::isLoaded() const {
+    return loaded;
+}
+
+void SalesIndex::setLoaded(bool value) {
+    loaded = value;
+}
+
+// Shared index instance, guarded so a background prefetch can build it
+static SalesIndex sharedIndex;
+static mutex sharedIndexLock;
+static atomic<bool> sharedIndexLoaded(false);
+
+// Shared sales index, built from the partitions on first use
+SalesIndex& salesIndex() {
+    refreshSalesCaches();
+    shared_lock<shared_mutex> appends(salesAppendLock(), defer_lock);
+    unique_lock<mutex> guard(sharedIndexLock);
+    
+    if (!sharedIndex.isLoaded()) {
+        // Scan with appends held off, so no sale is both read and noted
+        guard.unlock();
+        appends.lock();
+        guard.lock();
+    }
+    if (!sharedIndex.isLoaded()) {
+        ProfileSpan span("index", "buildSalesIndex");
+        sharedIndex.clear();
+        forEachSaleInFileWithOffsets([](const Sales& sale, uint64_t offset) {
+            sharedIndex.add(sale, offset);
+        });
+        sharedIndex.setLoaded(true);
+        sharedIndexLoaded = true;
+    }
+    return sharedIndex;
+}
+
+// True once the shared index is built
+bool salesIndexLoaded() {
+    return sharedIndexLoaded;
+}
+
+// Keep the shared index current after a sale is stored
+void noteSaleStored(const Sales& sale, uint64_t offset) {
+    lock_guard<mutex> guard(sharedIndexLock);
+    
+    if (sharedIndex.isLoaded()) {
+        sharedIndex.add(sale, offset);
+    }
+}
+
+// Drop the shared index
+void resetSalesIndex() {
+    lock_guard<mutex> guard(sharedIndexLock);
+    sharedIndexLoaded = false;
+    sharedIndex.clear();
+}
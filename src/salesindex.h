@@ -0,0 +1,78 @@
+#ifndef SALESINDEX_H
+#define SALESINDEX_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include "sales.h"
+#include "customers.h"
+
+using namespace std;
+
+// Hash indexes over all stored sales on sale ID, vehicle ID and payment status.
+// Each sale gets a position (in storage order) holding its partition, ID,
+// customer and byte offset in its partition file; the indexes map a field
+// value to a sorted list of positions, and each customer in the dictionary
+// has the sorted positions of their sales. Built from the partitions on first
+// use and kept current by appendSaleToFile.
+class SalesIndex {
+private:
+    vector<string> partitionKeys;                   // Interned partition keys
+    unordered_map<string, uint32_t> partitionIds;
+    vector<uint32_t> partitionOf;                   // Per position
+    vector<string> saleIds;                         // Per position
+    vector<uint64_t> offsets;                       // Per position
+    vector<uint32_t> customerOf;                    // Per position
+    CustomerDictionary customers;
+    vector<vector<uint32_t>> customerSales;         // Per customer ID
+    unordered_map<string, vector<uint32_t>> byId;
+    unordered_map<string, vector<uint32_t>> byVehicle;
+    unordered_map<string, vector<uint32_t>> byPayment;
+    bool loaded;
+
+public:
+    // Constructor
+    SalesIndex();
+
+    void clear();
+
+    // Index one stored sale found at a byte offset of its partition file
+    void add(const Sales& sale, uint64_t offset);
+
+    // Sorted positions of sales whose field ("id", "vehicle" or "payment")
+    // equals value; nullptr if the field has no index
+    const vector<uint32_t>* positionsWith(const string& field, const string& value) const;
+
+    // True if the field has a hash index
+    static bool isIndexed(const string& field);
+
+    // Partition key, sale ID, byte offset and customer ID stored at a position
+    const string& partitionAt(uint32_t position) const;
+    const string& saleIdAt(uint32_t position) const;
+    uint64_t offsetAt(uint32_t position) const;
+    uint32_t customerAt(uint32_t position) const;
+
+    // Distinct customers, and the sorted positions of one customer's sales
+    const CustomerDictionary& customerDictionary() const;
+    const vector<uint32_t>& positionsOfCustomer(uint32_t customerId) const;
+
+    size_t size() const;
+    bool isLoaded() const;
+    void setLoaded(bool value);
+};
+
+// Shared sales index, built from the partitions on first use
+SalesIndex& salesIndex();
+
+// True once the shared index is built; never waits for a build in progress
+bool salesIndexLoaded();
+
+// Keep the shared index current after a sale is stored at a byte offset
+// (appendSalesToFile calls it with salesAppendLock held)
+void noteSaleStored(const Sales& sale, uint64_t offset);
+
+// Drop the shared index (it is rebuilt on next use)
+void resetSalesIndex();
+
+#endif // SALESINDEX_H
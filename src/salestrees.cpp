@@ -0,0 +1,231 @@
+#include "salestrees.h"
+#include "btree.h"
+#include "partition.h"
+#include "extsort.h"
+#include "dates.h"
+#include "fileutil.h"
+#include "config.h"
+#include "profile.h"
+#include <iostream>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+// One tree per indexed field, in this order
+static const char* const TREE_FIELDS[] = {"id", "vehicle", "start"};
+static const size_t TREE_COUNT = 3;
+
+static DiskBTree trees[TREE_COUNT];
+static mutex treesLock;
+
+// A locator keeps the byte offset in its low bits and the partition's month
+// (year * 12 + month, or 0 for undated sales) above them
+static const int LOCATOR_OFFSET_BITS = 40;
+static const uint64_t LOCATOR_OFFSET_MASK = (1ULL << LOCATOR_OFFSET_BITS) - 1;
+
+static string treeFile(size_t tree) {
+    return dataPath(string("sales_") + TREE_FIELDS[tree] + ".idx");
+}
+
+static int treeNumber(const string& field) {
+    for (size_t tree = 0; tree < TREE_COUNT; tree++) {
+        if (field == TREE_FIELDS[tree]) {
+            return (int)tree;
+        }
+    }
+    return -1;
+}
+
+static uint64_t makeLocator(const string& partition, uint64_t offset) {
+    uint64_t month = 0;
+    if (partition != UNDATED_PARTITION) {
+        month = (uint64_t)atoi(partition.substr(0, 4).c_str()) * 12 + atoi(partition.substr(5, 2).c_str());
+    }
+    return (month << LOCATOR_OFFSET_BITS) | (offset & LOCATOR_OFFSET_MASK);
+}
+
+static string locatorPartition(uint64_t locator) {
+    uint64_t month = locator >> LOCATOR_OFFSET_BITS;
+    if (month == 0) {
+        return UNDATED_PARTITION;
+    }
+    char key[16];
+    snprintf(key, sizeof(key), "%04d-%02d", (int)((month - 1) / 12), (int)((month - 1) % 12 + 1));
+    return key;
+}
+
+// FNV-1a hash of each partition's key, rows, size and modification time
+static uint64_t salesGeneration(const vector<SalesPartition>& partitions) {
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (const auto& partition : partitions) {
+        long long size = -1, modified = -1;
+        fileStamp(salesPartitionFile(partition.key), size, modified);
+        string stamp = partition.key + "|" + to_string(partition.rows) + "|" + to_string(size) + "|" +
+                       to_string(modified) + "\n";
+        for (unsigned char c : stamp) {
+            hash = (hash ^ c) * 1099511628211ULL;
+        }
+    }
+    return hash == 0 ? 1 : hash;  // 0 marks a stale tree
+}
+
+// True if the trees are enabled and this thread reads the working directory
+bool salesTreesEnabled() {
+    static bool enabled = getConfigBool("sales_btree_index", true);
+    return enabled && dataPath("").empty();
+}
+
+// Key a sale is stored under in one tree, cut as the tree stores it
+string salesTreeKey(const string& field, const Sales& sale) {
+    string key;
+    if (field == "id") {
+        key = sale.getSaleId();
+    } else if (field == "vehicle") {
+        key = sale.getVehicleId();
+    } else if (field == "start") {
+        int day = dateToDayNumber(sale.getStartDate());
+        key = day == INVALID_DAY ? "" : dayNumberToDate(day);
+    }
+    return key.substr(0, BTREE_KEY_BYTES);
+}
+
+// Open any tree not open yet; the lock must be held
+static bool openTrees() {
+    bool opened = true;
+    for (size_t tree = 0; tree < TREE_COUNT; tree++) {
+        opened = (trees[tree].isOpen() || trees[tree].open(treeFile(tree))) && opened;
+    }
+    return opened;
+}
+
+// True if every tree describes the files as they are now
+static bool treesCurrent(uint64_t generation) {
+    if (!openTrees()) {
+        return false;
+    }
+    for (const auto& tree : trees) {
+        if (tree.dataGeneration() != generation) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Write all three trees from one pass over the partitions. Entries go through
+// an external sort, so memory stays bounded however many sales there are.
+static bool buildTrees(uint64_t generation) {
+    ProfileSpan span("index", "buildSalesTrees");
+    vector<unique_ptr<ExternalSorter>> sorters;
+    bool ok = true;
+
+    for (size_t tree = 0; tree < TREE_COUNT; tree++) {
+        trees[tree].close();
+        sorters.emplace_back(new ExternalSorter(false));
+    }
+
+    ok = forEachSaleInFileWithOffsets([&sorters, &ok](const Sales& sale, uint64_t offset) {
+        uint64_t locator = makeLocator(salesPartitionKey(sale), offset);
+        for (size_t tree = 0; tree < TREE_COUNT; tree++) {
+            string key = salesTreeKey(TREE_FIELDS[tree], sale);
+            if (!key.empty()) {
+                string entry = btreeSortKey(key, locator);
+                ok = sorters[tree]->add(entry, entry) && ok;
+            }
+        }
+    }) && ok;
+
+    for (size_t tree = 0; ok && tree < TREE_COUNT; tree++) {
+        BTreeWriter writer(treeFile(tree));
+        ok = sorters[tree]->finish([&writer](const string& entry) { writer.addSorted(entry); }) &&
+             writer.finish(generation) && trees[tree].open(treeFile(tree));
+        if (!ok) {
+            cout << "Error: Could not write " << treeFile(tree) << "." << endl;
+        }
+    }
+    return ok;
+}
+
+// (offset, key) of sales whose field lies in [low, high], by partition
+bool findSalesInTrees(const string& field, const string& low, const string& high, size_t limit,
+                      map<string, vector<pair<uint64_t, string>>>& found) {
+    int tree = treeNumber(field);
+    found.clear();
+    if (tree < 0 || !salesTreesEnabled()) {
+        return false;
+    }
+
+    lock_guard<mutex> guard(treesLock);
+    uint64_t generation = salesGeneration(loadSalesManifest());
+    if (!treesCurrent(generation) && !buildTrees(generation)) {
+        return false;
+    }
+
+    size_t count = 0;
+    trees[tree].scan(low, high, [&count, limit, &found](const string& key, uint64_t locator) {
+        if (++count > limit) {
+            return false;
+        }
+        found[locatorPartition(locator)].push_back(make_pair(locator & LOCATOR_OFFSET_MASK, key));
+        return true;
+    });
+    if (count > limit) {
+        found.clear();
+        return false;
+    }
+
+    // Read each partition front to back
+    for (auto& partition : found) {
+        sort(partition.second.begin(), partition.second.end());
+    }
+    return true;
+}
+
+// Hold the trees and note whether they match the files before the write
+SalesTreeAppend::SalesTreeAppend() : current(false) {
+    if (salesTreesEnabled()) {
+        guard = unique_lock<mutex>(treesLock);
+        current = treesCurrent(salesGeneration(loadSalesManifest()));
+    }
+}
+
+// Insert the new entries and record the files' new generation. Trees that
+// were stale stay stale and are rebuilt on next use.
+void SalesTreeAppend::stored(const vector<Sales>& sales, const vector<uint64_t>& offsets) {
+    if (!current) {
+        return;
+    }
+    ProfileSpan span("index", "SalesTreeAppend::stored");
+    bool ok = true;
+
+    for (size_t i = 0; i < sales.size(); i++) {
+        uint64_t locator = makeLocator(salesPartitionKey(sales[i]), offsets[i]);
+        for (size_t tree = 0; tree < TREE_COUNT; tree++) {
+            string key = salesTreeKey(TREE_FIELDS[tree], sales[i]);
+            if (!key.empty()) {
+                ok = trees[tree].insert(key, locator) && ok;
+            }
+        }
+    }
+
+    uint64_t generation = ok ? salesGeneration(loadSalesManifest()) : 0;
+    for (auto& tree : trees) {
+        tree.setDataGeneration(generation);
+    }
+    current = false;
+}
+
+// Mark the trees stale
+void invalidateSalesTrees() {
+    if (!salesTreesEnabled()) {
+        return;
+    }
+    lock_guard<mutex> guard(treesLock);
+    openTrees();
+    for (auto& tree : trees) {
+        tree.setDataGeneration(0);
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef SALESTREES_H
+#define SALESTREES_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cstdint>
+#include "sales.h"
+
+using namespace std;
+
+// Persistent B+tree indexes (see btree.h) over the working directory's sales,
+// so lookups after a cold start read a few pages instead of every partition:
+//   sales_id.idx       sale ID
+//   sales_vehicle.idx  vehicle ID
+//   sales_start.idx    start date as YYYY-MM-DD (undated sales are left out)
+// Each entry points at a record by its partition and byte offset. The trees
+// store the generation of the sales files they describe, a hash of each
+// partition's key, row count, size and modification time; when it no longer
+// matches (the files were rewritten or changed by another program) the trees
+// are rebuilt on next use. appendSalesToFile adds new sales to them in place.
+// sales_btree_index=false in tourmate.conf turns them off.
+
+// True if the trees are enabled and this thread reads the working directory
+bool salesTreesEnabled();
+
+// Key a sale is stored under in one tree ("id", "vehicle" or "start"); empty
+// if it is not in that tree
+string salesTreeKey(const string& field, const Sales& sale);
+
+// (byte offset, tree key) of sales whose field lies in [low, high], by
+// partition; opens the trees, rebuilding them if they are missing or stale.
+// False if the trees cannot be used or more than limit sales match.
+bool findSalesInTrees(const string& field, const string& low, const string& high, size_t limit,
+                      map<string, vector<pair<uint64_t, string>>>& found);
+
+// Keeps the trees in step with one append to the partitions: create it before
+// the files are written and call stored() once they are. Appends wait for
+// each other while one is held.
+class SalesTreeAppend {
+private:
+    unique_lock<mutex> guard;
+    bool current;   // The trees matched the files before the write
+
+public:
+    SalesTreeAppend();
+
+    SalesTreeAppend(const SalesTreeAppend&) = delete;
+    SalesTreeAppend& operator=(const SalesTreeAppend&) = delete;
+
+    // Add the appended sales, found at these byte offsets of their partitions
+    void stored(const vector<Sales>& sales, const vector<uint64_t>& offsets);
+};
+
+// Mark the trees stale after the partitions were rewritten
+void invalidateSalesTrees();
+
+#endif // SALESTREES_H
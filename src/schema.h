@@ -0,0 +1,380 @@
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+
+using namespace std;
+
+// Each stored record type lists its fields once, in file order, by
+// specializing RecordSchema next to the class (which makes it a friend):
+//
+//     template <> struct RecordSchema<Vehicle> {
+//         static constexpr auto fields = make_tuple(
+//             schemaField("id", &Vehicle::vehicleId),
+//             schemaField("year", &Vehicle::year), ...);
+//     };
+//
+// The templates below expand that list at compile time into the '|'
+// separated text parser and formatter, the export columns, the query
+// fields and a binary encoding. Field types may be string, string_view, int
+// and double. The names are the export column and query field names. Adding
+// a field is one schema line.
+//
+// A view type that points into record text instead of owning its fields
+// (SalesView) keeps them in a SchemaViewValues<Record>::type tuple named
+// values and takes its schema from the owning type's:
+//
+//     template <> struct RecordSchema<SalesView> {
+//         static constexpr auto fields = schemaViewFields<SalesView, Sales>();
+//     };
+template <class Record>
+struct RecordSchema;
+
+// One field: its column name and where it lives in the record
+template <class Record, class Type>
+struct SchemaField {
+    const char* name;
+    Type Record::*member;
+
+    Type& of(Record& record) const { return record.*member; }
+    const Type& of(const Record& record) const { return record.*member; }
+};
+
+template <class Record, class Type>
+constexpr SchemaField<Record, Type> schemaField(const char* name, Type Record::*member) {
+    return {name, member};
+}
+
+// Call visit(field) for each field of Record's schema, in order
+template <class Record, class Visit>
+inline void forEachSchemaField(const Visit& visit) {
+    apply([&visit](const auto&... fields) { (visit(fields), ...); }, RecordSchema<Record>::fields);
+}
+
+// Number of fields in Record's schema
+template <class Record>
+constexpr size_t schemaFieldCount() {
+    return tuple_size<decay_t<decltype(RecordSchema<Record>::fields)>>::value;
+}
+
+constexpr bool schemaNamesEqual(const char* a, const char* b) {
+    while (*a != '\0' && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+template <class Record, size_t... Index>
+constexpr size_t schemaFieldIndex(const char* name, index_sequence<Index...>) {
+    const char* names[] = {get<Index>(RecordSchema<Record>::fields).name...};
+    for (size_t i = 0; i < sizeof...(Index); i++) {
+        if (schemaNamesEqual(names[i], name)) {
+            return i;
+        }
+    }
+    return sizeof...(Index);
+}
+
+// Position of the named field in Record's schema (the field count if none)
+template <class Record>
+constexpr size_t schemaFieldIndex(const char* name) {
+    return schemaFieldIndex<Record>(name, make_index_sequence<schemaFieldCount<Record>()>());
+}
+
+// Type a field has in a view: strings become views into the record text
+template <class Type>
+struct SchemaViewType {
+    typedef Type type;
+};
+
+template <>
+struct SchemaViewType<string> {
+    typedef string_view type;
+};
+
+// Tuple holding a view of each of Record's fields, in schema order
+template <class Record, class Fields = decay_t<decltype(RecordSchema<Record>::fields)>>
+struct SchemaViewValues;
+
+template <class Record, class... Types>
+struct SchemaViewValues<Record, tuple<SchemaField<Record, Types>...>> {
+    typedef tuple<typename SchemaViewType<Types>::type...> type;
+};
+
+// One field of a view type: its name and its place in the values tuple. The
+// view type befriends this template.
+template <class View, size_t Index>
+struct SchemaViewField {
+    const char* name;
+
+    auto& of(View& view) const { return get<Index>(view.values); }
+    const auto& of(const View& view) const { return get<Index>(view.values); }
+};
+
+template <class View, class Record, size_t... Index>
+constexpr auto schemaViewFields(index_sequence<Index...>) {
+    return make_tuple(SchemaViewField<View, Index>{get<Index>(RecordSchema<Record>::fields).name}...);
+}
+
+// Schema of a view type: Record's field names, read from the values tuple
+template <class View, class Record>
+constexpr auto schemaViewFields() {
+    return schemaViewFields<View, Record>(make_index_sequence<schemaFieldCount<Record>()>());
+}
+
+template <class Record, class Source, size_t... Index>
+inline void assignRecordFields(Record& record, const Source& source, index_sequence<Index...>) {
+    ((get<Index>(RecordSchema<Record>::fields).of(record) = get<Index>(RecordSchema<Source>::fields).of(source)), ...);
+}
+
+// Copy every field of source into record, field by field in schema order.
+// Both must have the same schema, e.g. an owning type and its view type.
+template <class Record, class Source>
+inline void assignRecordFields(Record& record, const Source& source) {
+    static_assert(schemaFieldCount<Record>() == schemaFieldCount<Source>(), "schemas differ");
+    assignRecordFields(record, source, make_index_sequence<schemaFieldCount<Record>()>());
+}
+
+// Text form of one field. Numbers use the shortest text that reads back as
+// the same value; a number that does not parse reads as 0.
+inline void parseFieldText(string_view text, string& value) {
+    value.assign(text.data(), text.size());
+}
+
+inline void parseFieldText(string_view text, string_view& value) {
+    value = text;
+}
+
+inline void parseFieldText(string_view text, int& value) {
+    value = 0;
+    from_chars(text.data(), text.data() + text.size(), value);
+}
+
+// Longest text a number field can take
+const size_t SCHEMA_NUMBER_TEXT_BYTES = 32;
+
+// Floating-point from_chars and to_chars need GCC 11 or newer. Older standard
+// libraries (MinGW GCC 10, for one) do not define __cpp_lib_to_chars, and
+// doubles are read with strtod and written with snprintf instead.
+
+// Double at the start of text, 0 if it does not start with a number
+inline double parseDoubleText(string_view text) {
+    double value = 0.0;
+#ifdef __cpp_lib_to_chars
+    from_chars(text.data(), text.data() + text.size(), value);
+#else
+    // Like from_chars: no leading spaces or plus sign
+    if (!text.empty() && text[0] != '+' && !isspace((unsigned char)text[0])) {
+        value = strtod(string(text).c_str(), nullptr);
+    }
+#endif
+    return value;
+}
+
+// Shortest text that reads back as the same double; returns the end
+inline char* formatDoubleText(char* first, char* last, double value) {
+#ifdef __cpp_lib_to_chars
+    return to_chars(first, last, value).ptr;
+#else
+    int written = 0;
+    for (int precision = 15; precision <= 17; precision++) {
+        written = snprintf(first, last - first, "%.*g", precision, value);
+        if (strtod(first, nullptr) == value) {
+            break;
+        }
+    }
+    return first + written;
+#endif
+}
+
+inline void parseFieldText(string_view text, double& value) {
+    value = parseDoubleText(text);
+}
+
+inline size_t fieldTextBound(string_view value) {
+    return value.size();
+}
+
+inline size_t fieldTextBound(int) {
+    return SCHEMA_NUMBER_TEXT_BYTES;
+}
+
+inline size_t fieldTextBound(double) {
+    return SCHEMA_NUMBER_TEXT_BYTES;
+}
+
+inline void appendFieldText(string& out, string_view value) {
+    out.append(value.data(), value.size());
+}
+
+template <class Number>
+inline void appendNumberText(string& out, Number value) {
+    char text[SCHEMA_NUMBER_TEXT_BYTES];
+    char* end = to_chars(text, text + sizeof(text), value).ptr;
+    out.append(text, end - text);
+}
+
+inline void appendFieldText(string& out, int value) {
+    appendNumberText(out, value);
+}
+
+inline void appendFieldText(string& out, double value) {
+    char text[SCHEMA_NUMBER_TEXT_BYTES];
+    char* end = formatDoubleText(text, text + sizeof(text), value);
+    out.append(text, end - text);
+}
+
+// Parse one "a|b|...|z" record into the schema's fields. Like splitting with
+// getline on '|', empty text and a trailing '|' add no field; fields the line
+// does not have are left as they were. Returns the number of fields read.
+template <class Record>
+size_t parseRecordText(string_view line, Record& record) {
+    size_t start = 0;
+    size_t count = 0;
+
+    forEachSchemaField<Record>([&](const auto& field) {
+        if (start >= line.size()) {
+            return;
+        }
+        size_t bar = line.find('|', start);
+        if (bar == string_view::npos) {
+            bar = line.size();
+        }
+        parseFieldText(line.substr(start, bar - start), field.of(record));
+        start = bar + 1;
+        count++;
+    });
+    return count;
+}
+
+// Append the record's text form to out, with a single reservation
+template <class Record>
+void appendRecordText(string& out, const Record& record) {
+    size_t bound = out.size() + schemaFieldCount<Record>();
+    forEachSchemaField<Record>([&](const auto& field) {
+        bound += fieldTextBound(field.of(record));
+    });
+    out.reserve(bound);
+
+    bool first = true;
+    forEachSchemaField<Record>([&](const auto& field) {
+        if (!first) {
+            out += '|';
+        }
+        appendFieldText(out, field.of(record));
+        first = false;
+    });
+}
+
+template <class Record>
+string formatRecordText(const Record& record) {
+    string text;
+    appendRecordText(text, record);
+    return text;
+}
+
+// Header row of the schema's column names, e.g. "id,make,year"
+template <class Record>
+string schemaColumnList(char separator) {
+    string columns;
+    forEachSchemaField<Record>([&](const auto& field) {
+        if (!columns.empty()) {
+            columns += separator;
+        }
+        columns += field.name;
+    });
+    return columns;
+}
+
+// Binary form, for temporary files the program reads back itself: strings as
+// a 32-bit length and their bytes, numbers as their bytes in memory order
+inline void appendFieldBinary(string& out, string_view value) {
+    uint32_t length = (uint32_t)value.size();
+    out.append((const char*)&length, sizeof(length));
+    out.append(value.data(), value.size());
+}
+
+inline void appendFieldBinary(string& out, int value) {
+    out.append((const char*)&value, sizeof(value));
+}
+
+inline void appendFieldBinary(string& out, double value) {
+    out.append((const char*)&value, sizeof(value));
+}
+
+// Read a fixed-size value at offset, advancing it; false if data is too short
+template <class Value>
+inline bool readBinaryValue(string_view data, size_t& offset, Value& value) {
+    if (data.size() - offset < sizeof(Value)) {
+        return false;
+    }
+    memcpy(&value, data.data() + offset, sizeof(Value));
+    offset += sizeof(Value);
+    return true;
+}
+
+inline bool parseFieldBinary(string_view data, size_t& offset, string_view& value) {
+    uint32_t length;
+    if (!readBinaryValue(data, offset, length) || data.size() - offset < length) {
+        return false;
+    }
+    value = data.substr(offset, length);
+    offset += length;
+    return true;
+}
+
+inline bool parseFieldBinary(string_view data, size_t& offset, string& value) {
+    string_view text;
+    if (!parseFieldBinary(data, offset, text)) {
+        return false;
+    }
+    value.assign(text.data(), text.size());
+    return true;
+}
+
+inline bool parseFieldBinary(string_view data, size_t& offset, int& value) {
+    return readBinaryValue(data, offset, value);
+}
+
+inline bool parseFieldBinary(string_view data, size_t& offset, double& value) {
+    return readBinaryValue(data, offset, value);
+}
+
+template <class Record>
+void appendRecordBinary(string& out, const Record& record) {
+    forEachSchemaField<Record>([&](const auto& field) {
+        appendFieldBinary(out, field.of(record));
+    });
+}
+
+template <class Record>
+string formatRecordBinary(const Record& record) {
+    string data;
+    appendRecordBinary(data, record);
+    return data;
+}
+
+// False if data ends before the last field
+template <class Record>
+bool parseRecordBinary(string_view data, Record& record) {
+    size_t offset = 0;
+    bool complete = true;
+
+    forEachSchemaField<Record>([&](const auto& field) {
+        complete = complete && parseFieldBinary(data, offset, field.of(record));
+    });
+    return complete;
+}
+
+#endif // SCHEMA_H
@@ -0,0 +1,458 @@
+#include "slotfile.h"
+#include "fileutil.h"
+#include "profile.h"
+#include "prefetch.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+static const string SLOT_MAGIC = "TMSLOT1";
+
+// Smallest slot width accepted (tag, a short payload and the newline)
+static const long long MIN_SLOT_WIDTH = 32;
+
+// Constructor
+SlotFile::SlotFile(const string& fileName, long long defaultWidth)
+    : fileName(fileName), defaultWidth(max(defaultWidth, MIN_SLOT_WIDTH)), width(0),
+      lockFile(fileName + ".lock"), slotCount(0), freeHead(0), writeCount(0), opened(false) {
+#ifndef _WIN32
+    fd = -1;
+#endif
+}
+
+// Destructor
+SlotFile::~SlotFile() {
+    closeLocked();
+}
+
+void SlotFile::closeLocked() {
+#ifdef _WIN32
+    if (file.is_open()) {
+        file.close();
+    }
+#else
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+#endif
+    opened = false;
+}
+
+// Write data at a byte offset
+bool SlotFile::writeAt(long long offset, const string& data) {
+    bool ok = true;
+#ifdef _WIN32
+    file.clear();
+    file.seekp(offset);
+    file.write(data.data(), data.size());
+    file.flush();
+    ok = (bool)file;
+#else
+    size_t written = 0;
+    while (ok && written < data.size()) {
+        ssize_t result = pwrite(fd, data.data() + written, data.size() - written, offset + (off_t)written);
+        ok = result > 0;
+        written += ok ? (size_t)result : 0;
+    }
+#endif
+    if (!ok) {
+        cout << "Error: Could not write to " << fileName << "." << endl;
+    }
+    return ok;
+}
+
+// Read bytes at a byte offset
+bool SlotFile::readAt(long long offset, size_t bytes, string& data) {
+    data.resize(bytes);
+#ifdef _WIN32
+    file.clear();
+    file.seekg(offset);
+    file.read(&data[0], bytes);
+    return (size_t)file.gcount() == bytes;
+#else
+    size_t done = 0;
+    while (done < bytes) {
+        ssize_t result = pread(fd, &data[done], bytes - done, offset + (off_t)done);
+        if (result <= 0) {
+            return false;
+        }
+        done += (size_t)result;
+    }
+    return true;
+#endif
+}
+
+// One slot: tag, payload, space padding, newline
+string SlotFile::formatSlot(char tag, const string& payload) const {
+    string slot(width, ' ');
+    slot[0] = tag;
+    slot.replace(1, payload.size(), payload);
+    slot[width - 1] = '\n';
+    return slot;
+}
+
+// Header slot: magic|width|free head|write count
+string SlotFile::formatHeader() const {
+    string header(width, ' ');
+    string text = SLOT_MAGIC + "|" + to_string(width) + "|" + to_string(freeHead) + "|" + to_string(writeCount);
+    header.replace(0, text.size(), text);
+    header[width - 1] = '\n';
+    return header;
+}
+
+bool SlotFile::writeHeader() {
+    return writeAt(0, formatHeader());
+}
+
+// Fields of a header line; false if it is not one. Files written before the
+// write count was added read as count 0.
+static bool parseHeader(const string& header, long long& width, long long& freeHead, long long& writes) {
+    stringstream ss(header.substr(0, header.find('\n')));
+    string magic, widthText, freeText, writesText;
+    getline(ss, magic, '|');
+    getline(ss, widthText, '|');
+    getline(ss, freeText, '|');
+    getline(ss, writesText, '|');
+
+    width = atoll(widthText.c_str());
+    freeHead = atoll(freeText.c_str());
+    writes = atoll(writesText.c_str());
+    return magic == SLOT_MAGIC && width >= MIN_SLOT_WIDTH;
+}
+
+// Read the whole file, rebuilding the key-to-slot map (and records if asked)
+bool SlotFile::scanLocked(vector<string>* records) {
+    ifstream in(fileName, ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+
+    ostringstream contents;
+    contents << in.rdbuf();
+    string data = contents.str();
+
+    if (!parseHeader(data, width, freeHead, writeCount)) {
+        loadMessages() << "Error: " << fileName << " is not a valid slot file." << endl;
+        return false;
+    }
+    slotCount = (long long)data.size() / width;
+    slotOf.clear();
+
+    for (long long slot = 1; slot < slotCount; slot++) {
+        size_t offset = (size_t)(slot * width);
+        if (data[offset] != 'U') {
+            continue;
+        }
+
+        string record = data.substr(offset + 1, width - 2);
+        record.erase(record.find_last_not_of(' ') + 1);
+        slotOf[recordKey(record)] = slot;
+        if (records != nullptr) {
+            records->push_back(record);
+        }
+    }
+    return true;
+}
+
+// Open the file for positioned I/O, creating it if needed
+bool SlotFile::openLocked() {
+    if (opened) {
+        return true;
+    }
+
+    if (!fileExists(fileName)) {
+        rewriteLocked(vector<string>(), defaultWidth);
+        return opened;
+    }
+    if (!scanLocked(nullptr)) {
+        return false;
+    }
+
+#ifdef _WIN32
+    file.open(fileName, ios::in | ios::out | ios::binary);
+    opened = file.is_open();
+#else
+    fd = open(fileName.c_str(), O_RDWR);
+    opened = fd >= 0;
+#endif
+    if (!opened) {
+        cout << "Error: Could not open " << fileName << " for writing." << endl;
+    }
+    return opened;
+}
+
+// True if the file on disk is no longer the one this process has open
+// (another process rewrote it into place)
+bool SlotFile::replacedOnDisk() {
+#ifdef _WIN32
+    return false;
+#else
+    struct stat open, named;
+    if (fstat(fd, &open) != 0 || stat(fileName.c_str(), &named) != 0) {
+        return true;
+    }
+    return open.st_ino != named.st_ino || open.st_dev != named.st_dev;
+#endif
+}
+
+// Catch up with other processes before an access: reopen the file if it was
+// replaced, and rebuild the key map if the header's write count has moved.
+// Call with fileLock and the lock file held.
+bool SlotFile::refreshLocked() {
+    if (opened && replacedOnDisk()) {
+        closeLocked();
+    }
+    if (!opened) {
+        return openLocked();
+    }
+
+    string header;
+    long long headerWidth, headerFree, headerWrites;
+    if (!readAt(0, (size_t)width, header) || !parseHeader(header, headerWidth, headerFree, headerWrites) ||
+        headerWidth != width || headerWrites != writeCount) {
+        closeLocked();
+        return openLocked();
+    }
+    return true;
+}
+
+// All records in slot order. Returns false if the file does not exist.
+bool SlotFile::load(vector<string>& records) {
+    ProfileSpan span("file", "SlotFile::load");
+    lock_guard<mutex> guard(fileLock);
+    FileLock readLock(lockFile, FILE_LOCK_SHARED);
+
+    if (!fileExists(fileName)) {
+        return false;
+    }
+    closeLocked();
+    if (!scanLocked(&records)) {
+        return false;
+    }
+    return openLocked();
+}
+
+// All records, read without opening the file for writing
+bool SlotFile::read(vector<string>& records) {
+    ProfileSpan span("file", "SlotFile::read");
+    lock_guard<mutex> guard(fileLock);
+    FileLock readLock(lockFile, FILE_LOCK_SHARED);
+
+    return fileExists(fileName) && scanLocked(&records);
+}
+
+// Store one change in place
+bool SlotFile::append(ChangeOp op, const string& record) {
+    ProfileSpan span("file", "SlotFile::append");
+    lock_guard<mutex> guard(fileLock);
+    FileLock changeLock(lockFile, FILE_LOCK_EXCLUSIVE);
+
+    if (!refreshLocked()) {
+        return false;
+    }
+
+    string key = op == CHANGE_DELETE ? record : recordKey(record);
+    auto it = slotOf.find(key);
+
+    if (op == CHANGE_DELETE) {
+        if (it == slotOf.end()) {
+            return true;
+        }
+        // Slot first, then header: a crash or failure in between only leaks the slot
+        long long slot = it->second;
+        if (!writeAt(slot * width, formatSlot('F', to_string(freeHead)))) {
+            return false;
+        }
+        slotOf.erase(it);
+        long long next = freeHead;
+        freeHead = slot;
+        writeCount++;
+        if (!writeHeader()) {
+            freeHead = next;
+            writeCount--;
+            return false;
+        }
+        return true;
+    }
+
+    // Too long for the current slots: rewrite once with wider ones
+    if ((long long)record.size() > width - 2) {
+        vector<string> records;
+        scanLocked(&records);
+        long long newWidth = width;
+        while ((long long)record.size() > newWidth - 2) {
+            newWidth *= 2;
+        }
+
+        bool replaced = false;
+        for (auto& existing : records) {
+            if (recordKey(existing) == key) {
+                existing = record;
+                replaced = true;
+            }
+        }
+        if (!replaced) {
+            records.push_back(record);
+        }
+        return rewriteLocked(records, newWidth);
+    }
+
+    if (it != slotOf.end()) {
+        // Update in place: one write at a computed offset
+        return writeAt(it->second * width, formatSlot('U', record));
+    }
+
+    long long slot;
+    if (freeHead != 0) {
+        // Reuse a freed slot. Header first, then slot: a crash or failure in
+        // between only leaks the slot instead of handing it out twice.
+        string next;
+        slot = freeHead;
+        if (!readAt(slot * width + 1, (size_t)(width - 2), next)) {
+            cout << "Error: Could not read " << fileName << "." << endl;
+            return false;
+        }
+        freeHead = atoll(next.c_str());
+        writeCount++;
+        if (!writeHeader()) {
+            freeHead = slot;
+            writeCount--;
+            return false;
+        }
+        if (!writeAt(slot * width, formatSlot('U', record))) {
+            return false;
+        }
+    } else {
+        // The header's write count tells other processes the file grew
+        slot = slotCount;
+        if (!writeAt(slot * width, formatSlot('U', record))) {
+            return false;
+        }
+        slotCount++;
+        writeCount++;
+        if (!writeHeader()) {
+            writeCount--;
+            return false;
+        }
+    }
+
+    slotOf[key] = slot;
+    return true;
+}
+
+// Replace the whole table
+void SlotFile::rewrite(const vector<string>& records) {
+    lock_guard<mutex> guard(fileLock);
+    FileLock changeLock(lockFile, FILE_LOCK_EXCLUSIVE);
+
+    long long newWidth = max(width, defaultWidth);
+    for (const auto& record : records) {
+        while ((long long)record.size() > newWidth - 2) {
+            newWidth *= 2;
+        }
+    }
+    rewriteLocked(records, newWidth);
+}
+
+// Write a fresh file with no free slots, sync it into place and reopen it.
+// On failure the old file is left as it was and is rescanned on next use.
+bool SlotFile::rewriteLocked(const vector<string>& records, long long newWidth) {
+    ProfileSpan span("file", "SlotFile::rewrite");
+    string tempFile = fileName + ".tmp";
+    ofstream out(tempFile, ios::binary | ios::trunc);
+
+    if (!out.is_open()) {
+        cout << "Error: Could not open " << tempFile << " for writing." << endl;
+        return false;
+    }
+
+    closeLocked();
+    width = newWidth;
+    freeHead = 0;
+    writeCount++;
+    slotCount = 1;
+    slotOf.clear();
+
+    out << formatHeader();
+
+    for (const auto& record : records) {
+        out << formatSlot('U', record);
+        slotOf[recordKey(record)] = slotCount++;
+    }
+    out.close();
+
+    if (out.fail() || !replaceFileDurably(tempFile, fileName)) {
+        cout << "Error: Could not write " << fileName << "." << endl;
+        remove(tempFile.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    file.open(fileName, ios::in | ios::out | ios::binary);
+    opened = file.is_open();
+#else
+    fd = open(fileName.c_str(), O_RDWR);
+    opened = fd >= 0;
+#endif
+    return opened;
+}
+
+// Flush the slot file to disk
+bool SlotFile::sync() {
+    ProfileSpan span("file", "SlotFile::sync");
+    lock_guard<mutex> guard(fileLock);
+
+    if (!opened) {
+        return true;
+    }
+#ifdef _WIN32
+    file.flush();
+    bool ok = (bool)file && syncFile(fileName);
+#else
+    bool ok = fsync(fd) == 0;
+#endif
+    return syncDirectory(directoryOf(fileName)) && ok;
+}
+
+// Record with this key
+bool SlotFile::find(const string& key, string& record) {
+    lock_guard<mutex> guard(fileLock);
+    FileLock readLock(lockFile, FILE_LOCK_SHARED);
+
+    if ((!opened && !fileExists(fileName)) || !refreshLocked()) {
+        return false;
+    }
+    auto it = slotOf.find(key);
+    return it != slotOf.end() && readSlotLocked(it->second, record) && recordKey(record) == key;
+}
+
+// Record in slot n by one positioned read
+bool SlotFile::readSlot(long long slot, string& record) {
+    lock_guard<mutex> guard(fileLock);
+    FileLock readLock(lockFile, FILE_LOCK_SHARED);
+
+    return (opened || fileExists(fileName)) && refreshLocked() && readSlotLocked(slot, record);
+}
+
+bool SlotFile::readSlotLocked(long long slot, string& record) {
+    if (slot < 1 || slot >= slotCount || !readAt(slot * width, (size_t)width, record)) {
+        return false;
+    }
+    if (record[0] != 'U') {
+        return false;
+    }
+
+    record = record.substr(1, width - 2);
+    record.erase(record.find_last_not_of(' ') + 1);
+    return true;
+}
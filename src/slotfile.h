@@ -0,0 +1,85 @@
+#ifndef SLOTFILE_H
+#define SLOTFILE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#ifdef _WIN32
+#include <fstream>
+#endif
+#include "deltastore.h"
+
+using namespace std;
+
+// Fixed-width record file. Every slot is the same number of bytes, so slot n
+// starts at n * width: an update or delete is one positioned write and
+// reading record n is one positioned read.
+//
+//   slot 0:  "TMSLOT1|<width>|<free head>|<writes>" padded with spaces, then '\n'
+//   in use:  'U' + record, padded with spaces, then '\n'
+//   free:    'F' + next free slot (0 ends the list), padded, then '\n'
+//
+// Deleted slots form a free list headed in slot 0, and inserts reuse them
+// before growing the file. A record too long for its slot triggers a single
+// rewrite with wider slots. Records must not end in spaces.
+//
+// Several processes may share the file. Changes hold an exclusive flock on
+// <file>.lock and lookups a shared one. Every insert or delete bumps the
+// header's write count, so before each access the header is reread: the key
+// map is rebuilt if another process moved records, and the file is reopened
+// if another process replaced it.
+class SlotFile : public RecordStore {
+private:
+    string fileName;
+    long long defaultWidth;
+    long long width;
+    string lockFile;
+    long long slotCount;    // Including the header slot
+    long long freeHead;
+    long long writeCount;   // Header write count the key map matches
+    unordered_map<string, long long> slotOf;
+    bool opened;
+    mutex fileLock;
+#ifdef _WIN32
+    fstream file;
+#else
+    int fd;
+#endif
+
+    bool openLocked();
+    bool refreshLocked();
+    bool replacedOnDisk();
+    bool scanLocked(vector<string>* records);
+    bool readSlotLocked(long long slot, string& record);
+    void closeLocked();
+    bool writeAt(long long offset, const string& data);
+    bool readAt(long long offset, size_t bytes, string& data);
+    string formatSlot(char tag, const string& payload) const;
+    string formatHeader() const;
+    bool writeHeader();
+    bool rewriteLocked(const vector<string>& records, long long newWidth);
+
+public:
+    // Constructor; defaultWidth is used when the file is created
+    SlotFile(const string& fileName, long long defaultWidth);
+
+    // Destructor
+    ~SlotFile();
+
+    bool load(vector<string>& records) override;
+
+    // All records, without opening the file for writing (read-only data)
+    bool read(vector<string>& records);
+    bool append(ChangeOp op, const string& record) override;
+    void rewrite(const vector<string>& records) override;
+    bool sync() override;
+
+    // Record with this key: its slot from the key map, then readSlot
+    bool find(const string& key, string& record) override;
+
+    // Record in slot n (1-based) by one positioned read. False if free or out of range.
+    bool readSlot(long long slot, string& record);
+};
+
+#endif // SLOTFILE_H
@@ -0,0 +1,157 @@
+// Shared store check: two processes change one table at once, through a
+// DeltaStore with a small compaction threshold (so each compacts while the
+// other keeps appending) and then through a SlotFile (so each reuses slots
+// the other freed and one widens the slots mid-run). A fresh load must hold
+// exactly the records both of them wrote. Build with "make check" and run
+// tourmate_storecheck <empty directory>; exits nonzero if a change was lost.
+#include "deltastore.h"
+#include "slotfile.h"
+#include "fileutil.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <memory>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+using namespace std;
+
+static const string DELTA_FILE = "storecheck.txt";
+static const string SLOT_FILE = "storecheck.dat";
+static const int RECORDS_PER_WRITER = 3000;
+
+// This writer's changes: inserts, some updates of earlier records and
+// deletes of every tenth
+static vector<pair<ChangeOp, string>> writerChanges(const string& prefix) {
+    vector<pair<ChangeOp, string>> changes;
+    for (int i = 0; i < RECORDS_PER_WRITER; i++) {
+        changes.push_back({CHANGE_INSERT, prefix + to_string(i) + "|first"});
+        if (i % 3 == 0) {
+            changes.push_back({CHANGE_UPDATE, prefix + to_string(i / 2) + "|second"});
+        }
+        if (i % 10 == 9) {
+            changes.push_back({CHANGE_DELETE, prefix + to_string(i)});
+        }
+        if (i == RECORDS_PER_WRITER / 2) {
+            // Too long for the slot file's first width
+            changes.push_back({CHANGE_UPDATE, prefix + "0|" + string(100, 'w')});
+        }
+    }
+    return changes;
+}
+
+// The shared table, opened through one of the two stores
+static unique_ptr<RecordStore> openStore(bool slots) {
+    if (slots) {
+        return unique_ptr<RecordStore>(new SlotFile(SLOT_FILE, 64));
+    }
+    return unique_ptr<RecordStore>(new DeltaStore(DELTA_FILE, 512));
+}
+
+// Store the changes one at a time, so the other writer's land in between
+static bool writeRecords(bool slots, const string& prefix) {
+    unique_ptr<RecordStore> store = openStore(slots);
+
+    for (const auto& change : writerChanges(prefix)) {
+        if (!store->append(change.first, change.second)) {
+            return false;
+        }
+    }
+    return store->sync();
+}
+
+// The records the changes leave behind
+static void expectedRecords(const string& prefix, set<string>& records) {
+    map<string, string> table;
+    for (const auto& change : writerChanges(prefix)) {
+        if (change.first == CHANGE_DELETE) {
+            table.erase(change.second);
+        } else {
+            table[recordKey(change.second)] = change.second;
+        }
+    }
+    for (const auto& entry : table) {
+        records.insert(entry.second);
+    }
+}
+
+// Run both writers against one store and compare a fresh load with what
+// they wrote; returns the number of failures
+static int checkStore(bool slots) {
+    pid_t child = fork();
+    if (child < 0) {
+        cout << "Error: Could not start the second writer." << endl;
+        return 1;
+    }
+    if (child == 0) {
+        _exit(writeRecords(slots, "C") ? 0 : 1);
+    }
+
+    bool written = writeRecords(slots, "P");
+    int status = 0;
+    written = waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0 && written;
+    if (!written) {
+        cout << "Error: A writer could not store its changes." << endl;
+        return 1;
+    }
+
+    set<string> expected;
+    expectedRecords("P", expected);
+    expectedRecords("C", expected);
+
+    vector<string> loaded;
+    openStore(slots)->load(loaded);
+    set<string> actual(loaded.begin(), loaded.end());
+
+    int failures = 0;
+    for (const auto& record : expected) {
+        if (!actual.count(record)) {
+            if (failures++ < 10) {
+                cout << "FAIL missing " << record << endl;
+            }
+        }
+    }
+    for (const auto& record : actual) {
+        if (!expected.count(record)) {
+            if (failures++ < 10) {
+                cout << "FAIL unexpected " << record << endl;
+            }
+        }
+    }
+    if (loaded.size() != actual.size()) {
+        cout << "FAIL " << loaded.size() - actual.size() << " duplicate record(s)" << endl;
+        failures++;
+    }
+
+    cout << (slots ? "Slot file: " : "Delta store: ") << expected.size() << " records checked, " << failures
+         << " failure(s)" << endl;
+    return failures;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        cout << "Usage: tourmate_storecheck <empty directory>" << endl;
+        return 1;
+    }
+
+#ifdef _WIN32
+    cout << "Skipped: the store check needs fork()." << endl;
+    return 0;
+#else
+    if (chdir(argv[1]) != 0) {
+        cout << "Error: Could not open directory " << argv[1] << endl;
+        return 1;
+    }
+    if (fileExists(DELTA_FILE) || fileExists(DELTA_FILE + ".delta") || fileExists(SLOT_FILE)) {
+        cout << "Error: " << argv[1] << " already holds a store; use an empty directory." << endl;
+        return 1;
+    }
+
+    int failures = checkStore(false) + checkStore(true);
+    return failures == 0 ? 0 : 1;
+#endif
+}
@@ -0,0 +1,180 @@
+#include "topk.h"
+#include "sales.h"
+#include "trace.h"
+#include "profile.h"
+#include "resultcache.h"
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <queue>
+#include <algorithm>
+
+using namespace std;
+
+// Constructor
+GroupTotals::GroupTotals() {
+    total = 0.0;
+    count = 0;
+}
+
+// Ranking order: larger total first, then key for a stable result
+static bool ranksHigher(const RankedEntry& a, const RankedEntry& b) {
+    if (a.total != b.total) {
+        return a.total > b.total;
+    }
+    return a.key < b.key;
+}
+
+// Select the K groups with the largest totals using a bounded min-heap
+vector<RankedEntry> selectTopK(const unordered_map<string, GroupTotals>& groups, size_t k) {
+    vector<RankedEntry> result;
+
+    if (k == 0) {
+        return result;
+    }
+
+    // With ranksHigher as "less", the heap top is the weakest entry kept so far
+    priority_queue<RankedEntry, vector<RankedEntry>, bool (*)(const RankedEntry&, const RankedEntry&)>
+        heap(ranksHigher);
+
+    for (const auto& group : groups) {
+        RankedEntry entry = {group.first, group.second.total, group.second.count};
+
+        if (heap.size() < k) {
+            heap.push(entry);
+        } else if (ranksHigher(entry, heap.top())) {
+            heap.pop();
+            heap.push(entry);
+        }
+    }
+
+    result.reserve(heap.size());
+    while (!heap.empty()) {
+        result.push_back(heap.top());
+        heap.pop();
+    }
+    reverse(result.begin(), result.end());
+
+    return result;
+}
+
+// Top customers by total spend, streamed from the sales file
+vector<RankedEntry> topCustomersBySpend(size_t k) {
+    static ResultCache<vector<RankedEntry>> cache;
+    shared_ptr<const vector<RankedEntry>> cached = cache.find(to_string(k));
+    if (cached) {
+        return *cached;
+    }
+
+    ProfileSpan span("report", "topCustomersBySpend");
+    TableGenerations generations = currentTableGenerations();
+    unordered_map<string, GroupTotals> groups;
+    string key;
+
+    // The key buffer is reused, so only a customer's first sale allocates
+    forEachSaleViewInFile([&groups, &key](const SalesView& sale) {
+        key.assign(sale.getCustomerName()).append(" (").append(sale.getCustomerContact()).append(")");
+        GroupTotals& totals = groups[key];
+        totals.total += sale.getAmount();
+        totals.count++;
+    });
+
+    vector<RankedEntry> ranked = selectTopK(groups, k);
+    return *cache.store(to_string(k), DEPENDS_ON_SALES, generations, ranked.size(), move(ranked));
+}
+
+// Top vehicles by total revenue, streamed from the sales file
+vector<RankedEntry> topVehiclesByRevenue(size_t k) {
+    static ResultCache<vector<RankedEntry>> cache;
+    shared_ptr<const vector<RankedEntry>> cached = cache.find(to_string(k));
+    if (cached) {
+        return *cached;
+    }
+
+    ProfileSpan span("report", "topVehiclesByRevenue");
+    TableGenerations generations = currentTableGenerations();
+    unordered_map<string, GroupTotals> groups;
+
+    string key;
+
+    forEachSaleViewInFile([&groups, &key](const SalesView& sale) {
+        key.assign(sale.getVehicleId());
+        GroupTotals& totals = groups[key];
+        totals.total += sale.getAmount();
+        totals.count++;
+    });
+
+    vector<RankedEntry> ranked = selectTopK(groups, k);
+    return *cache.store(to_string(k), DEPENDS_ON_SALES, generations, ranked.size(), move(ranked));
+}
+
+// Print a ranked table
+void printTopK(const string& title, const string& keyLabel, const vector<RankedEntry>& entries) {
+    cout << "\n===== " << title << " =====\n";
+
+    if (entries.empty()) {
+        cout << "No sales data available." << endl;
+        return;
+    }
+
+    cout << left << setw(6) << "Rank" << setw(40) << keyLabel
+         << right << setw(10) << "Rentals" << setw(16) << "Total($)" << endl;
+    cout << string(72, '-') << endl;
+
+    for (size_t i = 0; i < entries.size(); i++) {
+        cout << left << setw(6) << (i + 1) << setw(40) << entries[i].key.substr(0, 39)
+             << right << setw(10) << entries[i].count
+             << fixed << setprecision(2) << setw(16) << entries[i].total << endl;
+    }
+}
+
+// Interactive top-K screen for the sales menu
+void displayTopK() {
+    int option;
+    string input;
+    size_t k = DEFAULT_TOP_K;
+
+    cout << "\n===== TOP RANKINGS =====\n";
+    cout << "1. Top Customers by Spend\n";
+    cout << "2. Top Vehicles by Revenue\n";
+    cout << "Enter your choice: ";
+
+    if (!(cin >> option)) {
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        cout << "Invalid input. Please enter a number." << endl;
+        return;
+    }
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+
+    cout << "How many (Enter for " << DEFAULT_TOP_K << "): ";
+    getline(cin, input);
+    if (!input.empty()) {
+        // Signed, so "-5" is rejected instead of wrapping to a huge count
+        long long count = 0;
+        size_t used = 0;
+        try {
+            count = stoll(input, &used);
+        } catch (...) {
+            used = 0;
+        }
+        if (used != input.size() || count <= 0) {
+            cout << "Invalid number. Please enter a count of 1 or more." << endl;
+            return;
+        }
+        k = (size_t)count;
+    }
+
+    switch (option) {
+        case 1:
+            traceOperation("report.topk", "customers|" + to_string(k));
+            printTopK("TOP " + to_string(k) + " CUSTOMERS BY SPEND", "Customer", topCustomersBySpend(k));
+            break;
+        case 2:
+            traceOperation("report.topk", "vehicles|" + to_string(k));
+            printTopK("TOP " + to_string(k) + " VEHICLES BY REVENUE", "Vehicle ID", topVehiclesByRevenue(k));
+            break;
+        default:
+            cout << "Invalid option." << endl;
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+using namespace std;
+
+// Default number of rows for top-K queries
+const size_t DEFAULT_TOP_K = 20;
+
+// Running totals for one group-by key
+struct GroupTotals {
+    double total;
+    long long count;
+
+    GroupTotals();
+};
+
+// One row of a top-K result
+struct RankedEntry {
+    string key;
+    double total;
+    long long count;
+};
+
+// Select the K groups with the largest totals using a bounded min-heap.
+// Runs in O(n log K) and returns entries in descending order of total.
+vector<RankedEntry> selectTopK(const unordered_map<string, GroupTotals>& groups, size_t k);
+
+// Top customers by total spend, streamed from the sales file.
+// Keys are "name (contact)" so namesakes stay separate.
+vector<RankedEntry> topCustomersBySpend(size_t k);
+
+// Top vehicles by total revenue, streamed from the sales file
+vector<RankedEntry> topVehiclesByRevenue(size_t k);
+
+// Print a ranked table
+void printTopK(const string& title, const string& keyLabel, const vector<RankedEntry>& entries);
+
+// Interactive top-K screen for the sales menu
+void displayTopK();
+
+#endif // TOPK_H
@@ -0,0 +1,81 @@
+#include "trace.h"
+#include "config.h"
+#include <fstream>
+#include <mutex>
+#include <chrono>
+#include <cstdlib>
+
+using namespace std;
+
+static mutex traceLock;
+
+// Record one operation
+void traceOperation(const string& type, const string& args) {
+    static const string fileName = getConfigString("trace_file", "");
+    if (fileName.empty()) {
+        return;
+    }
+
+    lock_guard<mutex> guard(traceLock);
+    static ofstream file(fileName, ios::app);
+    static const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    if (!file.is_open()) {
+        return;
+    }
+
+    double atMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    file << (long long)atMs << "|" << type << "|" << args << "\n";
+    file.flush();
+}
+
+// Read a trace file
+bool loadTrace(const string& fileName, vector<TraceEntry>& entries) {
+    ifstream file(fileName);
+    string line;
+
+    if (!file.is_open()) {
+        return false;
+    }
+
+    while (getline(file, line)) {
+        size_t first = line.find('|');
+        if (line.empty() || first == string::npos) {
+            continue;
+        }
+        size_t second = line.find('|', first + 1);
+
+        TraceEntry entry;
+        entry.atMs = atof(line.substr(0, first).c_str());
+        if (second == string::npos) {
+            entry.type = line.substr(first + 1);
+        } else {
+            entry.type = line.substr(first + 1, second - first - 1);
+            entry.args = line.substr(second + 1);
+        }
+        entries.push_back(entry);
+    }
+
+    return true;
+}
+
+// Split trace arguments on '|'
+vector<string> splitTraceArgs(const string& args, size_t maxFields) {
+    vector<string> fields;
+    size_t start = 0;
+
+    while (fields.size() + 1 < maxFields) {
+        size_t bar = args.find('|', start);
+        if (bar == string::npos) {
+            break;
+        }
+        fields.push_back(args.substr(start, bar - start));
+        start = bar + 1;
+    }
+    fields.push_back(args.substr(start));
+
+    while (fields.size() < maxFields) {
+        fields.push_back("");
+    }
+    return fields;
+}
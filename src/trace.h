@@ -0,0 +1,44 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Operation trace for the load generator (tourmate_loadgen). When
+// tourmate.conf sets trace_file=<path>, every operation issued through the
+// menus is appended to that file as one line:
+//
+//   <ms since the first traced operation>|<type>|<arguments>
+//
+// Types and their '|'-separated arguments:
+//   vehicle.list                          vehicle.add|<vehicle record>
+//   vehicle.update|<vehicle record>       vehicle.delete|<vehicle ID>
+//   vehicle.query|<query text>            vehicle.fuzzy|<term>|<max edits>
+//   vehicle.rates|<low>|<high>|<type>|<status>
+//   vehicle.cheapest|<type>|<status>
+//   sale.list                             sale.add|<sale record>
+//   sale.query|<query text>               sale.fuzzy|<term>|<max edits>
+//   report.sales                          report.utilization|<from>|<to>
+//   report.topk|customers or vehicles|<k> report.rollup|<option>|<from>|<to>
+// Dates are YYYY-MM-DD; an empty date means the whole history.
+
+// One recorded operation
+struct TraceEntry {
+    double atMs;
+    string type;
+    string args;
+};
+
+// Record one operation (does nothing unless trace_file is set)
+void traceOperation(const string& type, const string& args = "");
+
+// Read a trace file; returns false if it cannot be opened
+bool loadTrace(const string& fileName, vector<TraceEntry>& entries);
+
+// Split trace arguments into exactly maxFields fields on '|'. The last field
+// keeps any further '|'s (so it can hold a whole record); missing fields are empty.
+vector<string> splitTraceArgs(const string& args, size_t maxFields);
+
+#endif // TRACE_H
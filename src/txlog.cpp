@@ -0,0 +1,427 @@
+#include "txlog.h"
+#include "vehicle.h"
+#include "sales.h"
+#include "partition.h"
+#include "profile.h"
+#include "fileutil.h"
+#include "changelog.h"
+#include "config.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <mutex>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/file.h>
+#endif
+
+using namespace std;
+
+static const string TX_LOG_FILE = "tourmate.txlog";
+static const string TX_APPLIED = "APPLIED\n";
+
+// Commits and checkpoints in this process; TxLogLock adds the file lock
+// that keeps other processes out
+static mutex txLock;
+
+// FNV-1a over the change lines, to spot a torn or partial log write
+static uint64_t txChecksum(const string& text) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : text) {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// The log, open for appending, with this process's and the file lock held
+class TxLogLock {
+private:
+    unique_lock<mutex> guard;
+    int fd;
+
+public:
+    TxLogLock() : guard(txLock), fd(-1) {
+        bool created = !fileExists(TX_LOG_FILE);
+#ifdef _WIN32
+        fd = _open(TX_LOG_FILE.c_str(), _O_RDWR | _O_CREAT | _O_APPEND | _O_BINARY, 0644);
+#else
+        fd = open(TX_LOG_FILE.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        if (fd >= 0) {
+            flock(fd, LOCK_EX);
+        }
+#endif
+        // A new log's directory entry is synced once, not on every commit
+        if (fd >= 0 && created) {
+            syncDirectory("");
+        }
+    }
+
+    ~TxLogLock() {
+        if (fd >= 0) {
+#ifdef _WIN32
+            _close(fd);
+#else
+            flock(fd, LOCK_UN);
+            close(fd);
+#endif
+        }
+    }
+
+    TxLogLock(const TxLogLock&) = delete;
+    TxLogLock& operator=(const TxLogLock&) = delete;
+
+    bool isOpen() const { return fd >= 0; }
+
+    long long size() const {
+#ifdef _WIN32
+        return _lseeki64(fd, 0, SEEK_END);
+#else
+        return (long long)lseek(fd, 0, SEEK_END);
+#endif
+    }
+
+    // True if the log ends with a transaction that has not been applied, or
+    // with a torn write
+    bool pending() const {
+        long long length = size();
+        if (length <= 0) {
+            return false;
+        }
+        if (length < (long long)TX_APPLIED.size()) {
+            return true;
+        }
+
+        string tail(TX_APPLIED.size(), '\0');
+#ifdef _WIN32
+        _lseeki64(fd, length - (long long)tail.size(), SEEK_SET);
+        bool read = _read(fd, &tail[0], (unsigned)tail.size()) == (int)tail.size();
+#else
+        bool read = pread(fd, &tail[0], tail.size(), (off_t)(length - (long long)tail.size())) == (ssize_t)tail.size();
+#endif
+        return !read || tail != TX_APPLIED;
+    }
+
+    // Append text with one write, syncing it to disk if asked
+    bool append(const string& text, bool durable) {
+        ProfileSpan span("file", "txlog.append");
+#ifdef _WIN32
+        return _write(fd, text.data(), (unsigned)text.size()) == (int)text.size() && (!durable || _commit(fd) == 0);
+#else
+        return write(fd, text.data(), text.size()) == (ssize_t)text.size() && (!durable || fsync(fd) == 0);
+#endif
+    }
+
+    // Cut the log back to its first 'length' bytes and sync that
+    bool truncate(long long length) {
+#ifdef _WIN32
+        return _chsize_s(fd, length) == 0 && _commit(fd) == 0;
+#else
+        return ftruncate(fd, (off_t)length) == 0 && fsync(fd) == 0;
+#endif
+    }
+};
+
+// One logged transaction
+struct TxRecord {
+    vector<TxChange> changes;
+    bool applied;
+};
+
+// Read the complete records in the log. 'length' is set to the bytes they
+// take up and 'torn' to whether anything after them was cut short.
+static void readLog(vector<TxRecord>& records, long long& length, bool& torn) {
+    ifstream file(TX_LOG_FILE, ios::binary);
+    string line;
+    long long offset = 0;
+
+    length = 0;
+    torn = false;
+
+    // getline sets eof on a last line without its newline: a torn write
+    auto readLine = [&file, &line, &offset]() {
+        if (!getline(file, line) || file.eof()) {
+            return false;
+        }
+        offset += (long long)line.size() + 1;
+        return true;
+    };
+
+    while (readLine()) {
+        if (line + "\n" == TX_APPLIED && !records.empty()) {
+            records.back().applied = true;
+            length = offset;
+            continue;
+        }
+
+        // Header: TX|count|checksum
+        stringstream ss(line);
+        string tag, countText, checksumText;
+        getline(ss, tag, '|');
+        getline(ss, countText, '|');
+        getline(ss, checksumText, '|');
+
+        size_t count = (size_t)atoll(countText.c_str());
+        TxRecord record;
+        record.applied = false;
+        string body;
+
+        while (record.changes.size() < count && readLine()) {
+            body += line + "\n";
+            if (line.size() < 4 || line[1] != '|' || line[3] != '|') {
+                break;
+            }
+            record.changes.push_back({line[0], (ChangeOp)line[2], line.substr(4)});
+        }
+
+        if (tag != "TX" || record.changes.size() != count || to_string(txChecksum(body)) != checksumText) {
+            torn = true;
+            return;
+        }
+        records.push_back(record);
+        length = offset;
+    }
+    torn = !line.empty();
+}
+
+// Apply a transaction's changes: all vehicle changes with one write to the
+// vehicle store, then all the sales with one write per partition. Nothing is
+// synced; the log covers the changes until the next checkpoint.
+static bool applyChanges(const vector<TxChange>& changes) {
+    ProfileSpan span("tx", "applyChanges");
+    vector<pair<ChangeOp, Vehicle>> vehicleChanges;
+    vector<Sales> sales;
+
+    for (const auto& change : changes) {
+        if (change.table == TX_VEHICLES) {
+            Vehicle vehicle;
+            if (change.op == CHANGE_DELETE) {
+                vehicle.setVehicleId(change.record);
+            } else {
+                vehicle = Vehicle::fromString(change.record);
+            }
+            vehicleChanges.push_back({change.op, vehicle});
+        } else if (change.table == TX_SALES && change.op == CHANGE_INSERT) {
+            sales.push_back(Sales::fromString(change.record));
+        }
+    }
+
+    bool ok = vehicleChanges.empty() || saveVehicleChanges(vehicleChanges);
+    return ok && (sales.empty() || appendSalesToFile(sales));
+}
+
+// Apply whatever part of logged transactions did not reach the tables. For
+// each vehicle only its last logged state is stored again, and only if the
+// store does not already hold it; sales are looked for in their partitions
+// and appended if missing, and those partitions' manifest entries are then
+// recounted from their files, since the manifest may be behind (or ahead of)
+// them. Changes found already stored are change-logged if the log missed
+// them. 'reapplied' counts the changes stored again.
+static bool replayChanges(const vector<TxChange>& changes, long long& reapplied) {
+    ProfileSpan span("tx", "replayChanges");
+    refreshVehicleCaches();
+    refreshSalesCaches();
+
+    map<string, size_t> lastVehicleChange;         // Vehicle ID -> position in 'changes'
+    map<string, map<string, size_t>> salesByPartition;  // Partition -> sale ID -> position
+    for (size_t i = 0; i < changes.size(); i++) {
+        const TxChange& change = changes[i];
+        if (change.table == TX_VEHICLES) {
+            lastVehicleChange[recordKey(change.record)] = i;
+        } else if (change.table == TX_SALES && change.op == CHANGE_INSERT) {
+            Sales sale = Sales::fromString(change.record);
+            salesByPartition[salesPartitionKey(sale)][sale.getSaleId()] = i;
+        }
+    }
+
+    vector<bool> redo(changes.size(), false);
+    for (const auto& entry : lastVehicleChange) {
+        const TxChange& change = changes[entry.second];
+        Vehicle stored;
+        bool found = findVehicleById(entry.first, stored);
+        if (change.op == CHANGE_DELETE ? found
+                                       : !found || stored.toString() != Vehicle::fromString(change.record).toString()) {
+            redo[entry.second] = true;
+        }
+    }
+
+    vector<string> partitions;
+    for (auto& entry : salesByPartition) {
+        map<string, size_t>& missing = entry.second;
+        for (const auto& sale : missing) {
+            redo[sale.second] = true;
+        }
+        forEachSaleViewInPartition(entry.first, [&missing, &redo](const SalesView& view) {
+            auto it = missing.find(string(view.getSaleId()));
+            if (it != missing.end()) {
+                redo[it->second] = false;
+            }
+        });
+        partitions.push_back(entry.first);
+    }
+
+    vector<TxChange> stored, again;
+    for (size_t i = 0; i < changes.size(); i++) {
+        (redo[i] ? again : stored).push_back(changes[i]);
+    }
+
+    bool ok = logMissingChanges(stored) && applyChanges(again);
+    reapplied = (long long)again.size();
+
+    if (ok && !partitions.empty()) {
+        ok = recountSalesPartitions(partitions);
+        resetSalesCaches();
+    }
+    return ok;
+}
+
+// Sync every table file the logged transactions changed
+static bool syncLoggedTables(const vector<TxRecord>& records) {
+    ProfileSpan span("tx", "syncLoggedTables");
+    bool vehicles = false;
+    set<string> partitions;
+
+    for (const auto& record : records) {
+        for (const auto& change : record.changes) {
+            if (change.table == TX_VEHICLES) {
+                vehicles = true;
+            } else if (change.table == TX_SALES) {
+                partitions.insert(salesPartitionKey(Sales::fromString(change.record)));
+            }
+        }
+    }
+
+    bool ok = !vehicles || syncVehicleStore();
+    if (!partitions.empty()) {
+        ok = syncSalesPartitions(vector<string>(partitions.begin(), partitions.end())) && ok;
+    }
+    return syncChangeLog() && ok;
+}
+
+// Checkpoint with the log locked: replay either every logged transaction or
+// just those left unapplied, sync the tables and empty the log
+static bool checkpointLocked(TxLogLock& log, bool replayAll, long long& reapplied) {
+    ProfileSpan span("tx", "checkpoint");
+    vector<TxRecord> records;
+    long long length = 0;
+    bool torn = false;
+    reapplied = 0;
+
+    readLog(records, length, torn);
+
+    // A torn record never committed: nothing of it was applied
+    if (torn) {
+        cout << "Note: Discarded an incomplete transaction in " << TX_LOG_FILE << "." << endl;
+        if (!log.truncate(length)) {
+            return false;
+        }
+    }
+
+    vector<TxChange> changes;
+    for (const auto& record : records) {
+        if (replayAll || !record.applied) {
+            changes.insert(changes.end(), record.changes.begin(), record.changes.end());
+        }
+    }
+    if (!changes.empty() && !replayChanges(changes, reapplied)) {
+        return false;
+    }
+
+    return syncLoggedTables(records) && log.truncate(0);
+}
+
+// Log record: "TX|<changes>|<checksum>" then one "<table>|<op>|<record>" line
+// per change, and "APPLIED" once the changes are in the tables
+bool commitTransaction(const vector<TxChange>& changes) {
+    ProfileSpan span("tx", "commitTransaction");
+    TxLogLock log;
+    long long reapplied = 0;
+
+    if (!log.isOpen()) {
+        cout << "Error: Could not open " << TX_LOG_FILE << "." << endl;
+        return false;
+    }
+
+    // A transaction left unapplied is finished first, so this one cannot be
+    // replayed ahead of it
+    if (log.pending() && !checkpointLocked(log, false, reapplied)) {
+        cout << "Error: An earlier transaction in " << TX_LOG_FILE << " is still not applied." << endl;
+        return false;
+    }
+
+    string body;
+    for (const auto& change : changes) {
+        body += string(1, change.table) + "|" + (char)change.op + "|" + change.record + "\n";
+    }
+
+    string text = "TX|" + to_string(changes.size()) + "|" + to_string(txChecksum(body)) + "\n" + body;
+    if (!log.append(text, true)) {
+        cout << "Error: Could not write " << TX_LOG_FILE << "." << endl;
+        return false;
+    }
+
+    // The transaction is committed; a failure from here on is replayed from the log
+    if (!applyChanges(changes) || !log.append(TX_APPLIED, false)) {
+        cout << "Error: The transaction could not be stored; it is kept in " << TX_LOG_FILE
+             << " and will be retried." << endl;
+        return false;
+    }
+
+    if (log.size() >= getConfigInt("tx_log_checkpoint_bytes", 256 * 1024) &&
+        !checkpointLocked(log, false, reapplied)) {
+        cout << "Warning: Could not checkpoint " << TX_LOG_FILE << "; it is kept and will be replayed." << endl;
+    }
+    return true;
+}
+
+// Sync the tables the log has changed and empty it
+bool checkpointTransactions() {
+    TxLogLock log;
+    long long reapplied = 0;
+
+    if (!log.isOpen() || log.size() == 0) {
+        return log.isOpen();
+    }
+    if (!checkpointLocked(log, false, reapplied)) {
+        cout << "Error: Could not checkpoint " << TX_LOG_FILE << "; it is kept and will be replayed." << endl;
+        return false;
+    }
+    return true;
+}
+
+// Replay every logged transaction left behind by a crash
+void recoverTransactions() {
+    ProfileSpan span("tx", "recoverTransactions");
+    TxLogLock log;
+    long long reapplied = 0;
+
+    if (!log.isOpen() || log.size() == 0) {
+        return;
+    }
+
+    if (!checkpointLocked(log, true, reapplied)) {
+        cout << "Error: Could not apply the transactions in " << TX_LOG_FILE << "; they are kept and will be retried." << endl;
+        return;
+    }
+    if (reapplied > 0) {
+        cout << "Note: Recovered " << reapplied << " change(s) from an interrupted transaction." << endl;
+    }
+}
+
+// Checkpoint, then hold the log until the change is written
+UnloggedChange::UnloggedChange() : lock(new TxLogLock()) {
+    long long reapplied = 0;
+
+    if (lock->isOpen() && lock->size() > 0 && !checkpointLocked(*lock, false, reapplied)) {
+        cout << "Warning: Could not checkpoint " << TX_LOG_FILE << " before this change." << endl;
+    }
+}
+
+UnloggedChange::~UnloggedChange() {
+}
@@ -0,0 +1,63 @@
+#ifndef TXLOG_H
+#define TXLOG_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "deltastore.h"
+
+using namespace std;
+
+// Tables a transaction can change
+const char TX_VEHICLES = 'V';
+const char TX_SALES = 'S';
+
+// One change inside a transaction
+struct TxChange {
+    char table;       // TX_VEHICLES or TX_SALES
+    ChangeOp op;      // Sales only support CHANGE_INSERT
+    string record;    // Full record, or just the key for deletes
+};
+
+// tourmate.txlog is a write-ahead log. A commit appends one record
+// ("TX|<changes>|<checksum>" then one line per change) and syncs it, which is
+// the only sync it pays; the changes are then applied to the tables without
+// syncing and an "APPLIED" line follows the record. A checkpoint syncs the
+// table files the log names and empties it. Checkpoints run once the log
+// passes tx_log_checkpoint_bytes (default 256 KiB), before any change that
+// bypasses the log (see UnloggedChange) and at exit. The log is shared by
+// every process using the directory and locked while it is written.
+
+// Commit changes to several tables atomically. Returns false, with nothing
+// applied, if the log cannot be written, and false with the transaction kept
+// in the log (to be replayed before the next commit) if applying fails.
+bool commitTransaction(const vector<TxChange>& changes);
+
+// Sync the tables the log has changed and empty it, first replaying a
+// transaction that was logged but not applied. False if that failed; the log
+// is then kept.
+bool checkpointTransactions();
+
+// Replay every transaction in the log, as after a crash or power loss may
+// have lost any unsynced write, then checkpoint. Applying is idempotent, so
+// this is safe at any point.
+void recoverTransactions();
+
+class TxLogLock;
+
+// Held around a change that bypasses the log (a single vehicle change or a
+// whole-table rewrite). It checkpoints first, so replaying the log can never
+// undo the change, and holds commits back until the change is written.
+class UnloggedChange {
+private:
+    unique_ptr<TxLogLock> lock;
+
+public:
+    UnloggedChange();
+    ~UnloggedChange();
+
+    UnloggedChange(const UnloggedChange&) = delete;
+    UnloggedChange& operator=(const UnloggedChange&) = delete;
+};
+
+#endif // TXLOG_H
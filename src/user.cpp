@@ -1,7 +1,9 @@
 #include "user.h"
+#include "prefetch.h"
+#include "fileutil.h"
 #include <iostream>
 #include <fstream>
-#include <sstream>
+#include <mutex>
 
 using namespace std;
 
@@ -47,32 +49,13 @@ void User::setRole(string r) {
 
 // String representation for file storage
 string User::toString() const {
-    ostringstream oss;
-    oss << username << "|" << password << "|" << role;
-    return oss.str();
+    return formatRecordText(*this);
 }
 
 // Create user from string (read from file)
 User User::fromString(string str) {
     User user;
-    stringstream ss(str);
-    string token;
-    
-    // Parse username
-    if (getline(ss, token, '|')) {
-        user.setUsername(token);
-    }
-    
-    // Parse password
-    if (getline(ss, token, '|')) {
-        user.setPassword(token);
-    }
-    
-    // Parse role
-    if (getline(ss, token, '|')) {
-        user.setRole(token);
-    }
-    
+    parseRecordText(str, user);
     return user;
 }
 
@@ -91,7 +74,7 @@ vector<User> loadUsersFromFile() {
         }
         file.close();
     } else {
-        cout << "Warning: Could not open users.txt. Creating default admin user." << endl;
+        loadMessages() << "Warning: Could not open users.txt. Creating default admin user." << endl;
         // Create default admin user if file doesn't exist
         User defaultAdmin("admin", "admin123", "admin");
         users.push_back(defaultAdmin);
@@ -111,15 +94,41 @@ void saveUsersToFile(const vector<User>& users) {
         }
         file.close();
     } else {
-        cout << "Error: Could not open users.txt for writing." << endl;
+        loadMessages() << "Error: Could not open users.txt for writing." << endl;
     }
 }
 
-// Validate user credentials
+// Users table, loaded by the background prefetch and reloaded whenever
+// users.txt changes
+static vector<User> userTable;
+static bool userTableLoaded = false;
+static string userTableStamp;   // fileChangeStamp of users.txt when it was loaded
+static mutex userTableLock;
+
+// Load the users table if it is not loaded yet or users.txt has changed
+// since (userTableLock must be held)
+static void refreshUserTable() {
+    string stamp = fileChangeStamp("users.txt");
+
+    if (!userTableLoaded || stamp != userTableStamp) {
+        userTable = loadUsersFromFile();
+        userTableLoaded = true;
+        userTableStamp = stamp;
+    }
+}
+
+// Load the users table ahead of the first login
+void prefetchUsers() {
+    lock_guard<mutex> guard(userTableLock);
+    refreshUserTable();
+}
+
+// Validate user credentials against the current users.txt
 bool validateUser(const string& username, const string& password, string& role) {
-    vector<User> users = loadUsersFromFile();
+    lock_guard<mutex> guard(userTableLock);
+    refreshUserTable();
     
-    for (const auto& user : users) {
+    for (const auto& user : userTable) {
         if (user.getUsername() == username && user.getPassword() == password) {
             role = user.getRole();
             return true;
@@ -127,4 +136,4 @@ bool validateUser(const string& username, const string& password, string& role)
     }
     
     return false;
-}
\ No newline at end of file
+}
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include "schema.h"
 
 using namespace std;
 
@@ -12,6 +13,8 @@ private:
     string password;
     string role; // admin, staff, etc.
 
+    friend struct RecordSchema<User>;
+
 public:
     // Constructor
     User(string uname, string pwd, string r);
@@ -36,9 +39,19 @@ public:
     static User fromString(string str);
 };
 
+// Stored user fields, in file order (see schema.h)
+template <>
+struct RecordSchema<User> {
+    static constexpr auto fields = make_tuple(
+        schemaField("username", &User::username),
+        schemaField("password", &User::password),
+        schemaField("role", &User::role));
+};
+
 // Function prototypes for user management
 vector<User> loadUsersFromFile();
 void saveUsersToFile(const vector<User>& users);
 bool validateUser(const string& username, const string& password, string& role);
+void prefetchUsers();
 
 #endif // USER_H
\ No newline at end of file
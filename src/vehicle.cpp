@@ -1,9 +1,25 @@
 #include "vehicle.h"
+#include "config.h"
+#include "bktree.h"
+#include "vehicleindex.h"
+#include "query.h"
+#include "slotfile.h"
+#include "fileutil.h"
+#include "trace.h"
+#include "profile.h"
+#include "changelog.h"
+#include "replica.h"
+#include "resultcache.h"
+#include "prefetch.h"
 #include <iostream>
 #include <fstream>
-#include <sstream>
+#include <iomanip>
 #include <limits>
 #include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <memory>
+#include <mutex>
 
 using namespace std;
 
@@ -30,11 +46,11 @@ Vehicle::Vehicle() {
 }
 
 // Getters
-string Vehicle::getVehicleId() const {
+const string& Vehicle::getVehicleId() const {
     return vehicleId;
 }
 
-string Vehicle::getMakeModel() const {
+const string& Vehicle::getMakeModel() const {
     return makeModel;
 }
 
@@ -42,15 +58,15 @@ int Vehicle::getYear() const {
     return year;
 }
 
-string Vehicle::getType() const {
+const string& Vehicle::getType() const {
     return type;
 }
 
-string Vehicle::getRegistrationNumber() const {
+const string& Vehicle::getRegistrationNumber() const {
     return registrationNumber;
 }
 
-string Vehicle::getStatus() const {
+const string& Vehicle::getStatus() const {
     return status;
 }
 
@@ -100,93 +116,282 @@ void Vehicle::displayDetails() const {
 
 // String representation for file storage
 string Vehicle::toString() const {
-    ostringstream oss;
-    oss << vehicleId << "|" << makeModel << "|" << year << "|" 
-        << type << "|" << registrationNumber << "|" << status << "|" << ratePerDay;
-    return oss.str();
+    return formatRecordText(*this);
 }
 
 // Create vehicle from string (read from file)
-Vehicle Vehicle::fromString(string str) {
+Vehicle Vehicle::fromString(const string& str) {
     Vehicle vehicle;
-    stringstream ss(str);
-    string token;
-    
-    // Parse vehicle ID
-    if (getline(ss, token, '|')) {
-        vehicle.setVehicleId(token);
-    }
-    
-    // Parse make/model
-    if (getline(ss, token, '|')) {
-        vehicle.setMakeModel(token);
+    parseRecordText(str, vehicle);
+    return vehicle;
+}
+
+// Open the configured vehicle table in the current data directory,
+// converting the text table on first use of the slot file
+static unique_ptr<RecordStore> openVehicleStore() {
+    long long compactBytes = getConfigInt("delta_compact_bytes", 64 * 1024);
+    string textFile = dataPath("vehicles.txt");
+    string slotFile = dataPath("vehicles.dat");
+    
+    if (getConfigString("vehicle_storage", "delta") != "fixed") {
+        return unique_ptr<RecordStore>(new DeltaStore(textFile, compactBytes));
     }
     
-    // Parse year
-    if (getline(ss, token, '|')) {
-        vehicle.setYear(stoi(token));
-    }
+    unique_ptr<RecordStore> store(new SlotFile(slotFile, getConfigInt("slot_width", 128)));
     
-    // Parse type
-    if (getline(ss, token, '|')) {
-        vehicle.setType(token);
+    if (!fileExists(slotFile) && fileExists(textFile)) {
+        vector<string> records;
+        {
+            DeltaStore text(textFile, compactBytes);
+            text.load(records);
+        }
+        store->rewrite(records);
+        
+        // The delta's changes are now in vehicles.dat
+        replaceFile(textFile, textFile + ".migrated");
+        remove((textFile + ".delta").c_str());
+        remove((textFile + ".delta.compacting").c_str());
+        loadMessages() << "Note: " << textFile << " was converted to " << slotFile << " (" << records.size()
+             << " vehicle(s)); the original was kept as " << textFile << ".migrated." << endl;
     }
     
-    // Parse registration number
-    if (getline(ss, token, '|')) {
-        vehicle.setRegistrationNumber(token);
+    return store;
+}
+
+// Vehicle table: vehicles.txt snapshot plus vehicles.txt.delta change log by
+// default, or the fixed-width vehicles.dat slot file with vehicle_storage=fixed
+static RecordStore& vehicleStore() {
+    static unique_ptr<RecordStore> store = openVehicleStore();
+    return *store;
+}
+
+// Fuzzy make/model index, built on the first fuzzy search and kept current by
+// saveVehicleChange. Every read and write holds makeModelIndexLock.
+static FuzzyIndex makeModelIndex;
+static mutex makeModelIndexLock;
+
+// Search the index, building it first if needed
+static vector<FuzzyMatch> searchMakeModelIndex(const VehicleIndex& vehicles, const string& searchTerm,
+                                               int maxDistance) {
+    lock_guard<mutex> guard(makeModelIndexLock);
+    if (!makeModelIndex.isLoaded()) {
+        ProfileSpan span("index", "buildMakeModelIndex");
+        for (const Vehicle* vehicle : vehicles.all()) {
+            makeModelIndex.replace(vehicle->getVehicleId(), vehicle->getMakeModel());
+        }
+        makeModelIndex.setLoaded(true);
     }
-    
-    // Parse status
-    if (getline(ss, token, '|')) {
-        vehicle.setStatus(token);
+    return makeModelIndex.search(searchTerm, maxDistance);
+}
+
+// One vehicle by ID, without loading the table when the store can look it up
+bool findVehicleById(const string& id, Vehicle& vehicle) {
+    string record;
+    if (vehicleStore().find(id, record)) {
+        vehicle = Vehicle::fromString(record);
+        return true;
     }
-    
-    // Parse rate per day
-    if (getline(ss, token, '|')) {
-        vehicle.setRatePerDay(stod(token));
+
+    LockedVehicleIndex index = vehicleIndex();
+    const Vehicle* found = index->find(id);
+    if (found == nullptr) {
+        return false;
     }
-    
-    return vehicle;
+    vehicle = *found;
+    return true;
 }
 
 // Load vehicles from file
 vector<Vehicle> loadVehiclesFromFile() {
+    ProfileSpan span("file", "loadVehiclesFromFile");
     vector<Vehicle> vehicles;
-    ifstream file("vehicles.txt");
-    string line;
-    
-    if (file.is_open()) {
-        while (getline(file, line)) {
-            if (!line.empty()) {
-                Vehicle vehicle = Vehicle::fromString(line);
-                vehicles.push_back(vehicle);
-            }
+    vector<string> records;
+    
+    if (vehicleStore().load(records)) {
+        vehicles.reserve(records.size());
+        for (const auto& record : records) {
+            vehicles.push_back(Vehicle::fromString(record));
         }
-        file.close();
     } else {
-        cout << "Warning: Could not open vehicles.txt. A new file will be created when vehicles are added." << endl;
+        loadMessages() << "Warning: Could not open vehicles.txt. A new file will be created when vehicles are added." << endl;
     }
     
     return vehicles;
 }
 
-// Save vehicles to file
+// Read the vehicles of the current data directory through a store of their
+// own, leaving the shared store and indexes alone
+bool loadVehiclesInDataDirectory(vector<Vehicle>& vehicles) {
+    ProfileSpan span("file", "loadVehiclesInDataDirectory");
+    vector<string> records;
+    string slotFile = dataPath("vehicles.dat");
+    bool found;
+    
+    // Read-only: a vehicles.txt is read as it is, not converted to vehicles.dat
+    if (getConfigString("vehicle_storage", "delta") == "fixed" && fileExists(slotFile)) {
+        found = SlotFile(slotFile, getConfigInt("slot_width", 128)).read(records);
+    } else {
+        found = DeltaStore(dataPath("vehicles.txt"), getConfigInt("delta_compact_bytes", 64 * 1024)).load(records);
+    }
+    if (!found) {
+        return false;
+    }
+    
+    vehicles.reserve(vehicles.size() + records.size());
+    for (const auto& record : records) {
+        vehicles.push_back(Vehicle::fromString(record));
+    }
+    return true;
+}
+
+// Save vehicles to file (full snapshot rewrite)
 void saveVehiclesToFile(const vector<Vehicle>& vehicles) {
-    ofstream file("vehicles.txt");
+    ProfileSpan span("file", "saveVehiclesToFile");
+    UnloggedChange unlogged;
+    vector<string> records;
+    records.reserve(vehicles.size());
     
-    if (file.is_open()) {
-        for (const auto& vehicle : vehicles) {
-            file << vehicle.toString() << endl;
+    for (const auto& vehicle : vehicles) {
+        records.push_back(vehicle.toString());
+    }
+    
+    vehicleStore().rewrite(records);
+    
+    // Rebuilt from the new snapshot on next use
+    {
+        lock_guard<mutex> guard(makeModelIndexLock);
+        makeModelIndex.clear();
+    }
+    resetVehicleIndex();
+    noteTableStored(TX_VEHICLES);
+}
+
+// Drop the in-memory vehicle indexes (rebuilt from file on next use)
+void resetVehicleCaches() {
+    {
+        lock_guard<mutex> guard(makeModelIndexLock);
+        makeModelIndex.clear();
+    }
+    resetVehicleIndex();
+    noteTableChanged(TX_VEHICLES);
+}
+
+// Drop the in-memory vehicle indexes if another process changed the files
+void refreshVehicleCaches() {
+    if (tableFilesChanged(TX_VEHICLES)) {
+        resetVehicleCaches();
+    }
+}
+
+// Layout version of the vehicle store
+unsigned long long vehicleStoreLayout() {
+    return vehicleStore().layoutVersion();
+}
+
+// Keep the in-memory indexes current after a vehicle change is stored
+static void noteStoredVehicleChange(ChangeOp op, const Vehicle& vehicle) {
+    noteVehicleChange(op, vehicle);
+    
+    lock_guard<mutex> guard(makeModelIndexLock);
+    if (makeModelIndex.isLoaded()) {
+        if (op == CHANGE_DELETE) {
+            makeModelIndex.remove(vehicle.getVehicleId());
+        } else {
+            makeModelIndex.replace(vehicle.getVehicleId(), vehicle.getMakeModel());
         }
-        file.close();
+    }
+}
+
+// Record a single vehicle change in the delta log instead of rewriting the file
+bool saveVehicleChange(ChangeOp op, const Vehicle& vehicle) {
+    ProfileSpan span("file", "saveVehicleChange");
+    UnloggedChange unlogged;
+    string record = op == CHANGE_DELETE ? vehicle.getVehicleId() : vehicle.toString();
+    if (!vehicleStore().append(op, record)) {
+        return false;
+    }
+    bool saved = logChanges(vector<TxChange>(1, TxChange{TX_VEHICLES, op, record}));
+    noteStoredVehicleChange(op, vehicle);
+    noteTableStored(TX_VEHICLES);
+    return saved;
+}
+
+// Explain a change saveVehicleChange reported as failed: either nothing was
+// stored, or it was stored but the change log missed it
+static void reportFailedVehicleChange(ChangeOp op, const Vehicle& vehicle, const string& action) {
+    Vehicle stored;
+    bool found = findVehicleById(vehicle.getVehicleId(), stored);
+    
+    if (op == CHANGE_DELETE ? !found : found && stored.toString() == vehicle.toString()) {
+        cout << "\nWarning: The vehicle was " << action << ", but not recorded in the change log; "
+             << "replicas and event subscribers will not see this change." << endl;
     } else {
-        cout << "Error: Could not open vehicles.txt for writing." << endl;
+        cout << "\nError: The vehicle could not be " << action << "." << endl;
+    }
+}
+
+// Record several vehicle changes with one write to the vehicle store
+bool saveVehicleChanges(const vector<pair<ChangeOp, Vehicle>>& changes) {
+    ProfileSpan span("file", "saveVehicleChanges");
+    vector<pair<ChangeOp, string>> records;
+    vector<TxChange> logged;
+    records.reserve(changes.size());
+    
+    for (const auto& change : changes) {
+        const Vehicle& vehicle = change.second;
+        records.push_back({change.first, change.first == CHANGE_DELETE ? vehicle.getVehicleId() : vehicle.toString()});
+        logged.push_back({TX_VEHICLES, change.first, records.back().second});
+    }
+    if (!vehicleStore().appendBatch(records)) {
+        return false;
+    }
+    bool saved = logChanges(logged);
+    
+    for (const auto& change : changes) {
+        noteStoredVehicleChange(change.first, change.second);
+    }
+    noteTableStored(TX_VEHICLES);
+    return saved;
+}
+
+// Flush the vehicle store's files to disk
+bool syncVehicleStore() {
+    return vehicleStore().sync();
+}
+
+// Next free vehicle ID (one past the highest numeric suffix in use)
+static string nextVehicleId(const vector<Vehicle>& vehicles) {
+    long long highest = 0;
+    
+    for (const auto& vehicle : vehicles) {
+        const string& id = vehicle.getVehicleId();
+        if (id.size() > 1 && id[0] == 'V') {
+            highest = max(highest, atoll(id.c_str() + 1));
+        }
     }
+    
+    return "V" + to_string(highest + 1);
 }
 
-// View all vehicles
+// View all vehicles, in file order or sorted by a field
 void viewAllVehicles() {
+    string sortText, error;
+    SortOrder order;
+    
+    cout << "Sort by field, optionally with asc/desc (Enter for file order): ";
+    getline(cin, sortText);
+    if (!parseVehicleSortOrder(sortText, order, error)) {
+        cout << "Invalid sort order: " << error << endl;
+        return;
+    }
+    
+    if (!order.field.empty()) {
+        traceOperation("vehicle.list", order.field + (order.descending ? " desc" : ""));
+        printSortedVehicles(order);
+        return;
+    }
+    
+    traceOperation("vehicle.list");
     vector<Vehicle> vehicles = loadVehiclesFromFile();
     
     if (vehicles.empty()) {
@@ -206,6 +411,10 @@ void viewAllVehicles() {
 
 // Add a new vehicle
 void addVehicle() {
+    if (refuseChangeOnReplica()) {
+        return;
+    }
+    
     vector<Vehicle> vehicles = loadVehiclesFromFile();
     Vehicle newVehicle;
     string input;
@@ -214,8 +423,8 @@ void addVehicle() {
     
     cout << "\n===== ADD NEW VEHICLE =====\n";
     
-    // Generate a vehicle ID (could be made more sophisticated)
-    string vehicleId = "V" + to_string(vehicles.size() + 1);
+    // Generate a vehicle ID that does not reuse the ID of a deleted vehicle
+    string vehicleId = nextVehicleId(vehicles);
     newVehicle.setVehicleId(vehicleId);
     
     // Get vehicle details from user
@@ -245,17 +454,22 @@ void addVehicle() {
     cin.ignore(numeric_limits<streamsize>::max(), '\n');
     newVehicle.setRatePerDay(rateInput);
     
-    // Add the new vehicle to the vector
-    vehicles.push_back(newVehicle);
-    
-    // Save the updated vehicles to file
-    saveVehiclesToFile(vehicles);
+    // Record the new vehicle
+    if (!saveVehicleChange(CHANGE_INSERT, newVehicle)) {
+        reportFailedVehicleChange(CHANGE_INSERT, newVehicle, "saved");
+        return;
+    }
+    traceOperation("vehicle.add", newVehicle.toString());
     
     cout << "\nVehicle added successfully with ID: " << vehicleId << endl;
 }
 
 // Update an existing vehicle
 void updateVehicle() {
+    if (refuseChangeOnReplica()) {
+        return;
+    }
+    
     vector<Vehicle> vehicles = loadVehiclesFromFile();
     
     if (vehicles.empty()) {
@@ -323,8 +537,12 @@ void updateVehicle() {
             vehicle.setRatePerDay(rateInput);
         }
         
-        // Save the updated vehicles to file
-        saveVehiclesToFile(vehicles);
+        // Record the updated vehicle
+        if (!saveVehicleChange(CHANGE_UPDATE, vehicle)) {
+            reportFailedVehicleChange(CHANGE_UPDATE, vehicle, "saved");
+            return;
+        }
+        traceOperation("vehicle.update", vehicle.toString());
         
         cout << "\nVehicle updated successfully!" << endl;
     } else {
@@ -334,6 +552,10 @@ void updateVehicle() {
 
 // Delete a vehicle
 void deleteVehicle() {
+    if (refuseChangeOnReplica()) {
+        return;
+    }
+    
     vector<Vehicle> vehicles = loadVehiclesFromFile();
     
     if (vehicles.empty()) {
@@ -361,8 +583,11 @@ void deleteVehicle() {
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
         
         if (tolower(confirmation) == 'y') {
-            vehicles.erase(it);
-            saveVehiclesToFile(vehicles);
+            if (!saveVehicleChange(CHANGE_DELETE, *it)) {
+                reportFailedVehicleChange(CHANGE_DELETE, *it, "deleted");
+                return;
+            }
+            traceOperation("vehicle.delete", it->getVehicleId());
             cout << "\nVehicle deleted successfully!" << endl;
         } else {
             cout << "\nDeletion cancelled." << endl;
@@ -372,18 +597,85 @@ void deleteVehicle() {
     }
 }
 
+// Fuzzy make/model lookup through the BK-tree index
+vector<FuzzyMatch> findVehiclesFuzzy(const string& searchTerm, int maxDistance) {
+    ProfileSpan span("index", "findVehiclesFuzzy");
+    LockedVehicleIndex index = vehicleIndex();
+    return searchMakeModelIndex(*index, searchTerm, maxDistance);
+}
+
+// Ranked fuzzy make/model search through the BK-tree index
+static void searchVehiclesFuzzy(const string& searchTerm, int maxDistance) {
+    traceOperation("vehicle.fuzzy", searchTerm + "|" + to_string(maxDistance));
+    vector<FuzzyMatch> matches = findVehiclesFuzzy(searchTerm, maxDistance);
+    
+    if (matches.empty()) {
+        cout << "\nNo vehicles within " << maxDistance << " edit(s) of \"" << searchTerm << "\"." << endl;
+        return;
+    }
+    
+    cout << "\nSearch Results (closest first):\n";
+    
+    LockedVehicleIndex index = vehicleIndex();
+    for (const auto& match : matches) {
+        cout << "\n\"" << match.term << "\" (distance " << match.distance << ")" << endl;
+        for (const auto& id : match.ids) {
+            const Vehicle* vehicle = index->find(id);
+            if (vehicle != nullptr) {
+                cout << "------------------------" << endl;
+                vehicle->displayDetails();
+            }
+        }
+    }
+}
+
+// List vehicles with rate in [low, high], cheapest first
+void printVehiclesByRate(double low, double high, const string& type, const string& status) {
+    traceOperation("vehicle.rates", to_string(low) + "|" + to_string(high) + "|" + type + "|" + status);
+    if (low > high) {
+        cout << "Error: Minimum rate is above maximum rate." << endl;
+        return;
+    }
+
+    LockedVehicleIndex index = vehicleIndex();
+    vector<string> ids = index->idsByRate(type, status, low, high);
+
+    cout << "\nVehicles from $" << fixed << setprecision(2) << low << " to $" << high << " per day:\n";
+    for (const string& id : ids) {
+        cout << "------------------------" << endl;
+        index->find(id)->displayDetails();
+    }
+
+    if (ids.empty()) {
+        cout << "No matching vehicles found." << endl;
+    }
+}
+
+// Show the cheapest vehicle of a type and/or status
+void printCheapestVehicle(const string& type, const string& status) {
+    traceOperation("vehicle.cheapest", type + "|" + status);
+    LockedVehicleIndex index = vehicleIndex();
+    const Vehicle* vehicle = index->rateExtreme(type, status, false);
+
+    if (vehicle == nullptr) {
+        cout << "No matching vehicles found." << endl;
+        return;
+    }
+
+    cout << "\nCheapest match:\n";
+    cout << "------------------------" << endl;
+    vehicle->displayDetails();
+}
+
 // Search for vehicles
 void searchVehicle() {
-    vector<Vehicle> vehicles = loadVehiclesFromFile();
-    
-    if (vehicles.empty()) {
+    if (vehicleIndex()->size() == 0) {
         cout << "No vehicles found in the system." << endl;
         return;
     }
     
     int searchOption;
     string searchTerm;
-    bool found = false;
     
     cout << "\n===== SEARCH VEHICLE =====\n";
     cout << "Search by:\n";
@@ -392,48 +684,82 @@ void searchVehicle() {
     cout << "3. Registration Number\n";
     cout << "4. Type\n";
     cout << "5. Status\n";
+    cout << "6. Make/Model (fuzzy, tolerates typos)\n";
+    cout << "7. Combined Query\n";
+    cout << "8. Rate Range (sorted by price)\n";
+    cout << "9. Cheapest by Type/Status\n";
     cout << "Enter your choice: ";
     
     cin >> searchOption;
     cin.ignore(numeric_limits<streamsize>::max(), '\n');
     
-    cout << "Enter search term: ";
-    getline(cin, searchTerm);
-    
-    cout << "\nSearch Results:\n";
+    if (searchOption < 1 || searchOption > 9) {
+        cout << "Invalid search option." << endl;
+        return;
+    }
     
-    for (const auto& vehicle : vehicles) {
-        bool match = false;
+    if (searchOption == 8 || searchOption == 9) {
+        string type, status;
+        double low = 0, high = 0;
         
-        switch (searchOption) {
-            case 1: // Vehicle ID
-                match = vehicle.getVehicleId() == searchTerm;
-                break;
-            case 2: // Make/Model
-                match = vehicle.getMakeModel().find(searchTerm) != string::npos;
-                break;
-            case 3: // Registration Number
-                match = vehicle.getRegistrationNumber() == searchTerm;
-                break;
-            case 4: // Type
-                match = vehicle.getType() == searchTerm;
-                break;
-            case 5: // Status
-                match = vehicle.getStatus() == searchTerm;
-                break;
-            default:
-                cout << "Invalid search option." << endl;
-                return;
+        if (searchOption == 8) {
+            cout << "Enter minimum rate per day: $";
+            cin >> low;
+            cout << "Enter maximum rate per day: $";
+            cin >> high;
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
         }
+        cout << "Enter type (blank for any): ";
+        getline(cin, type);
+        cout << "Enter status (blank for any): ";
+        getline(cin, status);
         
-        if (match) {
-            found = true;
-            cout << "------------------------" << endl;
-            vehicle.displayDetails();
+        if (searchOption == 8) {
+            printVehiclesByRate(low, high, type, status);
+        } else {
+            printCheapestVehicle(type, status);
         }
+        return;
     }
     
-    if (!found) {
-        cout << "No matching vehicles found." << endl;
+    Query query;
+    string error;
+    
+    if (searchOption == 7) {
+        printQueryHelp();
+        cout << "Enter query: ";
+        getline(cin, searchTerm);
+        if (!parseVehicleQuery(searchTerm, query, error)) {
+            cout << "Invalid query: " << error << endl;
+            return;
+        }
+        printVehicleQuery(query, false);
+        return;
     }
-}
\ No newline at end of file
+    
+    cout << "Enter search term: ";
+    getline(cin, searchTerm);
+    
+    switch (searchOption) {
+        case 1: // Vehicle ID
+            addVehiclePredicate(query, "id", OP_EQ, searchTerm, error);
+            break;
+        case 2: // Make/Model
+            addVehiclePredicate(query, "make", OP_CONTAINS, searchTerm, error);
+            break;
+        case 3: // Registration Number
+            addVehiclePredicate(query, "reg", OP_EQ, searchTerm, error);
+            break;
+        case 4: // Type
+            addVehiclePredicate(query, "type", OP_EQ, searchTerm, error);
+            break;
+        case 5: // Status
+            addVehiclePredicate(query, "status", OP_EQ, searchTerm, error);
+            break;
+        case 6: // Make/Model (fuzzy)
+            searchVehiclesFuzzy(searchTerm, readMaxEditDistance(2));
+            return;
+    }
+    
+    printVehicleQuery(query, false);
+}
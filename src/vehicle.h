@@ -3,6 +3,9 @@
 
 #include <string>
 #include <vector>
+#include "deltastore.h"
+#include "bktree.h"
+#include "schema.h"
 
 using namespace std;
 
@@ -16,6 +19,8 @@ private:
     string status; // Available, In maintenance, etc.
     double ratePerDay;
 
+    friend struct RecordSchema<Vehicle>;
+
 public:
     // Constructor
     Vehicle(string id, string make, int yr, string tp, string reg, string st, double rate);
@@ -24,12 +29,12 @@ public:
     Vehicle();
     
     // Getters
-    string getVehicleId() const;
-    string getMakeModel() const;
+    const string& getVehicleId() const;
+    const string& getMakeModel() const;
     int getYear() const;
-    string getType() const;
-    string getRegistrationNumber() const;
-    string getStatus() const;
+    const string& getType() const;
+    const string& getRegistrationNumber() const;
+    const string& getStatus() const;
     double getRatePerDay() const;
     
     // Setters
@@ -48,7 +53,20 @@ public:
     string toString() const;
     
     // Create vehicle from string (read from file)
-    static Vehicle fromString(string str);
+    static Vehicle fromString(const string& str);
+};
+
+// Stored vehicle fields, in file order (see schema.h)
+template <>
+struct RecordSchema<Vehicle> {
+    static constexpr auto fields = make_tuple(
+        schemaField("id", &Vehicle::vehicleId),
+        schemaField("make", &Vehicle::makeModel),
+        schemaField("year", &Vehicle::year),
+        schemaField("type", &Vehicle::type),
+        schemaField("reg", &Vehicle::registrationNumber),
+        schemaField("status", &Vehicle::status),
+        schemaField("rate", &Vehicle::ratePerDay));
 };
 
 // Function prototypes for vehicle management
@@ -57,7 +75,33 @@ void addVehicle();
 void updateVehicle();
 void deleteVehicle();
 void searchVehicle();
+void printVehiclesByRate(double low, double high, const string& type, const string& status);
+void printCheapestVehicle(const string& type, const string& status);
+// Make/models within maxDistance edits of searchTerm, closest first; ids are vehicle IDs
+vector<FuzzyMatch> findVehiclesFuzzy(const string& searchTerm, int maxDistance);
 vector<Vehicle> loadVehiclesFromFile();
+// The vehicle with this ID, read by one positioned read when the store is a
+// slot file (vehicle_storage=fixed) and from the vehicle index otherwise;
+// false if there is none
+bool findVehicleById(const string& id, Vehicle& vehicle);
+// Vehicles of this thread's data directory (see fileutil.h), read without the
+// shared store and without converting vehicles.txt to vehicles.dat; false if none
+bool loadVehiclesInDataDirectory(vector<Vehicle>& vehicles);
 void saveVehiclesToFile(const vector<Vehicle>& vehicles);
+// Record one vehicle change in the vehicle store; false if it could not be
+// written or the change log could not be (the store then holds it)
+bool saveVehicleChange(ChangeOp op, const Vehicle& vehicle);
+// Record several vehicle changes with one write to the vehicle store; false if
+// they could not be written
+bool saveVehicleChanges(const vector<pair<ChangeOp, Vehicle>>& changes);
+// Flush the vehicle store's files to disk; false if they could not be synced
+bool syncVehicleStore();
+// Drop the in-memory vehicle indexes, e.g. after another process changed the files
+void resetVehicleCaches();
+// Drop them only if another process has changed the vehicle store since
+// this one last stored to or checked it
+void refreshVehicleCaches();
+// Layout version of the vehicle store (see RecordStore::layoutVersion)
+unsigned long long vehicleStoreLayout();
 
 #endif // VEHICLE_H
\ No newline at end of file
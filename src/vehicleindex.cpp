@@ -0,0 +1,332 @@
+#include "vehicleindex.h"
+#include "profile.h"
+#include "fleetstatus.h"
+#include <algorithm>
+#include <mutex>
+
+using namespace std;
+
+static const unordered_set<string> EMPTY_IDS;
+
+// Constructor
+VehicleIndex::VehicleIndex() {
+    clear();
+}
+
+void VehicleIndex::clear() {
+    byId.clear();
+    byType.clear();
+    byStatus.clear();
+    byRegistration.clear();
+    byRate.clear();
+    byYear.clear();
+    nextSequence = 0;
+    loaded = false;
+}
+
+void VehicleIndex::link(const Vehicle& vehicle) {
+    byType[vehicle.getType()].insert(vehicle.getVehicleId());
+    byStatus[vehicle.getStatus()].insert(vehicle.getVehicleId());
+    byRegistration[vehicle.getRegistrationNumber()].insert(vehicle.getVehicleId());
+
+    pair<string, string> partition = make_pair(vehicle.getType(), vehicle.getStatus());
+    byRate[partition].insert(make_pair(vehicle.getRatePerDay(), vehicle.getVehicleId()));
+    byYear[partition].insert(make_pair(vehicle.getYear(), vehicle.getVehicleId()));
+}
+
+static void unlinkFrom(unordered_map<string, unordered_set<string>>& index, const string& value, const string& id) {
+    auto it = index.find(value);
+    if (it != index.end()) {
+        it->second.erase(id);
+        if (it->second.empty()) {
+            index.erase(it);
+        }
+    }
+}
+
+void VehicleIndex::unlink(const Vehicle& vehicle) {
+    unlinkFrom(byType, vehicle.getType(), vehicle.getVehicleId());
+    unlinkFrom(byStatus, vehicle.getStatus(), vehicle.getVehicleId());
+    unlinkFrom(byRegistration, vehicle.getRegistrationNumber(), vehicle.getVehicleId());
+
+    pair<string, string> partition = make_pair(vehicle.getType(), vehicle.getStatus());
+    auto rates = byRate.find(partition);
+    if (rates != byRate.end()) {
+        rates->second.erase(make_pair(vehicle.getRatePerDay(), vehicle.getVehicleId()));
+        if (rates->second.empty()) {
+            byRate.erase(rates);
+        }
+    }
+    auto years = byYear.find(partition);
+    if (years != byYear.end()) {
+        years->second.erase(make_pair(vehicle.getYear(), vehicle.getVehicleId()));
+        if (years->second.empty()) {
+            byYear.erase(years);
+        }
+    }
+}
+
+// Range scan over every (type, status) partition matching the filters
+template <class Key>
+static vector<string> orderedRange(const map<pair<string, string>, set<pair<Key, string>>>& index,
+                                   const string& type, const string& status, Key low, Key high, size_t limit) {
+    vector<pair<Key, string>> found;
+    size_t partitionsUsed = 0;
+
+    // With a type given, only its partitions are visited
+    auto it = type.empty() ? index.begin() : index.lower_bound(make_pair(type, string()));
+
+    for (; it != index.end() && (type.empty() || it->first.first == type) && found.size() <= limit; ++it) {
+        if (!status.empty() && it->first.second != status) {
+            continue;
+        }
+        partitionsUsed++;
+
+        const set<pair<Key, string>>& entries = it->second;
+        for (auto entry = entries.lower_bound(make_pair(low, string()));
+             entry != entries.end() && entry->first <= high; ++entry) {
+            if (found.size() > limit) {
+                break;
+            }
+            found.push_back(*entry);
+        }
+    }
+
+    // Partitions are each sorted; merge them into one ordering
+    if (partitionsUsed > 1) {
+        sort(found.begin(), found.end());
+    }
+
+    vector<string> ids;
+    ids.reserve(found.size());
+    for (const auto& entry : found) {
+        ids.push_back(entry.second);
+    }
+    return ids;
+}
+
+// Move an ID between the sets of an ordered index when its entry changes
+template <class Key>
+static void relinkOrdered(map<pair<string, string>, set<pair<Key, string>>>& index,
+                          const pair<string, string>& oldPartition, Key oldKey,
+                          const pair<string, string>& newPartition, Key newKey, const string& id) {
+    if (oldPartition == newPartition && oldKey == newKey) {
+        return;
+    }
+    auto old = index.find(oldPartition);
+    if (old != index.end()) {
+        old->second.erase(make_pair(oldKey, id));
+        if (old->second.empty()) {
+            index.erase(old);
+        }
+    }
+    index[newPartition].insert(make_pair(newKey, id));
+}
+
+// Move an ID between the sets of a hash index when its field changes
+static void relinkHashed(unordered_map<string, unordered_set<string>>& index, const string& oldValue,
+                         const string& newValue, const string& id) {
+    if (oldValue != newValue) {
+        unlinkFrom(index, oldValue, id);
+        index[newValue].insert(id);
+    }
+}
+
+// Re-file an updated vehicle, touching only the indexes whose key changed
+// (a status change, say, leaves the type and registration indexes alone)
+void VehicleIndex::relink(const Vehicle& before, const Vehicle& after) {
+    const string& id = after.getVehicleId();
+    relinkHashed(byType, before.getType(), after.getType(), id);
+    relinkHashed(byStatus, before.getStatus(), after.getStatus(), id);
+    relinkHashed(byRegistration, before.getRegistrationNumber(), after.getRegistrationNumber(), id);
+
+    pair<string, string> oldPartition = make_pair(before.getType(), before.getStatus());
+    pair<string, string> newPartition = make_pair(after.getType(), after.getStatus());
+    relinkOrdered(byRate, oldPartition, before.getRatePerDay(), newPartition, after.getRatePerDay(), id);
+    relinkOrdered(byYear, oldPartition, before.getYear(), newPartition, after.getYear(), id);
+}
+
+// Apply one insert, update or delete
+void VehicleIndex::apply(ChangeOp op, const Vehicle& vehicle) {
+    auto it = byId.find(vehicle.getVehicleId());
+
+    if (it != byId.end()) {
+        if (op == CHANGE_DELETE) {
+            unlink(it->second.vehicle);
+            byId.erase(it);
+            return;
+        }
+        relink(it->second.vehicle, vehicle);
+        it->second.vehicle = vehicle;
+        return;
+    } else if (op == CHANGE_DELETE) {
+        return;
+    } else {
+        Entry entry = {nextSequence++, vehicle};
+        byId.emplace(vehicle.getVehicleId(), entry);
+    }
+
+    link(vehicle);
+}
+
+// Lookup by vehicle ID
+const Vehicle* VehicleIndex::find(const string& id) const {
+    auto it = byId.find(id);
+    return it != byId.end() ? &it->second.vehicle : nullptr;
+}
+
+// True if the field has a hash index
+bool VehicleIndex::isIndexed(const string& field) {
+    return field == "type" || field == "status" || field == "reg";
+}
+
+// IDs of vehicles whose field equals value
+const unordered_set<string>* VehicleIndex::idsWith(const string& field, const string& value) const {
+    const unordered_map<string, unordered_set<string>>* index = nullptr;
+
+    if (field == "type") {
+        index = &byType;
+    } else if (field == "status") {
+        index = &byStatus;
+    } else if (field == "reg") {
+        index = &byRegistration;
+    } else {
+        return nullptr;
+    }
+
+    auto it = index->find(value);
+    return it != index->end() ? &it->second : &EMPTY_IDS;
+}
+
+// IDs with rate in [low, high], cheapest first
+vector<string> VehicleIndex::idsByRate(const string& type, const string& status, double low, double high,
+                                       size_t limit) const {
+    return orderedRange(byRate, type, status, low, high, limit);
+}
+
+// IDs with year in [low, high], oldest first
+vector<string> VehicleIndex::idsByYear(const string& type, const string& status, int low, int high,
+                                       size_t limit) const {
+    return orderedRange(byYear, type, status, low, high, limit);
+}
+
+// Cheapest (or most expensive) vehicle of a type and/or status
+const Vehicle* VehicleIndex::rateExtreme(const string& type, const string& status, bool highest) const {
+    const pair<double, string>* best = nullptr;
+    auto it = type.empty() ? byRate.begin() : byRate.lower_bound(make_pair(type, string()));
+
+    // The first or last entry of each matching partition is its extreme
+    for (; it != byRate.end() && (type.empty() || it->first.first == type); ++it) {
+        if (!status.empty() && it->first.second != status) {
+            continue;
+        }
+        const pair<double, string>& candidate = highest ? *it->second.rbegin() : *it->second.begin();
+        if (best == nullptr || (highest ? *best < candidate : candidate < *best)) {
+            best = &candidate;
+        }
+    }
+
+    return best != nullptr ? find(best->second) : nullptr;
+}
+
+// All vehicles in file order
+vector<const Vehicle*> VehicleIndex::all() const {
+    vector<pair<long long, const Vehicle*>> ordered;
+    ordered.reserve(byId.size());
+
+    for (const auto& entry : byId) {
+        ordered.push_back(make_pair(entry.second.sequence, &entry.second.vehicle));
+    }
+    sort(ordered.begin(), ordered.end());
+
+    vector<const Vehicle*> result;
+    result.reserve(ordered.size());
+    for (const auto& entry : ordered) {
+        result.push_back(entry.second);
+    }
+    return result;
+}
+
+// The given IDs in file order (unknown IDs are skipped)
+vector<const Vehicle*> VehicleIndex::inFileOrder(const vector<string>& ids) const {
+    vector<pair<long long, const Vehicle*>> ordered;
+    ordered.reserve(ids.size());
+
+    for (const auto& id : ids) {
+        auto it = byId.find(id);
+        if (it != byId.end()) {
+            ordered.push_back(make_pair(it->second.sequence, &it->second.vehicle));
+        }
+    }
+    sort(ordered.begin(), ordered.end());
+
+    vector<const Vehicle*> result;
+    result.reserve(ordered.size());
+    for (const auto& entry : ordered) {
+        result.push_back(entry.second);
+    }
+    return result;
+}
+
+size_t VehicleIndex::size() const {
+    return byId.size();
+}
+
+bool VehicleIndex::isLoaded() const {
+    return loaded;
+}
+
+void VehicleIndex::setLoaded(bool value) {
+    loaded = value;
+}
+
+// Shared index instance. The lock lets a background prefetch build it while
+// the first caller waits for it.
+static VehicleIndex sharedIndex;
+static mutex sharedIndexLock;
+
+LockedVehicleIndex::LockedVehicleIndex(unique_lock<mutex>&& guard, const VehicleIndex& index)
+    : guard(move(guard)), index(&index) {
+}
+
+// Shared vehicle index, loaded from file on first use
+LockedVehicleIndex vehicleIndex() {
+    refreshVehicleCaches();
+    unique_lock<mutex> guard(sharedIndexLock);
+    
+    if (!sharedIndex.isLoaded()) {
+        ProfileSpan span("index", "buildVehicleIndex");
+        sharedIndex.clear();
+        FleetCounts counts;
+        for (const auto& vehicle : loadVehiclesFromFile()) {
+            const Vehicle* before = sharedIndex.find(vehicle.getVehicleId());
+            if (before != nullptr) {
+                counts.count(*before, -1);
+            }
+            sharedIndex.apply(CHANGE_INSERT, vehicle);
+            counts.count(vehicle, 1);
+        }
+        sharedIndex.setLoaded(true);
+        publishFleetCounts(counts);
+    }
+    return LockedVehicleIndex(move(guard), sharedIndex);
+}
+
+// Keep the shared index current after a vehicle change is saved
+void noteVehicleChange(ChangeOp op, const Vehicle& vehicle) {
+    lock_guard<mutex> guard(sharedIndexLock);
+    
+    if (sharedIndex.isLoaded()) {
+        // Move the vehicle between the fleet counters as it is re-filed
+        const Vehicle* before = sharedIndex.find(vehicle.getVehicleId());
+        adjustFleetCounts(before, op == CHANGE_DELETE ? nullptr : &vehicle);
+        sharedIndex.apply(op, vehicle);
+    }
+}
+
+// Drop the shared index
+void resetVehicleIndex() {
+    lock_guard<mutex> guard(sharedIndexLock);
+    sharedIndex.clear();
+    resetFleetCounts();
+}
@@ -0,0 +1,109 @@
+#ifndef VEHICLEINDEX_H
+#define VEHICLEINDEX_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include <set>
+#include <climits>
+#include <cfloat>
+#include <cstdint>
+#include <mutex>
+#include "vehicle.h"
+
+using namespace std;
+
+// In-memory vehicle table with hash indexes on the fields searches filter by
+// most (type, status, registration), plus ordered indexes on rate per day and
+// year partitioned by (type, status). Loaded from file on first use and then
+// kept current by every saveVehicleChange, so queries never re-read the file.
+class VehicleIndex {
+private:
+    struct Entry {
+        long long sequence;  // Insertion order, so results keep file order
+        Vehicle vehicle;
+    };
+
+    unordered_map<string, Entry> byId;
+    unordered_map<string, unordered_set<string>> byType;
+    unordered_map<string, unordered_set<string>> byStatus;
+    unordered_map<string, unordered_set<string>> byRegistration;
+    map<pair<string, string>, set<pair<double, string>>> byRate;  // (type, status) -> (rate, id)
+    map<pair<string, string>, set<pair<int, string>>> byYear;      // (type, status) -> (year, id)
+    long long nextSequence;
+    bool loaded;
+
+    void link(const Vehicle& vehicle);
+    void unlink(const Vehicle& vehicle);
+    void relink(const Vehicle& before, const Vehicle& after);
+
+public:
+    // Constructor
+    VehicleIndex();
+
+    void clear();
+
+    // Apply one insert, update or delete
+    void apply(ChangeOp op, const Vehicle& vehicle);
+
+    // Lookup by vehicle ID (nullptr if absent)
+    const Vehicle* find(const string& id) const;
+
+    // IDs of vehicles whose field ("type", "status" or "reg") equals value;
+    // nullptr if the field has no index, an empty set if nothing matches
+    const unordered_set<string>* idsWith(const string& field, const string& value) const;
+
+    // True if the field has a hash index
+    static bool isIndexed(const string& field);
+
+    // IDs with rate in [low, high], cheapest first, optionally limited to one
+    // type and/or status ("" matches any). O(log n + k) per (type, status)
+    // partition. Stops once more than 'limit' IDs have been found.
+    vector<string> idsByRate(const string& type, const string& status, double low, double high,
+                             size_t limit = SIZE_MAX) const;
+
+    // IDs with year in [low, high], oldest first; same rules as idsByRate
+    vector<string> idsByYear(const string& type, const string& status, int low, int high,
+                             size_t limit = SIZE_MAX) const;
+
+    // Cheapest (or most expensive) vehicle of a type and/or status, nullptr if none
+    const Vehicle* rateExtreme(const string& type, const string& status, bool highest) const;
+
+    // All vehicles, or the given IDs, in file order
+    vector<const Vehicle*> all() const;
+    vector<const Vehicle*> inFileOrder(const vector<string>& ids) const;
+
+    size_t size() const;
+    bool isLoaded() const;
+    void setLoaded(bool value);
+};
+
+// The shared vehicle index with its lock held. The index, and the vehicles
+// and ID sets its lookups return, may only be used while the handle lives;
+// copy out what is needed before it goes. A thread holding one must not take
+// another or save a vehicle until it has let it go.
+class LockedVehicleIndex {
+private:
+    unique_lock<mutex> guard;
+    const VehicleIndex* index;
+
+public:
+    LockedVehicleIndex(unique_lock<mutex>&& guard, const VehicleIndex& index);
+
+    const VehicleIndex* operator->() const { return index; }
+    const VehicleIndex& operator*() const { return *index; }
+};
+
+// Shared vehicle index, loaded from file on first use and locked until the
+// returned handle goes
+LockedVehicleIndex vehicleIndex();
+
+// Keep the shared index current after a vehicle change is saved
+void noteVehicleChange(ChangeOp op, const Vehicle& vehicle);
+
+// Drop the shared index (it is reloaded on next use)
+void resetVehicleIndex();
+
+#endif // VEHICLEINDEX_H